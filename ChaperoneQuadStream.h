@@ -0,0 +1,131 @@
+#ifndef ChaperoneQuadStream_h
+#define ChaperoneQuadStream_h
+
+#include "Kernel/OVR_SharedMemory.h"
+#include "Kernel/OVR_Lockless.h"
+
+
+// Converted Chaperone bounds published for out-of-process viewers.
+//
+// The converter writes the latest quad set and origin into a named shared memory region
+// through a LocklessUpdater, so a viewer can poll it without locks while the converter keeps
+// updating. The layout only uses fixed-size types so that 32-bit and 64-bit processes agree.
+
+static const char* const ChaperoneQuadStreamName = "Guardian2Chaperone_QuadStream";
+
+#pragma pack(push, 8)
+
+struct ChaperoneQuad
+{
+    // Same corner order as vr::HmdQuad_t, relative to Origin.
+    float Corners[4][3];
+};
+
+struct ChaperoneQuadSet
+{
+    static const int MaxQuads = 256;
+
+    uint32_t      Sequence;         // Incremented on every publish
+    uint32_t      QuadCount;        // Number of valid entries in Quads
+    uint32_t      TotalQuadCount;   // Number of quads the converter had; more than QuadCount if they didn't all fit
+    float         Origin[3];        // Standing zero position in raw tracking space
+    ChaperoneQuad Quads[MaxQuads];
+
+    bool IsTruncated() const { return TotalQuadCount > QuadCount; }
+};
+
+#pragma pack(pop)
+
+typedef OVR::LocklessUpdater<ChaperoneQuadSet> ChaperoneQuadUpdater;
+
+
+// Writer side, owned by the converter.
+class ChaperoneQuadPublisher
+{
+public:
+    ChaperoneQuadPublisher() : Sequence(0) {}
+
+    bool Open(const char* name = ChaperoneQuadStreamName)
+    {
+        if (!Writer.Open(name))
+        {
+            return false;
+        }
+
+        // The region may be left over from an earlier run, so clear it until the first Publish.
+        memset(&Staging, 0, sizeof(Staging));
+        Writer.Get()->SetState(Staging);
+        return true;
+    }
+
+    // Publishes the first MaxQuads of quadCount quads. Readers can tell that the set was cut short
+    // from ChaperoneQuadSet::IsTruncated. Returns false if the region isn't open.
+    template<class QuadType>
+    bool Publish(const float origin[3], const QuadType* quads, int quadCount)
+    {
+        ChaperoneQuadUpdater* updater = Writer.Get();
+        if (!updater)
+        {
+            return false;
+        }
+
+        ChaperoneQuadSet& set = Staging;
+        set.Sequence = ++Sequence;
+        set.TotalQuadCount = (uint32_t)quadCount;
+
+        if (quadCount > ChaperoneQuadSet::MaxQuads)
+        {
+            quadCount = ChaperoneQuadSet::MaxQuads;
+        }
+
+        set.QuadCount = (uint32_t)quadCount;
+        memcpy(set.Origin, origin, sizeof(set.Origin));
+
+        for (int i = 0; i < quadCount; ++i)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                set.Quads[i].Corners[c][0] = quads[i].vCorners[c].v[0];
+                set.Quads[i].Corners[c][1] = quads[i].vCorners[c].v[1];
+                set.Quads[i].Corners[c][2] = quads[i].vCorners[c].v[2];
+            }
+        }
+
+        updater->SetState(set);
+        return true;
+    }
+
+protected:
+    OVR::SharedObjectWriter<ChaperoneQuadUpdater> Writer;
+    ChaperoneQuadSet Staging;
+    uint32_t Sequence;
+};
+
+
+// Reader side, for viewers. Returns false until the converter has created the region.
+class ChaperoneQuadSubscriber
+{
+public:
+    bool Open(const char* name = ChaperoneQuadStreamName)
+    {
+        return Reader.Open(name);
+    }
+
+    bool GetLatest(ChaperoneQuadSet& out) const
+    {
+        const ChaperoneQuadUpdater* updater = Reader.Get();
+        if (!updater)
+        {
+            return false;
+        }
+
+        out = updater->GetState();
+        return out.Sequence != 0;
+    }
+
+protected:
+    OVR::SharedObjectReader<ChaperoneQuadUpdater> Reader;
+};
+
+
+#endif // ChaperoneQuadStream_h
@@ -0,0 +1,153 @@
+/************************************************************************************
+
+Filename    :   Bench_Allocator.cpp
+Content     :   Compares multithreaded allocation through ThreadCachingHeap with
+                allocation directly from the heap it wraps
+Created     :   October 18, 2026
+Notes       :   See Bench_Common.h for how to build and run.
+
+Copyright   :   Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+
+Licensed under the Oculus VR Rift SDK License Version 3.3 (the "License");
+you may not use the Oculus VR Rift SDK except in compliance with the License,
+which is provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+You may obtain a copy of the License at
+
+http://www.oculusvr.com/licenses/LICENSE-3.3
+
+Unless required by applicable law or agreed to in writing, the Oculus VR SDK
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#include "Bench_Common.h"
+#include "Kernel/OVR_System.h"
+#include "Kernel/OVR_Allocator.h"
+#include <new>
+
+using namespace OVR;
+using namespace OVR::Bench;
+
+OVR_BENCH_SINK_DEFINITION;
+
+
+static const size_t WorkingSetSize = 1024;  // Blocks each thread keeps live in the working set test.
+static const size_t MaxBlockSize   = 1024;  // All sizes are small enough for ThreadCachingHeap's caches.
+
+
+// Creates a DefaultHeap, optionally wrapped by a ThreadCachingHeap. This is the same pairing the
+// Allocator uses when its thread cache is enabled.
+static Heap* CreateHeap(bool threadCaching)
+{
+    Heap* heap = new(SysMemAlloc(sizeof(DefaultHeap))) DefaultHeap;
+    heap->Init();
+
+    if (threadCaching)
+    {
+        heap = new(SysMemAlloc(sizeof(ThreadCachingHeap))) ThreadCachingHeap(heap, sizeof(DefaultHeap));
+        heap->Init();
+    }
+
+    return heap;
+}
+
+
+static void DestroyHeap(Heap* heap, bool threadCaching)
+{
+    heap->Shutdown(); // ThreadCachingHeap also shuts down and frees the DefaultHeap.
+    heap->~Heap();
+    SysMemFree(heap, (threadCaching ? sizeof(ThreadCachingHeap) : sizeof(DefaultHeap)));
+}
+
+
+static void BenchHeap(const char* variant, bool threadCaching, int threadCount, size_t operationCount)
+{
+    const int repeatCount = 5;
+    Heap*     heap = CreateHeap(threadCaching);
+
+    // Each allocation is freed right away, so every thread keeps reusing a few blocks.
+    double seconds = TimeBestThreads(repeatCount, threadCount, [&](int threadIndex)
+    {
+        Random   random(threadIndex + 1);
+        uint64_t sum = 0;
+
+        for (size_t i = 0; i < operationCount; ++i)
+        {
+            char* p = static_cast<char*>(heap->Alloc(1 + (random.Next() % MaxBlockSize)));
+            p[0] = 1;
+            sum += p[0];
+            heap->Free(p);
+        }
+
+        Sink += sum;
+    });
+    Report("Alloc/free pairs", variant, threadCount, seconds, operationCount * threadCount);
+
+    // As above, with 16 byte alignment, which every heap here provides without over-allocating.
+    seconds = TimeBestThreads(repeatCount, threadCount, [&](int threadIndex)
+    {
+        Random   random(threadIndex + 1);
+        uint64_t sum = 0;
+
+        for (size_t i = 0; i < operationCount; ++i)
+        {
+            char* p = static_cast<char*>(heap->AllocAligned(1 + (random.Next() % MaxBlockSize), 16));
+            p[0] = 1;
+            sum += p[0];
+            heap->FreeAligned(p);
+        }
+
+        Sink += sum;
+    });
+    Report("Aligned(16) pairs", variant, threadCount, seconds, operationCount * threadCount);
+
+    // Each thread keeps a working set of live blocks and replaces a random one at a time, which
+    // spreads the work over all size classes and keeps the free lists from being trivially hot.
+    seconds = TimeBestThreads(repeatCount, threadCount, [&](int threadIndex)
+    {
+        Random random(threadIndex + 1);
+        void*  blocks[WorkingSetSize];
+
+        for (size_t i = 0; i < WorkingSetSize; ++i)
+            blocks[i] = heap->Alloc(1 + (random.Next() % MaxBlockSize));
+
+        for (size_t i = 0; i < operationCount; ++i)
+        {
+            void*& block = blocks[random.Next() % WorkingSetSize];
+            heap->Free(block);
+            block = heap->Alloc(1 + (random.Next() % MaxBlockSize));
+        }
+
+        for (size_t i = 0; i < WorkingSetSize; ++i)
+            heap->Free(blocks[i]);
+    });
+    Report("Working set", variant, threadCount, seconds, operationCount * threadCount);
+
+    DestroyHeap(heap, threadCaching);
+}
+
+
+int main(int argc, char** argv)
+{
+    OVR::System::Init();
+
+    // An optional argument sets the number of operations per thread, e.g. for quick runs.
+    const size_t operationCount = ((argc > 1) ? (size_t)atoi(argv[1]) : 1000000);
+
+    ReportHeader("Threads");
+
+    for (int threadCount : GetThreadCounts())
+    {
+        BenchHeap("DefaultHeap",       false, threadCount, operationCount);
+        BenchHeap("ThreadCachingHeap", true,  threadCount, operationCount);
+        printf("\n");
+    }
+
+    OVR::System::Destroy();
+    return 0;
+}
@@ -0,0 +1,171 @@
+/************************************************************************************
+
+PublicHeader:   None
+Filename    :   Bench_Common.h
+Content     :   Timing and reporting helpers shared by the Kernel benchmarks
+Created     :   October 18, 2026
+Notes       :   Each Bench_*.cpp in this directory is a standalone program which
+                links against LibOVRKernel, e.g. with the Src directory as the
+                include path:
+                    cl /O2 /EHsc /I..\Src Bench_Hash.cpp LibOVRKernel.lib
+                Run them from a release build; debug builds mostly measure asserts.
+
+Copyright   :   Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+
+Licensed under the Oculus VR Rift SDK License Version 3.3 (the "License");
+you may not use the Oculus VR Rift SDK except in compliance with the License,
+which is provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+You may obtain a copy of the License at
+
+http://www.oculusvr.com/licenses/LICENSE-3.3
+
+Unless required by applicable law or agreed to in writing, the Oculus VR SDK
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#ifndef Bench_Common_h
+#define Bench_Common_h
+
+#include "Kernel/OVR_Types.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+namespace OVR { namespace Bench {
+
+
+// Seconds since an arbitrary point, from a monotonic clock.
+inline double GetSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Small, fast, deterministic random numbers, so that every variant sees the same input.
+class Random
+{
+public:
+    explicit Random(uint64_t seed = 12345) : State(seed) { }
+
+    uint32_t Next()
+    {
+        State = (State * UINT64_C(6364136223846793005)) + UINT64_C(1442695040888963407);
+        return (uint32_t)(State >> 33);
+    }
+
+protected:
+    uint64_t State;
+};
+
+// Runs f() repeatCount times and returns the fastest run in seconds. The fastest run is the one
+// least disturbed by other activity on the machine.
+template<class F>
+double TimeBest(int repeatCount, F f)
+{
+    double best = 1e30;
+
+    for (int i = 0; i < repeatCount; ++i)
+    {
+        const double start = GetSeconds();
+        f();
+        const double elapsed = (GetSeconds() - start);
+
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    return best;
+}
+
+// Runs f(threadIndex) on threadCount new threads and returns the seconds from when they were all
+// released together until the last of them finished. Thread creation isn't included.
+template<class F>
+double RunThreads(int threadCount, F f)
+{
+    std::atomic<int>         readyCount(0);
+    std::atomic<bool>        go(false);
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back([&, i]()
+        {
+            ++readyCount;
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            f(i);
+        });
+    }
+
+    while (readyCount.load() < threadCount)
+        std::this_thread::yield();
+
+    const double start = GetSeconds();
+    go.store(true, std::memory_order_release);
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    return (GetSeconds() - start);
+}
+
+// Like TimeBest, for RunThreads.
+template<class F>
+double TimeBestThreads(int repeatCount, int threadCount, F f)
+{
+    double best = 1e30;
+
+    for (int i = 0; i < repeatCount; ++i)
+    {
+        const double elapsed = RunThreads(threadCount, f);
+
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    return best;
+}
+
+// Returns the thread counts to measure scaling with: 1, 2, 4, ... up to the number of hardware threads.
+inline std::vector<int> GetThreadCounts()
+{
+    const int        hardwareThreadCount = (int)std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<int> threadCounts;
+
+    for (int count = 1; count < hardwareThreadCount; count *= 2)
+        threadCounts.push_back(count);
+    threadCounts.push_back(hardwareThreadCount);
+
+    return threadCounts;
+}
+
+// Prints one result line. operationCount is the number of operations done in seconds.
+inline void Report(const char* test, const char* variant, size_t size, double seconds, size_t operationCount)
+{
+    printf("%-24s %-20s %10u %10.3f ms %8.2f ns/op\n", test, variant, (unsigned)size,
+           seconds * 1000.0, (operationCount ? (seconds * 1e9 / (double)operationCount) : 0.0));
+}
+
+// sizeLabel names the Report size column, e.g. "Threads" for scaling tests.
+inline void ReportHeader(const char* sizeLabel = "Size")
+{
+    printf("%-24s %-20s %10s %13s %14s\n", "Test", "Variant", sizeLabel, "Time", "Per op");
+}
+
+// Keeps the compiler from discarding a result which is otherwise unused. Atomic, as the
+// multithreaded benchmarks add to it from every thread.
+extern std::atomic<uint64_t> Sink;
+#define OVR_BENCH_SINK_DEFINITION std::atomic<uint64_t> OVR::Bench::Sink(0)
+
+
+}} // namespace OVR::Bench
+
+#endif // Bench_Common_h
@@ -0,0 +1,124 @@
+/************************************************************************************
+
+Filename    :   Bench_ConcurrentHash.cpp
+Content     :   Measures how the lock-striped ConcurrentHash scales with threads,
+                compared with a Hash guarded by a single Lock
+Created     :   October 18, 2026
+Notes       :   See Bench_Common.h for how to build and run.
+
+Copyright   :   Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+
+Licensed under the Oculus VR Rift SDK License Version 3.3 (the "License");
+you may not use the Oculus VR Rift SDK except in compliance with the License,
+which is provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+You may obtain a copy of the License at
+
+http://www.oculusvr.com/licenses/LICENSE-3.3
+
+Unless required by applicable law or agreed to in writing, the Oculus VR SDK
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#include "Bench_Common.h"
+#include "Kernel/OVR_System.h"
+#include "Kernel/OVR_ConcurrentHash.h"
+
+using namespace OVR;
+using namespace OVR::Bench;
+
+OVR_BENCH_SINK_DEFINITION;
+
+
+static const uint32_t KeyCount = 65536;     // Keys are drawn from [0, KeyCount). Half are in the table at a time.
+
+
+// What ConcurrentHash replaces: a single Hash with one Lock around every operation.
+class LockedHash
+{
+public:
+    void Set(int key, int value)
+    {
+        Lock::Locker locker(&TableLock);
+        Table.Set(key, value);
+    }
+
+    void Remove(int key)
+    {
+        Lock::Locker locker(&TableLock);
+        Table.Remove(key);
+    }
+
+    bool Get(int key, int* pvalue) const
+    {
+        Lock::Locker locker(&TableLock);
+        return Table.Get(key, pvalue);
+    }
+
+protected:
+    mutable Lock   TableLock;
+    Hash<int, int> Table;
+};
+
+
+// writePercent of the operations are a Set or Remove of a random key; the rest are Gets.
+template<class TableType>
+static void BenchTable(const char* test, const char* variant, int threadCount, size_t operationCount, uint32_t writePercent)
+{
+    TableType table;
+
+    for (uint32_t key = 0; key < KeyCount; key += 2)
+        table.Set((int)key, (int)key);
+
+    const double seconds = TimeBestThreads(3, threadCount, [&](int threadIndex)
+    {
+        Random   random(threadIndex + 1);
+        uint64_t found = 0;
+        int      value;
+
+        for (size_t i = 0; i < operationCount; ++i)
+        {
+            const uint32_t r   = random.Next();
+            const int      key = (int)(r % KeyCount);
+
+            if (((r >> 16) % 100) >= writePercent)
+                found += table.Get(key, &value);
+            else if (r & 0x8000)
+                table.Set(key, key);
+            else
+                table.Remove(key);
+        }
+
+        Sink += found;
+    });
+
+    Report(test, variant, threadCount, seconds, operationCount * threadCount);
+}
+
+
+int main(int argc, char** argv)
+{
+    OVR::System::Init();
+
+    // An optional argument sets the number of operations per thread, e.g. for quick runs.
+    const size_t operationCount = ((argc > 1) ? (size_t)atoi(argv[1]) : 1000000);
+
+    ReportHeader("Threads");
+
+    for (int threadCount : GetThreadCounts())
+    {
+        BenchTable<LockedHash>                ("Read-mostly (5% write)", "Hash + Lock",    threadCount, operationCount, 5);
+        BenchTable<ConcurrentHash<int, int> > ("Read-mostly (5% write)", "ConcurrentHash", threadCount, operationCount, 5);
+        BenchTable<LockedHash>                ("Mixed (50% write)",      "Hash + Lock",    threadCount, operationCount, 50);
+        BenchTable<ConcurrentHash<int, int> > ("Mixed (50% write)",      "ConcurrentHash", threadCount, operationCount, 50);
+        printf("\n");
+    }
+
+    OVR::System::Destroy();
+    return 0;
+}
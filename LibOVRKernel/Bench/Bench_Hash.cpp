@@ -0,0 +1,139 @@
+/************************************************************************************
+
+Filename    :   Bench_Hash.cpp
+Content     :   Compares the chained Hash with the flat, SIMD-probed HashFlat
+Created     :   October 18, 2026
+Notes       :   See Bench_Common.h for how to build and run.
+
+Copyright   :   Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+
+Licensed under the Oculus VR Rift SDK License Version 3.3 (the "License");
+you may not use the Oculus VR Rift SDK except in compliance with the License,
+which is provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+You may obtain a copy of the License at
+
+http://www.oculusvr.com/licenses/LICENSE-3.3
+
+Unless required by applicable law or agreed to in writing, the Oculus VR SDK
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#include "Bench_Common.h"
+#include "Kernel/OVR_System.h"
+#include "Kernel/OVR_Hash.h"
+#include "Kernel/OVR_Array.h"
+
+using namespace OVR;
+using namespace OVR::Bench;
+
+OVR_BENCH_SINK_DEFINITION;
+
+
+// Keys are spread out so that neither table gets sequential, perfectly distributed hashes.
+static ArrayPOD<int> MakeKeys(size_t count, uint64_t seed)
+{
+    ArrayPOD<int> keys;
+    keys.Resize(count);
+    Random random(seed);
+
+    for (size_t i = 0; i < count; ++i)
+        keys[i] = (int)(random.Next() & 0x7fffffff);
+
+    return keys;
+}
+
+
+template<class HashType>
+static void BenchTable(const char* variant, size_t size)
+{
+    const int     repeatCount = ((size >= 1000000) ? 3 : 10);
+    ArrayPOD<int> keys        = MakeKeys(size, 1);
+    ArrayPOD<int> missingKeys = MakeKeys(size, 2);    // Almost all of these are absent from the table.
+
+    // Insert into an empty table, including all the rehashing as it grows.
+    double seconds = TimeBest(repeatCount, [&]()
+    {
+        HashType table;
+        for (size_t i = 0; i < size; ++i)
+            table.Set(keys[i], (int)i);
+        Sink += table.GetSize();
+    });
+    Report("Insert", variant, size, seconds, size);
+
+    HashType table;
+    for (size_t i = 0; i < size; ++i)
+        table.Set(keys[i], (int)i);
+
+    seconds = TimeBest(repeatCount, [&]()
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < size; ++i)
+            sum += *table.Get(keys[i]);
+        Sink += sum;
+    });
+    Report("Find hit", variant, size, seconds, size);
+
+    seconds = TimeBest(repeatCount, [&]()
+    {
+        uint64_t found = 0;
+        for (size_t i = 0; i < size; ++i)
+            found += (table.Get(missingKeys[i]) != nullptr);
+        Sink += found;
+    });
+    Report("Find miss", variant, size, seconds, size);
+
+    // Erase-heavy: the table stays at the same size while keys come and go, which is where
+    // tombstones (flat) and chain relinking (chained) cost the most.
+    seconds = TimeBest(repeatCount, [&]()
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            table.Remove(keys[i]);
+            table.Set(missingKeys[i], (int)i);
+        }
+        for (size_t i = 0; i < size; ++i)
+        {
+            table.Remove(missingKeys[i]);
+            table.Set(keys[i], (int)i);
+        }
+        Sink += table.GetSize();
+    });
+    Report("Erase/insert churn", variant, size, seconds, size * 4);
+
+    // Erase everything, in insertion order.
+    seconds = TimeBest(repeatCount, [&]()
+    {
+        HashType copy(table);
+        for (size_t i = 0; i < size; ++i)
+            copy.Remove(keys[i]);
+        Sink += copy.GetSize();
+    });
+    Report("Copy + erase all", variant, size, seconds, size);
+}
+
+
+int main(int argc, char** argv)
+{
+    OVR::System::Init();
+
+    // An optional argument limits the largest table size, e.g. for quick runs.
+    const size_t maxSize = ((argc > 1) ? (size_t)atoi(argv[1]) : 1000000);
+
+    ReportHeader();
+
+    for (size_t size = 1000; size <= maxSize; size *= 10)
+    {
+        BenchTable<Hash<int, int> >    ("Hash",     size);
+        BenchTable<HashFlat<int, int> >("HashFlat", size);
+        printf("\n");
+    }
+
+    OVR::System::Destroy();
+    return 0;
+}
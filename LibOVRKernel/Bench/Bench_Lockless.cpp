@@ -0,0 +1,238 @@
+/************************************************************************************
+
+Filename    :   Bench_Lockless.cpp
+Content     :   Throughput and latency of the lock-free queues in OVR_Lockless.h,
+                compared with a Deque guarded by a Lock and signaled with Events
+Created     :   October 18, 2026
+Notes       :   See Bench_Common.h for how to build and run.
+
+Copyright   :   Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+
+Licensed under the Oculus VR Rift SDK License Version 3.3 (the "License");
+you may not use the Oculus VR Rift SDK except in compliance with the License,
+which is provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+You may obtain a copy of the License at
+
+http://www.oculusvr.com/licenses/LICENSE-3.3
+
+Unless required by applicable law or agreed to in writing, the Oculus VR SDK
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#include "Bench_Common.h"
+#include "Kernel/OVR_System.h"
+#include "Kernel/OVR_Lockless.h"
+#include "Kernel/OVR_Deque.h"
+#include <memory>
+
+using namespace OVR;
+using namespace OVR::Bench;
+
+OVR_BENCH_SINK_DEFINITION;
+
+
+static const size_t QueueCapacity = 1024;
+
+
+// The cross-thread hand-off which the lock-free queues replace: a Deque guarded by a Lock, with
+// an Event per direction to sleep on while the queue is empty or full.
+class LockedQueue
+{
+public:
+    LockedQueue() : Items((int)QueueCapacity), SpaceEvent(true) { }
+
+    bool Push(const uint64_t& item)
+    {
+        for (;;)
+        {
+            {
+                Lock::Locker locker(&QueueLock);
+
+                if (!Items.IsFull())
+                {
+                    Items.PushBack(item);
+                    ItemEvent.SetEvent();
+                    if (Items.IsFull())
+                        SpaceEvent.ResetEvent();
+                    return true;
+                }
+            }
+
+            SpaceEvent.Wait();
+        }
+    }
+
+    bool Pop(uint64_t& item)
+    {
+        for (;;)
+        {
+            {
+                Lock::Locker locker(&QueueLock);
+
+                if (!Items.IsEmpty())
+                {
+                    item = Items.PopFront();
+                    SpaceEvent.SetEvent();
+                    if (Items.IsEmpty())
+                        ItemEvent.ResetEvent();
+                    return true;
+                }
+            }
+
+            ItemEvent.Wait();
+        }
+    }
+
+protected:
+    Lock             QueueLock;
+    Deque<uint64_t>  Items;
+    Event            ItemEvent;     // Set while Items isn't empty.
+    Event            SpaceEvent;    // Set while Items isn't full.
+};
+
+
+// Gives the lock-free queues the same blocking Push/Pop as the other variants, by spinning.
+template<class QueueType>
+class SpinningQueue : public QueueType
+{
+public:
+    bool Push(const uint64_t& item)
+    {
+        while (!this->TryPush(item))
+            std::this_thread::yield();
+        return true;
+    }
+
+    bool Pop(uint64_t& item)
+    {
+        while (!this->TryPop(item))
+            std::this_thread::yield();
+        return true;
+    }
+};
+
+// Adapts LocklessWaitableQueue's Push/Pop, which take an optional timeout, to the signature of the others.
+template<class QueueType>
+class WaitingQueue : public QueueType
+{
+public:
+    bool Push(const uint64_t& item) { return QueueType::Push(item); }
+    bool Pop(uint64_t& item)        { return QueueType::Pop(item); }
+};
+
+
+typedef SpinningQueue< LocklessSPSCQueue<uint64_t, QueueCapacity> >   SpinningSPSCQueue;
+typedef SpinningQueue< LocklessMPMCQueue<uint64_t, QueueCapacity> >   SpinningMPMCQueue;
+typedef LocklessWaitableQueue< LocklessSPSCQueue<uint64_t, QueueCapacity> > WaitableSPSCQueue;
+typedef LocklessWaitableQueue< LocklessMPMCQueue<uint64_t, QueueCapacity> > WaitableMPMCQueue;
+
+
+// producerCount threads each push itemCount items, which consumerCount threads pop.
+template<class QueueType>
+static void BenchThroughput(const char* test, const char* variant, int producerCount, int consumerCount, size_t itemCount)
+{
+    const size_t totalCount = (itemCount * producerCount);
+
+    std::unique_ptr<QueueType> queue(new QueueType); // Queues are large, so we keep them off the stack. Every run leaves it empty.
+
+    const double seconds = TimeBestThreads(3, producerCount + consumerCount, [&](int threadIndex)
+    {
+        if (threadIndex < producerCount)
+        {
+            for (size_t i = 0; i < itemCount; ++i)
+                queue->Push((uint64_t)i);
+        }
+        else
+        {
+            // Consumers split the items evenly; the first one takes the remainder.
+            const int consumerIndex = (threadIndex - producerCount);
+            size_t    count = (totalCount / consumerCount) + ((consumerIndex == 0) ? (totalCount % consumerCount) : 0);
+            uint64_t  sum = 0;
+            uint64_t  item;
+
+            while (count--)
+            {
+                queue->Pop(item);
+                sum += item;
+            }
+
+            Sink += sum;
+        }
+    });
+
+    Report(test, variant, (size_t)(producerCount + consumerCount), seconds, totalCount);
+}
+
+
+// Two threads bounce one item back and forth over a pair of queues. Reports the round trip time.
+template<class QueueType>
+static void BenchLatency(const char* variant, size_t roundTripCount)
+{
+    std::unique_ptr<QueueType> ping(new QueueType);
+    std::unique_ptr<QueueType> pong(new QueueType);
+
+    const double seconds = TimeBestThreads(3, 2, [&](int threadIndex)
+    {
+        uint64_t item = 0;
+
+        for (size_t i = 0; i < roundTripCount; ++i)
+        {
+            if (threadIndex == 0)
+            {
+                ping->Push(item);
+                pong->Pop(item);
+            }
+            else
+            {
+                ping->Pop(item);
+                pong->Push(item + 1);
+            }
+        }
+
+        Sink += item;
+    });
+
+    Report("Round trip latency", variant, 2, seconds, roundTripCount);
+}
+
+
+int main(int argc, char** argv)
+{
+    OVR::System::Init();
+
+    // An optional argument sets the number of items per producer, e.g. for quick runs.
+    const size_t itemCount = ((argc > 1) ? (size_t)atoi(argv[1]) : 2000000);
+
+    ReportHeader("Threads");
+
+    BenchThroughput<LockedQueue>                     ("1 to 1 throughput", "Deque + Lock + Event", 1, 1, itemCount);
+    BenchThroughput<SpinningSPSCQueue>               ("1 to 1 throughput", "SPSC spinning",        1, 1, itemCount);
+    BenchThroughput<WaitingQueue<WaitableSPSCQueue> >("1 to 1 throughput", "SPSC waitable",        1, 1, itemCount);
+    BenchThroughput<SpinningMPMCQueue>               ("1 to 1 throughput", "MPMC spinning",        1, 1, itemCount);
+    printf("\n");
+
+    for (int threadCount : GetThreadCounts())
+    {
+        const int sideCount = std::max(threadCount / 2, 1);
+
+        BenchThroughput<LockedQueue>                     ("N to N throughput", "Deque + Lock + Event", sideCount, sideCount, itemCount / sideCount);
+        BenchThroughput<SpinningMPMCQueue>               ("N to N throughput", "MPMC spinning",        sideCount, sideCount, itemCount / sideCount);
+        BenchThroughput<WaitingQueue<WaitableMPMCQueue> >("N to N throughput", "MPMC waitable",        sideCount, sideCount, itemCount / sideCount);
+    }
+    printf("\n");
+
+    const size_t roundTripCount = (itemCount / 20);
+
+    BenchLatency<LockedQueue>                     ("Deque + Lock + Event", roundTripCount);
+    BenchLatency<SpinningSPSCQueue>               ("SPSC spinning",        roundTripCount);
+    BenchLatency<WaitingQueue<WaitableSPSCQueue> >("SPSC waitable",        roundTripCount);
+
+    OVR::System::Destroy();
+    return 0;
+}
@@ -0,0 +1,213 @@
+/************************************************************************************
+
+Filename    :   Bench_RingBuffer.cpp
+Content     :   Measures RingBuffer against the virtual Deque interface, and its bulk
+                and span operations against per-element access
+Created     :   October 18, 2026
+Notes       :   See Bench_Common.h for how to build and run.
+
+Copyright   :   Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+
+Licensed under the Oculus VR Rift SDK License Version 3.3 (the "License");
+you may not use the Oculus VR Rift SDK except in compliance with the License,
+which is provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+You may obtain a copy of the License at
+
+http://www.oculusvr.com/licenses/LICENSE-3.3
+
+Unless required by applicable law or agreed to in writing, the Oculus VR SDK
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#include "Bench_Common.h"
+#include "Kernel/OVR_System.h"
+#include "Kernel/OVR_Deque.h"
+#include "Kernel/OVR_Array.h"
+
+using namespace OVR;
+using namespace OVR::Bench;
+
+OVR_BENCH_SINK_DEFINITION;
+
+
+// Roughly the shape of a pose history entry: a timestamp plus orientation and position.
+struct Sample
+{
+    double Time;
+    float  Orientation[4];
+    float  Position[3];
+};
+
+
+static const size_t OperationCount = 10000000;
+static const int    RepeatCount    = 5;
+
+
+// Fills the buffer to size, then does push back / pop front pairs at that size. Works with
+// anything that has Deque's interface, which RingBuffer has for these calls.
+template<class BufferType>
+static void BenchFifo(const char* variant, BufferType& buffer, size_t size)
+{
+    const double seconds = TimeBest(RepeatCount, [&]()
+    {
+        Sample sample = {};
+        double sum = 0;
+
+        buffer.Clear();
+        for (size_t i = 0; i < size; ++i)
+            buffer.PushBack(sample);
+
+        for (size_t i = 0; i < OperationCount; ++i)
+        {
+            sample.Time = (double)i;
+            buffer.PushBack(sample);
+            sum += buffer.PopFront().Time;
+        }
+
+        Sink += (uint64_t)sum;
+    });
+
+    Report("FIFO push/pop", variant, size, seconds, OperationCount);
+}
+
+
+// The pose history pattern: append to a full buffer which drops its oldest entry, and read
+// the newest few entries.
+template<class BufferType>
+static void BenchHistory(const char* variant, BufferType& buffer, size_t size)
+{
+    const double seconds = TimeBest(RepeatCount, [&]()
+    {
+        Sample sample = {};
+        double sum = 0;
+
+        buffer.Clear();
+
+        for (size_t i = 0; i < OperationCount; ++i)
+        {
+            if (buffer.IsFull())
+                buffer.PopFront();
+
+            sample.Time = (double)i;
+            buffer.PushBack(sample);
+            sum += buffer.PeekBack(0).Time + buffer.PeekBack((int)(buffer.GetSize() / 2)).Time;
+        }
+
+        Sink += (uint64_t)sum;
+    });
+
+    Report("History append + peek", variant, size, seconds, OperationCount);
+}
+
+
+static void BenchBulk(size_t size)
+{
+    RingBuffer<Sample> buffer(size);
+    ArrayPOD<Sample>   samples;
+    samples.Resize(size);
+
+    for (size_t i = 0; i < size; ++i)
+        samples[i].Time = (double)i;
+
+    const size_t passCount = (OperationCount / size);
+    const size_t fillCount = (size - 1); // Not a divisor of the storage size, so each pass starts at a different offset and the contents wrap around.
+
+    double seconds = TimeBest(RepeatCount, [&]()
+    {
+        for (size_t pass = 0; pass < passCount; ++pass)
+        {
+            for (size_t i = 0; i < fillCount; ++i)
+                buffer.PushBack(samples[i]);
+            for (size_t i = 0; i < fillCount; ++i)
+                samples[i] = buffer.PopFront();
+        }
+        Sink += (uint64_t)samples[0].Time;
+    });
+    Report("Fill/drain", "per element", size, seconds, passCount * fillCount);
+
+    seconds = TimeBest(RepeatCount, [&]()
+    {
+        for (size_t pass = 0; pass < passCount; ++pass)
+        {
+            buffer.PushBack(&samples[0], fillCount);
+            buffer.PopFront(&samples[0], fillCount);
+        }
+        Sink += (uint64_t)samples[0].Time;
+    });
+    Report("Fill/drain", "bulk", size, seconds, passCount * fillCount);
+
+    // Reads the whole (wrapped) contents.
+    for (size_t i = 0; i < size / 2; ++i)
+        buffer.PushBack(samples[i]);
+    buffer.DiscardFront(size / 2);
+    for (size_t i = 0; i < size; ++i)
+        buffer.PushBack(samples[i]);
+
+    seconds = TimeBest(RepeatCount, [&]()
+    {
+        double sum = 0;
+        for (size_t pass = 0; pass < passCount; ++pass)
+        {
+            for (size_t i = 0, iEnd = buffer.GetSize(); i < iEnd; ++i)
+                sum += buffer[i].Time;
+        }
+        Sink += (uint64_t)sum;
+    });
+    Report("Read all", "operator[]", size, seconds, passCount * size);
+
+    seconds = TimeBest(RepeatCount, [&]()
+    {
+        double sum = 0;
+        for (size_t pass = 0; pass < passCount; ++pass)
+        {
+            const Sample* first;
+            const Sample* second;
+            size_t        firstCount, secondCount;
+
+            buffer.GetSpans(&first, &firstCount, &second, &secondCount);
+
+            for (size_t i = 0; i < firstCount; ++i)
+                sum += first[i].Time;
+            for (size_t i = 0; i < secondCount; ++i)
+                sum += second[i].Time;
+        }
+        Sink += (uint64_t)sum;
+    });
+    Report("Read all", "GetSpans", size, seconds, passCount * size);
+}
+
+
+int main()
+{
+    OVR::System::Init();
+
+    ReportHeader();
+
+    for (size_t size = 16; size <= 4096; size *= 16)
+    {
+        {
+            Deque<Sample>      deque((int)size + 1);
+            RingBuffer<Sample> ringBuffer(size + 1);
+            BenchFifo("Deque",      deque,      size);
+            BenchFifo("RingBuffer", ringBuffer, size);
+        }
+        {
+            Deque<Sample>      deque((int)size);
+            RingBuffer<Sample> ringBuffer(size);
+            BenchHistory("Deque",      deque,      size);
+            BenchHistory("RingBuffer", ringBuffer, size);
+        }
+
+        BenchBulk(size);
+        printf("\n");
+    }
+
+    OVR::System::Destroy();
+    return 0;
+}
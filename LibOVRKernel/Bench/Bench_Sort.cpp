@@ -0,0 +1,201 @@
+/************************************************************************************
+
+Filename    :   Bench_Sort.cpp
+Content     :   Compares QuickSort, IntroSort, HeapSort and ParallelSort across input
+                distributions, including one built to make QuickSort go quadratic
+Created     :   October 18, 2026
+Notes       :   See Bench_Common.h for how to build and run.
+
+Copyright   :   Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+
+Licensed under the Oculus VR Rift SDK License Version 3.3 (the "License");
+you may not use the Oculus VR Rift SDK except in compliance with the License,
+which is provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+You may obtain a copy of the License at
+
+http://www.oculusvr.com/licenses/LICENSE-3.3
+
+Unless required by applicable law or agreed to in writing, the Oculus VR SDK
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#include "Bench_Common.h"
+#include "Kernel/OVR_System.h"
+#include "Kernel/OVR_Alg.h"
+#include "Kernel/OVR_Array.h"
+#include "Kernel/OVR_ParallelSort.h"
+
+using namespace OVR;
+using namespace OVR::Bench;
+
+OVR_BENCH_SINK_DEFINITION;
+
+
+// QuickSort is quadratic on the adversarial input, so we only run it on sizes up to this.
+static const size_t AdversaryMaxSize = 50000;
+
+enum Distribution
+{
+    DistRandom,
+    DistSorted,
+    DistReverse,
+    DistFewUnique,
+    DistOrganPipe,
+    DistSawtooth,
+    DistAdversary,
+    DistCount
+};
+
+static const char* DistributionNames[DistCount] =
+{
+    "Random", "Sorted", "Reverse", "Few unique", "Organ pipe", "Sawtooth", "QuickSort adversary"
+};
+
+
+// McIlroy's "killer adversary for quicksort": a comparator which decides the values of the
+// elements lazily, always in the way that makes the current pivot a bad one. Sorting indices
+// with it and then reading back the values it settled on gives an input which takes the sort
+// the same (worst case) path again.
+struct Adversary
+{
+    ArrayPOD<int>* Values;
+    int            Gas;         // Value of elements which haven't been decided yet. Larger than all decided ones.
+    int            SolidCount;  // Number of decided elements, which is also the next value to give out.
+    int            Candidate;   // The undecided element we last compared; likely the pivot.
+
+    bool operator()(int x, int y)
+    {
+        ArrayPOD<int>& values = *Values;
+
+        if ((values[x] == Gas) && (values[y] == Gas))
+            values[(x == Candidate) ? x : y] = SolidCount++;
+
+        if (values[x] == Gas)
+            Candidate = x;
+        else if (values[y] == Gas)
+            Candidate = y;
+
+        return (values[x] < values[y]);
+    }
+};
+
+// Adversary is passed by value, so each copy refers to the same state through this.
+struct AdversaryRef
+{
+    Adversary* State;
+    bool operator()(int x, int y) const { return (*State)(x, y); }
+};
+
+
+static void MakeInput(ArrayPOD<int>& data, Distribution distribution, size_t size)
+{
+    Random random(1);
+    data.Resize(size);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        switch (distribution)
+        {
+            case DistRandom:    data[i] = (int)(random.Next() & 0x7fffffff);          break;
+            case DistSorted:    data[i] = (int)i;                                     break;
+            case DistReverse:   data[i] = (int)(size - i);                            break;
+            case DistFewUnique: data[i] = (int)(random.Next() % 4);                   break;
+            case DistOrganPipe: data[i] = (int)((i < (size / 2)) ? i : (size - i));   break;
+            case DistSawtooth:  data[i] = (int)(i % 64);                              break;
+            default:            data[i] = 0;                                          break;
+        }
+    }
+
+    if (distribution == DistAdversary)
+    {
+        ArrayPOD<int> indices;
+        indices.Resize(size);
+
+        Adversary adversary = { &data, (int)size, 0, 0 };
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            data[i] = (int)size;
+            indices[i] = (int)i;
+        }
+
+        AdversaryRef less = { &adversary };
+        Alg::QuickSortSliced(indices, 0, size, less);
+    }
+}
+
+
+// Times sorting a fresh copy of input, excluding the copy.
+template<class SortF>
+static void BenchSort(const char* test, const char* variant, const ArrayPOD<int>& input, SortF sort)
+{
+    const size_t  size = input.GetSize();
+    const int     repeatCount = ((size >= 1000000) ? 3 : 10);
+    ArrayPOD<int> data;
+    double        best = 1e30;
+
+    for (int repeat = 0; repeat < repeatCount; ++repeat)
+    {
+        data = input;
+
+        const double start = GetSeconds();
+        sort(data);
+        const double elapsed = (GetSeconds() - start);
+
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    for (size_t i = 1; i < size; ++i)
+    {
+        if (data[i] < data[i - 1])
+        {
+            printf("%s %s: not sorted!\n", test, variant);
+            break;
+        }
+    }
+
+    Sink += data[size / 2];
+    Report(test, variant, size, best, size);
+}
+
+
+int main(int argc, char** argv)
+{
+    OVR::System::Init();
+
+    // An optional argument limits the largest array size, e.g. for quick runs.
+    const size_t maxSize = ((argc > 1) ? (size_t)atoi(argv[1]) : 1000000);
+
+    ReportHeader();
+
+    for (size_t size = 10000; size <= maxSize; size *= 10)
+    {
+        for (int distribution = 0; distribution < DistCount; ++distribution)
+        {
+            const char* test = DistributionNames[distribution];
+
+            if ((distribution == DistAdversary) && (size > AdversaryMaxSize))
+                continue;
+
+            ArrayPOD<int> input;
+            MakeInput(input, (Distribution)distribution, size);
+
+            BenchSort(test, "QuickSort",    input, [](ArrayPOD<int>& data) { Alg::QuickSort(data); });
+            BenchSort(test, "IntroSort",    input, [](ArrayPOD<int>& data) { Alg::IntroSort(data); });
+            BenchSort(test, "HeapSort",     input, [](ArrayPOD<int>& data) { Alg::HeapSortSliced(data, 0, data.GetSize(), Alg::OperatorLess<int>::Compare); });
+            BenchSort(test, "ParallelSort", input, [](ArrayPOD<int>& data) { Alg::ParallelSort(data); });
+        }
+
+        printf("\n");
+    }
+
+    OVR::System::Destroy();
+    return 0;
+}
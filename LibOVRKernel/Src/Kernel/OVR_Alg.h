@@ -39,6 +39,19 @@ limitations under the License.
     #include <x86intrin.h>
 #endif
 
+// Defined as 1 if LowerBoundSIMD compares with SSE2, otherwise it uses LowerBoundBranchless.
+#if !defined(OVR_ALG_SSE2)
+    #if defined(OVR_CPU_X86_64) || (defined(OVR_CPU_X86) && (defined(__SSE2__) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))))
+        #define OVR_ALG_SSE2 1
+    #else
+        #define OVR_ALG_SSE2 0
+    #endif
+#endif
+
+#if OVR_ALG_SSE2
+    #include <emmintrin.h>
+#endif
+
 namespace OVR { namespace Alg {
 
 
@@ -527,6 +540,241 @@ void InsertionSort(Array& arr)
     InsertionSortSliced(arr, 0, arr.GetSize(), OperatorLess<ValueType>::Compare);
 }
 
+//-----------------------------------------------------------------------------------
+// ***** HeapSortSliced
+//
+// Sort any part of any array: plain, Array, ArrayPaged, ArrayUnsafe.
+// The range is specified with start, end, where "end" is exclusive!
+// The comparison predicate must be specified.
+// Slower than Quick Sort on average, but guaranteed O(n log n) for any input.
+
+// Moves the element at index root (relative to start) down the max-heap of size heapSize.
+template<class Array, class Less> 
+void HeapSiftDown(Array& arr, size_t start, size_t root, size_t heapSize, Less less)
+{
+    for(;;)
+    {
+        size_t child = 2 * root + 1;
+
+        if(child >= heapSize)
+        {
+            break;
+        }
+        if(child + 1 < heapSize && less(arr[start + child], arr[start + child + 1]))
+        {
+            child++;
+        }
+        if(!less(arr[start + root], arr[start + child]))
+        {
+            break;
+        }
+
+        Swap(arr[start + root], arr[start + child]);
+        root = child;
+    }
+}
+
+template<class Array, class Less> 
+void HeapSortSliced(Array& arr, size_t start, size_t end, Less less)
+{
+    size_t size = end - start;
+
+    if(size < 2) return;
+
+    for(size_t i = size / 2; i-- > 0; )
+    {
+        HeapSiftDown(arr, start, i, size, less);
+    }
+
+    for(size_t last = size - 1; last > 0; last--)
+    {
+        Swap(arr[start], arr[start + last]);
+        HeapSiftDown(arr, start, 0, last, less);
+    }
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** PartitionSliced
+//
+// One Quick Sort partitioning step, with median of three pivot selection.
+// Returns the final pivot index p: the elements in [start, p) are not greater than
+// arr[p], and the elements in [p + 1, end) are not less than it.
+// The range must contain at least 3 elements.
+template<class Array, class Less> 
+size_t PartitionSliced(Array& arr, size_t start, size_t end, Less less)
+{
+    OVR_ASSERT(end - start >= 3);
+
+    size_t base = start;
+    size_t i    = base + 1;
+    size_t j    = end - 1;
+
+    Swap(arr[base], arr[base + (end - start) / 2]);
+
+    // now ensure that *i <= *base <= *j; these act as sentinels for the scans below
+    if(less(arr[j],    arr[i])) Swap(arr[j],    arr[i]);
+    if(less(arr[base], arr[i])) Swap(arr[base], arr[i]);
+    if(less(arr[j], arr[base])) Swap(arr[j], arr[base]);
+
+    for(;;)
+    {
+        do i++; while( less(arr[i], arr[base]) );
+        do j--; while( less(arr[base], arr[j]) );
+
+        if( i > j )
+        {
+            break;
+        }
+
+        Swap(arr[i], arr[j]);
+    }
+
+    Swap(arr[base], arr[j]);
+    return j;
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** IntroSortSliced
+//
+// Sort any part of any array: plain, Array, ArrayPaged, ArrayUnsafe.
+// The range is specified with start, end, where "end" is exclusive!
+// The comparison predicate must be specified.
+// Same as QuickSortSliced, except that a slice which is still being partitioned after
+// 2*log2(n) levels is heap sorted instead. That bounds the worst case to O(n log n),
+// where QuickSortSliced goes quadratic on adversarial inputs.
+
+// Returns the partitioning depth after which IntroSort switches to Heap Sort.
+inline int IntroSortDepthLimit(size_t size)
+{
+    int depthLimit = 0;
+
+    for(; size > 1; size >>= 1)
+    {
+        depthLimit += 2;
+    }
+    return depthLimit;
+}
+
+template<class Array, class Less> 
+void IntroSortSliced(Array& arr, size_t start, size_t end, Less less, int depthLimit = -1)
+{
+    enum 
+    {
+        Threshold = 16
+    };
+
+    struct Slice
+    {
+        size_t Start;
+        size_t End;
+        int    DepthLimit;
+    };
+
+    if(end - start <  2) return;
+
+    // The smaller side is always sorted first, so each pushed slice is less than half
+    // of the one below it, and 64 entries are always enough.
+    Slice  stack[64];
+    Slice* top   = stack;
+    size_t base  = start;
+    size_t limit = end;
+
+    if(depthLimit < 0)
+    {
+        depthLimit = IntroSortDepthLimit(end - start);
+    }
+
+    for(;;)
+    {
+        if(limit - base > Threshold && depthLimit > 0)
+        {
+            depthLimit--;
+
+            size_t p = PartitionSliced(arr, base, limit, less);
+
+            // now, push the largest sub-array
+            if(p - base > limit - (p + 1))
+            {
+                top->Start = base;
+                top->End   = p;
+                base       = p + 1;
+            }
+            else
+            {
+                top->Start = p + 1;
+                top->End   = limit;
+                limit      = p;
+            }
+            top->DepthLimit = depthLimit;
+            top++;
+            continue;
+        }
+
+        if(limit - base > Threshold)
+        {
+            HeapSortSliced(arr, base, limit, less);
+        }
+        else
+        {
+            InsertionSortSliced(arr, base, limit, less);
+        }
+
+        if(top > stack)
+        {
+            top--;
+            base       = top->Start;
+            limit      = top->End;
+            depthLimit = top->DepthLimit;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+template<class Array> 
+void IntroSortSliced(Array& arr, size_t start, size_t end)
+{
+    typedef typename Array::ValueType ValueType;
+    IntroSortSliced(arr, start, end, OperatorLess<ValueType>::Compare);
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** IntroSort
+//
+// Sort an array Array, ArrayPaged, ArrayUnsafe, or a plain [first, last) range.
+// The array must have GetSize() function.
+// If no comparison predicate is specified, the data type must have a defined "<" operator.
+template<class Array, class Less> 
+void IntroSort(Array& arr, Less less)
+{
+    IntroSortSliced(arr, 0, arr.GetSize(), less);
+}
+
+template<class Array> 
+void IntroSort(Array& arr)
+{
+    typedef typename Array::ValueType ValueType;
+    IntroSortSliced(arr, 0, arr.GetSize(), OperatorLess<ValueType>::Compare);
+}
+
+template<class T, class Less> 
+void IntroSort(T* first, T* last, Less less)
+{
+    IntroSortSliced(first, 0, (size_t)(last - first), less);
+}
+
+template<class T> 
+void IntroSort(T* first, T* last)
+{
+    IntroSortSliced(first, 0, (size_t)(last - first), OperatorLess<T>::Compare);
+}
+
+
 //-----------------------------------------------------------------------------------
 // ***** Median
 // Returns a median value of the input array.
@@ -688,6 +936,301 @@ size_t UpperBound(const Array& arr, const Value& val)
 }
 
 
+//-----------------------------------------------------------------------------------
+// ***** LowerBoundBranchlessSliced
+//
+// Same result as LowerBoundSliced. The loop always runs log2(n) times and the only
+// data-dependent decision is a select, which compiles to a conditional move, so there are
+// no branch mispredictions. Faster than LowerBoundSliced when the searched values are
+// unpredictable and the array is small enough to stay in cache.
+template<class Array, class Value, class Less>
+size_t LowerBoundBranchlessSliced(const Array& arr, size_t start, size_t end, const Value& val, Less less)
+{
+    size_t base = start;
+    size_t len  = end - start;
+
+    if(len == 0)
+    {
+        return start;
+    }
+
+    while(len > 1)
+    {
+        size_t half = len >> 1;
+        base = less(arr[base + half], val) ? (base + half) : base;
+        len -= half;
+    }
+    return base + (less(arr[base], val) ? 1 : 0);
+}
+
+template<class Array, class Value>
+size_t LowerBoundBranchlessSliced(const Array& arr, size_t start, size_t end, const Value& val)
+{
+    return LowerBoundBranchlessSliced(arr, start, end, val, OperatorLess<Value>::Compare);
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** LowerBoundBranchless
+//
+template<class Array, class Value, class Less>
+size_t LowerBoundBranchless(const Array& arr, const Value& val, Less less)
+{
+    return LowerBoundBranchlessSliced(arr, 0, arr.GetSize(), val, less);
+}
+
+template<class Array, class Value>
+size_t LowerBoundBranchless(const Array& arr, const Value& val)
+{
+    return LowerBoundBranchlessSliced(arr, 0, arr.GetSize(), val, OperatorLess<Value>::Compare);
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** Eytzinger layout
+//
+// Stores a static sorted array in breadth-first (heap) order: the root at index 1, and
+// the children of element k at 2k and 2k + 1. A binary search then reads elements which
+// are close together in memory for the first several levels, which makes it much more
+// cache friendly than searching a large sorted array.
+//
+// The laid out array uses indices 1 to size; element 0 is unused. Payloads which go with
+// the keys can be laid out with the same EytzingerBuild call, or looked up with
+// EytzingerRank.
+//
+//    EytzingerBuild(sortedKeys, keyCount, eytzKeys);     // eytzKeys has keyCount + 1 elements.
+//    size_t k = EytzingerLowerBound(eytzKeys, keyCount, key);
+//    if (k && eytzKeys[k] == key)
+//        ...
+
+// Copies the subtree rooted at k from src, starting at src[i], and returns the index of
+// the first src element after it. Used by EytzingerBuild.
+template<class SrcArray, class DestArray>
+size_t EytzingerBuildSubtree(const SrcArray& src, size_t i, DestArray& dest, size_t k, size_t size)
+{
+    if(k <= size)
+    {
+        i = EytzingerBuildSubtree(src, i, dest, 2 * k, size);
+        dest[k] = src[i++];
+        i = EytzingerBuildSubtree(src, i, dest, 2 * k + 1, size);
+    }
+    return i;
+}
+
+// Copies src[0, size), which must be sorted, to dest[1, size] in Eytzinger order.
+template<class SrcArray, class DestArray>
+void EytzingerBuild(const SrcArray& src, size_t size, DestArray& dest)
+{
+    EytzingerBuildSubtree(src, 0, dest, 1, size);
+}
+
+// Returns the Eytzinger index of the first element which is not less than val,
+// or 0 if there is none.
+template<class Array, class Value, class Less>
+size_t EytzingerLowerBound(const Array& arr, size_t size, const Value& val, Less less)
+{
+    size_t k = 1;
+
+    while(k <= size)
+    {
+        k = 2 * k + (less(arr[k], val) ? 1 : 0);
+    }
+
+    // The path went left at the answer and right at every level below it; strip
+    // those right turns plus the left turn.
+    return (size_t)(k >> (CountTrailing0Bits((uint64_t)~k) + 1));
+}
+
+template<class Array, class Value>
+size_t EytzingerLowerBound(const Array& arr, size_t size, const Value& val)
+{
+    return EytzingerLowerBound(arr, size, val, OperatorLess<Value>::Compare);
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** LowerBoundSIMD
+//
+// LowerBound for static sorted arrays of 32 bit integers, using a separate search index.
+// The index is a 16-way tree (a B+ tree) over the keys: each node is 16 keys in one 64
+// byte cache line, and holds the largest key of each of 16 children. Every step compares
+// val with all 16 keys of a node at once, so a search touches log16(n) cache lines
+// instead of the log2(n) of a binary search. The sorted keys themselves are the bottom level,
+// and the result is an index into them, as with LowerBound.
+//
+//    ArrayPOD<uint32_t> index;
+//    index.Resize(LowerBoundSIMDIndexSize(keyCount));
+//    LowerBoundSIMDBuild(keys, keyCount, index.GetDataPtr());
+//    size_t i = LowerBoundSIMD(keys, keyCount, index.GetDataPtr(), key);
+//
+// The index must be rebuilt if the keys change. Without SSE2 the index is still built,
+// but LowerBoundSIMD uses LowerBoundBranchless on the keys.
+
+// Keys per index node.
+static const size_t LowerBoundSIMDNodeSize = 16;
+
+// Returns the number of index levels for size keys, and fills levelCounts[1..levels]
+// with the number of used entries on each level; levelCounts[0] is size.
+inline int LowerBoundSIMDLevels(size_t size, size_t levelCounts[17])
+{
+    int levels = 0;
+
+    levelCounts[0] = size;
+    while(levelCounts[levels] > LowerBoundSIMDNodeSize)
+    {
+        levelCounts[levels + 1] = (levelCounts[levels] + LowerBoundSIMDNodeSize - 1) / LowerBoundSIMDNodeSize;
+        levels++;
+    }
+    return levels;
+}
+
+// Returns the number of 32 bit elements the index for size keys needs. 0 for 16 keys or less.
+inline size_t LowerBoundSIMDIndexSize(size_t size)
+{
+    size_t levelCounts[17];
+    int    levels = LowerBoundSIMDLevels(size, levelCounts);
+    size_t total  = 0;
+
+    for(int l = 1; l <= levels; l++)
+    {
+        total += (levelCounts[l] + LowerBoundSIMDNodeSize - 1) & ~(LowerBoundSIMDNodeSize - 1);
+    }
+    return total;
+}
+
+// The index stores the top level first. Unused entries of the last node on each level are
+// set to pad, the largest key value, so that they never compare below the searched value.
+template<class T>
+void LowerBoundSIMDBuildT(const T* keys, size_t size, T* index, T pad)
+{
+    size_t levelCounts[17];
+    int    levels = LowerBoundSIMDLevels(size, levelCounts);
+
+    // Level l starts after all the levels above it.
+    size_t offsets[17];
+    size_t offset = 0;
+    for(int l = levels; l >= 1; l--)
+    {
+        offsets[l] = offset;
+        offset += (levelCounts[l] + LowerBoundSIMDNodeSize - 1) & ~(LowerBoundSIMDNodeSize - 1);
+    }
+
+    const T* below = keys;
+    for(int l = 1; l <= levels; l++)
+    {
+        T*     level       = index + offsets[l];
+        size_t paddedCount = (levelCounts[l] + LowerBoundSIMDNodeSize - 1) & ~(LowerBoundSIMDNodeSize - 1);
+
+        // Each entry is the largest key of a node on the level below, which is its last one.
+        for(size_t i = 0; i < levelCounts[l]; i++)
+        {
+            level[i] = below[Min((i + 1) * LowerBoundSIMDNodeSize, levelCounts[l - 1]) - 1];
+        }
+        for(size_t i = levelCounts[l]; i < paddedCount; i++)
+        {
+            level[i] = pad;
+        }
+        below = level;
+    }
+}
+
+inline void LowerBoundSIMDBuild(const int32_t* keys, size_t size, int32_t* index)
+{
+    LowerBoundSIMDBuildT(keys, size, index, (int32_t)0x7FFFFFFF);
+}
+
+inline void LowerBoundSIMDBuild(const uint32_t* keys, size_t size, uint32_t* index)
+{
+    LowerBoundSIMDBuildT(keys, size, index, (uint32_t)0xFFFFFFFF);
+}
+
+#if OVR_ALG_SSE2
+
+// Returns the number of the 16 keys at p which are less than val, where p[0, 16) is sorted.
+// The keys are XORed with biasV first; see LowerBoundSIMD32.
+inline size_t LowerBoundSIMDCount16(const int32_t* p, __m128i biasV, __m128i valV)
+{
+    __m128i lt0 = _mm_cmplt_epi32(_mm_xor_si128(_mm_loadu_si128((const __m128i*)(p     )), biasV), valV);
+    __m128i lt1 = _mm_cmplt_epi32(_mm_xor_si128(_mm_loadu_si128((const __m128i*)(p +  4)), biasV), valV);
+    __m128i lt2 = _mm_cmplt_epi32(_mm_xor_si128(_mm_loadu_si128((const __m128i*)(p +  8)), biasV), valV);
+    __m128i lt3 = _mm_cmplt_epi32(_mm_xor_si128(_mm_loadu_si128((const __m128i*)(p + 12)), biasV), valV);
+
+    // Narrow the 32 bit lane masks to bytes. The keys are sorted, so the set bits are
+    // the low ones and their count is the position of the first clear bit.
+    __m128i lt   = _mm_packs_epi16(_mm_packs_epi32(lt0, lt1), _mm_packs_epi32(lt2, lt3));
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(lt);
+
+    return (size_t)CountTrailing0Bits(~mask);
+}
+
+// keys, index and val are XORed with bias before the (signed) comparisons; a bias of
+// 0x80000000 turns them into unsigned comparisons.
+inline size_t LowerBoundSIMD32(const int32_t* keys, size_t size, const int32_t* index, int32_t val, int32_t bias)
+{
+    const __m128i biasV = _mm_set1_epi32(bias);
+    const __m128i valV  = _mm_set1_epi32(val ^ bias);
+
+    if(size < LowerBoundSIMDNodeSize)
+    {
+        size_t i = 0;
+        while((i < size) && ((keys[i] ^ bias) < (val ^ bias)))
+        {
+            i++;
+        }
+        return i;
+    }
+
+    size_t levelCounts[17];
+    int    levels = LowerBoundSIMDLevels(size, levelCounts);
+    size_t node   = 0;
+
+    for(int l = levels; l >= 1; l--)
+    {
+        // The entry found on this level is the node to visit on the level below.
+        size_t entry = node * LowerBoundSIMDNodeSize +
+                       LowerBoundSIMDCount16(index + node * LowerBoundSIMDNodeSize, biasV, valV);
+
+        // Only possible on the top level: every key is less than val.
+        if(entry >= levelCounts[l])
+        {
+            return size;
+        }
+
+        index += (levelCounts[l] + LowerBoundSIMDNodeSize - 1) & ~(LowerBoundSIMDNodeSize - 1);
+        node   = entry;
+    }
+
+    // Count in a 16 key window ending no later than the last key. Keys before the node
+    // are all below val, so the count still lands on the answer.
+    const size_t window = Min(node * LowerBoundSIMDNodeSize, size - LowerBoundSIMDNodeSize);
+    return window + LowerBoundSIMDCount16(keys + window, biasV, valV);
+}
+
+inline size_t LowerBoundSIMD(const int32_t* keys, size_t size, const int32_t* index, int32_t val)
+{
+    return LowerBoundSIMD32(keys, size, index, val, 0);
+}
+
+inline size_t LowerBoundSIMD(const uint32_t* keys, size_t size, const uint32_t* index, uint32_t val)
+{
+    return LowerBoundSIMD32((const int32_t*)keys, size, (const int32_t*)index, (int32_t)val, (int32_t)0x80000000);
+}
+
+#else
+
+inline size_t LowerBoundSIMD(const int32_t* keys, size_t size, const int32_t*, int32_t val)
+{
+    return LowerBoundBranchlessSliced(keys, 0, size, val);
+}
+
+inline size_t LowerBoundSIMD(const uint32_t* keys, size_t size, const uint32_t*, uint32_t val)
+{
+    return LowerBoundBranchlessSliced(keys, 0, size, val);
+}
+
+#endif // OVR_ALG_SSE2
+
+
 //-----------------------------------------------------------------------------------
 // ***** ReverseArray
 //
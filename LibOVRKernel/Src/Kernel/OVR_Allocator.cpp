@@ -27,11 +27,14 @@ limitations under the License.
 #include "OVR_Allocator.h"
 #include "OVR_DebugHelp.h"
 #include "OVR_Alg.h"
+#include "OVR_Threads.h"
+#include "OVR_JSON.h"
 #include "Util/Util_SystemInfo.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <exception>
 #include <algorithm>
+#include <cstddef>
 #include <sstream>
 #include <memory>
 
@@ -45,6 +48,15 @@ limitations under the License.
     #include <unistd.h>
     #include <sys/mman.h>
     #include <execinfo.h>
+    #if defined(__linux__)
+        #include <fcntl.h>
+        #include <malloc.h>
+        #include <sys/syscall.h>
+        #include <errno.h>
+    #endif
+    #if !defined(MAP_NORESERVE)
+        #define MAP_NORESERVE 0
+    #endif
 #endif
 
 
@@ -120,6 +132,59 @@ limitations under the License.
 #endif
 
 
+//-----------------------------------------------------------------------------------
+// ***** OVR_ALLOCATOR_THREAD_CACHE_ENABLED
+//
+// Defined as 0 or 1.
+// If enabled then small allocations are served from per-thread caches by default.
+// However, even if this is disabled it can still be enabled at runtime by manually
+// setting the appropriate environment variable/registry key.
+// This has no effect when the debug page heap is used, as caching freed blocks
+// would defeat its use-after-free detection.
+//
+#ifndef OVR_ALLOCATOR_THREAD_CACHE_ENABLED
+    #define OVR_ALLOCATOR_THREAD_CACHE_ENABLED 0
+#endif
+
+
+//-----------------------------------------------------------------------------------
+// ***** OVR_ALLOCATOR_SAMPLING_ENABLED
+//
+// Defined as 0 or 1.
+// If enabled then heap sampling is done by default, with Allocator::DefaultSampleInterval.
+// However, even if this is disabled it can still be enabled at runtime by manually
+// setting the appropriate environment variable/registry key, or via Allocator::EnableSampling.
+//
+#ifndef OVR_ALLOCATOR_SAMPLING_ENABLED
+    #define OVR_ALLOCATOR_SAMPLING_ENABLED 0
+#endif
+
+
+//-----------------------------------------------------------------------------------
+// ***** OVR_ALLOCATOR_HEAP_STATS_ENABLED
+//
+// Defined as 0 or 1.
+// If enabled then the Allocator keeps HeapStats counters (see Allocator::GetHeapStats).
+// They cost a few uncontended thread-local increments per allocation, so they are on by default.
+//
+#ifndef OVR_ALLOCATOR_HEAP_STATS_ENABLED
+    #define OVR_ALLOCATOR_HEAP_STATS_ENABLED 1
+#endif
+
+
+//-----------------------------------------------------------------------------------
+// ***** OVR_ALLOCATOR_HUGE_PAGES_ENABLED
+//
+// Defined as 0 or 1.
+// If enabled then on Linux the OSHeap is used by default, with transparent huge pages and
+// NUMA node binding for allocations of at least OSHeap::DefaultHugePageThreshold bytes.
+// This can also be set up at runtime via Allocator::EnableOSHeap and SetHugePagePolicy.
+//
+#ifndef OVR_ALLOCATOR_HUGE_PAGES_ENABLED
+    #define OVR_ALLOCATOR_HUGE_PAGES_ENABLED 0
+#endif
+
+
 //-----------------------------------------------------------------------------------
 // ***** OVR_REDIRECT_CRT_MALLOC
 //
@@ -970,2183 +1035,5639 @@ AllocatorAutoCreate allocatorAutoCreate;
 
 
 //-----------------------------------------------------------------------------------
-// ***** Allocator
+// ***** AllocTrackingTable
 //
 
-Allocator* Allocator::DefaultAllocator    = nullptr;
-uint64_t   Allocator::ReferenceHeapTimeNs = 0;  // Don't set this to GetCurrentHeapTimeNs() because we may need to initialize it earlier than that construction occurs.
-
-Allocator* Allocator::GetInstance(bool create)
+AllocTrackingTable::AllocTrackingTable()
 {
-    if(!DefaultAllocator && create)
+    for (size_t i = 0; i < ShardCount; ++i)
     {
-        // This is not thread-safe. Two calls could race to this point.
-        #if defined(_WIN32)
-            // Cannot allocate memory while doing the following.
-            wchar_t moduleNameW[MAX_PATH];
-            char    defaultAllocatorName[MAX_PATH * 6] = {}; // Maximum possible requirement for a UTF16 to UTF8 conversion.
-            DWORD   nameStrlen = GetModuleFileNameW(nullptr, moduleNameW, MAX_PATH);
-            WideCharToMultiByte(CP_UTF8, 0, moduleNameW, nameStrlen + 1, defaultAllocatorName, sizeof(defaultAllocatorName), nullptr, nullptr); // +1 because WideCharToMultiByte will only 0-terminate if you include the 0 as part of the input.
-            defaultAllocatorName[sizeof(defaultAllocatorName)-1] = '\0';
-            std::transform(defaultAllocatorName, defaultAllocatorName + strlen(defaultAllocatorName), defaultAllocatorName, [](char c) { return ((c == '/') ? '\\' : c); }); // Convert any / to \.
-            const char* lastSeparator = strrchr(defaultAllocatorName, '\\');
-            if (lastSeparator)
-                memmove(defaultAllocatorName, lastSeparator + 1, strlen(lastSeparator + 1) + 1);
-            OVR_strlcat(defaultAllocatorName, " Default Allocator", sizeof(defaultAllocatorName));
-        #else
-            const char* defaultAllocatorName = "Default Allocator";
-        #endif
-        DefaultAllocator = new(SysMemAlloc(sizeof(Allocator))) Allocator(defaultAllocatorName);
-        DefaultAllocator->Init();
+        Shard& shard = Shards[i];
+        shard.Slots = nullptr;
+        shard.Capacity = 0;
+        shard.Size = 0;
+        shard.FreeList = nullptr;
+        shard.ChunkList = nullptr;
     }
 
-    return DefaultAllocator;
+    for (size_t i = 0; i < FilterSize; ++i)
+        Filter[i].store(0, std::memory_order_relaxed);
 }
 
 
-
-void Allocator::DestroyInstance()
+AllocTrackingTable::~AllocTrackingTable()
 {
-    if (DefaultAllocator)
-    {
-        // This is not thread-safe. Two calls could race to this line.
-        DefaultAllocator->Shutdown();
-        DefaultAllocator->~Allocator();
-        SysMemFree(DefaultAllocator, sizeof(Allocator));
-        DefaultAllocator = nullptr;
-    }
+    Clear();
 }
 
 
-Allocator::Allocator(const char* allocatorName)
-   : AllocatorName{}
-   , Heap(nullptr)
-   , DebugPageHeapEnabled(false)
-   , OSHeapEnabled(false)
-   , MallocRedirectEnabled(false)
-   , MallocRedirect(nullptr)
-   , TrackingEnabled(false)
-   , TraceAllocationsOnShutdown(false)
-   , TrackLock()
-   , TrackIterator()
-   , AllocationMap()
-   , DelayedFreeList()
-   , DelayedAlignedFreeList()
-   , CurrentCounter()
-   , SymbolLookupEnabled(false)
-   , TagMap()
-   , TagMapLock()
+uint64_t AllocTrackingTable::HashPointer(const void* p)
 {
-    SetAllocatorName(allocatorName);
-
-    if (ReferenceHeapTimeNs == 0)   // There is a thread race condition for the case that on startup two threads somehow execute this line at the same time.
-        ReferenceHeapTimeNs = GetCurrentHeapTimeNs();
+    // MurmurHash3 finalizer. Allocation addresses have few distinct low bits, so we need to mix well.
+    uint64_t h = (uint64_t)(uintptr_t)p;
+    h ^= (h >> 33);
+    h *= UINT64_C(0xff51afd7ed558ccd);
+    h ^= (h >> 33);
+    h *= UINT64_C(0xc4ceb9fe1a85ec53);
+    h ^= (h >> 33);
+    return h;
 }
 
 
-void Allocator::SetAllocatorName(const char* allocatorName)
+AllocTrackingTable::Slot* AllocTrackingTable::FindSlot(const Shard& shard, const void* p, uint64_t hash)
 {
-    if (allocatorName)
-        OVR::OVR_strlcpy(AllocatorName, allocatorName, OVR_ARRAY_COUNT(AllocatorName));
-}
+    // Returns the slot holding p, else the empty slot where p would be inserted.
+    // The table is never full, so this always terminates.
+    const size_t mask = (shard.Capacity - 1);
 
+    for (size_t i = ((size_t)hash & mask); ; i = ((i + 1) & mask))
+    {
+        Slot* slot = &shard.Slots[i];
 
-const char* Allocator::GetAllocatorName() const
-{
-    return AllocatorName;
+        if ((slot->Alloc == p) || !slot->Alloc)
+            return slot;
+    }
 }
 
 
-Allocator::~Allocator()
+bool AllocTrackingTable::GrowShard(Shard& shard)
 {
-    Allocator::Shutdown();
-}
+    const size_t newCapacity = (shard.Capacity ? (shard.Capacity * 2) : InitialCapacity);
+    Slot* newSlots = static_cast<Slot*>(SafeMMapAlloc(newCapacity * sizeof(Slot))); // Returned memory is 0-filled.
+
+    if (!newSlots)
+        return false;
 
+    const size_t mask = (newCapacity - 1);
 
-bool Allocator::Init()
-{
-    if (!Heap) // If not already initialized...
+    for (size_t i = 0; i < shard.Capacity; ++i)
     {
-        // Potentially redirect the CRT malloc family of functions.
-        if (!MallocRedirectEnabled) // If not programmatically enabled before this init call...
+        if (shard.Slots[i].Alloc)
         {
-            #if OVR_REDIRECT_CRT_MALLOC
-                MallocRedirectEnabled = true;
-            #else
-                MallocRedirectEnabled = OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"MallocRedirectEnabled", false); // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\MallocRedirectEnabled", REG_DWORD of 0 or 1.
-            #endif
+            size_t j = ((size_t)HashPointer(shard.Slots[i].Alloc) & mask);
 
-            if (Allocator::GetInstance(false) != this) // Only redirect malloc if we are the default heap.
-                MallocRedirectEnabled = false;
-        }
+            while (newSlots[j].Alloc)
+                j = ((j + 1) & mask);
 
-        if (MallocRedirectEnabled)
-        {
-            // We will need to enable tracking so that we can distinguish between our pointers and pointers allocated via malloc before we did this redirect.
-            TrackingEnabled = true;
+            newSlots[j] = shard.Slots[i];
+        }
+    }
 
-            // Make a struct of our override function pointers.
-            OVR::InterceptCRTMalloc::MallocFunctionPointers mfp;
+    if (shard.Slots)
+        SafeMMapFree(shard.Slots, shard.Capacity * sizeof(Slot));
 
-            mfp.malloc_ptr = ovr_malloc;
-            mfp.calloc_ptr = ovr_calloc;
-            mfp.realloc_ptr = ovr_realloc;
-            mfp.recalloc_ptr = ovr_recalloc;
-            mfp.msize_ptr = ovr_msize;
-            mfp.free_ptr = ovr_free;
-            mfp.aligned_malloc_ptr = ovr_aligned_malloc;
-            mfp.aligned_offset_malloc_ptr = ovr_aligned_offset_malloc;
-            mfp.aligned_realloc_ptr = ovr_aligned_realloc;
-            mfp.aligned_offset_realloc_ptr = ovr_aligned_offset_realloc;
-            mfp.aligned_recalloc_ptr = ovr_aligned_recalloc;
-            mfp.aligned_offset_recalloc_ptr = ovr_aligned_offset_recalloc;
-            mfp.aligned_msize_ptr = ovr_aligned_msize;
-            mfp.aligned_free_ptr = ovr_aligned_free;
+    shard.Slots = newSlots;
+    shard.Capacity = newCapacity;
 
-            #ifdef OVR_DEBUG_CRT_PRESENT
-                mfp.malloc_dbg_ptr = ovr_malloc_dbg;
-                mfp.calloc_dbg_ptr = ovr_calloc_dbg;
-                mfp.realloc_dbg_ptr = ovr_realloc_dbg;
-                mfp.recalloc_dbg_ptr = ovr_recalloc_dbg;
-                mfp.msize_dbg_ptr = ovr_msize_dbg;
-                mfp.free_dbg_ptr = ovr_free_dbg;
-                mfp.aligned_malloc_dbg_ptr = ovr_aligned_malloc_dbg;
-                mfp.aligned_offset_malloc_dbg_ptr = ovr_aligned_offset_malloc_dbg;
-                mfp.aligned_realloc_dbg_ptr = ovr_aligned_realloc_dbg;
-                mfp.aligned_offset_realloc_dbg_ptr = ovr_aligned_offset_realloc_dbg;
-                mfp.aligned_recalloc_dbg_ptr = ovr_aligned_recalloc_dbg;
-                mfp.aligned_offset_recalloc_dbg_ptr = ovr_aligned_offset_recalloc_dbg;
-                mfp.aligned_msize_dbg_ptr = ovr_aligned_msize_dbg;
-                mfp.aligned_free_dbg_ptr = ovr_aligned_free_dbg;
-            #endif
+    return true;
+}
 
-            MallocRedirect = new (SysMemAlloc(sizeof(OVR::InterceptCRTMalloc))) OVR::InterceptCRTMalloc;
-            MallocRedirect->ReplaceCRTMalloc(mfp);
-        }
 
+AllocMetadata* AllocTrackingTable::NewMetadata(Shard& shard)
+{
+    if (!shard.FreeList)
+    {
+        char* chunk = static_cast<char*>(SafeMMapAlloc(MetadataChunkSize));
 
-        // Potentially enable the debug page heap.
-        if (!DebugPageHeapEnabled) // If not programmatically enabled before this init call...
-        {
-            // The debug page heap is restricted to 64 bit platforms due to the potential for address space exhaustion on 32-bit platforms.
-            #if defined(OVR_CPU_X86_64)
-                #if OVR_ALLOCATOR_DEBUG_PAGE_HEAP_ENABLED // If we should try to enable the debug heap...
-                    DebugPageHeapEnabled = true;
-                #else
-                    DebugPageHeapEnabled = OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"DebugPageHeapEnabled", DebugPageHeapEnabled); // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\DebugPageHeapEnabled", REG_DWORD of 0 or 1.
-                #endif
+        if (!chunk)
+            return nullptr;
 
-                #if defined(OVR_BUILD_DEBUG) && defined(_MSC_VER)
-                    if (DebugPageHeapEnabled)
-                    {
-                        // Make _CrtIsValidHeapPointer always return true. The VC++ concurrency library has a bug in that
-                        // it's calling _CrtIsValidHeapPointer, which is invalid and recommended against by Microsoft themselves.
-                        // We need to deal with this nevertheless. The problem is that the VC++ concurrency library is
-                        // calling _CrtIsValidHeapPointer on the default heap instead of the current heap (DebugPageHeap).
-                        // So we modify the _CrtIsValidHeapPointer implementation to always return true. The primary risk
-                        // with this change is that there's some code somewhere that uses it for a non-diagnostic purpose.
-                        // However this os Oculus-debug-internal and so has no effect on any formally published software.
-                        DebugPageHeapEnabled = OVR::KillCdeclFunction(_CrtIsValidHeapPointer, true); // If we can successfully kill _CrtIsValidHeapPointer, enable our debug heap.
-                    }
-                #endif
-            #endif
-        }
+        *reinterpret_cast<void**>(chunk) = shard.ChunkList;
+        shard.ChunkList = chunk;
 
-        if (DebugPageHeapEnabled)
+        // The first 16 bytes of the chunk hold the ChunkList link, the rest are records.
+        for (size_t offset = 16; (offset + sizeof(AllocMetadata)) <= MetadataChunkSize; offset += sizeof(AllocMetadata))
         {
-            // We will need to enable tracking so that we can distinguish between our pointers and pointers allocated via malloc before we did this redirect.
-            TrackingEnabled = true;
-
-            Heap = new(SysMemAlloc(sizeof(DebugPageHeap))) DebugPageHeap;
-            Heap->Init();
+            AllocMetadata* record = reinterpret_cast<AllocMetadata*>(chunk + offset);
+            *reinterpret_cast<AllocMetadata**>(record) = shard.FreeList;
+            shard.FreeList = record;
         }
-        else if(MallocRedirectEnabled)
-        {
-            // We will need to enable tracking so that we can distinguish between our pointers and pointers allocated via malloc before we did this redirect.
-            TrackingEnabled = true;
-            OSHeapEnabled = true;
+    }
 
-            // If we are redirecting CRT malloc then we can't use the default heap, because it used CRT malloc, which would we be circular.
-            Heap = new(SysMemAlloc(sizeof(OSHeap))) OSHeap;
-            Heap->Init();
-        }
-        else // Else default heap (which uses malloc).
-        {
-            Heap = new(SysMemAlloc(sizeof(DefaultHeap))) DefaultHeap;
-            Heap->Init();
-        }
+    AllocMetadata* record = shard.FreeList;
+    shard.FreeList = *reinterpret_cast<AllocMetadata**>(record);
 
+    return record;
+}
 
-        // Potentially enable allocation tracking.
-        if (!TrackingEnabled) // If not programmatically enabled before this init call...
-        {
-            #if OVR_ALLOCATOR_TRACKING_ENABLED
-                TrackingEnabled = true;
-            #else
-                TrackingEnabled = IsHeapTrackingRegKeyEnabled(TrackingEnabled);
-            #endif
-        }
 
+void AllocTrackingTable::ClearShard(Shard& shard)
+{
+    if (shard.Slots)
+        SafeMMapFree(shard.Slots, shard.Capacity * sizeof(Slot));
 
-        // Initialize the symbol and backtrace utility library
-        SymbolLookupEnabled = SymbolLookup::Initialize();
+    while (shard.ChunkList)
+    {
+        void* next = *reinterpret_cast<void**>(shard.ChunkList);
+        SafeMMapFree(shard.ChunkList, MetadataChunkSize);
+        shard.ChunkList = next;
     }
 
-    return true;
+    shard.Slots = nullptr;
+    shard.Capacity = 0;
+    shard.Size = 0;
+    shard.FreeList = nullptr;
 }
 
 
-void Allocator::Shutdown()
+bool AllocTrackingTable::Insert(const AllocMetadata& amd)
 {
-    if (Heap) // If we were initialized...
+    const uint64_t hash = HashPointer(amd.Alloc);
+    Shard& shard = GetShard(hash);
+    Lock::Locker locker(&shard.Lock);
+
+    if (((shard.Size + 1) * 4) > (shard.Capacity * 3)) // Keep the load factor at or below 75%.
     {
-        if (TraceAllocationsOnShutdown)
-            TraceTrackedAllocations(nullptr, 0);
+        if (!GrowShard(shard))
+            return false;
+    }
 
-        if (SymbolLookupEnabled)
-            SymbolLookup::Shutdown();
+    Slot* slot = FindSlot(shard, amd.Alloc, hash);
 
-        if (MallocRedirectEnabled)
-        {
-            MallocRedirect->RestoreCRTMalloc();
-            MallocRedirect->~InterceptCRTMalloc();
-            SysMemFree(MallocRedirect, sizeof(OVR::InterceptCRTMalloc));
-            MallocRedirect = nullptr;
-        }
+    if (!slot->Alloc) // If this is a new entry...
+    {
+        AllocMetadata* record = NewMetadata(shard);
 
-        for(auto p: DelayedAlignedFreeList)
-            _aligned_free(p);
-        DelayedAlignedFreeList.clear();
+        if (!record)
+            return false;
 
-        for(auto p: DelayedFreeList)
-            free(p);
-        DelayedFreeList.clear();
+        slot->Alloc = amd.Alloc;
+        slot->Metadata = record;
+        shard.Size++;
+        Filter[GetFilterIndex(hash)].fetch_add(1, std::memory_order_relaxed);
+    }
 
-        AllocationMap.clear();
-        TagMap.clear();
-        CurrentCounter = 0;
+    *slot->Metadata = amd;
 
-        // Free the heap.
-        if (Heap)
-        {
-            Heap->Shutdown();
-            Heap->~Heap();
-            if (DebugPageHeapEnabled)
-                SysMemFree(Heap, sizeof(DebugPageHeap));
-            else
-                SysMemFree(Heap, sizeof(DefaultHeap));
-        }
-        Heap = nullptr;
-    }
+    return true;
 }
 
 
-void* Allocator::Alloc(size_t size, const char* tag)
+bool AllocTrackingTable::Remove(const void* p)
 {
-    return AllocDebug(size, tag, nullptr, 0);
+    const uint64_t hash = HashPointer(p);
+    Shard& shard = GetShard(hash);
+    Lock::Locker locker(&shard.Lock);
+
+    if (!shard.Size)
+        return false;
+
+    Slot* slot = FindSlot(shard, p, hash);
+
+    if (!slot->Alloc)
+        return false;
+
+    *reinterpret_cast<AllocMetadata**>(slot->Metadata) = shard.FreeList;
+    shard.FreeList = slot->Metadata;
+
+    // Backward-shift deletion: Move following entries of the same probe run into the hole, so that
+    // we need no tombstones and lookups never have to skip deleted entries.
+    const size_t mask = (shard.Capacity - 1);
+    size_t i = (size_t)(slot - shard.Slots);
+
+    for (size_t j = ((i + 1) & mask); shard.Slots[j].Alloc; j = ((j + 1) & mask))
+    {
+        const size_t home = ((size_t)HashPointer(shard.Slots[j].Alloc) & mask);
+
+        if (((j - home) & mask) >= ((j - i) & mask)) // If the hole is within the entry's probe path...
+        {
+            shard.Slots[i] = shard.Slots[j];
+            i = j;
+        }
+    }
+
+    shard.Slots[i].Alloc = nullptr;
+    shard.Slots[i].Metadata = nullptr;
+    shard.Size--;
+    Filter[GetFilterIndex(hash)].fetch_sub(1, std::memory_order_relaxed);
+
+    return true;
 }
 
 
-void* Allocator::Calloc(size_t count, size_t size, const char* tag)
+bool AllocTrackingTable::Contains(const void* p)
 {
-    return CallocDebug(count, size, tag, nullptr, 0);
+    const uint64_t hash = HashPointer(p);
+    Shard& shard = GetShard(hash);
+    Lock::Locker locker(&shard.Lock);
+
+    return (shard.Size && FindSlot(shard, p, hash)->Alloc);
 }
 
 
-void* Allocator::AllocAligned(size_t size, size_t align, const char* tag)
+bool AllocTrackingTable::MayContain(const void* p) const
 {
-    return AllocAlignedDebug(size, align, tag, nullptr, 0);
+    // A relaxed load is enough: If p was inserted, that happened in the thread which allocated p,
+    // before p could have been handed to the thread which is now asking about it.
+    return (Filter[GetFilterIndex(HashPointer(p))].load(std::memory_order_relaxed) != 0);
 }
 
 
-void* Allocator::AllocDebug(size_t size, const char* tag, const char* file, unsigned line)
+bool AllocTrackingTable::Get(const void* p, AllocMetadata& metadata)
 {
-    OVR_ALLOC_BENCHMARK_START();
-
-    void* p = Heap->Alloc(size);
+    const uint64_t hash = HashPointer(p);
+    Shard& shard = GetShard(hash);
+    Lock::Locker locker(&shard.Lock);
 
-    if (p)
+    if (shard.Size)
     {
-        TrackAlloc(p, size, tag, file, line);
-    }
+        const Slot* slot = FindSlot(shard, p, hash);
 
-    OVR_ALLOC_BENCHMARK_END();
+        if (slot->Alloc)
+        {
+            metadata = *slot->Metadata;
+            return true;
+        }
+    }
 
-    return p;
+    return false;
 }
 
 
-void* Allocator::CallocDebug(size_t count, size_t size, const char* tag, const char* file, unsigned line)
+bool AllocTrackingTable::SetSize(const void* p, uint64_t allocSize, uint64_t blockSize)
 {
-    void* p = AllocDebug(count * size,  tag, file, line);
+    const uint64_t hash = HashPointer(p);
+    Shard& shard = GetShard(hash);
+    Lock::Locker locker(&shard.Lock);
 
-    if (p)
+    if (shard.Size)
     {
-        memset(p, 0, count * size);
+        const Slot* slot = FindSlot(shard, p, hash);
+
+        if (slot->Alloc)
+        {
+            slot->Metadata->AllocSize = allocSize;
+            slot->Metadata->BlockSize = blockSize;
+            return true;
+        }
     }
 
-    return p;
+    return false;
 }
 
 
-void* Allocator::AllocAlignedDebug(size_t size, size_t align, const char* tag, const char* file, unsigned line)
+void AllocTrackingTable::Clear()
 {
-    OVR_ALLOC_BENCHMARK_START();
+    for (size_t i = 0; i < ShardCount; ++i)
+    {
+        // Each shard's part of Filter is cleared under the shard's lock, like Insert and Remove update
+        // it. Otherwise an entry inserted concurrently could lose its filter count and never be removed.
+        Lock::Locker locker(&Shards[i].Lock);
+        ClearShard(Shards[i]);
+
+        for (size_t j = (i * FilterShardSize), jEnd = (j + FilterShardSize); j < jEnd; ++j)
+            Filter[j].store(0, std::memory_order_relaxed);
+    }
+}
 
-    void* p = Heap->AllocAligned(size, align);
 
-    if (p)
+size_t AllocTrackingTable::GetSize() const
+{
+    size_t size = 0;
+
+    for (size_t i = 0; i < ShardCount; ++i)
+        size += Shards[i].Size;
+
+    return size;
+}
+
+
+size_t AllocTrackingTable::CopyShard(size_t shardIndex, AllocMetadata* metadata, size_t capacity)
+{
+    OVR_ASSERT(shardIndex < ShardCount);
+
+    Shard& shard = Shards[shardIndex];
+    Lock::Locker locker(&shard.Lock);
+    size_t count = 0;
+
+    for (size_t i = 0; (i < shard.Capacity) && (count < capacity); ++i)
     {
-        TrackAlloc(p, size, tag, file, line);
+        if (shard.Slots[i].Alloc)
+            metadata[count++] = *shard.Slots[i].Metadata;
     }
 
-    OVR_ALLOC_BENCHMARK_END();
+    return shard.Size;
+}
 
-    return p;
+
+void AllocTrackingTable::LockAll()
+{
+    for (size_t i = 0; i < ShardCount; ++i)
+        Shards[i].Lock.DoLock();
 }
 
 
-size_t Allocator::GetAllocSize(const void* p) const
+void AllocTrackingTable::UnlockAll()
 {
-    return Heap->GetAllocSize(p);
+    for (size_t i = ShardCount; i > 0; --i)
+        Shards[i - 1].Lock.Unlock();
 }
 
 
-size_t Allocator::GetAllocAlignedSize(const void* p, size_t align) const
+const AllocMetadata* AllocTrackingTable::IterateBegin(Iterator& it) const
 {
-    return Heap->GetAllocAlignedSize(p, align);
+    it.ShardIndex = 0;
+    it.SlotIndex = 0;
+
+    return IterateFrom(it);
 }
 
 
-void Allocator::Free(void* p)
+const AllocMetadata* AllocTrackingTable::IterateNext(Iterator& it) const
 {
-    OVR_ALLOC_BENCHMARK_START();
+    it.SlotIndex++;
 
-    if (p)
+    return IterateFrom(it);
+}
+
+
+const AllocMetadata* AllocTrackingTable::IterateFrom(Iterator& it) const
+{
+    for (; it.ShardIndex < ShardCount; it.ShardIndex++, it.SlotIndex = 0)
     {
-        if(UntrackAlloc(p)) // If this pointer is recognized as belonging to us...
-        {
-            Heap->Free(p);
-        }
-        else
-        {
-            // We don't recognize the pointer being freed. That almost always means one of two things:
-            //     - We are overriding malloc/free and somebody is freeing memory that they allocated before we 
-            //       started overriding malloc and free. 
-            //     - We are not overriding malloc/free and somebody is freeing memory via operater delete
-            //       which they allocated with malloc(). That's disallowed C++ but in fact it happens.
-            // We have a number of options for dealing with this and try to choose the best option:
-            //     - Call CRT free function.
-            //       Can't do this if we are overriding CRT free and have lost access to the original CRT free function.
-            //     - Call the CRT underlying _free_base function.
-            //       Can't do this if the debug CRT is active, because p is not the actual pointer to free.
-            //     - Call the OS underlying HeapFree function.
-            //       Can't do this if the debug CRT is active, because this method results in the debug heap structures being corrupt.
-            //     - Put the pointer in a list which we free later, in the case that we are overriding CRT free and have lost access to the original CRT free function.
-            //       This works fairly well.
-            //     - Do nothing and let the memory leak in the underlying heap.
-            //       This works fairly well but results in there looking like there was a CRT memory leak.
+        const Shard& shard = Shards[it.ShardIndex];
 
-            if (MallocRedirect)
-            {
-                #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900) // VS2013 doesn't expose _free_base, so use this delayed approach with VS2013.
-                    // In this case we can't just call the internal CRT _free_base function becase the debug heap is active and 
-                    // we would need to call a dbg function. The best way for us to do that would be to implement our own function
-                    // which works the same as _free_dbg(). However, for now we just add this pointer to the delayed free list and 
-                    // simply free it the normal way later when we shutdown.
-                    DelayedFreeList.push_back(p); // We will call free on the pointer later when we've restored the MallocRedirect.
-                #else
-                    // In this case we can just call the internal CRT _free_base function that underlies all CRT malloc functions.
-                    _free_base(p);
-                #endif
-            }
-            else
-            {
-                free(p);
-            }
+        for (; it.SlotIndex < shard.Capacity; it.SlotIndex++)
+        {
+            if (shard.Slots[it.SlotIndex].Alloc)
+                return shard.Slots[it.SlotIndex].Metadata;
         }
     }
 
-    OVR_ALLOC_BENCHMARK_END();
+    return nullptr;
 }
 
 
-void Allocator::FreeAligned(void* p)
+
+//-----------------------------------------------------------------------------------
+// ***** HeapStats
+//
+
+// The per-thread shard of an Allocator's heap statistics. Only the owning thread writes to a shard,
+// so the counters are atomic merely so that GetHeapStats can read them. Frees are counted by the
+// shard of the freeing thread, so a single shard's counts can't be interpreted on their own.
+struct HeapStatsShard
 {
-    OVR_ALLOC_BENCHMARK_START();
+    enum Counter
+    {
+        AllocCount,
+        FreeCount,
+        AllocBytes,
+        RequestedBytes,
+        FreeBytes,
+        ReallocCount,
+        ReallocGrowCount,
+        ReallocShrinkCount,
+        ReallocMoveCount,
+        ReallocGrowBytes,
+        ReallocShrinkBytes,
+        CounterCount
+    };
 
-    if (p)
+    struct TagEntry
     {
-        if(UntrackAlloc(p))
-        {
-           Heap->FreeAligned(p);
-        }
-        else
+        std::atomic<const char*> Tag;
+        std::atomic<uint64_t>    AllocCount;
+        std::atomic<uint64_t>    AllocBytes;
+    };
+
+    HeapStatsShard*       Next;                 // Set before the shard is added to Allocator::HeapStatsShardList and never changed after.
+    uint32_t              ThreadId;
+    int64_t               UnreportedLiveBytes;  // Change in live bytes not yet added to Allocator::HeapStatsLiveBytes.
+    std::atomic<uint64_t> Counters[CounterCount];
+    std::atomic<uint64_t> SizeClassAllocCount[HeapStats::SizeClassCount];
+    std::atomic<uint64_t> SizeClassFreeCount[HeapStats::SizeClassCount];
+    TagEntry              Tags[HeapStats::TagCapacity];
+    TagEntry              OtherTag;             // For tags which didn't fit into Tags.
+
+    static void Add(std::atomic<uint64_t>& counter, uint64_t value)
+        { counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed); } // Cheaper than fetch_add, and we are the only writer.
+
+    TagEntry& GetTagEntry(const char* tag);
+};
+
+
+struct HeapStatsTLS
+{
+    void*    Shard;         // HeapStatsShard* of the calling thread.
+    uint64_t InstanceId;    // Allocator::HeapStatsInstanceId of the Allocator which owns Shard.
+};
+
+static OVR_THREAD_LOCAL HeapStatsTLS CurrentHeapStatsShard;
+static std::atomic<uint64_t>        HeapStatsInstanceCounter(0);
+static const int64_t                HeapStatsReportThreshold = 262144;  // Threads report live byte changes of this size, which bounds the error of PeakLiveBytes.
+static const char* const            HeapStatsUntaggedName = "(untagged)";
+static const char* const            HeapStatsOtherTagName = "(other)";
+
+
+HeapStatsShard::TagEntry& HeapStatsShard::GetTagEntry(const char* tag)
+{
+    const size_t mask = (HeapStats::TagCapacity - 1);
+    size_t index = ((reinterpret_cast<uintptr_t>(tag) >> 4) & mask);
+
+    static_assert((HeapStats::TagCapacity & mask) == 0, "TagCapacity must be a power of two.");
+
+    for (size_t i = 0; i < HeapStats::TagCapacity; ++i, index = ((index + 1) & mask))
+    {
+        const char* entryTag = Tags[index].Tag.load(std::memory_order_relaxed);
+
+        if (entryTag == tag)
+            return Tags[index];
+
+        if (!entryTag)
         {
-            if (MallocRedirect)
-            {
-                #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900) // VS2013 doesn't expose _aligned_free_base, so use this delayed approach with VS2013.
-                    // In this case we can't just call the internal CRT _aligned_free_base function becase the debug heap is active and 
-                    // we would need to call a dbg function. The best way for us to do that would be to implement our own function
-                    // which works the same as _aligned_free_dbg(). However, for now we just add this pointer to the delayed free list and 
-                    // simply free it the normal way later when we shutdown.
-                    DelayedAlignedFreeList.push_back(p); // We will call _aligned_free on the pointer later when we've restored the MallocRedirect.
-                #else
-                    // In this case we can just call the internal CRT _free_base function that underlies all CRT malloc functions.
-                    _aligned_free_base(p);
-                #endif
-            }
-            else
-            {
-                _aligned_free(p);
-            }
+            Tags[index].Tag.store(tag, std::memory_order_release);
+            return Tags[index];
         }
     }
 
-    OVR_ALLOC_BENCHMARK_END();
+    return OtherTag;
 }
 
 
-void* Allocator::Realloc(void* p, size_t newSize)
+size_t HeapStats::GetSizeClass(size_t size)
 {
-    return ReallocDebug(p, newSize, nullptr, 0);
+    if (size <= 1)
+        return 0;
+
+    // The class is the number of significant bits in (size - 1), i.e. the exponent of the next power of two.
+    uint64_t value = (uint64_t)(size - 1);
+    size_t   sizeClass;
+
+    #if defined(_MSC_VER) && defined(_WIN64)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        sizeClass = (size_t)index + 1;
+    #elif defined(__GNUC__)
+        sizeClass = (size_t)(64 - __builtin_clzll(value));
+    #else
+        for (sizeClass = 0; value; value >>= 1)
+            ++sizeClass;
+    #endif
+
+    return ((sizeClass < SizeClassCount) ? sizeClass : (SizeClassCount - 1));
 }
 
 
-void* Allocator::Recalloc(void* p, size_t count, size_t newSize)
+
+//-----------------------------------------------------------------------------------
+// ***** FrameSymbolCache
+//
+// Maps backtrace frame addresses to their symbol descriptions, so that each unique frame is
+// looked up only once, however many backtraces it appears in. Symbol lookup is by far the most
+// expensive part of a heap report, and leaked allocations tend to share most of their frames.
+// All memory is from SafeMMapAlloc, as we may be reporting on the heap we'd otherwise use.
+// Not thread-safe; Allocator serializes use via SymbolCacheLock.
+//
+class FrameSymbolCache
 {
-    return RecallocDebug(p, count, newSize, nullptr, 0);
-}
+public:
+    FrameSymbolCache();
+   ~FrameSymbolCache();
 
+    // Returns the description of address, e.g. "Foo.cpp(12): Foo::Bar", or an empty string if
+    // symbols are unavailable for it. The result is either cached text or, if we can't get memory
+    // to cache it, written to buffer.
+    const char* Lookup(SymbolLookup& symbols, void* address, char* buffer, size_t bufferCapacity);
 
-void* Allocator::ReallocAligned(void* p, size_t newSize, size_t newAlign)
+protected:
+    struct Entry
+    {
+        void*       Address;            // nullptr if the entry is unused.
+        const char* Text;
+    };
+
+    struct TextChunk
+    {
+        TextChunk* Next;
+        size_t     Size;                // Size of the chunk, including this header.
+        size_t     Used;                // Bytes used, including this header.
+    };
+
+    bool        Grow();
+    const char* StoreText(const char* text);
+
+    static size_t GetIndex(const void* address, size_t capacity)
+        { return (size_t)(((uint64_t)(uintptr_t)address * UINT64_C(0x9E3779B97F4A7C15)) >> 24) & (capacity - 1); }
+
+    static const size_t InitialCapacity = 4096;     // Must be a power of two.
+    static const size_t TextChunkSize   = 65536;
+
+    Entry*     Entries;                 // Open-addressing table, kept at most half full.
+    size_t     Capacity;
+    size_t     Size;
+    TextChunk* TextChunkList;           // The most recent chunk is first.
+};
+
+
+FrameSymbolCache::FrameSymbolCache()
+  : Entries(nullptr), Capacity(0), Size(0), TextChunkList(nullptr)
 {
-    return ReallocAlignedDebug(p, newSize, newAlign, nullptr, 0);
 }
 
 
-void* Allocator::RecallocAligned(void* p, size_t count, size_t newSize, size_t newAlign)
+FrameSymbolCache::~FrameSymbolCache()
 {
-    return RecallocAlignedDebug(p, count, newSize, newAlign, nullptr, 0);
+    if (Entries)
+        SafeMMapFree(Entries, Capacity * sizeof(Entry));
+
+    while (TextChunkList)
+    {
+        TextChunk* next = TextChunkList->Next;
+        SafeMMapFree(TextChunkList, TextChunkList->Size);
+        TextChunkList = next;
+    }
 }
 
 
-void* Allocator::ReallocDebug(void* p, size_t newSize, const char* file, unsigned line)
+const char* FrameSymbolCache::Lookup(SymbolLookup& symbols, void* address, char* buffer, size_t bufferCapacity)
 {
-    OVR_ALLOC_BENCHMARK_START();
+    size_t index = 0;
 
-    // We have a tedious problem to solve here. If we have overridden malloc and the memory p was allocated by malloc before we
-    // did the override, then p belongs to the original malloc heap. We can attempt to reallocate it here with our own heap or 
-    // we can reallocate it in the original heap it came from. The latter is simpler.
+    if (((Size * 2) < Capacity) || Grow())
+    {
+        for (index = GetIndex(address, Capacity); Entries[index].Address; index = ((index + 1) & (Capacity - 1)))
+        {
+            if (Entries[index].Address == address)
+                return Entries[index].Text;
+        }
+    }
 
-    AllocMetadata metadata;
-    bool valid = true; // realloc allows you to reallocate NULL, so set this to true by default.
-    void* pNew = nullptr;
+    SymbolInfo symbolInfo;
+    char*      text = buffer;
 
-    if (p)
+    text[0] = '\0';
+
+    if (symbols.LookupSymbol((uint64_t)address, symbolInfo) && (symbolInfo.filePath[0] || symbolInfo.function[0]))
     {
-        GetAllocMetadata(p, metadata);
-        valid = UntrackAlloc(p); // valid will be true if p is NULL, which is what we want.
+        if (symbolInfo.filePath[0])
+            snprintf(text, bufferCapacity, "%s(%d): %s", symbolInfo.filePath, symbolInfo.fileLineNumber, symbolInfo.function[0] ? symbolInfo.function : "(unknown function)");
+        else
+            snprintf(text, bufferCapacity, "0x%p (unknown source file): %s", address, symbolInfo.function);
     }
 
-    if (valid)
+    if (Capacity)
     {
-        pNew = Heap->Realloc(p, newSize);
+        const char* storedText = StoreText(text);
 
-        if (pNew)
+        if (storedText)
         {
-            TrackAlloc(pNew, newSize, metadata.Tag, file, line);
+            Entries[index].Address = address;
+            Entries[index].Text = storedText;
+            Size++;
+            return storedText;
         }
     }
-    else if (MallocRedirect) // Else p came from the CRT heap. It was likely malloc'd before we redirected malloc.
-    {
-        #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900) // VS2013 doesn't expose _realloc_base, so use this delayed approach with VS2013.
-            #if OVR_DEBUG_CRT_PRESENT
-                size_t originalSize = header_from_block(p)->data_size; // We have to read internal debug data.
-                pNew = crt_malloc_dbg(newSize, _NORMAL_BLOCK, file, line);
-            #else
-                size_t originalSize = HeapSize(GetCRTHeapHandle(), 0, p);
-                pNew = HeapAlloc(GetCRTHeapHandle(), 0, newSize);
-            #endif
-            if (pNew)
-            {
-                size_t copySize = std::min(originalSize, newSize);
-                memcpy(pNew, p, copySize);
-                DelayedFreeList.push_back(p);
-            }
-            // Else don't free p and return nullptr.
-        #else
-            pNew = _realloc_base(p, newSize);
-        #endif
-    }
-    else
-    {
-        pNew = realloc(p, newSize);
-    }
-
-    OVR_ALLOC_BENCHMARK_END();
 
-    return pNew;
+    return text;
 }
 
 
-void* Allocator::RecallocDebug(void* p, size_t count, size_t newSize, const char* file, unsigned line)
+bool FrameSymbolCache::Grow()
 {
-    void* pNew = nullptr;
+    const size_t newCapacity = (Capacity ? (Capacity * 2) : InitialCapacity);
+    Entry*       newEntries = static_cast<Entry*>(SafeMMapAlloc(newCapacity * sizeof(Entry))); // Returned memory is 0-filled.
 
-    if (!OVR::Alg::UnsignedMultiplyWouldOverflow(count, newSize))
+    if (!newEntries)
+        return (Capacity != 0) && ((Size + 1) < Capacity); // We can keep using the current table, though it gets slower.
+
+    for (size_t i = 0; i < Capacity; ++i)
+    {
+        if (Entries[i].Address)
+        {
+            size_t index = GetIndex(Entries[i].Address, newCapacity);
+
+            while (newEntries[index].Address)
+                index = ((index + 1) & (newCapacity - 1));
+
+            newEntries[index] = Entries[i];
+        }
+    }
+
+    if (Entries)
+        SafeMMapFree(Entries, Capacity * sizeof(Entry));
+
+    Entries = newEntries;
+    Capacity = newCapacity;
+
+    return true;
+}
+
+
+const char* FrameSymbolCache::StoreText(const char* text)
+{
+    if (!text[0])
+        return ""; // Most frames of system modules have no symbols, so don't store a copy of the empty string for each.
+
+    const size_t length = (strlen(text) + 1);
+
+    if (!TextChunkList || ((TextChunkList->Used + length) > TextChunkList->Size))
+    {
+        const size_t chunkSize = (((sizeof(TextChunk) + length) > TextChunkSize) ? (sizeof(TextChunk) + length) : TextChunkSize); // Not std::max, which would odr-use TextChunkSize.
+        TextChunk*   chunk = static_cast<TextChunk*>(SafeMMapAlloc(chunkSize));
+
+        if (!chunk)
+            return nullptr;
+
+        chunk->Next = TextChunkList;
+        chunk->Size = chunkSize;
+        chunk->Used = sizeof(TextChunk);
+        TextChunkList = chunk;
+    }
+
+    char* storedText = (reinterpret_cast<char*>(TextChunkList) + TextChunkList->Used);
+    memcpy(storedText, text, length);
+    TextChunkList->Used += length;
+
+    return storedText;
+}
+
+
+
+//-----------------------------------------------------------------------------------
+// ***** Allocator
+//
+
+Allocator* Allocator::DefaultAllocator    = nullptr;
+uint64_t   Allocator::ReferenceHeapTimeNs = 0;  // Don't set this to GetCurrentHeapTimeNs() because we may need to initialize it earlier than that construction occurs.
+
+Allocator* Allocator::GetInstance(bool create)
+{
+    if(!DefaultAllocator && create)
+    {
+        // This is not thread-safe. Two calls could race to this point.
+        #if defined(_WIN32)
+            // Cannot allocate memory while doing the following.
+            wchar_t moduleNameW[MAX_PATH];
+            char    defaultAllocatorName[MAX_PATH * 6] = {}; // Maximum possible requirement for a UTF16 to UTF8 conversion.
+            DWORD   nameStrlen = GetModuleFileNameW(nullptr, moduleNameW, MAX_PATH);
+            WideCharToMultiByte(CP_UTF8, 0, moduleNameW, nameStrlen + 1, defaultAllocatorName, sizeof(defaultAllocatorName), nullptr, nullptr); // +1 because WideCharToMultiByte will only 0-terminate if you include the 0 as part of the input.
+            defaultAllocatorName[sizeof(defaultAllocatorName)-1] = '\0';
+            std::transform(defaultAllocatorName, defaultAllocatorName + strlen(defaultAllocatorName), defaultAllocatorName, [](char c) { return ((c == '/') ? '\\' : c); }); // Convert any / to \.
+            const char* lastSeparator = strrchr(defaultAllocatorName, '\\');
+            if (lastSeparator)
+                memmove(defaultAllocatorName, lastSeparator + 1, strlen(lastSeparator + 1) + 1);
+            OVR_strlcat(defaultAllocatorName, " Default Allocator", sizeof(defaultAllocatorName));
+        #else
+            const char* defaultAllocatorName = "Default Allocator";
+        #endif
+        DefaultAllocator = new(SysMemAlloc(sizeof(Allocator))) Allocator(defaultAllocatorName);
+        DefaultAllocator->Init();
+    }
+
+    return DefaultAllocator;
+}
+
+
+
+void Allocator::DestroyInstance()
+{
+    if (DefaultAllocator)
+    {
+        // This is not thread-safe. Two calls could race to this line.
+        DefaultAllocator->Shutdown();
+        DefaultAllocator->~Allocator();
+        SysMemFree(DefaultAllocator, sizeof(Allocator));
+        DefaultAllocator = nullptr;
+    }
+}
+
+
+Allocator::Allocator(const char* allocatorName)
+   : AllocatorName{}
+   , Heap(nullptr)
+   , DebugPageHeapEnabled(false)
+   , OSHeapEnabled(false)
+   , HugePages(HugePagesNone)
+   , HugePageThreshold(OSHeap::DefaultHugePageThreshold)
+   , NumaBindingEnabled(false)
+   , ThreadCacheEnabled(false)
+   , MallocRedirectEnabled(false)
+   , MallocRedirect(nullptr)
+   , TrackingEnabled(false)
+   , TraceAllocationsOnShutdown(false)
+   , TrackLock()
+   , TrackIterator()
+   , AllocationTable()
+   , DelayedFreeList()
+   , DelayedAlignedFreeList()
+   , CurrentCounter()
+   , SampleInterval(0)
+   , SampleTable()
+   , SampleRandom()
+   , SampleRandomLock()
+   , SymbolLookupEnabled(false)
+   , OfflineSymbolization(false)
+   , SymbolCache(nullptr)
+   , SymbolCacheLock()
+   , HeapStatsEnabled(false)
+   , HeapStatsInstanceId(0)
+   , HeapStatsShardList(nullptr)
+   , HeapStatsLiveBytes(0)
+   , HeapStatsPeakLiveBytes(0)
+{
+    SetAllocatorName(allocatorName);
+
+    if (ReferenceHeapTimeNs == 0)   // There is a thread race condition for the case that on startup two threads somehow execute this line at the same time.
+        ReferenceHeapTimeNs = GetCurrentHeapTimeNs();
+}
+
+
+void Allocator::SetAllocatorName(const char* allocatorName)
+{
+    if (allocatorName)
+        OVR::OVR_strlcpy(AllocatorName, allocatorName, OVR_ARRAY_COUNT(AllocatorName));
+}
+
+
+const char* Allocator::GetAllocatorName() const
+{
+    return AllocatorName;
+}
+
+
+Allocator::~Allocator()
+{
+    Allocator::Shutdown();
+    FreeSymbolCache(); // In case of a TraceTrackedAllocations call after Shutdown.
+}
+
+
+bool Allocator::Init()
+{
+    if (!Heap) // If not already initialized...
+    {
+        // Potentially redirect the CRT malloc family of functions.
+        if (!MallocRedirectEnabled) // If not programmatically enabled before this init call...
+        {
+            #if OVR_REDIRECT_CRT_MALLOC
+                MallocRedirectEnabled = true;
+            #else
+                MallocRedirectEnabled = OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"MallocRedirectEnabled", false); // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\MallocRedirectEnabled", REG_DWORD of 0 or 1.
+            #endif
+
+            if (Allocator::GetInstance(false) != this) // Only redirect malloc if we are the default heap.
+                MallocRedirectEnabled = false;
+        }
+
+        if (MallocRedirectEnabled)
+        {
+            // We will need to enable tracking so that we can distinguish between our pointers and pointers allocated via malloc before we did this redirect.
+            TrackingEnabled = true;
+
+            // Make a struct of our override function pointers.
+            OVR::InterceptCRTMalloc::MallocFunctionPointers mfp;
+
+            mfp.malloc_ptr = ovr_malloc;
+            mfp.calloc_ptr = ovr_calloc;
+            mfp.realloc_ptr = ovr_realloc;
+            mfp.recalloc_ptr = ovr_recalloc;
+            mfp.msize_ptr = ovr_msize;
+            mfp.free_ptr = ovr_free;
+            mfp.aligned_malloc_ptr = ovr_aligned_malloc;
+            mfp.aligned_offset_malloc_ptr = ovr_aligned_offset_malloc;
+            mfp.aligned_realloc_ptr = ovr_aligned_realloc;
+            mfp.aligned_offset_realloc_ptr = ovr_aligned_offset_realloc;
+            mfp.aligned_recalloc_ptr = ovr_aligned_recalloc;
+            mfp.aligned_offset_recalloc_ptr = ovr_aligned_offset_recalloc;
+            mfp.aligned_msize_ptr = ovr_aligned_msize;
+            mfp.aligned_free_ptr = ovr_aligned_free;
+
+            #ifdef OVR_DEBUG_CRT_PRESENT
+                mfp.malloc_dbg_ptr = ovr_malloc_dbg;
+                mfp.calloc_dbg_ptr = ovr_calloc_dbg;
+                mfp.realloc_dbg_ptr = ovr_realloc_dbg;
+                mfp.recalloc_dbg_ptr = ovr_recalloc_dbg;
+                mfp.msize_dbg_ptr = ovr_msize_dbg;
+                mfp.free_dbg_ptr = ovr_free_dbg;
+                mfp.aligned_malloc_dbg_ptr = ovr_aligned_malloc_dbg;
+                mfp.aligned_offset_malloc_dbg_ptr = ovr_aligned_offset_malloc_dbg;
+                mfp.aligned_realloc_dbg_ptr = ovr_aligned_realloc_dbg;
+                mfp.aligned_offset_realloc_dbg_ptr = ovr_aligned_offset_realloc_dbg;
+                mfp.aligned_recalloc_dbg_ptr = ovr_aligned_recalloc_dbg;
+                mfp.aligned_offset_recalloc_dbg_ptr = ovr_aligned_offset_recalloc_dbg;
+                mfp.aligned_msize_dbg_ptr = ovr_aligned_msize_dbg;
+                mfp.aligned_free_dbg_ptr = ovr_aligned_free_dbg;
+            #endif
+
+            MallocRedirect = new (SysMemAlloc(sizeof(OVR::InterceptCRTMalloc))) OVR::InterceptCRTMalloc;
+            MallocRedirect->ReplaceCRTMalloc(mfp);
+        }
+
+
+        // Potentially enable the debug page heap.
+        if (!DebugPageHeapEnabled) // If not programmatically enabled before this init call...
+        {
+            // The debug page heap is restricted to 64 bit platforms due to the potential for address space exhaustion on 32-bit platforms.
+            #if defined(OVR_CPU_X86_64)
+                #if OVR_ALLOCATOR_DEBUG_PAGE_HEAP_ENABLED // If we should try to enable the debug heap...
+                    DebugPageHeapEnabled = true;
+                #else
+                    DebugPageHeapEnabled = OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"DebugPageHeapEnabled", DebugPageHeapEnabled); // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\DebugPageHeapEnabled", REG_DWORD of 0 or 1.
+                #endif
+
+                #if defined(OVR_BUILD_DEBUG) && defined(_MSC_VER)
+                    if (DebugPageHeapEnabled)
+                    {
+                        // Make _CrtIsValidHeapPointer always return true. The VC++ concurrency library has a bug in that
+                        // it's calling _CrtIsValidHeapPointer, which is invalid and recommended against by Microsoft themselves.
+                        // We need to deal with this nevertheless. The problem is that the VC++ concurrency library is
+                        // calling _CrtIsValidHeapPointer on the default heap instead of the current heap (DebugPageHeap).
+                        // So we modify the _CrtIsValidHeapPointer implementation to always return true. The primary risk
+                        // with this change is that there's some code somewhere that uses it for a non-diagnostic purpose.
+                        // However this os Oculus-debug-internal and so has no effect on any formally published software.
+                        DebugPageHeapEnabled = OVR::KillCdeclFunction(_CrtIsValidHeapPointer, true); // If we can successfully kill _CrtIsValidHeapPointer, enable our debug heap.
+                    }
+                #endif
+            #endif
+        }
+
+        // Potentially use the OSHeap with huge pages.
+        #if OVR_ALLOCATOR_HUGE_PAGES_ENABLED && defined(__linux__)
+            if (!OSHeapEnabled && (HugePages == HugePagesNone)) // If not programmatically set up before this init call...
+            {
+                OSHeapEnabled = true;
+                HugePages = HugePagesTransparent;
+                NumaBindingEnabled = true;
+            }
+        #endif
+
+        if (DebugPageHeapEnabled)
+        {
+            // We will need to enable tracking so that we can distinguish between our pointers and pointers allocated via malloc before we did this redirect.
+            TrackingEnabled = true;
+            OSHeapEnabled = false;
+
+            Heap = new(SysMemAlloc(sizeof(DebugPageHeap))) DebugPageHeap;
+            Heap->Init();
+        }
+        else if(MallocRedirectEnabled || OSHeapEnabled)
+        {
+            if (MallocRedirectEnabled)
+            {
+                // We will need to enable tracking so that we can distinguish between our pointers and pointers allocated via malloc before we did this redirect.
+                TrackingEnabled = true;
+                OSHeapEnabled = true;
+            }
+
+            // If we are redirecting CRT malloc then we can't use the default heap, because it used CRT malloc, which would we be circular.
+            Heap = new(SysMemAlloc(sizeof(OSHeap))) OSHeap(HugePages, HugePageThreshold, NumaBindingEnabled);
+            Heap->Init();
+        }
+        else // Else default heap (which uses malloc).
+        {
+            Heap = new(SysMemAlloc(sizeof(DefaultHeap))) DefaultHeap;
+            Heap->Init();
+        }
+
+
+        // Potentially put per-thread caches in front of the heap.
+        if (!ThreadCacheEnabled) // If not programmatically enabled before this init call...
+        {
+            #if OVR_ALLOCATOR_THREAD_CACHE_ENABLED
+                ThreadCacheEnabled = true;
+            #else
+                ThreadCacheEnabled = OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"ThreadCacheEnabled", false); // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\ThreadCacheEnabled", REG_DWORD of 0 or 1.
+            #endif
+        }
+
+        if (DebugPageHeapEnabled)
+            ThreadCacheEnabled = false;
+
+        if (ThreadCacheEnabled)
+        {
+            size_t wrappedHeapSize = (OSHeapEnabled ? sizeof(OSHeap) : sizeof(DefaultHeap));
+            Heap = new(SysMemAlloc(sizeof(ThreadCachingHeap))) ThreadCachingHeap(Heap, wrappedHeapSize);
+            Heap->Init();
+        }
+
+
+        // Potentially enable allocation tracking.
+        if (!TrackingEnabled) // If not programmatically enabled before this init call...
+        {
+            #if OVR_ALLOCATOR_TRACKING_ENABLED
+                TrackingEnabled = true;
+            #else
+                TrackingEnabled = IsHeapTrackingRegKeyEnabled(TrackingEnabled);
+            #endif
+        }
+
+
+        // Potentially enable heap sampling.
+        if (!SampleInterval.load(std::memory_order_relaxed)) // If not programmatically enabled before this init call...
+        {
+            #if OVR_ALLOCATOR_SAMPLING_ENABLED
+                SampleInterval.store(DefaultSampleInterval, std::memory_order_relaxed);
+            #else
+                if (OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"HeapSamplingEnabled", false)) // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\HeapSamplingEnabled", REG_DWORD of 0 or 1.
+                    SampleInterval.store(DefaultSampleInterval, std::memory_order_relaxed);
+            #endif
+        }
+
+
+        // Enable heap statistics. A new instance id invalidates any thread-local shard pointers
+        // left over from a previous Init of this Allocator.
+        HeapStatsEnabled = (OVR_ALLOCATOR_HEAP_STATS_ENABLED != 0);
+        HeapStatsInstanceId = ++HeapStatsInstanceCounter;
+
+
+        // Initialize the symbol and backtrace utility library
+        SymbolLookupEnabled = SymbolLookup::Initialize();
+    }
+
+    return true;
+}
+
+
+void Allocator::Shutdown()
+{
+    if (Heap) // If we were initialized...
+    {
+        if (TraceAllocationsOnShutdown)
+            TraceTrackedAllocations(nullptr, 0);
+
+        FreeSymbolCache();
+
+        if (SymbolLookupEnabled)
+            SymbolLookup::Shutdown();
+
+        if (MallocRedirectEnabled)
+        {
+            MallocRedirect->RestoreCRTMalloc();
+            MallocRedirect->~InterceptCRTMalloc();
+            SysMemFree(MallocRedirect, sizeof(OVR::InterceptCRTMalloc));
+            MallocRedirect = nullptr;
+        }
+
+        for(auto p: DelayedAlignedFreeList)
+            _aligned_free(p);
+        DelayedAlignedFreeList.clear();
+
+        for(auto p: DelayedFreeList)
+            free(p);
+        DelayedFreeList.clear();
+
+        AllocationTable.Clear();
+        SampleTable.Clear();
+        CurrentCounter = 0;
+
+        HeapStatsEnabled = false;
+        HeapStatsInstanceId = 0;
+
+        for (HeapStatsShard* shard = HeapStatsShardList.exchange(nullptr), *shardNext; shard; shard = shardNext)
+        {
+            shardNext = shard->Next;
+            shard->~HeapStatsShard();
+            SafeMMapFree(shard, sizeof(HeapStatsShard));
+        }
+
+        HeapStatsLiveBytes = 0;
+        HeapStatsPeakLiveBytes = 0;
+
+        // Free the heap.
+        if (Heap)
+        {
+            Heap->Shutdown();
+            Heap->~Heap();
+            if (DebugPageHeapEnabled)
+                SysMemFree(Heap, sizeof(DebugPageHeap));
+            else if (ThreadCacheEnabled)
+                SysMemFree(Heap, sizeof(ThreadCachingHeap)); // Its Shutdown freed the heap it wraps.
+            else
+                SysMemFree(Heap, sizeof(DefaultHeap));
+        }
+        Heap = nullptr;
+    }
+}
+
+
+void* Allocator::Alloc(size_t size, const char* tag)
+{
+    return AllocDebug(size, tag, nullptr, 0);
+}
+
+
+void* Allocator::Calloc(size_t count, size_t size, const char* tag)
+{
+    return CallocDebug(count, size, tag, nullptr, 0);
+}
+
+
+void* Allocator::AllocAligned(size_t size, size_t align, const char* tag)
+{
+    return AllocAlignedDebug(size, align, tag, nullptr, 0);
+}
+
+
+void* Allocator::AllocDebug(size_t size, const char* tag, const char* file, unsigned line)
+{
+    OVR_ALLOC_BENCHMARK_START();
+
+    ArenaHeap* arena = ArenaHeap::GetThreadArena();
+    void* p = (arena ? arena->Alloc(size) : Heap->Alloc(size));
+
+    if (p && !arena) // Arena allocations aren't tracked, as they are all freed at once.
+    {
+        TrackAlloc(p, size, tag, file, line);
+
+        if (HeapStatsEnabled)
+            RecordStatsAlloc(Heap->GetAllocSizeNoLock(p), size, tag);
+    }
+
+    OVR_ALLOC_BENCHMARK_END();
+
+    return p;
+}
+
+
+void* Allocator::CallocDebug(size_t count, size_t size, const char* tag, const char* file, unsigned line)
+{
+    void* p = AllocDebug(count * size,  tag, file, line);
+
+    if (p)
+    {
+        memset(p, 0, count * size);
+    }
+
+    return p;
+}
+
+
+void* Allocator::AllocAlignedDebug(size_t size, size_t align, const char* tag, const char* file, unsigned line)
+{
+    OVR_ALLOC_BENCHMARK_START();
+
+    ArenaHeap* arena = ArenaHeap::GetThreadArena();
+    void* p = (arena ? arena->AllocAligned(size, align) : Heap->AllocAligned(size, align));
+
+    if (p && !arena)
+    {
+        TrackAlloc(p, size, tag, file, line);
+
+        if (HeapStatsEnabled)
+            RecordStatsAlloc(HeapStats::UnknownSize, size, tag);
+    }
+
+    OVR_ALLOC_BENCHMARK_END();
+
+    return p;
+}
+
+
+size_t Allocator::GetAllocSize(const void* p) const
+{
+    if (ArenaHeap* arena = ArenaHeap::FindArena(p))
+        return arena->GetAllocSize(p);
+
+    return Heap->GetAllocSize(p);
+}
+
+
+size_t Allocator::GetAllocAlignedSize(const void* p, size_t align) const
+{
+    if (ArenaHeap* arena = ArenaHeap::FindArena(p))
+        return arena->GetAllocAlignedSize(p, align);
+
+    return Heap->GetAllocAlignedSize(p, align);
+}
+
+
+void Allocator::Free(void* p)
+{
+    OVR_ALLOC_BENCHMARK_START();
+
+    if (p)
+    {
+        if (ArenaHeap* arena = ArenaHeap::FindArena(p))
+        {
+            arena->Free(p);
+        }
+        else if(UntrackAlloc(p)) // If this pointer is recognized as belonging to us...
+        {
+            if (HeapStatsEnabled)
+                RecordStatsFree(Heap->GetAllocSizeNoLock(p));
+
+            Heap->Free(p);
+        }
+        else
+        {
+            // We don't recognize the pointer being freed. That almost always means one of two things:
+            //     - We are overriding malloc/free and somebody is freeing memory that they allocated before we 
+            //       started overriding malloc and free. 
+            //     - We are not overriding malloc/free and somebody is freeing memory via operater delete
+            //       which they allocated with malloc(). That's disallowed C++ but in fact it happens.
+            // We have a number of options for dealing with this and try to choose the best option:
+            //     - Call CRT free function.
+            //       Can't do this if we are overriding CRT free and have lost access to the original CRT free function.
+            //     - Call the CRT underlying _free_base function.
+            //       Can't do this if the debug CRT is active, because p is not the actual pointer to free.
+            //     - Call the OS underlying HeapFree function.
+            //       Can't do this if the debug CRT is active, because this method results in the debug heap structures being corrupt.
+            //     - Put the pointer in a list which we free later, in the case that we are overriding CRT free and have lost access to the original CRT free function.
+            //       This works fairly well.
+            //     - Do nothing and let the memory leak in the underlying heap.
+            //       This works fairly well but results in there looking like there was a CRT memory leak.
+
+            if (MallocRedirect)
+            {
+                #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900) // VS2013 doesn't expose _free_base, so use this delayed approach with VS2013.
+                    // In this case we can't just call the internal CRT _free_base function becase the debug heap is active and 
+                    // we would need to call a dbg function. The best way for us to do that would be to implement our own function
+                    // which works the same as _free_dbg(). However, for now we just add this pointer to the delayed free list and 
+                    // simply free it the normal way later when we shutdown.
+                    DelayedFreeList.push_back(p); // We will call free on the pointer later when we've restored the MallocRedirect.
+                #else
+                    // In this case we can just call the internal CRT _free_base function that underlies all CRT malloc functions.
+                    _free_base(p);
+                #endif
+            }
+            else
+            {
+                free(p);
+            }
+        }
+    }
+
+    OVR_ALLOC_BENCHMARK_END();
+}
+
+
+void Allocator::FreeAligned(void* p)
+{
+    OVR_ALLOC_BENCHMARK_START();
+
+    if (p)
+    {
+        if (ArenaHeap* arena = ArenaHeap::FindArena(p))
+        {
+            arena->FreeAligned(p);
+        }
+        else if(UntrackAlloc(p))
+        {
+            if (HeapStatsEnabled)
+                RecordStatsFree(HeapStats::UnknownSize);
+
+           Heap->FreeAligned(p);
+        }
+        else
+        {
+            if (MallocRedirect)
+            {
+                #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900) // VS2013 doesn't expose _aligned_free_base, so use this delayed approach with VS2013.
+                    // In this case we can't just call the internal CRT _aligned_free_base function becase the debug heap is active and 
+                    // we would need to call a dbg function. The best way for us to do that would be to implement our own function
+                    // which works the same as _aligned_free_dbg(). However, for now we just add this pointer to the delayed free list and 
+                    // simply free it the normal way later when we shutdown.
+                    DelayedAlignedFreeList.push_back(p); // We will call _aligned_free on the pointer later when we've restored the MallocRedirect.
+                #else
+                    // In this case we can just call the internal CRT _free_base function that underlies all CRT malloc functions.
+                    _aligned_free_base(p);
+                #endif
+            }
+            else
+            {
+                _aligned_free(p);
+            }
+        }
+    }
+
+    OVR_ALLOC_BENCHMARK_END();
+}
+
+
+void* Allocator::Realloc(void* p, size_t newSize)
+{
+    return ReallocDebug(p, newSize, nullptr, 0);
+}
+
+
+void* Allocator::Recalloc(void* p, size_t count, size_t newSize)
+{
+    return RecallocDebug(p, count, newSize, nullptr, 0);
+}
+
+
+void* Allocator::ReallocAligned(void* p, size_t newSize, size_t newAlign)
+{
+    return ReallocAlignedDebug(p, newSize, newAlign, nullptr, 0);
+}
+
+
+void* Allocator::RecallocAligned(void* p, size_t count, size_t newSize, size_t newAlign)
+{
+    return RecallocAlignedDebug(p, count, newSize, newAlign, nullptr, 0);
+}
+
+
+// Reallocates p, which belongs to an arena that the calling thread doesn't own. Only the owning
+// thread may Alloc or Realloc an arena, so the data is copied to a new block from the calling thread's
+// arena or heap. p stays where it is until the arena's next Reset, as does any freed arena memory.
+// newAlign is 0 for a block which is freed with Free rather than FreeAligned.
+static void* ReallocForeignArenaBlock(Allocator* allocator, ArenaHeap* arena, void* p, size_t newSize, size_t newAlign,
+                                      const char* file, unsigned line)
+{
+    if (!newSize)
+        return nullptr; // As with realloc, this frees p.
+
+    void* pNew = (newAlign ? allocator->AllocAlignedDebug(newSize, newAlign, nullptr, file, line) :
+                             allocator->AllocDebug(newSize, nullptr, file, line));
+
+    if (pNew)
+    {
+        const size_t oldSize = arena->GetAllocSize(p);
+        memcpy(pNew, p, (oldSize < newSize) ? oldSize : newSize);
+    }
+
+    return pNew;
+}
+
+
+void* Allocator::ReallocDebug(void* p, size_t newSize, const char* file, unsigned line)
+{
+    OVR_ALLOC_BENCHMARK_START();
+
+    // We have a tedious problem to solve here. If we have overridden malloc and the memory p was allocated by malloc before we
+    // did the override, then p belongs to the original malloc heap. We can attempt to reallocate it here with our own heap or 
+    // we can reallocate it in the original heap it came from. The latter is simpler.
+    // Likewise, arena memory stays in its arena, and a new allocation goes to the thread's arena if there is one.
+    // Memory from another thread's arena is copied out, as that arena may only be resized by its owner.
+
+    ArenaHeap* threadArena = ArenaHeap::GetThreadArena();
+
+    if (ArenaHeap* arena = (p ? ArenaHeap::FindArena(p) : threadArena))
+    {
+        void* pArena = ((arena == threadArena) ? arena->Realloc(p, newSize) :
+                                                 ReallocForeignArenaBlock(this, arena, p, newSize, 0, file, line));
+        OVR_ALLOC_BENCHMARK_END();
+        return pArena;
+    }
+
+    AllocMetadata metadata;
+    bool valid = true; // realloc allows you to reallocate NULL, so set this to true by default.
+    void* pNew = nullptr;
+
+    if (p)
+    {
+        GetAllocMetadata(p, metadata);
+        valid = UntrackAlloc(p); // valid will be true if p is NULL, which is what we want.
+    }
+
+    if (valid)
+    {
+        const size_t oldBlockSize = ((p && HeapStatsEnabled) ? Heap->GetAllocSizeNoLock(p) : 0);
+
+        pNew = Heap->Realloc(p, newSize);
+
+        if (pNew)
+        {
+            TrackAlloc(pNew, newSize, metadata.Tag, file, line);
+        }
+
+        if (HeapStatsEnabled)
+        {
+            if (!p)
+            {
+                if (pNew)
+                    RecordStatsAlloc(Heap->GetAllocSizeNoLock(pNew), newSize, nullptr);
+            }
+            else if (pNew)
+                RecordStatsRealloc(oldBlockSize, Heap->GetAllocSizeNoLock(pNew), (pNew != p));
+            else if (newSize == 0) // realloc(p, 0) frees p.
+                RecordStatsFree(oldBlockSize);
+        }
+    }
+    else if (MallocRedirect) // Else p came from the CRT heap. It was likely malloc'd before we redirected malloc.
+    {
+        #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900) // VS2013 doesn't expose _realloc_base, so use this delayed approach with VS2013.
+            #if OVR_DEBUG_CRT_PRESENT
+                size_t originalSize = header_from_block(p)->data_size; // We have to read internal debug data.
+                pNew = crt_malloc_dbg(newSize, _NORMAL_BLOCK, file, line);
+            #else
+                size_t originalSize = HeapSize(GetCRTHeapHandle(), 0, p);
+                pNew = HeapAlloc(GetCRTHeapHandle(), 0, newSize);
+            #endif
+            if (pNew)
+            {
+                size_t copySize = std::min(originalSize, newSize);
+                memcpy(pNew, p, copySize);
+                DelayedFreeList.push_back(p);
+            }
+            // Else don't free p and return nullptr.
+        #else
+            pNew = _realloc_base(p, newSize);
+        #endif
+    }
+    else
+    {
+        pNew = realloc(p, newSize);
+    }
+
+    OVR_ALLOC_BENCHMARK_END();
+
+    return pNew;
+}
+
+
+void* Allocator::RecallocDebug(void* p, size_t count, size_t newSize, const char* file, unsigned line)
+{
+    void* pNew = nullptr;
+
+    if (!OVR::Alg::UnsignedMultiplyWouldOverflow(count, newSize))
+    {
+        newSize *= count;
+
+        size_t oldSize;
+        bool valid = IsAllocTracked(p);
+
+        if (valid || ArenaHeap::FindArena(p))
+        {
+            oldSize = GetAllocSize(p);
+        }
+        else if (MallocRedirect)
+        {
+            #if OVR_DEBUG_CRT_PRESENT
+                oldSize = header_from_block(p)->data_size; // We have to read internal debug data.
+            #else
+                oldSize = HeapSize(GetCRTHeapHandle(), 0, p);
+            #endif
+        }
+        else
+        {
+            // So which heap does this allocation come from?
+            oldSize = _msize(p);
+        }
+
+        pNew = ReallocDebug(p, newSize, file, line);
+
+        if (pNew && (newSize > oldSize))
+        {
+            memset(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pNew) + oldSize), 0, (newSize - oldSize));
+        }
+    }
+
+    return pNew;
+}
+
+
+void* Allocator::ReallocAlignedDebug(void* p, size_t newSize, size_t newAlign, const char* file, unsigned line)
+{
+    OVR_ALLOC_BENCHMARK_START();
+
+    ArenaHeap* threadArena = ArenaHeap::GetThreadArena();
+
+    if (ArenaHeap* arena = (p ? ArenaHeap::FindArena(p) : threadArena))
+    {
+        void* pArena = ((arena == threadArena) ? arena->ReallocAligned(p, newSize, newAlign) :
+                                                 ReallocForeignArenaBlock(this, arena, p, newSize, newAlign, file, line));
+        OVR_ALLOC_BENCHMARK_END();
+        return pArena;
+    }
+
+    AllocMetadata metadata;
+    bool valid = true; // realloc allows you to reallocate NULL, so set this to true by default.
+    void* pNew = nullptr;
+
+    if (p)
+    {
+        GetAllocMetadata(p, metadata);
+        valid = UntrackAlloc(p); // valid will be true if p is NULL, which is what we want.
+    }
+
+    if (valid)
+    {
+        pNew = Heap->ReallocAligned(p, newSize, newAlign);
+
+        if (pNew)
+        {
+            TrackAlloc(pNew, newSize, metadata.Tag, file, line);
+        }
+
+        if (HeapStatsEnabled)
+        {
+            if (!p)
+            {
+                if (pNew)
+                    RecordStatsAlloc(HeapStats::UnknownSize, newSize, nullptr);
+            }
+            else if (pNew)
+                RecordStatsRealloc(HeapStats::UnknownSize, HeapStats::UnknownSize, (pNew != p));
+            else if (newSize == 0)
+                RecordStatsFree(HeapStats::UnknownSize);
+        }
+
+        return pNew;
+    }
+    else if (MallocRedirect) // Else this must go to the CRT heap. It was likely malloc'd before we existed.
+    {
+        #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900)
+            // To do. This function in practice is not used by the CRT and so is not very important to us, especially as this is debug-build only.
+            OVR_FAIL_M("Allocator::ReallocAlignedDebug not implemented yet."); 
+        #else
+            pNew = _aligned_realloc_base(p, newSize, newAlign);
+        #endif
+    }
+    else
+    {
+        pNew = _aligned_realloc(p, newSize, newAlign);
+    }
+
+    OVR_ALLOC_BENCHMARK_END();
+
+    return pNew;
+}
+
+
+void* Allocator::RecallocAlignedDebug(void* p, size_t count, size_t newSize, size_t newAlign, const char* file, unsigned line)
+{
+    void* pNew = nullptr;
+
+    if (!OVR::Alg::UnsignedMultiplyWouldOverflow(count, newSize))
+    {
+        newSize *= count;
+
+        size_t oldSize;
+        bool valid = IsAllocTracked(p);
+
+        if (valid)
+        {
+            oldSize = GetAllocAlignedSize(p, newAlign); // We really want the original alignment, not the new alignment.
+        }
+        else if (MallocRedirect)
+        {
+            #if OVR_DEBUG_CRT_PRESENT
+                oldSize = header_from_block(p)->data_size; // We have to read internal debug data.
+            #else
+                oldSize = HeapSize(GetCRTHeapHandle(), 0, p);
+            #endif
+        }
+        else
+        {
+            // So which heap does this allocation come from?
+            oldSize = _aligned_msize(p, newAlign, 0); // We really want the original alignment, not the new alignment.
+        }
+
+        pNew = ReallocAlignedDebug(p, newSize, newAlign, file, line);
+
+        if (pNew && (newSize > oldSize))
+        {
+            memset(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pNew) + oldSize), 0, (newSize - oldSize));
+        }
+    }
+
+    return pNew;
+}
+
+
+bool Allocator::TryExpand(void* p, size_t newSize)
+{
+    // Arena memory and memory which isn't from our heap (e.g. malloc'd before we redirected malloc) 
+    // is never resized in place. Callers fall back to Realloc, which knows how to deal with it.
+    if (!p || !Heap || ArenaHeap::FindArena(p) || !IsAllocTracked(p))
+        return false;
+
+    OVR_ALLOC_BENCHMARK_START();
+
+    const size_t oldBlockSize = (HeapStatsEnabled ? Heap->GetAllocSizeNoLock(p) : 0);
+    const bool   expanded = Heap->TryExpand(p, newSize);
+
+    if (expanded)
+    {
+        // This is the same allocation as far as the user is concerned, so only the recorded sizes
+        // change. Its tag, backtrace and count stay, and the sampling countdown isn't charged again.
+        if (TrackingEnabled)
+            AllocationTable.SetSize(p, newSize, (newSize + 7) & ~(size_t)7); // Same rounding as TrackAlloc.
+
+        if (SampleInterval.load(std::memory_order_relaxed) && SampleTable.MayContain(p))
+            SampleTable.SetSize(p, newSize, newSize);
+
+        if (HeapStatsEnabled)
+            RecordStatsRealloc(oldBlockSize, Heap->GetAllocSizeNoLock(p), false);
+    }
+
+    OVR_ALLOC_BENCHMARK_END();
+
+    return expanded;
+}
+
+
+uint64_t Allocator::GetCurrentHeapTimeNs()
+{
+    #if defined(_WIN32)
+        LARGE_INTEGER tickCount;
+        ::QueryPerformanceCounter(&tickCount);
+
+        LARGE_INTEGER qpfFrequency;
+        ::QueryPerformanceFrequency(&qpfFrequency); // To do: Move this to a single call on startup.
+
+        return (uint64_t)((tickCount.QuadPart * UINT64_C(1000000000)) / qpfFrequency.QuadPart) - ReferenceHeapTimeNs;
+    #else
+        return (uint64_t)(time(NULL) * UINT64_C(1000000000)) - ReferenceHeapTimeNs; // Crude value. Should improve this.
+    #endif
+}
+
+
+// Returns an id of the calling thread which no other running thread has, though the id of an exited
+// thread may be reused. Per-thread records are matched by this id, so it mustn't be a truncation of
+// pthread_self(), which is a 64 bit pointer on most platforms.
+static uint32_t GetThreadId()
+{
+    #if defined(_WIN32)
+        return ::GetCurrentThreadId();
+    #elif defined(__linux__)
+        return (uint32_t)syscall(SYS_gettid);
+    #elif defined(__APPLE__)
+        return (uint32_t)pthread_mach_thread_np(pthread_self());
+    #else
+        return (uint32_t)(uintptr_t)pthread_self(); // To do: This isn't unique if pthread_t is wider than 32 bits.
+    #endif
+}
+
+
+// Returns true if the thread is still running. If that can't be determined, returns true, so that
+// callers never take over a record of a running thread.
+static bool ThreadIdIsValid(uint32_t threadId)
+{
+    #if defined(_WIN32)
+        bool result = false;
+        HANDLE h = ::OpenThread(THREAD_QUERY_LIMITED_INFORMATION, TRUE, threadId);
+
+        if (h)
+        {
+            DWORD exitCode;
+            BOOL  bResult = ::GetExitCodeThread(h, &exitCode);
+            result = ((bResult != FALSE) && (exitCode == STILL_ACTIVE));
+            ::CloseHandle(h);
+        }
+
+        return result;
+    #elif defined(__linux__)
+        // Signal 0 does nothing but check that the thread exists. tgkill limits it to our own process.
+        return ((syscall(SYS_tgkill, getpid(), (pid_t)threadId, 0) == 0) || (errno != ESRCH));
+    #else
+        OVR_UNUSED(threadId);
+        return true;
+    #endif
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** AllocatorTagStack
+//
+// The per-thread stack of tags pushed via Allocator::PushTag.
+// A thread finds its stack via thread-local storage, so tag operations need no lock. Stacks are
+// also linked into a global list, which is used only for reporting on other threads and for
+// handing the stack of an exited thread to a new thread. We have no thread exit notification,
+// so stacks are never freed. The list is lock-free, as tags may be used during static init,
+// before any lock we declared here could be constructed.
+//
+struct AllocatorTagStack
+{
+    static const uint32_t Capacity = 64; // Deeper nesting is counted but not recorded, and such pushes don't change GetTag.
+
+    struct Entry
+    {
+        const Allocator* Owner;         // Allocator the tag was pushed to. Multiple Allocators can share a thread's stack.
+        const char*      Tag;
+    };
+
+    AllocatorTagStack*    Next;         // Set before the stack is added to AllocatorTagStackList and never changed after.
+    std::atomic<uint32_t> ThreadId;     // Thread which owns this stack.
+    std::atomic<uint32_t> Depth;        // Number of pushed tags. Written only by the owning thread.
+    Entry                 Entries[Capacity];
+};
+
+static std::atomic<AllocatorTagStack*>       AllocatorTagStackList(nullptr);
+static OVR_THREAD_LOCAL AllocatorTagStack*   ThreadTagStack = nullptr;
+static const size_t                          AllocatorTagStackReuseThreshold = 128; // This is some number that should be more than the number of unique threads we ever have.
+
+
+static AllocatorTagStack* GetThreadTagStack()
+{
+    if (ThreadTagStack)
+        return ThreadTagStack;
+
+    // Slow path: This is the thread's first tag push. Try to take over the stack of an exited thread.
+    const uint32_t threadId = GetThreadId();
+    size_t stackCount = 0;
+    AllocatorTagStack* stack;
+
+    for (stack = AllocatorTagStackList.load(std::memory_order_acquire); stack; stack = stack->Next, ++stackCount)
+    {
+        if (stack->ThreadId.load(std::memory_order_relaxed) == threadId) // The thread which had our id previously must have exited.
+            break;
+    }
+
+    if (!stack && (stackCount >= AllocatorTagStackReuseThreshold)) // Checking thread liveness is slow, so we do it only once we have many stacks.
+    {
+        for (stack = AllocatorTagStackList.load(std::memory_order_acquire); stack; stack = stack->Next)
+        {
+            uint32_t oldThreadId = stack->ThreadId.load(std::memory_order_relaxed);
+
+            if (!ThreadIdIsValid(oldThreadId) && stack->ThreadId.compare_exchange_strong(oldThreadId, threadId))
+                break;
+        }
+    }
+
+    if (stack)
+    {
+        stack->ThreadId.store(threadId, std::memory_order_relaxed);
+        stack->Depth.store(0, std::memory_order_release);
+    }
+    else
+    {
+        void* memory = SafeMMapAlloc(sizeof(AllocatorTagStack)); // Returned memory is 0-filled.
+
+        if (!memory)
+            return nullptr;
+
+        stack = new(memory) AllocatorTagStack;
+        stack->ThreadId.store(threadId, std::memory_order_relaxed);
+        stack->Depth.store(0, std::memory_order_relaxed);
+        stack->Next = AllocatorTagStackList.load(std::memory_order_relaxed);
+
+        while (!AllocatorTagStackList.compare_exchange_weak(stack->Next, stack, std::memory_order_release, std::memory_order_relaxed))
+            { }
+    }
+
+    ThreadTagStack = stack;
+    return stack;
+}
+
+
+// Returns the top tag of the stack which was pushed to allocator, else nullptr.
+// This can be called from threads other than the stack's owner, in which case the result may be stale.
+static const char* GetTopTag(const AllocatorTagStack* stack, const Allocator* allocator)
+{
+    uint32_t depth = stack->Depth.load(std::memory_order_acquire);
+
+    if (depth > AllocatorTagStack::Capacity)
+        depth = AllocatorTagStack::Capacity;
+
+    while (depth--)
+    {
+        if (stack->Entries[depth].Owner == allocator)
+            return stack->Entries[depth].Tag;
+    }
+
+    return nullptr;
+}
+
+
+void Allocator::PushTag(const char* tag)
+{
+    AllocatorTagStack* stack = GetThreadTagStack();
+
+    if (stack)
+    {
+        const uint32_t depth = stack->Depth.load(std::memory_order_relaxed);
+
+        if (depth < AllocatorTagStack::Capacity)
+        {
+            stack->Entries[depth].Owner = this;
+            stack->Entries[depth].Tag = tag;
+        }
+
+        stack->Depth.store(depth + 1, std::memory_order_release); // Publishes the entry to GetThreadTag.
+    }
+}
+
+void Allocator::PopTag()
+{
+    AllocatorTagStack* stack = ThreadTagStack;
+
+    // We do some error checking to make sure we don't crash if this facility is mis-used.
+    if (stack)
+    {
+        const uint32_t depth = stack->Depth.load(std::memory_order_relaxed);
+
+        if (depth)
+            stack->Depth.store(depth - 1, std::memory_order_release);
+    }
+}
+
+const char* Allocator::GetTag(const char* defaultTag)
+{
+    const char* tag = (ThreadTagStack ? GetTopTag(ThreadTagStack, this) : nullptr);
+
+    if (tag)
+        return tag;
+
+    if (defaultTag)
+        return defaultTag;
+
+    return OVR_ALLOCATOR_UNSPECIFIED_TAG;
+}
+
+const char* Allocator::GetThreadTag(uint32_t threadId, const char* defaultTag)
+{
+    for (const AllocatorTagStack* stack = AllocatorTagStackList.load(std::memory_order_acquire); stack; stack = stack->Next)
+    {
+        if (stack->ThreadId.load(std::memory_order_relaxed) == threadId)
+        {
+            const char* tag = GetTopTag(stack, this);
+
+            if (tag)
+                return tag;
+
+            break;
+        }
+    }
+
+    if (defaultTag)
+        return defaultTag;
+
+    return OVR_ALLOCATOR_UNSPECIFIED_TAG;
+}
+
+
+void Allocator::SetNewBlockMetadata(Allocator* allocator, AllocMetadata& amd, const void* alloc, uint64_t allocSize, uint64_t blockSize, 
+                                const char* file, int line, const char* tag)
+{
+    amd.Alloc = alloc;
+    amd.File = file;
+    amd.Line = line;
+    amd.TimeNs = Allocator::GetCurrentHeapTimeNs();
+    amd.Count = allocator->GetAndUpdateCounter();
+    amd.AllocSize = allocSize;
+    amd.BlockSize = blockSize;
+    amd.Tag = tag;
+    amd.ThreadId = GetThreadId();
+    OVR::Thread::GetCurrentThreadName(amd.ThreadName, sizeof(amd.ThreadName)); // Currently works on Windows only for threads that were named via our OVR thread naming API.
+}
+
+
+// Bytes the calling thread may still allocate before its next sample is taken. This is shared by
+// all Allocator instances, which doesn't matter as the distance to the next sample is random anyway.
+static OVR_THREAD_LOCAL int64_t ThreadBytesUntilSample = 0;
+static OVR_THREAD_LOCAL bool    ThreadSampleCountdownStarted = false;
+
+
+void Allocator::TrackAlloc(const void* p, size_t size, const char* tag, const char* file, int line)
+{
+    if (p && SampleInterval.load(std::memory_order_relaxed))
+    {
+        ThreadBytesUntilSample -= (int64_t)size;
+
+        if (ThreadBytesUntilSample <= 0)
+            SampleAlloc(p, size, tag, file, line);
+    }
+
+    if (p && TrackingEnabled) // To consider: Make TrackingEnabled an atomic.
+    {
+        auto AlignSizeUp = [](size_t value, size_t alignment) -> size_t { // To do: Have a centralized version of this.
+            return ((value + (alignment - 1)) & ~(alignment - 1));
+        };
+
+        AllocMetadata amd;
+
+        if (!tag)
+            tag = GetTag();
+
+        SetNewBlockMetadata(this, amd, p, size, 
+                            AlignSizeUp(size, 8),       // This is only a default value, and may be under-represented at time time, until we can have that passed into this function as well.
+                            file, line, tag);
+
+        #if defined(_WIN64)
+            amd.BacktraceCount = (uint32_t)Symbols.GetBacktrace(amd.Backtrace, OVR_ARRAY_COUNT(amd.Backtrace), 2);
+        #else
+            // Currently 32 bit backtrace reading is too slow. We can fix it by writing our own version
+            // that reads the stack frames, but it's not a high priority since we work mostly with 64 bit.
+            amd.BacktraceCount = 0;
+        #endif
+
+        if (TrackingEnabled) // To consider: Do we really need to do this?
+        {
+            AllocationTable.Insert(amd); // Takes only the lock of the shard p maps to.
+        }
+    }
+}
+
+
+bool Allocator::UntrackAlloc(const void* p)
+{
+    if (p && SampleInterval.load(std::memory_order_relaxed) && SampleTable.MayContain(p)) // MayContain keeps the common case lock-free.
+        SampleTable.Remove(p);
+
+    if (!TrackingEnabled)
+        return true; // Just assume the pointer is valid.
+
+    if (p)
+        return AllocationTable.Remove(p);
+
+    return false;
+}
+
+
+bool Allocator::IsAllocTracked(const void* p)
+{
+    if (!TrackingEnabled)
+        return true; // Just assume the pointer is valid.
+
+    if (p)
+        return AllocationTable.Contains(p);
+
+    return false;
+}
+
+
+bool Allocator::GetAllocMetadata(const void* p, AllocMetadata& metadata)
+{
+    return AllocationTable.Get(p, metadata);
+}
+
+
+bool Allocator::EnableTracking(bool enable)
+{
+    bool result = false;
+
+    // We may need to deal with the case that this is called when we 
+    // have already started memory allocation activity. Currently disabled.
+    Lock::Locker locker(&TrackLock);
+
+    if (!Heap) // If we haven't initialized yet...
+    {
+        TrackingEnabled = enable;
+        result = true;
+    }
+    else if(TrackingEnabled != enable) // if there is a change being requested...
+    {
+        // Currently we support the enabling and disabling of tracking after initialization
+        // only if we aren't using the page debug heap. We may be able to work around that
+        // in the future if needed. Tracking is enabled by default before initialization when 
+        // the page debug heap is enabled, so it's only a matter here of attempting to 
+        // disable tracking after it's been enabled, in practice.
+        if (!DebugPageHeapEnabled)  
+        {
+            TrackingEnabled = enable;
+
+            if(!TrackingEnabled) // If we are disabling tracking...
+            {
+                AllocationTable.Clear(); // Clear all the tracking we've done so far.
+            }
+
+            result = true;
+        } // Else don't allow the change.
+    }
+    else //Else there's no change.
+    {
+        result = true;
+    }
+
+    return result;
+}
+
+
+bool Allocator::EnableSampling(size_t sampleInterval)
+{
+    // Other threads may be allocating meanwhile. A sample they take during the Clear is either
+    // discarded or kept intact, never left in the table without its filter count. But samples taken
+    // while sampling is being disabled can remain until sampling is enabled again.
+    SampleInterval.store(sampleInterval, std::memory_order_relaxed);
+    SampleTable.Clear();
+
+    return true;
+}
+
+
+int64_t Allocator::GetNextSampleDistance()
+{
+    // The distance between samples is exponentially distributed, which makes sampling a Poisson process
+    // over allocated bytes: every byte has the same chance of being sampled, regardless of what
+    // allocations preceded it. This is what allows the unbiased estimate in TraceSampledAllocations.
+    double r;
+    {
+        Lock::Locker locker(&SampleRandomLock);
+        r = SampleRandom.Rand(); // In the open interval (0, 1).
+    }
+
+    int64_t distance = (int64_t)(-log(r) * (double)SampleInterval.load(std::memory_order_relaxed));
+
+    return ((distance > 0) ? distance : 1);
+}
+
+
+void Allocator::SampleAlloc(const void* p, size_t size, const char* tag, const char* file, int line)
+{
+    const bool countdownStarted = ThreadSampleCountdownStarted;
+
+    ThreadBytesUntilSample = GetNextSampleDistance();
+    ThreadSampleCountdownStarted = true;
+
+    if (!countdownStarted) // If this is the thread's first allocation, the countdown hadn't been drawn yet.
+        return;
+
+    AllocMetadata amd;
+
+    if (!tag)
+        tag = GetTag();
+
+    SetNewBlockMetadata(this, amd, p, size, size, file, line, tag);
+
+    // Unlike in TrackAlloc we always read the backtrace, as it's done only once per SampleInterval bytes.
+    amd.BacktraceCount = (uint32_t)Symbols.GetBacktrace(amd.Backtrace, OVR_ARRAY_COUNT(amd.Backtrace), 3);
+
+    SampleTable.Insert(amd);
+}
+
+
+uint64_t Allocator::TraceSampledAllocations(SampleGrouping grouping, AllocationTraceCallback callback, uintptr_t context)
+{
+    struct SampleGroup
+    {
+        size_t   First;             // Index into sortedSamples.
+        size_t   Count;
+        uint64_t EstimatedBytes;
+    };
+
+    auto Output = [callback, context](const char* text) -> void {
+        // We cannot use normal logging system here because it will allocate more memory!
+        if (callback)
+            callback(context, text);
+        else
+            ::OutputDebugStringA(text);
+    };
+
+    // Each sample stands for 1 / P(sampled) bytes per byte, where P(sampled) = 1 - e^(-size / interval).
+    const size_t sampleInterval = SampleInterval.load(std::memory_order_relaxed);
+    const double interval = (double)sampleInterval;
+    auto EstimateBytes = [interval](uint64_t size) -> double {
+        if (!size || (interval <= 0))
+            return 0;
+        return (double)size / (1.0 - exp(-(double)size / interval));
+    };
+
+    auto SameGroup = [grouping](const AllocMetadata* a, const AllocMetadata* b) -> bool {
+        if (grouping == SampleGroupByTag)
+            return (strcmp(a->Tag ? a->Tag : OVR_ALLOCATOR_UNSPECIFIED_TAG, b->Tag ? b->Tag : OVR_ALLOCATOR_UNSPECIFIED_TAG) == 0);
+        return ((a->BacktraceCount == b->BacktraceCount) && (memcmp(a->Backtrace, b->Backtrace, a->BacktraceCount * sizeof(void*)) == 0));
+    };
+
+    auto GroupOrder = [grouping](const AllocMetadata* a, const AllocMetadata* b) -> bool {
+        if (grouping == SampleGroupByTag)
+            return (strcmp(a->Tag ? a->Tag : OVR_ALLOCATOR_UNSPECIFIED_TAG, b->Tag ? b->Tag : OVR_ALLOCATOR_UNSPECIFIED_TAG) < 0);
+        if (a->BacktraceCount != b->BacktraceCount)
+            return (a->BacktraceCount < b->BacktraceCount);
+        return (memcmp(a->Backtrace, b->Backtrace, a->BacktraceCount * sizeof(void*)) < 0);
+    };
+
+    // Copy the samples so that SampleTable isn't locked while we sort and look up symbols.
+    // All temporary memory here comes from SafeMMapAlloc, so that we don't disturb the heap we are reporting on.
+    AllocMetadata*        samples = nullptr;
+    const AllocMetadata** sortedSamples = nullptr;
+    SampleGroup*          groups = nullptr;
+    size_t                sampleCapacity = 0;
+    size_t                sampleCount = 0;
+
+    SampleTable.LockAll();
+    sampleCapacity = SampleTable.GetSize();
+
+    if (sampleCapacity)
+    {
+        samples = static_cast<AllocMetadata*>(SafeMMapAlloc(sampleCapacity * sizeof(AllocMetadata)));
+
+        if (samples)
+        {
+            AllocTrackingTable::Iterator it;
+
+            for (const AllocMetadata* amd = SampleTable.IterateBegin(it); amd && (sampleCount < sampleCapacity); amd = SampleTable.IterateNext(it))
+                samples[sampleCount++] = *amd;
+        }
+    }
+
+    SampleTable.UnlockAll();
+
+    if (sampleCount)
+    {
+        sortedSamples = static_cast<const AllocMetadata**>(SafeMMapAlloc(sampleCount * sizeof(AllocMetadata*)));
+        groups = static_cast<SampleGroup*>(SafeMMapAlloc(sampleCount * sizeof(SampleGroup)));
+    }
+
+    uint64_t totalEstimatedBytes = 0;
+    size_t   groupCount = 0;
+
+    if (sortedSamples && groups)
+    {
+        for (size_t i = 0; i < sampleCount; ++i)
+            sortedSamples[i] = &samples[i];
+
+        std::sort(sortedSamples, sortedSamples + sampleCount, GroupOrder);
+
+        for (size_t i = 0; i < sampleCount; ++i)
+        {
+            if (!groupCount || !SameGroup(sortedSamples[groups[groupCount - 1].First], sortedSamples[i]))
+            {
+                groups[groupCount].First = i;
+                groups[groupCount].Count = 0;
+                groups[groupCount].EstimatedBytes = 0;
+                groupCount++;
+            }
+
+            const uint64_t estimatedBytes = (uint64_t)EstimateBytes(sortedSamples[i]->AllocSize);
+            groups[groupCount - 1].Count++;
+            groups[groupCount - 1].EstimatedBytes += estimatedBytes;
+            totalEstimatedBytes += estimatedBytes;
+        }
+
+        std::sort(groups, groups + groupCount, [](const SampleGroup& a, const SampleGroup& b) -> bool {
+            return (a.EstimatedBytes > b.EstimatedBytes);
+        });
+    }
+
+    char summary[256];
+    snprintf(summary, OVR_ARRAY_COUNT(summary), "Sample interval: %llu bytes, samples: %llu, estimated live heap: %llu bytes\n",
+             (uint64_t)sampleInterval, (uint64_t)sampleCount, totalEstimatedBytes);
+    Output(summary);
+
+    if (groupCount)
+    {
+        const bool symbolLookupWasInitialized = SymbolLookup::IsInitialized();
+        const bool symbolLookupAvailable = SymbolLookup::Initialize();
+
+        if (!symbolLookupWasInitialized) // If SymbolLookup::Initialize was the first time being initialized, we need to refresh the Symbols view of modules, etc.
+            Symbols.Refresh();
+
+        const size_t reportBufferSize = 8192;
+        char*        reportBuffer = static_cast<char*>(SafeMMapAlloc(reportBufferSize));
+
+        for (size_t g = 0; reportBuffer && (g < groupCount); ++g)
+        {
+            const SampleGroup&   group = groups[g];
+            const AllocMetadata* amd = sortedSamples[group.First];
+
+            snprintf(reportBuffer, reportBufferSize, "\nEstimated bytes: %llu (%.1f%%), samples: %llu, tag: %.64s\n",
+                     group.EstimatedBytes, (totalEstimatedBytes ? ((100.0 * group.EstimatedBytes) / totalEstimatedBytes) : 0.0),
+                     (uint64_t)group.Count, amd->Tag ? amd->Tag : OVR_ALLOCATOR_UNSPECIFIED_TAG);
+
+            if (grouping == SampleGroupByCallSite)
+            {
+                size_t currentStrlen = strlen(reportBuffer);
+
+                if (amd->BacktraceCount)
+                    DescribeAllocation(amd, (AMFBacktrace | AMFBacktraceSymbols), reportBuffer + currentStrlen, reportBufferSize - currentStrlen, 1);
+                else
+                    OVR_strlcat(reportBuffer, "(backtrace unavailable)\n", reportBufferSize);
+            }
+
+            Output(reportBuffer);
+        }
+
+        if (reportBuffer)
+            SafeMMapFree(reportBuffer, reportBufferSize);
+
+        if (symbolLookupAvailable)
+            SymbolLookup::Shutdown();
+    }
+
+    if (groups)
+        SafeMMapFree(groups, sampleCount * sizeof(SampleGroup));
+    if (sortedSamples)
+        SafeMMapFree(sortedSamples, sampleCount * sizeof(AllocMetadata*));
+    if (samples)
+        SafeMMapFree(samples, sampleCapacity * sizeof(AllocMetadata));
+
+    return totalEstimatedBytes;
+}
+
+
+HeapStatsShard* Allocator::GetHeapStatsShard()
+{
+    if (CurrentHeapStatsShard.Shard && (CurrentHeapStatsShard.InstanceId == HeapStatsInstanceId))
+        return static_cast<HeapStatsShard*>(CurrentHeapStatsShard.Shard);
+
+    // Slow path: This is the first use of this Allocator by the calling thread, or the thread
+    // has since used another Allocator (in which case it already has a shard here).
+    const uint32_t threadId = GetThreadId();
+    HeapStatsShard* shard;
+
+    for (shard = HeapStatsShardList.load(std::memory_order_acquire); shard; shard = shard->Next)
+    {
+        if (shard->ThreadId == threadId) // Either ours, or that of an exited thread which had our id. The counts are cumulative, so either is fine.
+            break;
+    }
+
+    if (!shard)
+    {
+        void* memory = SafeMMapAlloc(sizeof(HeapStatsShard)); // Returned memory is 0-filled.
+
+        if (!memory)
+            return nullptr;
+
+        shard = new(memory) HeapStatsShard;
+        shard->ThreadId = threadId;
+        shard->Next = HeapStatsShardList.load(std::memory_order_relaxed);
+
+        while (!HeapStatsShardList.compare_exchange_weak(shard->Next, shard, std::memory_order_release, std::memory_order_relaxed))
+            { }
+    }
+
+    CurrentHeapStatsShard.Shard = shard;
+    CurrentHeapStatsShard.InstanceId = HeapStatsInstanceId;
+
+    return shard;
+}
+
+
+void Allocator::AddStatsLiveBytes(HeapStatsShard* shard, int64_t delta)
+{
+    shard->UnreportedLiveBytes += delta;
+
+    if ((shard->UnreportedLiveBytes >= HeapStatsReportThreshold) || (shard->UnreportedLiveBytes <= -HeapStatsReportThreshold))
+    {
+        int64_t liveBytes = (HeapStatsLiveBytes.fetch_add(shard->UnreportedLiveBytes, std::memory_order_relaxed) + shard->UnreportedLiveBytes);
+        int64_t peakLiveBytes = HeapStatsPeakLiveBytes.load(std::memory_order_relaxed);
+        shard->UnreportedLiveBytes = 0;
+
+        while ((liveBytes > peakLiveBytes) && !HeapStatsPeakLiveBytes.compare_exchange_weak(peakLiveBytes, liveBytes, std::memory_order_relaxed))
+            { }
+    }
+}
+
+
+void Allocator::RecordStatsAlloc(size_t blockSize, size_t requestedSize, const char* tag)
+{
+    HeapStatsShard* shard = GetHeapStatsShard();
+
+    if (!shard)
+        return;
+
+    HeapStatsShard::Add(shard->Counters[HeapStatsShard::AllocCount], 1);
+
+    if (blockSize != HeapStats::UnknownSize)
+    {
+        HeapStatsShard::Add(shard->Counters[HeapStatsShard::AllocBytes], blockSize);
+        HeapStatsShard::Add(shard->Counters[HeapStatsShard::RequestedBytes], requestedSize);
+        HeapStatsShard::Add(shard->SizeClassAllocCount[HeapStats::GetSizeClass(blockSize)], 1);
+        AddStatsLiveBytes(shard, (int64_t)blockSize);
+    }
+    else
+        blockSize = requestedSize; // Good enough for the tag totals.
+
+    if (!tag)
+        tag = GetTag(HeapStatsUntaggedName);
+
+    HeapStatsShard::TagEntry& tagEntry = shard->GetTagEntry(tag);
+    HeapStatsShard::Add(tagEntry.AllocCount, 1);
+    HeapStatsShard::Add(tagEntry.AllocBytes, blockSize);
+}
+
+
+void Allocator::RecordStatsFree(size_t blockSize)
+{
+    HeapStatsShard* shard = GetHeapStatsShard();
+
+    if (!shard)
+        return;
+
+    HeapStatsShard::Add(shard->Counters[HeapStatsShard::FreeCount], 1);
+
+    if (blockSize != HeapStats::UnknownSize)
+    {
+        HeapStatsShard::Add(shard->Counters[HeapStatsShard::FreeBytes], blockSize);
+        HeapStatsShard::Add(shard->SizeClassFreeCount[HeapStats::GetSizeClass(blockSize)], 1);
+        AddStatsLiveBytes(shard, -(int64_t)blockSize);
+    }
+}
+
+
+void Allocator::RecordStatsRealloc(size_t oldBlockSize, size_t newBlockSize, bool moved)
+{
+    HeapStatsShard* shard = GetHeapStatsShard();
+
+    if (!shard)
+        return;
+
+    HeapStatsShard::Add(shard->Counters[HeapStatsShard::ReallocCount], 1);
+
+    if (moved)
+        HeapStatsShard::Add(shard->Counters[HeapStatsShard::ReallocMoveCount], 1);
+
+    if ((oldBlockSize != HeapStats::UnknownSize) && (newBlockSize != HeapStats::UnknownSize))
+    {
+        if (newBlockSize > oldBlockSize)
+        {
+            HeapStatsShard::Add(shard->Counters[HeapStatsShard::ReallocGrowCount], 1);
+            HeapStatsShard::Add(shard->Counters[HeapStatsShard::ReallocGrowBytes], (newBlockSize - oldBlockSize));
+        }
+        else if (newBlockSize < oldBlockSize)
+        {
+            HeapStatsShard::Add(shard->Counters[HeapStatsShard::ReallocShrinkCount], 1);
+            HeapStatsShard::Add(shard->Counters[HeapStatsShard::ReallocShrinkBytes], (oldBlockSize - newBlockSize));
+        }
+
+        HeapStatsShard::Add(shard->SizeClassFreeCount[HeapStats::GetSizeClass(oldBlockSize)], 1);
+        HeapStatsShard::Add(shard->SizeClassAllocCount[HeapStats::GetSizeClass(newBlockSize)], 1);
+        AddStatsLiveBytes(shard, ((int64_t)newBlockSize - (int64_t)oldBlockSize));
+    }
+}
+
+
+void Allocator::GetHeapStats(HeapStats& stats)
+{
+    memset(&stats, 0, sizeof(stats));
+
+    uint64_t counters[HeapStatsShard::CounterCount] = {};
+    uint64_t sizeClassFreeCount[HeapStats::SizeClassCount] = {};
+
+    for (const HeapStatsShard* shard = HeapStatsShardList.load(std::memory_order_acquire); shard; shard = shard->Next)
+    {
+        stats.ThreadCount++;
+
+        for (size_t i = 0; i < HeapStatsShard::CounterCount; ++i)
+            counters[i] += shard->Counters[i].load(std::memory_order_relaxed);
+
+        for (size_t i = 0; i < HeapStats::SizeClassCount; ++i)
+        {
+            stats.SizeClasses[i].AllocCount += shard->SizeClassAllocCount[i].load(std::memory_order_relaxed);
+            sizeClassFreeCount[i]           += shard->SizeClassFreeCount[i].load(std::memory_order_relaxed);
+        }
+
+        for (size_t i = 0; i <= HeapStats::TagCapacity; ++i)
+        {
+            const HeapStatsShard::TagEntry& entry = ((i < HeapStats::TagCapacity) ? shard->Tags[i] : shard->OtherTag);
+            const char* tag = ((i < HeapStats::TagCapacity) ? entry.Tag.load(std::memory_order_acquire) : HeapStatsOtherTagName);
+
+            if (!tag || !entry.AllocCount.load(std::memory_order_relaxed))
+                continue;
+
+            // Find the tag by pointer or by name, as the same string literal can have multiple addresses.
+            // Tags beyond capacity go to the last entry, which we reserve for HeapStatsOtherTagName.
+            size_t t;
+
+            for (t = 0; t < stats.TagCount; ++t)
+            {
+                if ((stats.Tags[t].Tag == tag) || (strcmp(stats.Tags[t].Tag, tag) == 0))
+                    break;
+            }
+
+            if (t == stats.TagCount)
+            {
+                if (stats.TagCount == HeapStats::TagCapacity)
+                {
+                    t = HeapStats::TagCapacity;
+                    stats.Tags[t].Tag = HeapStatsOtherTagName;
+                    stats.TagCount = HeapStats::TagCapacity + 1;
+                }
+                else
+                    stats.Tags[stats.TagCount++].Tag = tag;
+            }
+
+            stats.Tags[t].AllocCount += entry.AllocCount.load(std::memory_order_relaxed);
+            stats.Tags[t].AllocBytes += entry.AllocBytes.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Counts from different threads may be read at slightly different times, so we guard against
+    // transiently seeing a free before its allocation.
+    auto Difference = [](uint64_t a, uint64_t b) -> uint64_t { return ((a > b) ? (a - b) : 0); };
+
+    stats.AllocCount         = counters[HeapStatsShard::AllocCount];
+    stats.FreeCount          = counters[HeapStatsShard::FreeCount];
+    stats.LiveCount          = Difference(stats.AllocCount, stats.FreeCount);
+    stats.AllocBytes         = counters[HeapStatsShard::AllocBytes];
+    stats.RequestedBytes     = counters[HeapStatsShard::RequestedBytes];
+    stats.ReallocCount       = counters[HeapStatsShard::ReallocCount];
+    stats.ReallocGrowCount   = counters[HeapStatsShard::ReallocGrowCount];
+    stats.ReallocShrinkCount = counters[HeapStatsShard::ReallocShrinkCount];
+    stats.ReallocMoveCount   = counters[HeapStatsShard::ReallocMoveCount];
+    stats.ReallocGrowBytes   = counters[HeapStatsShard::ReallocGrowBytes];
+    stats.ReallocShrinkBytes = counters[HeapStatsShard::ReallocShrinkBytes];
+    stats.LiveBytes          = Difference(stats.AllocBytes + stats.ReallocGrowBytes, counters[HeapStatsShard::FreeBytes] + stats.ReallocShrinkBytes);
+
+    int64_t peakLiveBytes = HeapStatsPeakLiveBytes.load(std::memory_order_relaxed);
+    stats.PeakLiveBytes = (((uint64_t)peakLiveBytes > stats.LiveBytes) ? (uint64_t)peakLiveBytes : stats.LiveBytes);
+
+    for (size_t i = 0; i < HeapStats::SizeClassCount; ++i)
+        stats.SizeClasses[i].LiveCount = Difference(stats.SizeClasses[i].AllocCount, sizeClassFreeCount[i]);
+}
+
+
+JSON* Allocator::CreateHeapStatsJSON()
+{
+    HeapStats stats;
+    GetHeapStats(stats); // Do this before creating any JSON, as that allocates memory.
+
+    JSON* json = JSON::CreateObject();
+
+    json->AddNumberItem("AllocCount",            (double)stats.AllocCount);
+    json->AddNumberItem("FreeCount",             (double)stats.FreeCount);
+    json->AddNumberItem("LiveCount",             (double)stats.LiveCount);
+    json->AddNumberItem("AllocBytes",            (double)stats.AllocBytes);
+    json->AddNumberItem("RequestedBytes",        (double)stats.RequestedBytes);
+    json->AddNumberItem("LiveBytes",             (double)stats.LiveBytes);
+    json->AddNumberItem("PeakLiveBytes",         (double)stats.PeakLiveBytes);
+    json->AddNumberItem("InternalFragmentation", stats.GetInternalFragmentation());
+    json->AddNumberItem("ReallocCount",          (double)stats.ReallocCount);
+    json->AddNumberItem("ReallocGrowCount",      (double)stats.ReallocGrowCount);
+    json->AddNumberItem("ReallocShrinkCount",    (double)stats.ReallocShrinkCount);
+    json->AddNumberItem("ReallocMoveCount",      (double)stats.ReallocMoveCount);
+    json->AddNumberItem("ReallocGrowBytes",      (double)stats.ReallocGrowBytes);
+    json->AddNumberItem("ReallocShrinkBytes",    (double)stats.ReallocShrinkBytes);
+    json->AddNumberItem("ThreadCount",           (double)stats.ThreadCount);
+
+    JSON* sizeClasses = JSON::CreateArray();
+
+    for (size_t i = 0; i < HeapStats::SizeClassCount; ++i)
+    {
+        if (stats.SizeClasses[i].AllocCount) // Omit empty classes, which are most of them.
+        {
+            JSON* sizeClass = JSON::CreateObject();
+            sizeClass->AddNumberItem("MaxSize",    (double)((uint64_t)1 << i));
+            sizeClass->AddNumberItem("AllocCount", (double)stats.SizeClasses[i].AllocCount);
+            sizeClass->AddNumberItem("LiveCount",  (double)stats.SizeClasses[i].LiveCount);
+            sizeClasses->AddArrayElement(sizeClass);
+        }
+    }
+
+    json->AddItem("SizeClasses", sizeClasses);
+
+    JSON* tags = JSON::CreateArray();
+
+    for (size_t i = 0; i < stats.TagCount; ++i)
+    {
+        JSON* tag = JSON::CreateObject();
+        tag->AddStringItem("Tag",        stats.Tags[i].Tag);
+        tag->AddNumberItem("AllocCount", (double)stats.Tags[i].AllocCount);
+        tag->AddNumberItem("AllocBytes", (double)stats.Tags[i].AllocBytes);
+        tags->AddArrayElement(tag);
+    }
+
+    json->AddItem("Tags", tags);
+
+    if (OSHeapEnabled)
+    {
+        OSHeap::HugePageStats hugePageStats;
+        OSHeap::GetHugePageStats(hugePageStats);
+
+        JSON* hugePages = JSON::CreateObject();
+        hugePages->AddNumberItem("MappedCount",              (double)hugePageStats.MappedCount);
+        hugePages->AddNumberItem("MappedBytes",              (double)hugePageStats.MappedBytes);
+        hugePages->AddNumberItem("ExplicitHugePageBytes",    (double)hugePageStats.ExplicitHugePageBytes);
+        hugePages->AddNumberItem("TransparentHugePageBytes", (double)hugePageStats.TransparentHugePageBytes);
+        hugePages->AddNumberItem("NumaBoundBytes",           (double)hugePageStats.NumaBoundBytes);
+        hugePages->AddNumberItem("ExplicitFallbackCount",    (double)hugePageStats.ExplicitFallbackCount);
+        json->AddItem("HugePages", hugePages);
+    }
+
+    return json;
+}
+
+
+bool Allocator::EnableDebugPageHeap(bool enable)
+{
+    bool result = false;
+
+    if (!Heap) // If we haven't initialized yet...
+    {
+        DebugPageHeapEnabled = enable;
+        result = true;
+    }
+
+    return result;
+}
+
+
+bool Allocator::EnableOSHeap(bool enable)
+{
+    bool result = false;
+
+    if (!Heap) // If we haven't initialized yet...
+    {
+        OSHeapEnabled = enable;
+        result = true;
+    }
+
+    return result;
+}
+
+
+bool Allocator::SetHugePagePolicy(HugePageMode mode, size_t threshold, bool bindToNumaNode)
+{
+    bool result = false;
+
+    if (!Heap) // If we haven't initialized yet...
+    {
+        HugePages = mode;
+        HugePageThreshold = threshold;
+        NumaBindingEnabled = bindToNumaNode;
+        result = true;
+    }
+
+    return result;
+}
+
+
+bool Allocator::EnableThreadCache(bool enable)
+{
+    bool result = false;
+
+    if (!Heap) // If we haven't initialized yet...
+    {
+        ThreadCacheEnabled = enable;
+        result = true;
+    }
+
+    return result;
+}
+
+
+bool Allocator::EnableMallocRedirect()
+{
+    bool result = false;
+
+    if (!Heap)
+    {
+        MallocRedirectEnabled = true;
+        result = true;
+    }
+
+    return result;
+}
+
+bool Allocator::IsHeapTrackingRegKeyEnabled(bool defaultValue)
+{
+    // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\HeapTrackingEnabled", REG_DWORD of 0 or 1.
+    return OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"HeapTrackingEnabled", defaultValue);
+}
+
+const AllocMetadata* Allocator::IterateHeapBegin()
+{
+    TrackLock.DoLock();             // Will be unlocked in IterateHeapEnd().
+    AllocationTable.LockAll();      // "
+
+    if (TrackingEnabled)
+    {
+        // We have a problem in the case that a single thread calls IterateHeapBegin twice 
+        // before calling IterateHeapEnd. It can be resolved the application calling IterateHeapEnd 
+        // twice as well, but do we want to support that usage? It's probably easier to just disallow it.
+
+        return AllocationTable.IterateBegin(TrackIterator);
+    }
+
+    return nullptr;
+}
+
+const AllocMetadata* Allocator::IterateHeapNext()
+{
+    return AllocationTable.IterateNext(TrackIterator);
+}
+
+void Allocator::IterateHeapEnd()
+{
+    AllocationTable.UnlockAll();
+    TrackLock.Unlock();
+}
+
+size_t Allocator::CopyTrackedAllocations(size_t shardIndex, AllocMetadata* metadata, size_t capacity)
+{
+    Lock::Locker locker(&TrackLock); // Keeps EnableTracking from clearing the table during the copy.
+
+    if (!TrackingEnabled)
+        return 0;
+
+    return AllocationTable.CopyShard(shardIndex, metadata, capacity);
+}
+
+
+size_t Allocator::DescribeAllocation(const AllocMetadata* amd, int amdFlags, char* description, size_t descriptionCapacity, size_t appendedNewlineCount)
+{
+    SysAllocatedString descriptionString;
+    char buffer[2048];
+
+    if (amdFlags & AMFAlloc)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), "0x%p", amd->Alloc);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFAllocSize)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", size: %llu", amd->AllocSize);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFBlockSize)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", block size: %llu", amd->BlockSize);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFTime)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", time: %llus", amd->TimeNs / UINT64_C(1000000000));
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFCount)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", #: %llu", amd->Count);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFTag)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", tag: %s", amd->Tag ? amd->Tag : OVR_ALLOCATOR_UNSPECIFIED_TAG);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFThreadId)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", tid: %u", amd->ThreadId);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFThreadName)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", thread name: %s", amd->ThreadName);
+        descriptionString += buffer;
+    }
+
+    if ((amdFlags & AMFFile) || (amdFlags & AMFLine))
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", file/line: %s(%d)", amd->File, amd->Line);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & (AMFBacktrace | AMFBacktraceSymbols))
+    {
+        if (!descriptionString.empty()) // If anything was written above...
+            descriptionString += "\n";
+
+        char symbolBuffer[FrameSymbolCapacity];
+
+        for (size_t j = 0, jEnd = amd->BacktraceCount; (j < jEnd) && (descriptionString.length() < descriptionCapacity); ++j)
+        {
+            const bool  shouldLookupSymbols = (SymbolLookupEnabled && ((amdFlags & AMFBacktraceSymbols) != 0));
+            const char* symbolText = (shouldLookupSymbols ? LookupFrameSymbol(amd->Backtrace[j], symbolBuffer, sizeof(symbolBuffer)) : "");
+
+            if (symbolText[0])
+                snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%2u: %s\n", (unsigned)j, symbolText);
+            else
+                snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%2u: 0x%p (symbols unavailable)\n", (unsigned)j, amd->Backtrace[j]);
+
+            descriptionString += buffer;
+        }
+
+        descriptionString.erase(descriptionString.size() - 1); // Remove the last newline. We may add back below.
+    }
+
+    for(size_t i = 0; i < appendedNewlineCount; ++i)
+        descriptionString += '\n';
+
+    return OVR_strlcpy(description, descriptionString.c_str(), descriptionCapacity);
+}
+
+
+const char* Allocator::LookupFrameSymbol(void* address, char* buffer, size_t bufferCapacity)
+{
+    Lock::Locker locker(&SymbolCacheLock);
+
+    buffer[0] = '\0';
+
+    if (!SymbolCache)
+    {
+        void* memory = SafeMMapAlloc(sizeof(FrameSymbolCache));
+
+        if (!memory)
+            return buffer;
+
+        SymbolCache = new(memory) FrameSymbolCache;
+    }
+
+    const char* text = SymbolCache->Lookup(Symbols, address, buffer, bufferCapacity);
+
+    if (text != buffer)
+        OVR_strlcpy(buffer, text, bufferCapacity);
+
+    return buffer;
+}
+
+
+void Allocator::FreeSymbolCache()
+{
+    Lock::Locker locker(&SymbolCacheLock);
+
+    if (SymbolCache)
+    {
+        SymbolCache->~FrameSymbolCache();
+        SafeMMapFree(SymbolCache, sizeof(FrameSymbolCache));
+        SymbolCache = nullptr;
+    }
+}
+
+
+size_t Allocator::TraceTrackedAllocations(AllocationTraceCallback callback, uintptr_t context)
+{
+    // Leaked allocations typically come from a much smaller number of call sites, so we group them
+    // by backtrace, and write and symbolize each backtrace only once.
+    struct LeakRecord
+    {
+        const void* Alloc;
+        uint64_t    AllocSize;
+        const char* Tag;
+        size_t      NextLeak;               // Index of the next LeakRecord with the same backtrace, or SIZE_MAX.
+    };
+
+    struct LeakBacktrace
+    {
+        void*    Backtrace[AllocMetadata::BacktraceCapacity];
+        uint32_t BacktraceCount;
+        size_t   FirstLeak;                 // Index of the first LeakRecord with this backtrace.
+        size_t   LeakCount;
+        uint64_t LeakBytes;
+        bool     Ignored;                   // True if these aren't reported as leaks.
+    };
+
+    auto Output = [callback, context](const char* text) -> void {
+        // We cannot use normal logging system here because it will allocate more memory!
+        if (callback)
+            callback(context, text);
+        else
+            ::OutputDebugStringA(text);
+    };
+
+    auto HashBacktrace = [](void* const* backtrace, uint32_t backtraceCount) -> uint64_t {
+        uint64_t hash = UINT64_C(14695981039346656037); // FNV-1a, a pointer at a time.
+        for (uint32_t i = 0; i < backtraceCount; ++i)
+            hash = ((hash ^ (uint64_t)(uintptr_t)backtrace[i]) * UINT64_C(1099511628211));
+        return (hash ^ (hash >> 29));
+    };
+
+    const bool symbolLookupWasInitialized = SymbolLookup::IsInitialized();
+    const bool symbolLookupAvailable = SymbolLookup::Initialize();
+
+    if(!symbolLookupWasInitialized) // If SymbolLookup::Initialize was the first time being initialized, we need to refresh the Symbols view of modules, etc.
+    {
+        Symbols.Refresh();
+        FreeSymbolCache(); // Symbols that were cached before may be for modules that are no longer loaded.
+    }
+
+    // All temporary memory here comes from SafeMMapAlloc, so that we don't disturb the heap we are reporting on.
+    LeakRecord*    leaks = nullptr;
+    LeakBacktrace* backtraces = nullptr;
+    size_t*        backtraceTable = nullptr;   // Hash table of (index into backtraces) + 1. 0 means empty.
+    size_t         leakCapacity = 0;
+    size_t         tableCapacity = 0;
+    size_t         measuredLeakCount = 0;
+    size_t         backtraceCount = 0;
+    bool           outOfMemory = false;
+
+    // If we're dumping while LibOVR is running, then we should hold the locks, but only while we
+    // copy what we need. It's possible this is being called after the Allocator was shut down, in
+    // which case the table is empty and the locks are uncontended.
+    TrackLock.DoLock();
+    AllocationTable.LockAll();
+
+    leakCapacity = AllocationTable.GetSize();
+
+    if (leakCapacity)
+    {
+        for (tableCapacity = 64; tableCapacity < (leakCapacity * 2); tableCapacity *= 2)
+            { }
+
+        leaks          = static_cast<LeakRecord*>(SafeMMapAlloc(leakCapacity * sizeof(LeakRecord)));
+        backtraces     = static_cast<LeakBacktrace*>(SafeMMapAlloc(leakCapacity * sizeof(LeakBacktrace)));
+        backtraceTable = static_cast<size_t*>(SafeMMapAlloc(tableCapacity * sizeof(size_t))); // Returned memory is 0-filled.
+        outOfMemory    = (!leaks || !backtraces || !backtraceTable);
+    }
+
+    AllocTrackingTable::Iterator it;
+
+    for (const AllocMetadata* amd = (outOfMemory ? nullptr : AllocationTable.IterateBegin(it)); amd && (measuredLeakCount < leakCapacity); amd = AllocationTable.IterateNext(it))
+    {
+        const uint32_t amdBacktraceCount = std::min(amd->BacktraceCount, (uint32_t)AllocMetadata::BacktraceCapacity);
+        size_t         index = (size_t)(HashBacktrace(amd->Backtrace, amdBacktraceCount) & (tableCapacity - 1));
+        LeakBacktrace* backtrace = nullptr;
+
+        for (; backtraceTable[index]; index = ((index + 1) & (tableCapacity - 1)))
+        {
+            LeakBacktrace* candidate = &backtraces[backtraceTable[index] - 1];
+
+            if ((candidate->BacktraceCount == amdBacktraceCount) && (memcmp(candidate->Backtrace, amd->Backtrace, amdBacktraceCount * sizeof(void*)) == 0))
+            {
+                backtrace = candidate;
+                break;
+            }
+        }
+
+        if (!backtrace) // If this is the first allocation with this backtrace...
+        {
+            backtrace = &backtraces[backtraceCount++];
+            backtraceTable[index] = backtraceCount;
+            memcpy(backtrace->Backtrace, amd->Backtrace, amdBacktraceCount * sizeof(void*));
+            backtrace->BacktraceCount = amdBacktraceCount;
+            backtrace->FirstLeak = SIZE_MAX;
+        }
+
+        LeakRecord& leak = leaks[measuredLeakCount];
+        leak.Alloc     = amd->Alloc;
+        leak.AllocSize = amd->AllocSize;
+        leak.Tag       = amd->Tag;
+        leak.NextLeak  = backtrace->FirstLeak;
+
+        backtrace->FirstLeak = measuredLeakCount++;
+        backtrace->LeakCount++;
+        backtrace->LeakBytes += amd->AllocSize;
+    }
+
+    AllocationTable.UnlockAll();
+    TrackLock.Unlock();
+
+    // Symbolize each unique backtrace and filter out the ones we ignore. There are some leaks that aren't real because
+    // they are allocated by the Standard Library at runtime but aren't freed until shutdown. We don't want to report those.
+    const bool   lookupSymbols = (symbolLookupAvailable && !OfflineSymbolization);
+    const char*  ignoredPhrases[] = { "Concurrency::details" /*add any additional strings here*/ };
+    char         symbolBuffer[FrameSymbolCapacity];
+    size_t       reportedLeakCount = 0;
+    size_t*      backtraceOrder = (backtraceCount ? static_cast<size_t*>(SafeMMapAlloc(backtraceCount * sizeof(size_t))) : nullptr);
+
+    outOfMemory = (outOfMemory || (backtraceCount && !backtraceOrder));
+
+    for (size_t b = 0; backtraceOrder && (b < backtraceCount); ++b)
+    {
+        LeakBacktrace& backtrace = backtraces[b];
+
+        for (uint32_t j = 0; lookupSymbols && (j < backtrace.BacktraceCount) && !backtrace.Ignored; ++j)
+        {
+            const char* symbolText = LookupFrameSymbol(backtrace.Backtrace[j], symbolBuffer, sizeof(symbolBuffer));
+
+            for (size_t p = 0; (p < OVR_ARRAY_COUNT(ignoredPhrases)) && !backtrace.Ignored; ++p)
+                backtrace.Ignored = (strstr(symbolText, ignoredPhrases[p]) != nullptr);
+        }
+
+        if (!backtrace.Ignored)
+            reportedLeakCount += backtrace.LeakCount;
+
+        backtraceOrder[b] = b;
+    }
+
+    if (backtraceOrder)
+    {
+        std::sort(backtraceOrder, backtraceOrder + backtraceCount, [backtraces](size_t a, size_t b) -> bool {
+            return (backtraces[a].LeakBytes > backtraces[b].LeakBytes);
+        });
+    }
+
+    // Write the report. We batch lines into reportBuffer so as to make fewer calls to the callback.
+    const size_t reportBufferSize = 8192;
+    char*        reportBuffer = (reportedLeakCount ? static_cast<char*>(SafeMMapAlloc(reportBufferSize)) : nullptr);
+    size_t       reportLength = 0;
+    char         line[2048];
+
+    auto Append = [&](const char* text) -> void {
+        const size_t length = strlen(text);
+        if ((reportLength + length) >= reportBufferSize)
+        {
+            Output(reportBuffer);
+            reportLength = 0;
+        }
+        OVR_strlcpy(reportBuffer + reportLength, text, reportBufferSize - reportLength); // Truncates only if the line by itself is longer than the buffer.
+        reportLength = std::min(reportLength + length, reportBufferSize - 1);
+    };
+
+    for (size_t b = 0; reportBuffer && (b < backtraceCount); ++b)
+    {
+        const LeakBacktrace& backtrace = backtraces[backtraceOrder[b]];
+
+        if (backtrace.Ignored)
+            continue;
+
+        snprintf(line, OVR_ARRAY_COUNT(line), "\nLeaks with backtrace #%u: %llu, total size: %llu\n", (unsigned)(b + 1), (uint64_t)backtrace.LeakCount, backtrace.LeakBytes);
+        Append(line);
+
+        if (backtrace.BacktraceCount == 0)
+            Append("(backtrace unavailable)\n");
+
+        for (uint32_t j = 0; j < backtrace.BacktraceCount; ++j)
+        {
+            const char* symbolText = (lookupSymbols ? LookupFrameSymbol(backtrace.Backtrace[j], symbolBuffer, sizeof(symbolBuffer)) : "");
+
+            if (symbolText[0])
+                snprintf(line, OVR_ARRAY_COUNT(line), "%2u: %s\n", (unsigned)j, symbolText);
+            else if (OfflineSymbolization)
+            {
+                const ModuleInfo* moduleInfo = Symbols.GetModuleInfoForAddress((uint64_t)backtrace.Backtrace[j]);
+
+                if (moduleInfo)
+                    snprintf(line, OVR_ARRAY_COUNT(line), "%2u: 0x%p %s+0x%llx\n", (unsigned)j, backtrace.Backtrace[j], moduleInfo->name, ((uint64_t)backtrace.Backtrace[j] - moduleInfo->baseAddress));
+                else
+                    snprintf(line, OVR_ARRAY_COUNT(line), "%2u: 0x%p (unknown module)\n", (unsigned)j, backtrace.Backtrace[j]);
+            }
+            else
+                snprintf(line, OVR_ARRAY_COUNT(line), "%2u: 0x%p (symbols unavailable)\n", (unsigned)j, backtrace.Backtrace[j]);
+
+            Append(line);
+        }
+
+        for (size_t l = backtrace.FirstLeak; l != SIZE_MAX; l = leaks[l].NextLeak)
+        {
+            snprintf(line, OVR_ARRAY_COUNT(line), "0x%p, size: %llu, tag: %.64s\n", leaks[l].Alloc, leaks[l].AllocSize, leaks[l].Tag ? leaks[l].Tag : "none"); // Limit the tag length so that a line can't exhaust the buffer.
+            Append(line);
+        }
+    }
+
+    if (reportLength)
+        Output(reportBuffer);
+
+    if (outOfMemory)
+        Output("Allocator::TraceTrackedAllocations: Not enough memory for a complete report.\n");
+
+    char summaryBuffer[128];
+    snprintf(summaryBuffer, OVR_ARRAY_COUNT(summaryBuffer), "Measured leak count: %llu, Reported leak count: %llu, unique backtraces: %llu\n", (uint64_t)measuredLeakCount, (uint64_t)reportedLeakCount, (uint64_t)backtraceCount);
+    Output(summaryBuffer);
+
+    if (reportBuffer)
+        SafeMMapFree(reportBuffer, reportBufferSize);
+    if (backtraceOrder)
+        SafeMMapFree(backtraceOrder, backtraceCount * sizeof(size_t));
+    if (backtraceTable)
+        SafeMMapFree(backtraceTable, tableCapacity * sizeof(size_t));
+    if (backtraces)
+        SafeMMapFree(backtraces, leakCapacity * sizeof(LeakBacktrace));
+    if (leaks)
+        SafeMMapFree(leaks, leakCapacity * sizeof(LeakRecord));
+
+    if(symbolLookupAvailable)
+        SymbolLookup::Shutdown();
+
+    return reportedLeakCount;
+}
+
+
+
+//------------------------------------------------------------------------
+// ***** HeapIterationFilterRPN
+//
+
+HeapIterationFilterRPN::HeapIterationFilterRPN()
+  : AllocatorInstance(nullptr), Filter(nullptr), Instructions{}, Strings{}, StringSize(0), CurrentHeapTimeNs(Allocator::GetCurrentHeapTimeNs()),
+    Snapshot(nullptr), SnapshotCapacity(0), SnapshotSize(0), SnapshotIndex(0), ShardIndex(0)
+{
+}
+
+HeapIterationFilterRPN::~HeapIterationFilterRPN()
+{
+    FreeSnapshot();
+}
+
+bool HeapIterationFilterRPN::SetFilter(Allocator* allocator, const char* filter)
+{
+    AllocatorInstance = allocator;
+    Filter = filter;
+    return Compile(filter);    
+}
+
+const AllocMetadata* HeapIterationFilterRPN::IterateHeapBegin()
+{
+    SnapshotSize = 0;
+    SnapshotIndex = 0;
+    ShardIndex = 0;
+
+    return FindNextMatch();
+}
+
+const AllocMetadata* HeapIterationFilterRPN::IterateHeapNext()
+{
+    return FindNextMatch();
+}
+
+void HeapIterationFilterRPN::IterateHeapEnd()
+{
+    FreeSnapshot();
+}
+
+const AllocMetadata* HeapIterationFilterRPN::FindNextMatch()
+{
+    for (;;)
+    {
+        while (SnapshotIndex < SnapshotSize)
+        {
+            const AllocMetadata* amd = &Snapshot[SnapshotIndex++];
+
+            if (Evaluate(amd))
+                return amd;
+        }
+
+        if (ShardIndex >= AllocTrackingTable::ShardCount)
+            return nullptr;
+
+        // Copy the next shard, growing the snapshot if the shard doesn't fit. Other threads may grow
+        // the shard between our calls, so this can take more than one try.
+        size_t shardSize;
+
+        while ((shardSize = AllocatorInstance->CopyTrackedAllocations(ShardIndex, Snapshot, SnapshotCapacity)) > SnapshotCapacity)
+        {
+            FreeSnapshot();
+
+            const size_t newCapacity = (shardSize + (shardSize / 4) + 64);
+            Snapshot = static_cast<AllocMetadata*>(SafeMMapAlloc(newCapacity * sizeof(AllocMetadata)));
+
+            if (!Snapshot)
+            {
+                ShardIndex = AllocTrackingTable::ShardCount; // End the iteration.
+                return nullptr;
+            }
+
+            SnapshotCapacity = newCapacity;
+        }
+
+        SnapshotSize = shardSize;
+        SnapshotIndex = 0;
+        ShardIndex++;
+    }
+}
+
+void HeapIterationFilterRPN::FreeSnapshot()
+{
+    if (Snapshot)
+        SafeMMapFree(Snapshot, SnapshotCapacity * sizeof(AllocMetadata));
+
+    Snapshot = nullptr;
+    SnapshotCapacity = 0;
+    SnapshotSize = 0;
+    SnapshotIndex = 0;
+}
+
+
+bool HeapIterationFilterRPN::Compile(const char* filter)
+{
+    bool success = true; // To consider: We can report syntax errors and associated line numbers.
+
+    static_assert(std::is_standard_layout<Instruction>::value, "Instructions is presumed to be a POD here.");
+    memset(Instructions, 0, sizeof(Instructions));
+    memset(Strings, 0, sizeof(Strings));
+    StringSize = 0;
+
+    for(size_t instructionCount = 0; success && (instructionCount < InstructionCapacity); ) // While reading each line until the end of the text...
+    {
+        while(isspace(*filter)) // Move past whitespace. Currently we need this only because of our isOperandLine check below.
+            ++filter;
+
+        Instruction instruction{};
+        char        tempDataType[12], tempCompare[8], tempComparand[256], tempOperation[8], *nextChar;
+        size_t      i;
+        bool        isOperandLine = _strnicmp(filter, "and", 3) && _strnicmp(filter, "or", 2); // To consider: Find a cleaner way to discern which of the two kinds of lines this is (operand or operation).
+
+        if ((*filter == '\0') || (*filter == '/'))
+        {
+            // Ignore lines that are empty or begin with / 
+        }
+        else if (isOperandLine && (sscanf_s(filter, "%11s %7s %255[^;\r\n]", tempDataType,  (unsigned)sizeof(tempDataType),
+                                                                         tempCompare,   (unsigned)sizeof(tempCompare),
+                                                                         tempComparand, (unsigned)sizeof(tempComparand)) == 3)) // If this line looks like an operand (e.g. AllocSize > 100)...
+        {
+            static_assert(sizeof(tempComparand) == 256, "The format string here assumes 256. Fix the format string and this assert if tempComparand changes.");
+ 
+            struct OperandFieldPair{ const char* str; Field value; } 
+            operandFieldMap[] = { {"File", FieldFile}, {"Line", FieldLine}, {"Time", FieldTime}, {"Count", FieldCount}, {"Size", FieldAllocSize}, {"AllocSize", FieldAllocSize}, {"BlockSize", FieldBlockSize}, {"Tag", FieldTag}, {"ThreadId", FieldThreadId}, {"ThreadName", FieldThreadName} };
+
+            // Read the operand (e.g. size)
+            for(i = 0; i < OVR_ARRAY_COUNT(operandFieldMap) && (instruction.field == FieldNone); ++i)
+            {
+                if(OVR_stricmp(tempDataType, operandFieldMap[i].str) == 0)
+                    instruction.field = operandFieldMap[i].value;
+            }
+            success = success && (instruction.field != FieldNone); // Successful if a match was found.
+
+            // Read the compare type (e.g. >=). String fields support only == and has, and integer fields all but has.
+            const bool isStringField = ((instruction.field == FieldFile) || (instruction.field == FieldTag) || (instruction.field == FieldThreadName));
+
+            struct CompareOpcodePair{ const char* str; Opcode numValue; Opcode strValue; } 
+            compareOpcodeMap[] = { {"==", OpNumE, OpStrE}, {"<", OpNumL, OpEnd}, {"<=", OpNumLE, OpEnd}, {">", OpNumG, OpEnd}, {">=", OpNumGE, OpEnd}, {"has", OpEnd, OpStrHas} };
+
+            for(i = 0; i < OVR_ARRAY_COUNT(compareOpcodeMap) && (instruction.opcode == OpEnd); ++i)
+            {
+                if(OVR_stricmp(tempCompare, compareOpcodeMap[i].str) == 0)
+                    instruction.opcode = (isStringField ? compareOpcodeMap[i].strValue : compareOpcodeMap[i].numValue);
+            }
+            success = success && (instruction.opcode != OpEnd); // Successful if a match was found.
+
+            // Read the comparand (e.g. 4096)
+            if (isStringField)
+            {
+                size_t length = strlen(tempComparand);
+
+                while (length && isspace((unsigned char)tempComparand[length - 1])) // Trailing space before a ; is not part of the string.
+                    tempComparand[--length] = '\0';
+
+                if ((StringSize + length + 1) <= StringCapacity)
+                {
+                    instruction.strOffset = (uint16_t)StringSize;
+                    memcpy(&Strings[StringSize], tempComparand, length + 1);
+                    StringSize += (length + 1);
+                }
+                else
+                    success = false; // Out of space.
+            }
+            else
+            {
+                instruction.numValue = strtoll(tempComparand, &nextChar, 10);
+
+                if (instruction.field == FieldTime)
+                {
+                    if (*nextChar == 's')                                                       // If the filter is specifying time in seconds instead of nanoseconds...
+                        instruction.numValue *= 1000000000;                                     //     convert numValue from seconds to nanoseconds (which is what we internally use).
+                    if (instruction.numValue < 0)                                               // Handle the case that a negative time was passed, which
+                        instruction.numValue += CurrentHeapTimeNs;                              //     means to refer to time relative to current time.
+                }
+                else if ((instruction.field == FieldCount) && (instruction.numValue < 0))       // Handle the case that a negative count was passed, which
+                    instruction.numValue += AllocatorInstance->GetCounter();                    //     means to refer to the last N allocations.
+            }
+        }
+        else if (sscanf_s(filter, "%7[^;\r\n]", tempOperation, (unsigned)sizeof(tempOperation)) == 1) // If this line looks like an operation (e.g. And or Or).
+        {
+            for (char* p = tempOperation + strlen(tempOperation); (p > tempOperation) && isspace((unsigned char)p[-1]); )
+                *--p = '\0';
+
+            if (OVR_stricmp(tempOperation, "and") == 0)
+                instruction.opcode = OpAnd;
+            else if(OVR_stricmp(tempOperation, "or") == 0)
+                instruction.opcode = OpOr;
+            else
+                success = false;
+        }
+        else
+            success = false;
+
+        if (success && (instruction.opcode != OpEnd))
+            Instructions[instructionCount++] = instruction;
+
+        // Move to the start of the next statement (delimited by ; or \n)
+        filter = strpbrk(filter, ";\n");
+        if (filter)
+            filter++;
+        else
+            break;
+    }
+
+    if (success && filter && *filter) // If we ran out of instruction space before the end of the filter...
+    {
+        while (isspace(*filter))
+            ++filter;
+        success = (*filter == '\0');
+    }
+
+    return success;
+}
+
+bool HeapIterationFilterRPN::Evaluate(const AllocMetadata* amd) const
+{
+    // We execute an RPN (a.k.a. postfix) stack here. Because our language here involves 
+    // only logical operations, our stack is a stack of bits, with the top in bit 0. Its depth
+    // is bounded by 1 + InstructionCapacity, as each instruction pushes at most one value.
+    static_assert(InstructionCapacity < 64, "The stack below has room for only 64 entries.");
+
+    uint64_t stack = 1; // By default the state is true. An empty instruction set evaluates as true.
+
+    for(const Instruction* instruction = Instructions; (instruction != (Instructions + InstructionCapacity)) && (instruction->opcode != OpEnd); ++instruction)
+    {
+        bool result;
+
+        switch (instruction->opcode)
+        {
+            case OpAnd: // Pop the two, push the AND of the two.
+                stack = (((stack >> 2) << 1) | (stack & (stack >> 1) & 1));
+                continue;
+
+            case OpOr:
+                stack = (((stack >> 2) << 1) | ((stack | (stack >> 1)) & 1));
+                continue;
+
+            case OpStrE: case OpStrHas: // String-based operands
+            {
+                const char* p;
+
+                switch (instruction->field)
+                {
+                    default:
+                    case FieldFile:       p = amd->File;       break;
+                    case FieldTag:        p = amd->Tag;        break;
+                    case FieldThreadName: p = amd->ThreadName; break;
+                }
+
+                if (!p)
+                    p = "";
+
+                if (instruction->opcode == OpStrE)
+                    result = (OVR_stricmp(p, &Strings[instruction->strOffset]) == 0);
+                else
+                    result = (OVR_stristr(p, &Strings[instruction->strOffset]) != nullptr);
+                break;
+            }
+
+            default: // Integer-based operands
+            {
+                int64_t n;
+
+                switch (instruction->field)
+                {
+                    default:
+                    case FieldLine:      n = amd->Line;               break;
+                    case FieldTime:      n = (int64_t)amd->TimeNs;    break;
+                    case FieldCount:     n = (int64_t)amd->Count;     break;
+                    case FieldAllocSize: n = (int64_t)amd->AllocSize; break;
+                    case FieldBlockSize: n = (int64_t)amd->BlockSize; break;
+                    case FieldThreadId:  n = amd->ThreadId;           break;
+                }
+
+                switch (instruction->opcode)
+                {
+                    default:
+                    case OpNumE:  result = (n == instruction->numValue); break;
+                    case OpNumL:  result = (n <  instruction->numValue); break;
+                    case OpNumLE: result = (n <= instruction->numValue); break;
+                    case OpNumG:  result = (n >  instruction->numValue); break;
+                    case OpNumGE: result = (n >= instruction->numValue); break;
+                }
+                break;
+            }
+        }
+
+        stack = ((stack << 1) | (result ? 1 : 0)); // Push the result.
+    }
+
+    return ((stack & 1) != 0);
+}
+
+
+void HeapIterationFilterRPN::TraceTrackedAllocations(Allocator* allocator, const char* filter, Allocator::AllocationTraceCallback callback, uintptr_t context)
+{
+    OVR::HeapIterationFilterRPN hifRPN;
+
+    hifRPN.SetFilter(allocator, filter);
+
+    for(const OVR::AllocMetadata* amd = hifRPN.IterateHeapBegin(); amd; amd = hifRPN.IterateHeapNext())
+    {
+        char description[16384];
+        allocator->DescribeAllocation(amd, 0xffff, description, sizeof(description), 0);
+        callback(context, description);
+    }
+
+    hifRPN.IterateHeapEnd();
+}
+
+
+
+//------------------------------------------------------------------------
+// ***** Alignment helpers
+//
+// Alignments must be powers of two.
+//
+
+static size_t AlignSizeUp(size_t value, size_t alignment)
+{
+    return ((value + (alignment - 1)) & ~(alignment - 1));
+}
+
+static size_t AlignSizeDown(size_t value, size_t alignment)
+{
+    return (value & ~(alignment - 1));
+}
+
+template <typename Pointer>
+Pointer AlignPointerUp(Pointer p, size_t alignment)
+{
+    return reinterpret_cast<Pointer>(((reinterpret_cast<size_t>(p) + (alignment - 1)) & ~(alignment - 1)));
+}
+
+template <typename Pointer>
+Pointer AlignPointerDown(Pointer p, size_t alignment)
+{
+    return reinterpret_cast<Pointer>(reinterpret_cast<size_t>(p) & ~(alignment-1));
+}
+
+
+
+//------------------------------------------------------------------------
+// ***** DefaultHeap
+//
+
+bool DefaultHeap::Init()
+{
+    // Nothing to do.
+    return true;
+}
+
+void DefaultHeap::Shutdown()
+{
+    // Nothing to do.
+}
+
+
+void* DefaultHeap::Alloc(size_t size)
+{
+    void* p = malloc(size);
+
+    return p;
+}
+
+
+void* DefaultHeap::AllocAligned(size_t size, size_t align)
+{
+    #if defined(_MSC_VER)
+        void* p = _aligned_malloc(size, align);
+    #else
+        void* p = memalign(align, size);
+    #endif
+
+    return p;
+}
+
+
+size_t DefaultHeap::GetAllocSize(const void* p) const
+{
+    #if defined(_MSC_VER)
+        return _msize(const_cast<void*>(p));
+    #else
+        return malloc_usable_size(p);
+    #endif
+}
+
+
+size_t DefaultHeap::GetAllocSizeNoLock(const void* p) const
+{
+    #if defined(_MSC_VER)
+        OVR_UNUSED(p);
+        return SIZE_MAX; // _msize takes the CRT heap lock.
+    #else
+        return malloc_usable_size(const_cast<void*>(p));
+    #endif
+}
+
+
+size_t DefaultHeap::GetAllocAlignedSize(const void* p, size_t align) const
+{
+    #if defined(_MSC_VER)
+        return _aligned_msize(const_cast<void*>(p), align, 0);
+    #else
+        OVR_UNUSED(align);
+        return malloc_usable_size(p);
+    #endif
+}
+
+
+void DefaultHeap::Free(void *p)
+{
+    free(p);
+}
+
+void DefaultHeap::FreeAligned(void* p)
+{
+    #if defined(_MSC_VER)
+        _aligned_free(p);
+    #else
+        free(p); // No special function required.
+    #endif
+}
+
+
+void* DefaultHeap::Realloc(void* p, size_t newSize)
+{
+    void* newP = realloc(p, newSize);
+
+    return newP;
+}
+
+void* DefaultHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
+{
+    #if defined(_MSC_VER)
+        void* pNew = _aligned_realloc(p, newSize, newAlign);
+    #else
+        void* pNew = realloc(p, newSize); // We expect the implementation to know its alignment. There is no standard posix_memalign_realloc.
+    #endif
+
+    return pNew;
+}
+
+bool DefaultHeap::TryExpand(void* p, size_t newSize)
+{
+    #if defined(_MSC_VER)
+        return (_expand(p, newSize) != nullptr);
+    #else
+        // There is no standard way to grow a malloc block in place, but the block may already have room to spare.
+        return (malloc_usable_size(p) >= newSize);
+    #endif
+}
+
+
+
+//------------------------------------------------------------------------
+// ***** OSHeap
+//
+
+static std::atomic<uint64_t> OSHeapMappedCount(0);
+static std::atomic<uint64_t> OSHeapMappedBytes(0);
+static std::atomic<uint64_t> OSHeapExplicitHugePageBytes(0);
+static std::atomic<uint64_t> OSHeapTransparentHugePageBytes(0);
+static std::atomic<uint64_t> OSHeapNumaBoundBytes(0);
+static std::atomic<uint64_t> OSHeapExplicitFallbackCount(0);
+
+void OSHeap::GetHugePageStats(HugePageStats& stats)
+{
+    stats.MappedCount              = OSHeapMappedCount.load(std::memory_order_relaxed);
+    stats.MappedBytes              = OSHeapMappedBytes.load(std::memory_order_relaxed);
+    stats.ExplicitHugePageBytes    = OSHeapExplicitHugePageBytes.load(std::memory_order_relaxed);
+    stats.TransparentHugePageBytes = OSHeapTransparentHugePageBytes.load(std::memory_order_relaxed);
+    stats.NumaBoundBytes           = OSHeapNumaBoundBytes.load(std::memory_order_relaxed);
+    stats.ExplicitFallbackCount    = OSHeapExplicitFallbackCount.load(std::memory_order_relaxed);
+}
+
+#if defined(_WIN32)
+
+OSHeap::OSHeap(HugePageMode /*hugePageMode*/, size_t /*hugePageThreshold*/, bool /*bindToNumaNode*/)
+  : Heap(nullptr)
+{
+}
+
+OSHeap::~OSHeap()
+{
+    OSHeap::Shutdown();
+}
+
+bool OSHeap::Init()
+{
+    Heap = GetProcessHeap(); // This never fails.
+    return true;
+}
+
+void OSHeap::Shutdown()
+{
+    // Do not free this heap. Its lifetime is maintained by the OS.
+    Heap = nullptr;
+}
+
+void* OSHeap::Alloc(size_t size)
+{
+    return HeapAlloc(Heap, 0, size);
+}
+
+void* OSHeap::AllocAligned(size_t size, size_t /*align*/)
+{
+    // We need to solve this if we are to support aligned memory. We'll need to allocate exta memory up front, return an internal pointer, and store info to find the base pointer.
+    OVR_FAIL_M("OSHeap::AllocAligned not yet supported.");
+    return HeapAlloc(Heap, 0, size);
+}
+
+size_t OSHeap::GetAllocSize(const void* p) const
+{
+    return HeapSize(Heap, 0, p);
+}
+
+size_t OSHeap::GetAllocSizeNoLock(const void* /*p*/) const
+{
+    return SIZE_MAX; // HeapSize takes the heap lock.
+}
+
+size_t OSHeap::GetAllocAlignedSize(const void* p, size_t /*align*/) const
+{
+    // We need to solve this if we are to support aligned memory.
+    OVR_FAIL_M("OSHeap::AllocAligned not yet supported.");
+    return HeapSize(Heap, 0, p);
+}
+
+void OSHeap::Free(void* p)
+{
+    BOOL result = HeapFree(Heap, 0, p);
+    OVR_ASSERT_AND_UNUSED(result, result);
+}
+
+void OSHeap::FreeAligned(void* p)
+{
+    OVR_FAIL_M("OSHeap::AllocAligned not yet supported.");
+    BOOL result = HeapFree(Heap, 0, p);
+    OVR_ASSERT_AND_UNUSED(result, result);
+}
+
+void* OSHeap::Realloc(void* p, size_t newSize)
+{
+    return HeapReAlloc(Heap, 0, p, newSize);
+}
+
+void* OSHeap::ReallocAligned(void* p, size_t newSize, size_t /*newAlign*/)
+{
+    // We need to solve this if we are to support aligned memory.
+    return HeapReAlloc(Heap, 0, p, newSize);
+}
+
+bool OSHeap::TryExpand(void* p, size_t newSize)
+{
+    return (HeapReAlloc(Heap, HEAP_REALLOC_IN_PLACE_ONLY, p, newSize) != nullptr);
+}
+
+#else // POSIX
+
+OSHeap::OSHeap(HugePageMode hugePageMode, size_t hugePageThreshold, bool bindToNumaNode)
+  : HugePages(hugePageMode)
+  , HugePageThreshold(hugePageThreshold)
+  , BindToNumaNode(bindToNumaNode)
+  , PageSize(4096)
+  , HugePageSize(2 * 1024 * 1024)
+{
+    static_assert((sizeof(BlockHeader) == 16), "BlockHeader is expected to preserve 16 byte alignment.");
+}
+
+OSHeap::~OSHeap()
+{
+    OSHeap::Shutdown();
+}
+
+bool OSHeap::Init()
+{
+    PageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+    #if defined(__linux__)
+        // The default huge page size is reported by /proc/meminfo as e.g. "Hugepagesize:    2048 kB".
+        // We read it with plain file I/O, as we can't allocate memory while initializing the heap.
+        int fd = open("/proc/meminfo", O_RDONLY);
+
+        if (fd >= 0)
+        {
+            char    buffer[8192];
+            ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+            close(fd);
+
+            if (length > 0)
+            {
+                buffer[length] = '\0';
+
+                const char*   field = strstr(buffer, "Hugepagesize:");
+                unsigned long sizeKB = 0;
+
+                if (field && (sscanf(field, "Hugepagesize: %lu kB", &sizeKB) == 1) && sizeKB)
+                    HugePageSize = ((size_t)sizeKB * 1024);
+            }
+        }
+    #endif
+
+    return true;
+}
+
+void OSHeap::Shutdown()
+{
+    // Nothing to do. Blocks are individually freed.
+}
+
+void* OSHeap::Alloc(size_t size)
+{
+    return AllocAligned(size, 0);
+}
+
+void* OSHeap::AllocAligned(size_t size, size_t align)
+{
+    if ((size >= HugePageThreshold) && (align <= MaxMappedAlignment))
     {
-        newSize *= count;
+        void* p = AllocMapped(size, align);
+
+        if (p)
+            return p;
+        // Else fall back to malloc.
+    }
+
+    // The header is immediately before the returned pointer. Its size preserves malloc's alignment,
+    // and for larger alignments we put align bytes in front of the pointer.
+    const size_t offset = ((align > sizeof(BlockHeader)) ? align : sizeof(BlockHeader));
+    void*        base = nullptr;
+
+    if (align <= sizeof(void*))
+        base = malloc(offset + size);
+    else if (posix_memalign(&base, align, offset + size) != 0)
+        base = nullptr;
+
+    if (!base)
+        return nullptr;
+
+    void*        p = (static_cast<char*>(base) + offset);
+    BlockHeader* header = GetHeader(p);
+
+    header->Size   = size;
+    header->Offset = (uint32_t)offset;
+    header->Flags  = 0;
+
+    return p;
+}
+
+size_t OSHeap::GetAllocSize(const void* p) const
+{
+    return (size_t)GetHeader(p)->Size;
+}
+
+size_t OSHeap::GetAllocSizeNoLock(const void* p) const
+{
+    return (size_t)GetHeader(p)->Size;
+}
+
+size_t OSHeap::GetAllocAlignedSize(const void* p, size_t /*align*/) const
+{
+    return (size_t)GetHeader(p)->Size;
+}
+
+void OSHeap::Free(void* p)
+{
+    if (p)
+    {
+        BlockHeader* header = GetHeader(p);
+
+        if (header->Flags & BlockMapped)
+            FreeMapped(header);
+        else
+            free(static_cast<char*>(p) - header->Offset);
+    }
+}
+
+void OSHeap::FreeAligned(void* p)
+{
+    Free(p);
+}
+
+void* OSHeap::Realloc(void* p, size_t newSize)
+{
+    return ReallocAligned(p, newSize, 0);
+}
+
+void* OSHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
+{
+    if (!p)
+        return AllocAligned(newSize, newAlign);
+
+    if (!newSize)
+    {
+        Free(p);
+        return nullptr;
+    }
+
+    BlockHeader* header = GetHeader(p);
+
+    if (!(header->Flags & BlockMapped) && (header->Offset == sizeof(BlockHeader)) && (newAlign <= sizeof(void*)) && (newSize < HugePageThreshold))
+    {
+        // A plain malloc block which stays one.
+        void* base = realloc(static_cast<char*>(p) - sizeof(BlockHeader), sizeof(BlockHeader) + newSize);
 
-        size_t oldSize;
-        bool valid = IsAllocTracked(p);
+        if (!base)
+            return nullptr;
 
-        if (valid)
-        {
-            oldSize = GetAllocSize(p);
-        }
-        else if (MallocRedirect)
-        {
-            #if OVR_DEBUG_CRT_PRESENT
-                oldSize = header_from_block(p)->data_size; // We have to read internal debug data.
-            #else
-                oldSize = HeapSize(GetCRTHeapHandle(), 0, p);
-            #endif
-        }
-        else
-        {
-            // So which heap does this allocation come from?
-            oldSize = _msize(p);
-        }
+        p = (static_cast<char*>(base) + sizeof(BlockHeader));
+        GetHeader(p)->Size = newSize;
 
-        pNew = ReallocDebug(p, newSize, file, line);
+        return p;
+    }
 
-        if (pNew && (newSize > oldSize))
-        {
-            memset(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pNew) + oldSize), 0, (newSize - oldSize));
-        }
+    if ((header->Flags & BlockMapped) && (newSize >= HugePageThreshold) && (((uintptr_t)p % (newAlign ? newAlign : 1)) == 0))
+    {
+        // A moved mapping is only page aligned, but the user pointer keeps its offset within it.
+        void* pNew = ResizeMapped(p, newSize, (newAlign <= PageSize));
+
+        if (pNew)
+            return pNew;
+    }
+
+    void* pNew = AllocAligned(newSize, newAlign);
+
+    if (pNew)
+    {
+        memcpy(pNew, p, std::min((size_t)header->Size, newSize));
+        Free(p);
     }
 
     return pNew;
 }
 
-
-void* Allocator::ReallocAlignedDebug(void* p, size_t newSize, size_t newAlign, const char* file, unsigned line)
+bool OSHeap::TryExpand(void* p, size_t newSize)
 {
-    OVR_ALLOC_BENCHMARK_START();
+    BlockHeader* header = GetHeader(p);
 
-    AllocMetadata metadata;
-    bool valid = true; // realloc allows you to reallocate NULL, so set this to true by default.
-    void* pNew = nullptr;
+    if (header->Flags & BlockMapped)
+        return (ResizeMapped(p, newSize, false) != nullptr);
 
-    if (p)
+    // The malloc block may already have room to spare.
+    if ((header->Offset + newSize) <= malloc_usable_size(static_cast<char*>(p) - header->Offset))
     {
-        GetAllocMetadata(p, metadata);
-        valid = UntrackAlloc(p); // valid will be true if p is NULL, which is what we want.
+        header->Size = newSize;
+        return true;
     }
 
-    if (valid)
-    {
-        pNew = Heap->ReallocAligned(p, newSize, newAlign);
+    return false;
+}
 
-        if (pNew)
+void* OSHeap::ResizeMapped(void* p, size_t newSize, bool allowMove)
+{
+    BlockHeader*   header = GetHeader(p);
+    const size_t   oldSize = (size_t)header->Size;
+    const size_t   oldMappingSize = GetMappingSize(header);
+    const uint32_t offset = header->Offset;
+    const uint32_t flags = header->Flags;
+
+    header->Size = newSize;
+
+    const size_t newMappingSize = GetMappingSize(header);
+
+    if (newMappingSize == oldMappingSize) // If it needs no more or fewer pages...
+        return p;
+
+    header->Size = oldSize;
+
+    #if defined(__linux__) && defined(MREMAP_MAYMOVE)
+        // mremap of MAP_HUGETLB mappings isn't supported by older kernels, so we leave those alone.
+        // Moving a mapping moves its page table entries rather than copying its contents, and it 
+        // keeps its NUMA policy and huge page advice.
+        if (!(flags & BlockExplicitHuge))
         {
-            TrackAlloc(pNew, newSize, metadata.Tag, file, line);
+            void* base = (static_cast<char*>(p) - offset);
+            void* newBase = mremap(base, oldMappingSize, newMappingSize, (allowMove ? MREMAP_MAYMOVE : 0));
+
+            if (newBase != MAP_FAILED)
+            {
+                p = (static_cast<char*>(newBase) + offset);
+                GetHeader(p)->Size = newSize;
+
+                auto adjust = [oldMappingSize, newMappingSize](std::atomic<uint64_t>& counter) {
+                    if (newMappingSize > oldMappingSize)
+                        counter += (newMappingSize - oldMappingSize);
+                    else
+                        counter -= (oldMappingSize - newMappingSize);
+                };
+
+                adjust(OSHeapMappedBytes);
+                if (flags & BlockTransparentHuge)
+                    adjust(OSHeapTransparentHugePageBytes);
+                if (flags & BlockNumaBound)
+                    adjust(OSHeapNumaBoundBytes);
+
+                return p;
+            }
         }
+    #else
+        OVR_UNUSED3(offset, flags, allowMove);
+    #endif
 
-        return pNew;
-    }
-    else if (MallocRedirect) // Else this must go to the CRT heap. It was likely malloc'd before we existed.
+    return nullptr;
+}
+
+size_t OSHeap::GetMappingSize(const BlockHeader* header) const
+{
+    return AlignSizeUp(header->Offset + (size_t)header->Size, ((header->Flags & BlockExplicitHuge) ? HugePageSize : PageSize));
+}
+
+void* OSHeap::AllocMapped(size_t size, size_t align)
+{
+    const size_t offset = ((align > 64) ? align : 64); // Keep the returned pointer cache line aligned, as these are big buffers.
+    uint32_t     flags = BlockMapped;
+    void*        base = MAP_FAILED;
+    size_t       mappingSize = 0;
+
+    #if defined(__linux__) && defined(MAP_HUGETLB)
+        if (HugePages == HugePagesExplicit)
+        {
+            // This fails unless the system has huge pages reserved (e.g. via /proc/sys/vm/nr_hugepages).
+            mappingSize = AlignSizeUp(offset + size, HugePageSize);
+            base = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+            if (base != MAP_FAILED)
+                flags |= BlockExplicitHuge;
+            else
+                OSHeapExplicitFallbackCount++;
+        }
+    #endif
+
+    if (base == MAP_FAILED)
     {
-        #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900)
-            // To do. This function in practice is not used by the CRT and so is not very important to us, especially as this is debug-build only.
-            OVR_FAIL_M("Allocator::ReallocAlignedDebug not implemented yet."); 
-        #else
-            pNew = _aligned_realloc_base(p, newSize, newAlign);
+        mappingSize = AlignSizeUp(offset + size, PageSize);
+
+        #if defined(__linux__) && defined(MADV_HUGEPAGE)
+            if (HugePages != HugePagesNone)
+            {
+                // The kernel can back only huge page aligned ranges with transparent huge pages, so we map
+                // an extra huge page and trim the mapping to start at an aligned address.
+                void* mapping = mmap(nullptr, mappingSize + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+                if (mapping != MAP_FAILED)
+                {
+                    char*  alignedMapping = AlignPointerUp(static_cast<char*>(mapping), HugePageSize);
+                    size_t headSize = (size_t)(alignedMapping - static_cast<char*>(mapping));
+                    size_t tailSize = (HugePageSize - headSize);
+
+                    if (headSize)
+                        munmap(mapping, headSize);
+                    if (tailSize)
+                        munmap(alignedMapping + mappingSize, tailSize);
+
+                    base = alignedMapping;
+
+                    if (madvise(base, mappingSize, MADV_HUGEPAGE) == 0)
+                        flags |= BlockTransparentHuge;
+                }
+            }
+            else
         #endif
+            {
+                base = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            }
     }
-    else
+
+    if (base == MAP_FAILED)
+        return nullptr;
+
+    #if defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu)
+        if (BindToNumaNode)
+        {
+            // This must be done before the pages are first touched (by our header write below).
+            // We use MPOL_PREFERRED rather than MPOL_BIND so that we get memory from another node
+            // instead of failing if this node runs out. We use the syscalls directly because
+            // <numaif.h> is part of libnuma, which may not be installed.
+            unsigned cpu = 0, node = 0;
+
+            if ((syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) && (node < 63))
+            {
+                const int           mpolPreferred = 1;      // MPOL_PREFERRED
+                const unsigned long nodeMask = (1UL << node);
+
+                if (syscall(SYS_mbind, base, mappingSize, mpolPreferred, &nodeMask, (sizeof(nodeMask) * 8) + 1, 0) == 0) // +1 because the kernel ignores the last bit.
+                    flags |= BlockNumaBound;
+            }
+        }
+    #endif
+
+    void*        p = (static_cast<char*>(base) + offset);
+    BlockHeader* header = GetHeader(p);
+
+    header->Size   = size;
+    header->Offset = (uint32_t)offset;
+    header->Flags  = flags;
+
+    OSHeapMappedCount++;
+    OSHeapMappedBytes += mappingSize;
+    if (flags & BlockExplicitHuge)
+        OSHeapExplicitHugePageBytes += mappingSize;
+    if (flags & BlockTransparentHuge)
+        OSHeapTransparentHugePageBytes += mappingSize;
+    if (flags & BlockNumaBound)
+        OSHeapNumaBoundBytes += mappingSize;
+
+    OVR_ASSERT(GetMappingSize(header) == mappingSize);
+
+    return p;
+}
+
+void OSHeap::FreeMapped(BlockHeader* header)
+{
+    const size_t mappingSize = GetMappingSize(header);
+    const uint32_t flags = header->Flags;
+    void* base = (reinterpret_cast<char*>(header + 1) - header->Offset);
+
+    OSHeapMappedCount--;
+    OSHeapMappedBytes -= mappingSize;
+    if (flags & BlockExplicitHuge)
+        OSHeapExplicitHugePageBytes -= mappingSize;
+    if (flags & BlockTransparentHuge)
+        OSHeapTransparentHugePageBytes -= mappingSize;
+    if (flags & BlockNumaBound)
+        OSHeapNumaBoundBytes -= mappingSize;
+
+    munmap(base, mappingSize);
+}
+
+#endif // POSIX
+
+
+
+//------------------------------------------------------------------------
+// ***** ThreadCachingHeap
+//
+
+#if defined(OVR_THREAD_LOCAL)
+    // OVR_THREAD_LOCAL supports only POD types, so we store the ThreadCache as a void*.
+    struct ThreadCachingHeapTLS
     {
-        pNew = _aligned_realloc(p, newSize, newAlign);
-    }
+        void*    Cache;         // ThreadCachingHeap::ThreadCache* of the calling thread.
+        uint64_t InstanceId;    // ThreadCachingHeap::InstanceId of the heap which owns Cache.
+    };
 
-    OVR_ALLOC_BENCHMARK_END();
+    static OVR_THREAD_LOCAL ThreadCachingHeapTLS CurrentThreadCache;
+#endif
 
-    return pNew;
+static std::atomic<uint64_t> ThreadCachingHeapInstanceCounter(0);
+
+// The alignment of blocks from the wrapped heap's Alloc. Both DefaultHeap and OSHeap align like
+// malloc, which on Windows is MEMORY_ALLOCATION_ALIGNMENT: 8 bytes on 32 bit and 16 on 64 bit.
+#if defined(_WIN32)
+    static const size_t ThreadCachingHeapWrappedAlignment = MEMORY_ALLOCATION_ALIGNMENT;
+#else
+    static const size_t ThreadCachingHeapWrappedAlignment = alignof(std::max_align_t);
+#endif
+
+
+ThreadCachingHeap::ThreadCachingHeap(Heap* wrappedHeap, size_t wrappedHeapSize)
+  : WrappedHeap(wrappedHeap)
+  , WrappedHeapSize(wrappedHeapSize)
+  , InstanceId(0)
+  , CentralLock()
+  , Central()
+  , ThreadCacheList(nullptr)
+{
 }
 
+ThreadCachingHeap::~ThreadCachingHeap()
+{
+    ThreadCachingHeap::Shutdown();
+}
 
-void* Allocator::RecallocAlignedDebug(void* p, size_t count, size_t newSize, size_t newAlign, const char* file, unsigned line)
+bool ThreadCachingHeap::Init()
 {
-    void* pNew = nullptr;
+    InstanceId = ++ThreadCachingHeapInstanceCounter; // Never 0, so a zeroed ThreadCachingHeapTLS never matches.
+    return (WrappedHeap != nullptr);
+}
 
-    if (!OVR::Alg::UnsignedMultiplyWouldOverflow(count, newSize))
+void ThreadCachingHeap::Shutdown()
+{
+    if (WrappedHeap) // If not already shut down...
     {
-        newSize *= count;
+        {
+            Lock::Locker locker(&CentralLock);
 
-        size_t oldSize;
-        bool valid = IsAllocTracked(p);
+            // Other threads may still refer to their ThreadCache from thread-local storage.
+            // Clearing InstanceId makes them ignore it, though they shouldn't be using us at this point.
+            InstanceId = 0;
 
-        if (valid)
-        {
-            oldSize = GetAllocAlignedSize(p, newAlign); // We really want the original alignment, not the new alignment.
+            for (ThreadCache* cache = ThreadCacheList; cache; )
+            {
+                ThreadCache* next = cache->Next;
+
+                for (size_t i = 0; i < SizeClassCount; ++i)
+                    FreeBlockList(cache->FreeList[i]);
+
+                SafeMMapFree(cache, sizeof(ThreadCache));
+                cache = next;
+            }
+            ThreadCacheList = nullptr;
+
+            for (size_t i = 0; i < SizeClassCount; ++i)
+            {
+                FreeBlockList(Central[i].FreeList);
+                Central[i].FreeList = nullptr;
+                Central[i].FreeCount = 0;
+            }
         }
-        else if (MallocRedirect)
+
+        WrappedHeap->Shutdown();
+        WrappedHeap->~Heap();
+        SysMemFree(WrappedHeap, WrappedHeapSize);
+        WrappedHeap = nullptr;
+    }
+}
+
+ThreadCachingHeap::ThreadCache* ThreadCachingHeap::GetThreadCache()
+{
+    #if defined(OVR_THREAD_LOCAL)
+        if (CurrentThreadCache.Cache && (CurrentThreadCache.InstanceId == InstanceId))
+            return static_cast<ThreadCache*>(CurrentThreadCache.Cache);
+
+        // Slow path: This is the first use of this heap by the calling thread, or the thread
+        // has since used another ThreadCachingHeap (in which case it already has a cache here).
+        uint32_t threadId = GetThreadId();
+        ThreadCache* cache = nullptr;
+
         {
-            #if OVR_DEBUG_CRT_PRESENT
-                oldSize = header_from_block(p)->data_size; // We have to read internal debug data.
-            #else
-                oldSize = HeapSize(GetCRTHeapHandle(), 0, p);
-            #endif
+            Lock::Locker locker(&CentralLock);
+            size_t cacheCount = 0;
+
+            for (cache = ThreadCacheList; cache && (cache->ThreadId != threadId); cache = cache->Next, ++cacheCount)
+                { }
+
+            // We have no thread exit notification, so instead we take over the cache of an exited
+            // thread, along with the blocks in it. Otherwise every thread that comes and goes would
+            // leave a full cache behind. Checking thread liveness is slow, so we do it only once we
+            // have several caches.
+            if (!cache && (cacheCount >= ThreadCacheReuseThreshold))
+            {
+                for (cache = ThreadCacheList; cache && ThreadIdIsValid(cache->ThreadId); cache = cache->Next)
+                    { }
+
+                if (cache)
+                    cache->ThreadId = threadId;
+            }
+
+            if (!cache)
+            {
+                cache = static_cast<ThreadCache*>(SafeMMapAlloc(sizeof(ThreadCache))); // Returned memory is 0-filled.
+
+                if (cache)
+                {
+                    cache->ThreadId = threadId;
+                    cache->Next = ThreadCacheList;
+                    ThreadCacheList = cache;
+                }
+            }
         }
-        else
+
+        if (cache)
         {
-            // So which heap does this allocation come from?
-            oldSize = _aligned_msize(p, newAlign, 0); // We really want the original alignment, not the new alignment.
+            CurrentThreadCache.Cache = cache;
+            CurrentThreadCache.InstanceId = InstanceId;
         }
 
-        pNew = ReallocAlignedDebug(p, newSize, newAlign, file, line);
+        return cache;
+    #else
+        return nullptr; // Everything goes through the central pool.
+    #endif
+}
 
-        if (pNew && (newSize > oldSize))
+void* ThreadCachingHeap::Alloc(size_t size)
+{
+    if (size > MaxCachedSize)
+        return AllocLarge(size, 0);
+
+    size_t       sizeClass = (size ? ((size - 1) / SizeClassGranularity) : 0);
+    ThreadCache* cache = GetThreadCache();
+
+    if (cache)
+    {
+        if (!cache->FreeList[sizeClass])
+            RefillFromCentral(cache, sizeClass);
+
+        FreeBlock* block = cache->FreeList[sizeClass];
+
+        if (block)
         {
-            memset(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pNew) + oldSize), 0, (newSize - oldSize));
+            cache->FreeList[sizeClass] = block->Next;
+            if (--cache->FreeCount[sizeClass] < cache->LowFreeCount[sizeClass])
+                cache->LowFreeCount[sizeClass] = cache->FreeCount[sizeClass];
+
+            if (++cache->OperationCount >= RebalanceInterval)
+                Rebalance(cache);
+
+            return block;
+        }
+    }
+    else
+    {
+        Lock::Locker locker(&CentralLock);
+        FreeBlock* block = Central[sizeClass].FreeList;
+
+        if (block)
+        {
+            Central[sizeClass].FreeList = block->Next;
+            Central[sizeClass].FreeCount--;
+            return block;
         }
     }
 
-    return pNew;
+    // Nothing cached, so get a new block from the wrapped heap.
+    size_t blockSize = ((sizeClass + 1) * SizeClassGranularity);
+    BlockHeader* header = static_cast<BlockHeader*>(WrappedHeap->Alloc(sizeof(BlockHeader) + blockSize));
+
+    if (!header)
+        return nullptr;
+
+    header->SizeClass = (uint16_t)sizeClass;
+    header->Magic     = HeaderMagic;
+    header->Offset    = 0;
+    header->Size      = blockSize;
+
+    return (header + 1);
 }
 
+void* ThreadCachingHeap::AllocAligned(size_t size, size_t align)
+{
+    // User pointers are the wrapped heap's block plus our header, so they are aligned to the
+    // smaller of the two. Anything stricter needs an over-aligned block.
+    if (align <= std::min(ThreadCachingHeapWrappedAlignment, sizeof(BlockHeader)))
+        return Alloc(size);
 
-uint64_t Allocator::GetCurrentHeapTimeNs()
+    return AllocLarge(size, align);
+}
+
+void* ThreadCachingHeap::AllocLarge(size_t size, size_t align)
 {
-    #if defined(_WIN32)
-        LARGE_INTEGER tickCount;
-        ::QueryPerformanceCounter(&tickCount);
+    // We allocate over-aligned blocks with plain Alloc from the wrapped heap and align within them,
+    // as not every wrapped heap supports AllocAligned (e.g. OSHeap).
+    char* base = static_cast<char*>(WrappedHeap->Alloc(sizeof(BlockHeader) + size + align));
 
-        LARGE_INTEGER qpfFrequency;
-        ::QueryPerformanceFrequency(&qpfFrequency); // To do: Move this to a single call on startup.
+    if (!base)
+        return nullptr;
 
-        return (uint64_t)((tickCount.QuadPart * UINT64_C(1000000000)) / qpfFrequency.QuadPart) - ReferenceHeapTimeNs;
-    #else
-        return (uint64_t)(time(NULL) * UINT64_C(1000000000)) - ReferenceHeapTimeNs; // Crude value. Should improve this.
-    #endif
-}
+    char* user = (base + sizeof(BlockHeader));
 
+    if (align)
+        user = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(user) + (align - 1)) & ~(uintptr_t)(align - 1));
 
-static uint32_t GetThreadId()
+    BlockHeader* header = GetHeader(user);
+    header->SizeClass = LargeSizeClass;
+    header->Magic     = HeaderMagic;
+    header->Offset    = (uint32_t)(reinterpret_cast<char*>(header) - base);
+    header->Size      = size;
+
+    return user;
+}
+
+size_t ThreadCachingHeap::GetAllocSize(const void* p) const
 {
-    #if defined(_WIN32)
-        return ::GetCurrentThreadId();
-    #else
-        return pthread_self();
-    #endif
+    return (size_t)GetHeader(p)->Size;
 }
 
+size_t ThreadCachingHeap::GetAllocAlignedSize(const void* p, size_t /*align*/) const
+{
+    return (size_t)GetHeader(p)->Size;
+}
 
-static bool ThreadIdIsValid(uint32_t threadId)
+void ThreadCachingHeap::Free(void* p)
 {
-    #if defined(_WIN32)
-        bool result = false;
-        HANDLE h = ::OpenThread(THREAD_QUERY_LIMITED_INFORMATION, TRUE, threadId);
+    if (!p)
+        return;
 
-        if (h)
-        {
-            DWORD exitCode;
-            BOOL  bResult = ::GetExitCodeThread(h, &exitCode);
-            result = ((bResult != FALSE) && (exitCode != STILL_ACTIVE));
-            ::CloseHandle(h);
-        }
+    BlockHeader* header = GetHeader(p);
+    OVR_ASSERT(header->Magic == HeaderMagic);
 
-        return result;
-    #else
-        return true;
-    #endif
+    if (header->SizeClass == LargeSizeClass)
+    {
+        FreeLarge(header);
+        return;
+    }
+
+    size_t       sizeClass = header->SizeClass;
+    FreeBlock*   block = static_cast<FreeBlock*>(p);
+    ThreadCache* cache = GetThreadCache();
+
+    if (cache)
+    {
+        block->Next = cache->FreeList[sizeClass];
+        cache->FreeList[sizeClass] = block;
+
+        if (++cache->FreeCount[sizeClass] > MaxThreadBlockCount)
+            TrimThreadCache(cache, sizeClass, (MaxThreadBlockCount / 2));
+
+        if (++cache->OperationCount >= RebalanceInterval)
+            Rebalance(cache);
+    }
+    else
+    {
+        block->Next = nullptr;
+        ReleaseToCentral(sizeClass, block, block, 1);
+    }
 }
 
+void ThreadCachingHeap::FreeAligned(void* p)
+{
+    Free(p); // The header tells us how the block was allocated.
+}
 
-void Allocator::PushTag(const char* tag)
+void ThreadCachingHeap::FreeLarge(BlockHeader* header)
 {
-    uint32_t threadId = GetThreadId();
+    WrappedHeap->Free(reinterpret_cast<char*>(header) - header->Offset);
+}
 
-    Lock::Locker locker(&TagMapLock);
+void* ThreadCachingHeap::Realloc(void* p, size_t newSize)
+{
+    if (!p)
+        return Alloc(newSize);
 
-    TagMap[threadId].push_back(tag);
+    BlockHeader* header = GetHeader(p);
+    OVR_ASSERT(header->Magic == HeaderMagic);
 
-    if(TagMap.size() > 128) // This is some number that should be more than the number of unique threads we ever have.
-        PurgeTagMap();
-}
+    if (header->SizeClass != LargeSizeClass)
+    {
+        if (newSize <= header->Size) // If it still fits in the size class...
+            return p;
+    }
+    else if ((header->Offset == 0) && (newSize > MaxCachedSize)) // If it's a regular large block which stays large, let the wrapped heap resize it.
+    {
+        header = static_cast<BlockHeader*>(WrappedHeap->Realloc(header, sizeof(BlockHeader) + newSize));
 
-void Allocator::PopTag()
-{
-    uint32_t threadId = GetThreadId();
+        if (!header)
+            return nullptr;
 
-    Lock::Locker locker(&TagMapLock);
+        header->Size = newSize;
+        return (header + 1);
+    }
 
-    // We do some error checking to make sure we don't crash if this facility is mis-used.
-    ThreadIdToTagVectorMap::iterator it = TagMap.find(threadId);
+    void* pNew = Alloc(newSize);
 
-    if (it != TagMap.end())
+    if (pNew)
     {
-        if (!it->second.empty())
-            it->second.pop_back();
+        memcpy(pNew, p, std::min((size_t)header->Size, newSize));
+        Free(p);
     }
+
+    return pNew;
 }
 
-const char* Allocator::GetTag(const char* defaultTag)
+bool ThreadCachingHeap::TryExpand(void* p, size_t newSize)
 {
-    Lock::Locker locker(&TagMapLock);
+    BlockHeader* header = GetHeader(p);
+    OVR_ASSERT(header->Magic == HeaderMagic);
 
-    uint32_t threadId = GetThreadId();
-    ThreadIdToTagVectorMap::const_iterator it = TagMap.find(threadId);
+    if (header->SizeClass != LargeSizeClass)
+        return (newSize <= header->Size); // Small blocks can't leave their size class.
 
-    if (it != TagMap.end())
+    if ((header->Offset == 0) && WrappedHeap->TryExpand(header, sizeof(BlockHeader) + newSize))
     {
-        if (!it->second.empty())
-            return it->second.back();
+        header->Size = newSize;
+        return true;
     }
 
-    if (defaultTag)
-        return defaultTag;
-
-    return OVR_ALLOCATOR_UNSPECIFIED_TAG;
+    return false;
 }
 
-void Allocator::PurgeTagMap()
+void* ThreadCachingHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
 {
-    Lock::Locker locker(&TagMapLock);
-
-    for(ThreadIdToTagVectorMap::iterator it = TagMap.begin(); it != TagMap.end(); )
-    {
-        uint32_t threadId = it->first;
+    // See AllocAligned. Realloc only guarantees the alignment of a regular block.
+    if (newAlign <= std::min(ThreadCachingHeapWrappedAlignment, sizeof(BlockHeader)))
+        return Realloc(p, newSize);
 
-        if(!ThreadIdIsValid(threadId))
-            it = TagMap.erase(it);
-        else
-            ++it;
-    }
-}
+    if (!p)
+        return AllocLarge(newSize, newAlign);
 
+    BlockHeader* header = GetHeader(p);
+    OVR_ASSERT(header->Magic == HeaderMagic);
 
-void Allocator::SetNewBlockMetadata(Allocator* allocator, AllocMetadata& amd, const void* alloc, uint64_t allocSize, uint64_t blockSize, 
-                                const char* file, int line, const char* tag, void** backtraceArray, size_t backtraceArraySize)
-{
-    amd.Alloc = alloc;
-    amd.Backtrace.assign(backtraceArray, backtraceArray + backtraceArraySize);
-    amd.BacktraceSymbols.clear(); // This is only set when needed.
-    amd.File = file;
-    amd.Line = line;
-    amd.TimeNs = Allocator::GetCurrentHeapTimeNs();
-    amd.Count = allocator->GetAndUpdateCounter();
-    amd.AllocSize = allocSize;
-    amd.BlockSize = blockSize;
-    amd.Tag = tag;
-    amd.ThreadId = GetThreadId();
-    OVR::Thread::GetCurrentThreadName(amd.ThreadName, sizeof(amd.ThreadName)); // Currently works on Windows only for threads that were named via our OVR thread naming API.
-}
+    if ((newSize <= header->Size) && ((reinterpret_cast<uintptr_t>(p) & (newAlign - 1)) == 0))
+        return p;
 
+    void* pNew = AllocLarge(newSize, newAlign);
 
-void Allocator::TrackAlloc(const void* p, size_t size, const char* tag, const char* file, int line)
-{
-    if (p && TrackingEnabled) // To consider: Make TrackingEnabled an atomic.
+    if (pNew)
     {
-        auto AlignSizeUp = [](size_t value, size_t alignment) -> size_t { // To do: Have a centralized version of this.
-            return ((value + (alignment - 1)) & ~(alignment - 1));
-        };
+        memcpy(pNew, p, std::min((size_t)header->Size, newSize));
+        Free(p);
+    }
 
-        TrackedAllocMap::value_type value(p, AllocMetadata());
+    return pNew;
+}
 
-        #if defined(_WIN64)
-            void* addressArray[128];
-            size_t frameCount = Symbols.GetBacktrace(addressArray, OVR_ARRAY_COUNT(addressArray), 2);
-        #else
-            // Currently 32 bit backtrace reading is too slow. We can fix it by writing our own version
-            // that reads the stack frames, but it's not a high priority since we work mostly with 64 bit.
-            void* addressArray[1] = { nullptr };
-            size_t frameCount = 0;
-        #endif
+size_t ThreadCachingHeap::GetThreadCacheCount() const
+{
+    Lock::Locker locker(&CentralLock);
+    size_t count = 0;
 
-        if (!tag)
-            tag = GetTag();
+    for (const ThreadCache* cache = ThreadCacheList; cache; cache = cache->Next)
+        ++count;
 
-        SetNewBlockMetadata(this, value.second, p, size, 
-                            AlignSizeUp(size, 8),       // This is only a default value, and may be under-represented at time time, until we can have that passed into this function as well.
-                            file, line, tag, addressArray, frameCount);
+    return count;
+}
 
-        Lock::Locker locker(&TrackLock);
+void ThreadCachingHeap::FlushThreadCache()
+{
+    ThreadCache* cache = GetThreadCache();
 
-        if (TrackingEnabled) // To consider: Do we really need to do this?
+    if (cache)
+    {
+        for (size_t i = 0; i < SizeClassCount; ++i)
         {
-            AllocationMap.insert(value);
+            if (cache->FreeCount[i])
+                TrimThreadCache(cache, i, cache->FreeCount[i]);
         }
     }
 }
 
+void ThreadCachingHeap::TrimThreadCache(ThreadCache* cache, size_t sizeClass, uint32_t count)
+{
+    OVR_ASSERT(count && (count <= cache->FreeCount[sizeClass]));
+
+    FreeBlock* first = cache->FreeList[sizeClass];
+    FreeBlock* last = first;
 
-bool Allocator::UntrackAlloc(const void* p)
+    for (uint32_t i = 1; i < count; ++i)
+        last = last->Next;
+
+    cache->FreeList[sizeClass] = last->Next;
+    cache->FreeCount[sizeClass] -= count;
+    if (cache->LowFreeCount[sizeClass] > cache->FreeCount[sizeClass])
+        cache->LowFreeCount[sizeClass] = cache->FreeCount[sizeClass];
+
+    last->Next = nullptr;
+    ReleaseToCentral(sizeClass, first, last, count);
+}
+
+void ThreadCachingHeap::ReleaseToCentral(size_t sizeClass, FreeBlock* first, FreeBlock* last, uint32_t count)
 {
-    if (!TrackingEnabled)
-        return true; // Just assume the pointer is valid.
+    FreeBlock* excess = nullptr;
 
-    if (p)
     {
-        Lock::Locker locker(&TrackLock);
-
-        TrackedAllocMap::iterator it = AllocationMap.find(p);
+        Lock::Locker locker(&CentralLock);
+        CentralPool& pool = Central[sizeClass];
 
-        if(it != AllocationMap.end())
+        if ((pool.FreeCount + count) <= MaxCentralBlockCount)
         {
-            AllocationMap.erase(it);
-            return true;
+            last->Next = pool.FreeList;
+            pool.FreeList = first;
+            pool.FreeCount += count;
         }
+        else
+            excess = first;
     }
 
-    return false;
+    // The central pool is full, so these go back to the wrapped heap. We do that outside the lock.
+    FreeBlockList(excess);
 }
 
-
-bool Allocator::IsAllocTracked(const void* p)
+void ThreadCachingHeap::RefillFromCentral(ThreadCache* cache, size_t sizeClass)
 {
-    if (!TrackingEnabled)
-        return true; // Just assume the pointer is valid.
+    Lock::Locker locker(&CentralLock);
+    CentralPool& pool = Central[sizeClass];
 
-    if (p)
+    for (uint32_t i = 0; pool.FreeList && (i < (MaxThreadBlockCount / 2)); ++i)
     {
-        Lock::Locker locker(&TrackLock);
+        FreeBlock* block = pool.FreeList;
+        pool.FreeList = block->Next;
+        pool.FreeCount--;
 
-        return (AllocationMap.find(p) != AllocationMap.end());
+        block->Next = cache->FreeList[sizeClass];
+        cache->FreeList[sizeClass] = block;
+        cache->FreeCount[sizeClass]++;
     }
-
-    return false;
 }
 
-
-bool Allocator::GetAllocMetadata(const void* p, AllocMetadata& metadata)
+void ThreadCachingHeap::Rebalance(ThreadCache* cache)
 {
-    Lock::Locker locker(&TrackLock);
+    // LowFreeCount blocks of a class went unused during the entire interval. Give half of them
+    // to the central pool, so that a thread which has stopped allocating doesn't hold onto them.
+    for (size_t i = 0; i < SizeClassCount; ++i)
+    {
+        uint32_t count = (cache->LowFreeCount[i] / 2);
 
-    TrackedAllocMap::iterator it = AllocationMap.find(p);
+        if (count)
+            TrimThreadCache(cache, i, count);
 
-    if (it != AllocationMap.end())
-    {
-        const TrackedAllocMap::value_type& v = *it;
-        metadata = v.second;
-        return true;
+        cache->LowFreeCount[i] = cache->FreeCount[i];
     }
 
-    return false;
+    cache->OperationCount = 0;
+}
+
+void ThreadCachingHeap::FreeBlockList(FreeBlock* list)
+{
+    while (list)
+    {
+        FreeBlock* next = list->Next;
+        WrappedHeap->Free(GetHeader(list));
+        list = next;
+    }
 }
 
 
-bool Allocator::EnableTracking(bool enable)
+
+//------------------------------------------------------------------------
+// ***** SafeMMapAlloc / SafeMMapFree
+//
+
+void* SafeMMapAlloc(size_t size)
 {
-    bool result = false;
+    #if defined(_WIN32)
+        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE); // size is rounded up to a page. // Returned memory is 0-filled.
 
-    // We may need to deal with the case that this is called when we 
-    // have already started memory allocation activity. Currently disabled.
-    Lock::Locker locker(&TrackLock);
+    #elif defined(OVR_OS_MAC) || defined(OVR_OS_UNIX)
+        #if !defined(MAP_FAILED)
+            #define MAP_FAILED ((void*)-1)
+        #endif
 
-    if (!Heap) // If we haven't initialized yet...
-    {
-        TrackingEnabled = enable;
-        result = true;
-    }
-    else if(TrackingEnabled != enable) // if there is a change being requested...
-    {
-        // Currently we support the enabling and disabling of tracking after initialization
-        // only if we aren't using the page debug heap. We may be able to work around that
-        // in the future if needed. Tracking is enabled by default before initialization when 
-        // the page debug heap is enabled, so it's only a matter here of attempting to 
-        // disable tracking after it's been enabled, in practice.
-        if (!DebugPageHeapEnabled)  
-        {
-            TrackingEnabled = enable;
+        void* result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0); // Returned memory is 0-filled.
+        if(result == MAP_FAILED) // mmap returns MAP_FAILED (-1) upon failure.
+            result = nullptr;
+        return result;
+    #endif
+}
 
-            if(!TrackingEnabled) // If we are disabling tracking...
-            {
-                AllocationMap.clear(); // Clear all the tracking we've done so far.
-            }
+void SafeMMapFree(const void* memory, size_t size)
+{
+    #if defined(_WIN32)
+        OVR_UNUSED(size);
+        VirtualFree(const_cast<void*>(memory), 0, MEM_RELEASE);
 
-            result = true;
-        } // Else don't allow the change.
-    }
-    else //Else there's no change.
+    #elif defined(OVR_OS_MAC) || defined(OVR_OS_UNIX)
+        size_t pageSize = getpagesize();
+        size = (((size + (pageSize - 1)) / pageSize) * pageSize);
+        munmap(const_cast<void*>(memory), size); // Must supply the size to munmap.
+    #endif
+}
+
+
+
+
+//------------------------------------------------------------------------
+// ***** DebugPageHeap
+
+const size_t kFreedBlockArrayMaxSizeDefault = 16384;
+
+#if defined(_WIN32)
+    const size_t kProtectBatchSizeDefault = 1;  // VirtualProtect can't span separate VirtualAlloc regions, so there's little to gain from batching.
+#else
+    const size_t kProtectBatchSizeDefault = 16; // mprotect calls are expensive (TLB shootdowns), and adjacent blocks can be protected with one call.
+#endif
+
+
+#if defined(OVR_THREAD_LOCAL)
+    // OVR_THREAD_LOCAL supports only POD types, so we store the FreeRing as a void*.
+    struct DebugPageHeapTLS
     {
-        result = true;
-    }
+        void*    Ring;          // DebugPageHeap::FreeRing* of the calling thread.
+        uint64_t InstanceId;    // DebugPageHeap::InstanceId at the time Ring was looked up.
+    };
 
-    return result;
-}
+    static OVR_THREAD_LOCAL DebugPageHeapTLS CurrentFreeRing;
+#endif
 
+static std::atomic<uint64_t> DebugPageHeapInstanceCounter(0);
 
-bool Allocator::EnableDebugPageHeap(bool enable)
+
+
+DebugPageHeap::DebugPageHeap()
+  : FreeRingList(nullptr)
+  , FreeRingListLock()
+  , InstanceId(0)
+  , MaxDelayedFreeCount(0)
+  , RingCapacity(0)
+  , ProtectBatchSize(kProtectBatchSizeDefault)
+  , DelayedFreeCount(0)
+  , AllocationCount(0)
+  , OverrunPageEnabled(true)
+  #if defined(OVR_BUILD_DEBUG)
+  , OverrunGuardBytesEnabled(true)
+  #else
+  , OverrunGuardBytesEnabled(false)
+  #endif
+  //PageSize(0)
 {
-    bool result = false;
+    #if OVR_HUNT_UNTRACKED_ALLOCS
+        _CrtSetAllocHook(HuntUntrackedAllocHook);
+    #endif
 
-    if (!Heap) // If we haven't initialized yet...
-    {
-        DebugPageHeapEnabled = enable;
-        result = true;
-    }
+    #if defined(_WIN32)
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        PageSize = (size_t)systemInfo.dwPageSize;
+    #else
+        PageSize = (size_t)sysconf(_SC_PAGESIZE);
+    #endif
 
-    return result;
+    SetMaxDelayedFreeCount(kFreedBlockArrayMaxSizeDefault);
 }
 
 
-bool Allocator::EnableMallocRedirect()
+DebugPageHeap::~DebugPageHeap()
 {
-    bool result = false;
+    Shutdown();
+}
 
-    if (!Heap)
-    {
-        MallocRedirectEnabled = true;
-        result = true;
-    }
 
-    return result;
+bool DebugPageHeap::Init()
+{
+    // Nothing to do.
+    return true;
 }
 
-bool Allocator::IsHeapTrackingRegKeyEnabled(bool defaultValue)
+void DebugPageHeap::Shutdown()
 {
-    // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\HeapTrackingEnabled", REG_DWORD of 0 or 1.
-    return OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"HeapTrackingEnabled", defaultValue);
+    ReleaseFreeRings();
+    MaxDelayedFreeCount = 0;
+    RingCapacity = 0;
 }
 
-const AllocMetadata* Allocator::IterateHeapBegin()
+
+void DebugPageHeap::EnableOverrunDetection(bool enableOverrunDetection, bool enableOverrunGuardBytes)
 {
-    TrackLock.DoLock(); // Will be unlocked in IterateHeapEnd().
+    // Assert that no allocations have been made, which is a requirement for changing these properties. 
+    // Otherwise future deallocations of these allocations can fail to work properly because these 
+    // settings have changed behind their back.
+    OVR_ASSERT_M(AllocationCount == 0, "DebugPageHeap::EnableOverrunDetection called when DebugPageHeap is not in a newly initialized state.");
 
-    if (TrackingEnabled)
-    {
-        // We have a problem in the case that a single thread calls IterateHeapBegin twice 
-        // before calling IterateHeapEnd. It can be resolved the application calling IterateHeapEnd 
-        // twice as well, but do we want to support that usage? It's probably easier to just disallow it.
+    OverrunPageEnabled       = enableOverrunDetection;
+    OverrunGuardBytesEnabled = (enableOverrunDetection && enableOverrunGuardBytes); // Set OverrunGuardBytesEnabled to false if enableOverrunDetection is false.
+}
 
-        if (!AllocationMap.empty())
-        {
-            TrackIterator = AllocationMap.begin();
-            return &TrackIterator->second;
-        }
-    }
 
-    return nullptr;
+void DebugPageHeap::SetMaxDelayedFreeCount(size_t maxDelayedFreeCount)
+{
+    // Existing rings were sized for the previous count, so we purge them and let threads create new ones.
+    ReleaseFreeRings();
+
+    MaxDelayedFreeCount = maxDelayedFreeCount;
+    RingCapacity        = ((maxDelayedFreeCount < MaxRingCapacity) ? maxDelayedFreeCount : MaxRingCapacity);
 }
 
-const AllocMetadata* Allocator::IterateHeapNext()
+
+size_t DebugPageHeap::GetMaxDelayedFreeCount() const
 {
-    ++TrackIterator;
+    return MaxDelayedFreeCount;
+}
 
-    if(TrackIterator == AllocationMap.end())
-        return nullptr;
 
-    return &TrackIterator->second;
+void DebugPageHeap::SetProtectBatchSize(size_t protectBatchSize)
+{
+    if (protectBatchSize < 1)
+        protectBatchSize = 1;
+    else if (protectBatchSize > MaxProtectBatchSize)
+        protectBatchSize = MaxProtectBatchSize;
+
+    ProtectBatchSize = protectBatchSize;
 }
 
-void Allocator::IterateHeapEnd()
+
+size_t DebugPageHeap::GetProtectBatchSize() const
 {
-        TrackLock.Unlock();
-    }
+    return ProtectBatchSize;
+}
 
 
-size_t Allocator::DescribeAllocation(const AllocMetadata* amd, int amdFlags, char* description, size_t descriptionCapacity, size_t appendedNewlineCount)
+// Frees all delay-freed blocks and the rings that hold them. Threads will look up new rings on their next Free.
+void DebugPageHeap::ReleaseFreeRings()
 {
-    SysAllocatedString descriptionString;
-    char buffer[2048];
+    Lock::Locker autoLock(&FreeRingListLock);
 
-    if (amdFlags & AMFAlloc)
+    for (FreeRing* ring = FreeRingList; ring; )
     {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), "0x%p", amd->Alloc);
-        descriptionString += buffer;
-    }
+        FreeRing* next = ring->Next;
 
-    if (amdFlags & AMFAllocSize)
-    {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", size: %llu", amd->AllocSize);
-        descriptionString += buffer;
-    }
+        for (size_t i = 0, index = ring->Oldest; i < ring->Size; i++, index = ((index + 1) % RingCapacity))
+            FreePageMemory(ring->Blocks[index].BlockPtr, ring->Blocks[index].BlockSize);
 
-    if (amdFlags & AMFBlockSize)
-    {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", block size: %llu", amd->BlockSize);
-        descriptionString += buffer;
+        SafeMMapFree(ring, sizeof(FreeRing) + (RingCapacity * sizeof(Block)));
+        ring = next;
     }
 
-    if (amdFlags & AMFTime)
-    {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", time: %llus", amd->TimeNs / UINT64_C(1000000000));
-        descriptionString += buffer;
-    }
+    FreeRingList = nullptr;
+    DelayedFreeCount = 0;
+    InstanceId = ++DebugPageHeapInstanceCounter; // Never 0, so a zeroed DebugPageHeapTLS never matches.
+}
 
-    if (amdFlags & AMFCount)
-    {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", #: %llu", amd->Count);
-        descriptionString += buffer;
-    }
 
-    if (amdFlags & AMFTag)
-    {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", tag: %s", amd->Tag ? amd->Tag : OVR_ALLOCATOR_UNSPECIFIED_TAG);
-        descriptionString += buffer;
-    }
+DebugPageHeap::FreeRing* DebugPageHeap::GetFreeRing()
+{
+    if (!RingCapacity) // If delayed freeing is disabled...
+        return nullptr;
 
-    if (amdFlags & AMFThreadId)
-    {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", tid: %u", amd->ThreadId);
-        descriptionString += buffer;
-    }
+    #if defined(OVR_THREAD_LOCAL)
+        if (CurrentFreeRing.Ring && (CurrentFreeRing.InstanceId == InstanceId))
+            return static_cast<FreeRing*>(CurrentFreeRing.Ring);
+    #endif
 
-    if (amdFlags & AMFThreadName)
-    {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", thread name: %s", amd->ThreadName);
-        descriptionString += buffer;
-    }
+    // Slow path: This is the first Free by the calling thread since the rings were last released,
+    // or the thread has since used another DebugPageHeap (in which case it already has a ring here).
+    uint32_t  threadId = GetThreadId();
+    FreeRing* ring;
 
-    if ((amdFlags & AMFFile) || (amdFlags & AMFLine))
     {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", file/line: %s(%d)", amd->File, amd->Line);
-        descriptionString += buffer;
-    }
+        Lock::Locker autoLock(&FreeRingListLock);
+        size_t ringCount = 0;
 
-    if (amdFlags & (AMFBacktrace | AMFBacktraceSymbols))
-    {
-        if (!descriptionString.empty()) // If anything was written above...
-            descriptionString += "\n";
+        for (ring = FreeRingList; ring && (ring->ThreadId != threadId); ring = ring->Next, ++ringCount)
+            { }
+
+        if (!ring)
+            ring = FindUnownedRing();
 
-        for (size_t j = 0, jEnd = amd->Backtrace.size(); (j < jEnd) && (descriptionString.length() < descriptionCapacity); ++j)
+        if (!ring && (ringCount >= FreeRingReuseThreshold)) // Checking thread liveness is slow, so we do it only once we have several rings.
         {
-            const bool shouldLookupSymbols = (SymbolLookupEnabled && ((amdFlags & AMFBacktraceSymbols) != 0));
-            SymbolInfo symbolInfo;
+            ReclaimExitedThreadRings();
+            ring = FindUnownedRing();
+        }
 
-            if (shouldLookupSymbols && Symbols.LookupSymbol((uint64_t)amd->Backtrace[j], symbolInfo) && (symbolInfo.filePath[0] || symbolInfo.function[0]))
-            {
-                if (symbolInfo.filePath[0])
-                    snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%2u: %s(%d): %s\n", (unsigned)j, symbolInfo.filePath, symbolInfo.fileLineNumber, symbolInfo.function[0] ? symbolInfo.function : "(unknown function)");
-                else
-                    snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%2u: 0x%p (unknown source file): %s\n", (unsigned)j, amd->Backtrace[j], symbolInfo.function);
-            }
-            else
+        if (ring)
+            ring->ThreadId = threadId;
+        else
+        {
+            ring = static_cast<FreeRing*>(SafeMMapAlloc(sizeof(FreeRing) + (RingCapacity * sizeof(Block)))); // Returned memory is 0-filled.
+
+            if (ring)
             {
-                snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%2u: 0x%p (symbols unavailable)\n", (unsigned)j, amd->Backtrace[j]);
+                ring->ThreadId = threadId;
+                ring->Next = FreeRingList;
+                FreeRingList = ring;
             }
-
-            descriptionString += buffer;
         }
-
-        descriptionString.erase(descriptionString.size() - 1); // Remove the last newline. We may add back below.
     }
 
-    for(size_t i = 0; i < appendedNewlineCount; ++i)
-        descriptionString += '\n';
+    #if defined(OVR_THREAD_LOCAL)
+        if (ring)
+        {
+            CurrentFreeRing.Ring = ring;
+            CurrentFreeRing.InstanceId = InstanceId;
+        }
+    #endif
 
-    return OVR_strlcpy(description, descriptionString.c_str(), descriptionCapacity);
+    return ring;
 }
 
 
-size_t Allocator::TraceTrackedAllocations(AllocationTraceCallback callback, uintptr_t context)
+// Returns an empty ring which no thread owns, else nullptr. FreeRingListLock must be held.
+DebugPageHeap::FreeRing* DebugPageHeap::FindUnownedRing()
 {
-    const bool symbolLookupWasInitialized = SymbolLookup::IsInitialized();
-    const bool symbolLookupAvailable = SymbolLookup::Initialize();
+    FreeRing* ring;
 
-    if(!symbolLookupWasInitialized) // If SymbolLookup::Initialize was the first time being initialized, we need to refresh the Symbols view of modules, etc.
-        Symbols.Refresh();
+    for (ring = FreeRingList; ring && (ring->ThreadId != 0); ring = ring->Next)
+        { }
 
-    // If we're dumping while LibOVR is running, then we should hold the lock.
-    Allocator* pAlloc = Allocator::GetInstance();
+    return ring;
+}
 
-    // It's possible this is being called after the Allocator was shut down, at which 
-    // point we assume we are the only instance that can be executing at his time.
-    Lock* lock = pAlloc ? &pAlloc->TrackLock : nullptr;
-    if (lock) 
-        lock->DoLock();
 
-    size_t       measuredLeakCount = 0;
-    size_t       reportedLeakCount = 0;      // = realLeakCount minus leaks we ignore (e.g. C++ runtime concurrency leaks).
-    const size_t leakReportBufferSize = 8192;
-    char*        leakReportBuffer = nullptr;
+// Frees the blocks of all rings whose thread has exited, and leaves those rings unowned for other
+// threads to take over. Returns the number of blocks freed.
+size_t DebugPageHeap::ReclaimExitedThreadRings()
+{
+    Lock::Locker autoLock(&FreeRingListLock);
+    size_t freedCount = 0;
 
-    // Print out detail for each leaked pointer, but filtering away some that we ignore.
-    for (TrackedAllocMap::const_iterator it = AllocationMap.begin(); it != AllocationMap.end(); ++it)
+    for (FreeRing* ring = FreeRingList; ring; ring = ring->Next)
     {
-        const TrackedAllocMap::value_type& v = *it;
-        const void* p = v.first;
-        const AllocMetadata& amd = v.second;
-
-        measuredLeakCount++;
-
-        if (!leakReportBuffer) // Lazy allocate this, as it wouldn't be needed unless we had a leak, which we aim to be an unusual case.
+        if (ring->ThreadId && !ThreadIdIsValid(ring->ThreadId))
         {
-            leakReportBuffer = static_cast<char*>(SafeMMapAlloc(leakReportBufferSize));
-            if (!leakReportBuffer)
-                break;
-        }
-        leakReportBuffer[0] = '\0';
+            for (size_t i = 0, index = ring->Oldest; i < ring->Size; i++, index = ((index + 1) % RingCapacity))
+            {
+                FreePageMemory(ring->Blocks[index].BlockPtr, ring->Blocks[index].BlockSize);
+                ring->Blocks[index].Clear();
+            }
 
-        char line[2048];
-        snprintf(line, OVR_ARRAY_COUNT(line), "\n0x%p, size: %u, tag: %.64s\n", p, (unsigned)amd.AllocSize, amd.Tag ? amd.Tag : "none"); // Limit the tag length so that this can't exhaust the dest buffer. We need more dest buffer space below.
-        size_t currentStrlen = OVR_strlcat(leakReportBuffer, line, leakReportBufferSize);
+            DelayedFreeCount.fetch_sub(ring->Size, std::memory_order_relaxed);
+            freedCount += ring->Size;
 
-        if (amd.Backtrace.empty())
-        {
-            snprintf(line, OVR_ARRAY_COUNT(line), "(backtrace unavailable)\n");
-            OVR_strlcat(leakReportBuffer, line, leakReportBufferSize);
+            ring->ThreadId         = 0;
+            ring->Size             = 0;
+            ring->Oldest           = 0;
+            ring->PendingCount     = 0;
+            ring->BudgetPurgeCount = 0;
         }
-        else
-        {
-            size_t remainingCapacity = (leakReportBufferSize - currentStrlen);
-            DescribeAllocation(&amd, (AMFBacktrace | AMFBacktraceSymbols), leakReportBuffer + currentStrlen, remainingCapacity, 1);
+    }
 
-            // There are some leaks that aren't real because they are allocated by the Standard Library at runtime but 
-            // aren't freed until shutdown. We don't want to report those, and so we filter them out here.
-            const char* ignoredPhrases[] = { "Concurrency::details" /*add any additional strings here*/ };
+    return freedCount;
+}
 
-            for(size_t j = 0; j < OVR_ARRAY_COUNT(ignoredPhrases); ++j)
-            {
-                if (strstr(leakReportBuffer, ignoredPhrases[j])) // If we should ignore this leak...
-                {
-                    leakReportBuffer[0] = '\0';
-                } 
-            }
-        }
 
-        if (leakReportBuffer[0]) // If we are to report this as a bonafide leak...
-        {
-            ++reportedLeakCount;
+size_t DebugPageHeap::GetThreadDelayedFreeCount() const
+{
+    #if defined(OVR_THREAD_LOCAL)
+        if (CurrentFreeRing.Ring && (CurrentFreeRing.InstanceId == InstanceId))
+            return static_cast<const FreeRing*>(CurrentFreeRing.Ring)->Size;
+    #endif
 
-            // We cannot use normal logging system here because it will allocate more memory!
-            if (callback)
-                callback(context, leakReportBuffer);
-            else
-                ::OutputDebugStringA(leakReportBuffer);
-        }
-    }
+    return 0;
+}
 
-    char summaryBuffer[128];
-    snprintf(summaryBuffer, OVR_ARRAY_COUNT(summaryBuffer), "Measured leak count: %llu, Reported leak count: %llu\n", (uint64_t)measuredLeakCount, (uint64_t)reportedLeakCount);
 
-    if (callback)
-        callback(context, summaryBuffer);
-    else
-        ::OutputDebugStringA(summaryBuffer);
+// Finally frees the oldest block in the ring. The ring must not be empty.
+void DebugPageHeap::PurgeOldestBlock(FreeRing* ring)
+{
+    Block& block = ring->Blocks[ring->Oldest];
 
-    if (leakReportBuffer)
-    {
-        SafeMMapFree(leakReportBuffer, leakReportBufferSize);
-        leakReportBuffer = nullptr;
-    }
+    if (ring->PendingCount == ring->Size) // If the oldest block was never made inaccessible...
+        ring->PendingCount--;
 
-    if (lock)
-        lock->Unlock();
+    FreePageMemory(block.BlockPtr, block.BlockSize);
+    block.Clear();
 
-    if(symbolLookupAvailable)
-        SymbolLookup::Shutdown();
+    if (++ring->Oldest == RingCapacity)
+        ring->Oldest = 0;
 
-    return reportedLeakCount;
+    ring->Size--;
+    DelayedFreeCount.fetch_sub(1, std::memory_order_relaxed);
 }
 
 
+// Makes the pending blocks of the ring inaccessible. Sorting them by address lets us make adjacent
+// blocks inaccessible with a single call on platforms that allow it.
+void DebugPageHeap::FlushPendingBlocks(FreeRing* ring)
+{
+    Block  batch[MaxProtectBatchSize];
+    size_t batchSize = 0;
 
-//------------------------------------------------------------------------
-// ***** HeapIterationFilterRPN
-//
+    OVR_ASSERT(ring->PendingCount <= MaxProtectBatchSize); // Free flushes as soon as PendingCount reaches ProtectBatchSize.
 
-HeapIterationFilterRPN::HeapIterationFilterRPN()
-  : AllocatorInstance(nullptr), Filter(nullptr), Instructions{}, CurrentHeapTimeNs(Allocator::GetCurrentHeapTimeNs())
-{
+    for (size_t i = ring->Size - ring->PendingCount; i < ring->Size; i++)
+        batch[batchSize++] = ring->Blocks[(ring->Oldest + i) % RingCapacity];
+
+    ring->PendingCount = 0;
+
+    std::sort(batch, batch + batchSize, [](const Block& a, const Block& b) { return (a.BlockPtr < b.BlockPtr); });
+
+    for (size_t i = 0; i < batchSize; )
+    {
+        void*  blockPtr  = batch[i].BlockPtr;
+        size_t blockSize = batch[i].BlockSize;
+
+        #if !defined(_WIN32) // Windows doesn't let VirtualProtect span multiple VirtualAlloc regions, nor uncommitted guard pages.
+            // Merging includes the guard pages in between, but those are already inaccessible.
+            while (((i + 1) < batchSize) && ((static_cast<uint8_t*>(blockPtr) + blockSize) == batch[i + 1].BlockPtr))
+                blockSize += batch[++i].BlockSize;
+        #endif
+
+        DisablePageMemory(blockPtr, blockSize);
+        i++;
+    }
 }
 
-bool HeapIterationFilterRPN::SetFilter(Allocator* allocator, const char* filter)
+
+void* DebugPageHeap::Alloc(size_t size)
 {
-    AllocatorInstance = allocator;
-    Filter = filter;
-    return Compile(filter);    
+    return AllocAligned(size, DefaultAlignment);
 }
 
-const AllocMetadata* HeapIterationFilterRPN::IterateHeapBegin()
+
+void* DebugPageHeap::AllocAligned(size_t size, size_t align)
 {
-    const AllocMetadata* amd = AllocatorInstance->IterateHeapBegin();
+    OVR_ASSERT(align <= MaxAlignment);
 
-    while(amd && !Evaluate(amd))
-        amd = AllocatorInstance->IterateHeapNext();
+    if(align < DefaultAlignment)
+        align = DefaultAlignment;
 
-    return amd;
-}
+    // With overrun detection the user memory ends at the guard page, and the size info is right before it.
+    // Without it, the user memory is at the first aligned position after the size info, which is at align because align >= SizeStorageSize.
+    size_t maxRequiredSize = (OverrunPageEnabled ? (AlignSizeUp(size, align) + SizeStorageSize) : (align + size));
+    size_t blockSize = AlignSizeUp(maxRequiredSize, PageSize);
 
-const AllocMetadata* HeapIterationFilterRPN::IterateHeapNext()
-{
-    const AllocMetadata* amd = AllocatorInstance->IterateHeapNext();
+    if(OverrunPageEnabled)
+        blockSize += PageSize; // We add another page which will be uncommitted, so any read or write with it will except.
+
+    void*     pBlockPtr = nullptr;
+    FreeRing* ring = GetFreeRing();
+
+    if(ring && (ring->Size == RingCapacity) &&                  // If there is an old block we can recycle...
+       (ring->PendingCount < ring->Size) &&                     // and it has been made inaccessible (else recycling it gains nothing)...
+       (ring->Blocks[ring->Oldest].BlockSize == blockSize))     // We require it to be the exact size, as there would be some headaches for us if it was over-sized.
+    {
+        Block& block = ring->Blocks[ring->Oldest];
+        pBlockPtr = EnablePageMemory(block.BlockPtr, blockSize);  // Convert this memory from inaccessible back to read/write.
+        block.Clear();
+
+        if(++ring->Oldest == RingCapacity)
+            ring->Oldest = 0;
+
+        ring->Size--;
+        DelayedFreeCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        pBlockPtr = AllocCommittedPageMemory(blockSize); // Allocate a new block of one or more pages (via VirtualAlloc or mmap).
+    }
+
+    if(pBlockPtr)
+    {
+        void*   pUserPtr = GetUserPosition(pBlockPtr, blockSize, size, align);
+        size_t* pSizePos = GetSizePosition(pUserPtr);
 
-    while(amd && !Evaluate(amd))
-        amd = AllocatorInstance->IterateHeapNext();
+        pSizePos[UserSizeIndex] = size;
+        pSizePos[BlockSizeIndex] = blockSize;
+        AllocationCount.fetch_add(1, std::memory_order_relaxed);
 
-    return amd;
+        return pUserPtr;
+    }
+
+    return nullptr;
 }
 
-void HeapIterationFilterRPN::IterateHeapEnd()
+
+size_t DebugPageHeap::GetUserSize(const void* p)
 {
-    AllocatorInstance->IterateHeapEnd();
+    return GetSizePosition(p)[UserSizeIndex];
 }
 
 
-bool HeapIterationFilterRPN::Compile(const char* filter)
+size_t DebugPageHeap::GetBlockSize(const void* p)
 {
-    bool success = true; // To consider: We can report syntax errors and associated line numbers.
+    return GetSizePosition(p)[BlockSizeIndex];
+}
 
-    static_assert(std::is_standard_layout<Instruction>::value, "Instructions is presumed to be a POD here.");
-    memset(Instructions, 0, sizeof(Instructions));
 
-    for(size_t instructionCount = 0; success && (instructionCount < OVR_ARRAY_COUNT(Instructions)); ++instructionCount) // While reading each line until the end of the text...
-    {
-        while(isspace(*filter)) // Move past whitespace. Currently we need this only because of our isOperandLine check below.
-            ++filter;
+size_t* DebugPageHeap::GetSizePosition(const void* p)
+{
+    // No thread safety required as per our design, as we assume that anybody 
+    // who owns a pointer returned by Alloc cannot have another thread take it away.
 
-        Instruction instruction{};
-        char        tempDataType[12], tempCompare[8], tempComparand[256], tempOperation[8], *nextChar;
-        size_t      i;
-        bool        isOperandLine = _strnicmp(filter, "and", 3) && _strnicmp(filter, "or", 2); // To consider: Find a cleaner way to discern which of the two kinds of lines this is (operand or operation).
+    // We assume the pointer is a valid pointer allocated by this allocator.
+    // We store some size values into the memory returned to the user, a few bytes before it.
+    size_t  value    = reinterpret_cast<size_t>(p);
+    size_t  valuePos = (value - SizeStorageSize);
+    size_t* pSize    = reinterpret_cast<size_t*>(valuePos);
 
-        if ((*filter == '\r') || (*filter == '\n') || (*filter == '/'))
-        {
-            // Ignore lines that are empty or begin with / 
-        }
-        else if (isOperandLine && (sscanf_s(filter, "%11s %7s %255[^;]s", tempDataType,  (unsigned)sizeof(tempDataType),
-                                                                          tempCompare,   (unsigned)sizeof(tempCompare),
-                                                                          tempComparand, (unsigned)sizeof(tempComparand)) == 3)) // If this line looks like an operand (e.g. AllocSize > 100)...
-        {
-            static_assert(sizeof(tempComparand) == 256, "The format string here assumes 256. Fix the format string and this assert if tempComparand changes.");
- 
-            struct OperandTypePair{ const char* str; AllocMetadataFlags value; } 
-            operandTypeMap[] = { {"File", AMFFile}, {"Line", AMFLine}, {"Time", AMFTime}, {"Count", AMFCount}, {"Size", AMFAllocSize}, {"AllocSize", AMFAllocSize}, {"BlockSize", AMFBlockSize}, {"Tag", AMFTag}, {"ThreadId", AMFThreadId}, {"ThreadName", AMFThreadName} };
+    return pSize;
+}
 
-            // Read the operand (e.g. size)
-            for(i = 0; i < OVR_ARRAY_COUNT(operandTypeMap) && (instruction.operand.metadataType == AMFNone); ++i)
-            {
-                if(OVR_stricmp(tempDataType, operandTypeMap[i].str) == 0)
-                    instruction.operand.metadataType = operandTypeMap[i].value;
-            }
-            success = success && (instruction.operand.metadataType != AMFNone); // Successful if a match was found.
 
-            // Read the compare type (e.g. >=)
-            struct CompareTypePair{ const char* str; Comparison value; } 
-            compareTypeMap[] = { {"==", CmpE}, {"<", CmpL}, {"<=", CmpLE}, {">", CmpG}, {">=", CmpGE}, {"has", CmpHas} };
+void* DebugPageHeap::Realloc(void* p, size_t newSize)
+{
+    return ReallocAligned(p, newSize, DefaultAlignment);
+}
 
-            for(i = 0; i < OVR_ARRAY_COUNT(compareTypeMap) && (instruction.operand.comparison == CmpNone); ++i)
-            {
-                if(OVR_stricmp(tempCompare, compareTypeMap[i].str) == 0)
-                    instruction.operand.comparison = compareTypeMap[i].value;
-            }
-            success = success && (instruction.operand.comparison != CmpNone); // Successful if a match was found.
 
-            // Read the comparand (e.g. 4096)
-            instruction.operand.numValue = strtoll(tempComparand, &nextChar, 10);    // Just read it as both types here; we'll
-            strcpy(instruction.operand.strValue, tempComparand);                     // decide at execution time which to use.
+void* DebugPageHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
+{
+    // The ISO C99 standard states:
+    //     The realloc function deallocates the old object pointed to by ptr and 
+    //     returns a pointer to a new object that has the size specified by size. 
+    //     The contents of the new object shall be the same as that of the old 
+    //     object prior to deallocation, up to the lesser of the new and old sizes. 
+    //     Any bytes in the new object beyond the size of the old object have
+    //     indeterminate values.
+    //
+    //     If ptr is a null pointer, the realloc function behaves like the malloc 
+    //     function for the specified size. Otherwise, if ptr does not match a 
+    //     pointer earlier returned by the calloc, malloc, or realloc function, 
+    //     or if the space has been deallocated by a call to the free or realloc 
+    //     function, the behavior is undefined. If memory for the new object 
+    //     cannot be allocated, the old object is not deallocated and its value 
+    //     is unchanged.
+    //     
+    //     The realloc function returns a pointer to the new object (which may have 
+    //     the same value as a pointer to the old object), or a null pointer if 
+    //     the new object could not be allocated.
+
+    void* pReturn = nullptr;
+
+    if(p)
+    {
+        if(newSize)
+        {
+            pReturn = AllocAligned(newSize, newAlign);
 
-            if (instruction.operand.metadataType == AMFTime)
+            if(pReturn)
             {
-                if (*nextChar == 's')                                                                       // If the filter is specifying time in seconds instead of nanoseconds...
-                    instruction.operand.numValue *= 1000000000;                                             //     convert numValue from seconds to nanoseconds (which is what we internally use).
-                if (instruction.operand.numValue < 0)                                                       // Handle the case that a negative time was passed, which
-                    instruction.operand.numValue += CurrentHeapTimeNs;                                      //     means to refer to time relative to current time.
-            }
-            else if ((instruction.operand.metadataType == AMFCount) && (instruction.operand.numValue < 0))  // Handle the case that a negative count was passed, which
-                instruction.operand.numValue += AllocatorInstance->GetCounter();                            //     means to refer to the last N allocations.
-        }
-        else if (sscanf_s(filter, "%7[^;]s", tempOperation, (unsigned)sizeof(tempOperation)) == 1) // If this line looks like an operation (e.g. And or Or).
-        {
-            if (OVR_stricmp(tempOperation, "and") == 0)
-                instruction.operation = OpAnd;
-            else if(OVR_stricmp(tempOperation, "or") == 0)
-                instruction.operation = OpOr;
-            else
-                success = false;
+                size_t prevSize = GetUserSize(p);
+
+                if(newSize > prevSize)
+                    newSize = prevSize;
+
+                memcpy(pReturn, p, newSize);
+                Free(p);
+            } // Else fall through, leaving p's memory unmodified and returning nullptr.
         }
         else
-            success = false;
-
-        if (success)
         {
-            if (instructionCount < OVR_ARRAY_COUNT(Instructions))
-                Instructions[instructionCount] = instruction;
-            else
-                success = false; // Out of space.
+            Free(p);
         }
-
-        // Move to the start of the next statement (delimited by ; or \n)
-        filter = strpbrk(filter, ";\n");
-        if (filter)
-            filter++;
-        else
-            break;
+    }
+    else if(newSize)
+    {
+        pReturn = AllocAligned(newSize, newAlign);
     }
 
-    return success;
+    return pReturn;
 }
 
-// Evaluates an individual operand, such as (AllocSize < 32).
-bool HeapIterationFilterRPN::EvaluateOperand(const Operand& operand, const AllocMetadata* amd) const
+
+void DebugPageHeap::Free(void *p)
 {
-    switch ((int)operand.metadataType) // Cast to int in order to avoid compiler warnings about unhandled enumerants.
+    if(p)
     {
-        case AMFFile: case AMFTag: case AMFThreadName: // String-based operands
-        {
-            const char* p;
-
-            switch ((int)operand.metadataType)
+        #if defined(OVR_BUILD_DEBUG)
+            if(OverrunGuardBytesEnabled) // If we have extra bytes at the end of the user's allocation between it and an inaccessible guard page...
             {
-                default:
-                case AMFFile:       p = amd->File;       break;
-                case AMFTag:        p = amd->Tag;        break;
-                case AMFThreadName: p = amd->ThreadName; break;
+                const size_t   userSize = GetUserSize(p);
+                const uint8_t* pUserEnd = (static_cast<uint8_t*>(p) + userSize);
+                const uint8_t* pPageEnd = AlignPointerUp(pUserEnd, PageSize);
+
+                while(pUserEnd != pPageEnd)
+                {
+                    if(*pUserEnd++ != GuardFillByte)
+                    {
+                        OVR_FAIL();
+                        break;
+                    }
+                }
             }
+        #endif
 
-            switch ((int)operand.comparison)
-            {
-                case CmpE:   return (OVR_stricmp(p, operand.strValue) == 0);
-                case CmpHas: return (OVR_stristr(p, operand.strValue) != nullptr);
-            }                
-        }
-    
-        case AMFLine: case AMFTime: case AMFCount: case AMFAllocSize: case AMFBlockSize: case AMFThreadId: // Integer-based operands
-        {
-            int64_t n;
+        FreeRing* ring = GetFreeRing();
 
-            switch ((int)operand.metadataType)
+        if(ring)  // If we have a delayed free list...
+        {
+            // We don't free the page(s) associated with this but rather put them in the thread's ring in an inaccessible state for later freeing.
+            // We do this because we don't want those pages to be available again in the near future, so we can detect use-after-free misakes.
+            if(ring->Size == RingCapacity) // If we have reached freed block capacity... we can start purging old elements from it as a circular queue.
+                PurgeOldestBlock(ring);
+            else if(ring->Size && (DelayedFreeCount.load(std::memory_order_relaxed) >= MaxDelayedFreeCount)) // Else if all threads together hold the max, keep the total bounded.
             {
-                default:
-                case AMFLine:      n = amd->Line;      break;
-                case AMFTime:      n = amd->TimeNs;    break;
-                case AMFCount:     n = amd->Count;     break;
-                case AMFAllocSize: n = amd->AllocSize; break;
-                case AMFBlockSize: n = amd->BlockSize; break;
-                case AMFThreadId:  n = amd->ThreadId;  break;
-            }
+                // Some of the max may be held by threads which have exited. Those blocks would never
+                // leave their rings, and we would be purging our own blocks on every Free from now on.
+                if(++ring->BudgetPurgeCount >= ExitedRingCheckInterval)
+                {
+                    ring->BudgetPurgeCount = 0;
+                    ReclaimExitedThreadRings();
+                }
 
-            switch ((int)operand.comparison)
-            {
-                case CmpE:  return (n == operand.numValue);
-                case CmpL:  return (n <  operand.numValue);
-                case CmpLE: return (n <= operand.numValue);
-                case CmpG:  return (n >  operand.numValue);
-                case CmpGE: return (n >= operand.numValue);
+                if(DelayedFreeCount.load(std::memory_order_relaxed) >= MaxDelayedFreeCount)
+                    PurgeOldestBlock(ring);
             }
-        }
-    }
-
-    return false;
-}
-
-bool HeapIterationFilterRPN::Evaluate(const AllocMetadata* amd)
-{
-    // We execute an RPN (a.k.a. postfix) stack here. Because our language here involves 
-    // only logical operations, our stack need be only a stack of bool.
-    struct Stack
-    {
-        bool   data[32];
-        size_t size;
 
-        void PopAndSet(bool value) { memmove(&data[1], &data[2], sizeof(data) - (2 * sizeof(bool))); data[0] = value; size -= 1; }
-        void Push(bool value)      { memmove(&data[1], &data[0], sizeof(data) - (1 * sizeof(bool))); data[0] = value; size += 1; }
-    } stack{ {true, 1} }; // By default the state is true. An empty instruction set evaluates as true.
+            Block& blockNew = ring->Blocks[(ring->Oldest + ring->Size) % RingCapacity];
+            blockNew.BlockPtr  = GetBlockPtr(p);
+            blockNew.BlockSize = GetBlockSize(p);
+            ring->Size++;
+            ring->PendingCount++;
+            DelayedFreeCount.fetch_add(1, std::memory_order_relaxed);
 
-    for(size_t i = 0; (i < OVR_ARRAY_COUNT(Instructions)) && ((Instructions[i].operation != OpNone) || (Instructions[i].operand.comparison != CmpNone)); ++i)
-    {
-        if(Instructions[i].operation != OpNone) // if this is an operation...
+            if(ring->PendingCount >= ProtectBatchSize)
+                FlushPendingBlocks(ring); // Make it so that future attempts to use this memory result in an exception.
+        }
+        else
         {
-            if (Instructions[i].operation == OpAnd)
-                stack.PopAndSet(stack.data[0] && stack.data[1]);
-            else
-                stack.PopAndSet(stack.data[0] || stack.data[1]);
+            FreePageMemory(GetBlockPtr(p), GetBlockSize(p));
         }
-        else // Else this is an operand push.
-            stack.Push(EvaluateOperand(Instructions[i].operand, amd));
-    }
 
-    return stack.data[0];
+        AllocationCount.fetch_sub(1, std::memory_order_relaxed);
+    }
 }
 
 
-void HeapIterationFilterRPN::TraceTrackedAllocations(Allocator* allocator, const char* filter, Allocator::AllocationTraceCallback callback, uintptr_t context)
+void DebugPageHeap::FreeAligned(void* p)
 {
-    OVR::HeapIterationFilterRPN hifRPN;
-
-    hifRPN.SetFilter(allocator, filter);
+    return Free(p);
+}
 
-    for(const OVR::AllocMetadata* amd = hifRPN.IterateHeapBegin(); amd; amd = hifRPN.IterateHeapNext())
-    {
-        char description[16384];
-        allocator->DescribeAllocation(amd, 0xffff, description, sizeof(description), 0);
-        callback(context, description);
-    }
 
-    hifRPN.IterateHeapEnd();
+// Converts a user pointer to the beginning of its page.
+void* DebugPageHeap::GetBlockPtr(void* p)
+{
+    // We store size info before p in memory, and this will, by design, be always somewhere within 
+    // the first page of a block of pages. So just align down to the beginning of its page.
+    return AlignPointerDown(GetSizePosition(p), PageSize);
 }
 
 
+void* DebugPageHeap::GetUserPosition(void* pPageMemory, size_t blockSize, size_t userSize, size_t userAlignment)
+{
+    uint8_t* pUserPosition;
 
-//------------------------------------------------------------------------
-// ***** DefaultHeap
-//
+    if(OverrunPageEnabled)
+    {
+        // We need to return the highest position within the page memory that fits the user size while being aligned to userAlignment.
+        const size_t pageEnd      = reinterpret_cast<size_t>(pPageMemory) + (blockSize - PageSize); // pageEnd points to the beginning of the final guard page.
+        const size_t userPosition = AlignSizeDown(pageEnd - userSize, userAlignment);
+        pUserPosition = reinterpret_cast<uint8_t*>(userPosition);
+        OVR_ASSERT((userPosition + userSize) <= pageEnd);
 
-bool DefaultHeap::Init()
-{
-    // Nothing to do.
-    return true;
-}
+        // If userSize is not a multiple of userAlignment then there will be (userAlignment - userSize) bytes
+        // of unused memory between the user allocated space and the end of the page. There is no way around having this.
+        // For example, a user allocation of 3 bytes with 8 byte alignment will leave 5 unused bytes at the end of the page.
+        // We optionally fill those unused bytes with a pattern and upon Free verify that the pattern is undisturbed.
+        // This won't detect reads or writes in that area immediately as with reads or writes beyond that, but it will
+        // at least detect them at some point (e.g. upon Free).
+        #if defined(OVR_BUILD_DEBUG)
+            if(OverrunGuardBytesEnabled)
+            {
+                uint8_t* const pUserEnd = (pUserPosition + userSize);
+                const size_t remainingByteCount = (reinterpret_cast<uint8_t*>(pageEnd) - pUserEnd);
+                if(remainingByteCount) // If there are any left-over bytes...
+                    memset(pUserEnd, GuardFillByte, remainingByteCount);
+            }
+        #endif
+    }
+    else
+    {
+        // We need to return the first position in the first page after SizeStorageSize bytes which is aligned to userAlignment.
+        const size_t lowestPossiblePos = reinterpret_cast<size_t>(pPageMemory) + SizeStorageSize;
+        const size_t userPosition = AlignSizeUp(lowestPossiblePos, userAlignment);
+        pUserPosition = reinterpret_cast<uint8_t*>(userPosition);
+        OVR_ASSERT((userPosition + userSize) <= (reinterpret_cast<size_t>(pPageMemory) + blockSize));
+    }
 
-void DefaultHeap::Shutdown()
-{
-    // Nothing to do.
+    // Assert that the returned user pointer (actually the size info before it) will be within the first page.
+    // This is important because it verifieds that we haven't wasted memory and because 
+    // our functionality for telling the start of the page block depends on it.
+    OVR_ASSERT(AlignPointerDown(GetSizePosition(pUserPosition), PageSize) == pPageMemory);
+
+    return pUserPosition;
 }
 
 
-void* DefaultHeap::Alloc(size_t size)
+void* DebugPageHeap::AllocCommittedPageMemory(size_t blockSize)
 {
-    void* p = malloc(size);
+    #if defined(_WIN32)
+        void* p;
+    
+        if(OverrunPageEnabled)
+        {
+            // We need to make it so that last page is MEM_RESERVE and the previous pages are MEM_COMMIT + PAGE_READWRITE.
+            OVR_ASSERT(blockSize > PageSize); // There should always be at least one extra page.
 
-    return p;
-}
+            // Reserve blockSize amount of pages.
+            // We could possibly use PAGE_GUARD here for the last page. This differs from simply leaving it reserved
+            // because the OS will generate a one-time-only gaurd page exception. We probabl don't want this, as it's
+            // more useful for maintaining your own stack than for catching unintended overruns.
+            p = VirtualAlloc(nullptr, blockSize, MEM_RESERVE, PAGE_READWRITE);
+
+            if(p)
+            {
+                // Commit all but the last page. Leave the last page as merely reserved so that reads from or writes
+                // to it result in an immediate exception.
+                p = VirtualAlloc(p, blockSize - PageSize, MEM_COMMIT, PAGE_READWRITE);
+            }
+        }
+        else
+        {
+            // We need to make it so that all pages are MEM_COMMIT + PAGE_READWRITE.
+            p = VirtualAlloc(nullptr, blockSize, MEM_COMMIT, PAGE_READWRITE);
+        }
 
+        #if defined(OVR_BUILD_DEBUG)
+            if(!p)
+            {
+                // To consider: Make a generic OVRKernel function for formatting system errors. We could move 
+                // the OVRError GetSysErrorCodeString from LibOVR/OVRError.h to LibOVRKernel/OVR_DebugHelp.h
+                DWORD dwLastError = GetLastError();
+                WCHAR osError[256];
+                DWORD osErrorBufferCapacity = OVR_ARRAY_COUNT(osError);
+                CHAR  reportedError[384];
+                DWORD length = FormatMessageW(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr, (DWORD)dwLastError, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), osError, osErrorBufferCapacity, nullptr);
+        
+                if (length)
+                {
+                    std::string errorBuff = UCSStringToUTF8String(osError, length + 1);
+                    snprintf(reportedError, OVR_ARRAY_COUNT(reportedError), "DebugPageHeap: VirtualAlloc failed with error: %s", errorBuff.c_str());
+                }
+                else
+                {
+                    snprintf(reportedError, OVR_ARRAY_COUNT(reportedError), "DebugPageHeap: VirtualAlloc failed with error: %d.", dwLastError);
+                }
 
-void* DefaultHeap::AllocAligned(size_t size, size_t align)
-{
-    #if defined(_MSC_VER)
-        void* p = _aligned_malloc(size, align);
+                //LogError("%s", reportedError); Disabled because this call turns around and allocates memory, yet we may be in a broken or exhausted memory situation.
+                OVR_FAIL_M(reportedError);
+            }
+        #endif
+
+        return p;
     #else
-        void* p = memalign(align, size);
-    #endif
+        // Note that on Linux each block with a guard page uses two memory mappings, and the process
+        // is limited to vm.max_map_count (usually 65530) of them.
+        void* p = mmap(nullptr, blockSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0); // Returned memory is 0-filled.
 
-    return p;
-}
+        if(p == MAP_FAILED)
+        {
+            OVR_FAIL_M("DebugPageHeap: mmap failed.");
+            return nullptr;
+        }
 
+        if(OverrunPageEnabled)
+        {
+            // Make the last page inaccessible so that reads from or writes to it result in an immediate exception.
+            OVR_ASSERT(blockSize > PageSize); // There should always be at least one extra page.
+            int result = mprotect(static_cast<uint8_t*>(p) + (blockSize - PageSize), PageSize, PROT_NONE);
+            OVR_ASSERT_AND_UNUSED(result == 0, result);
+        }
 
-size_t DefaultHeap::GetAllocSize(const void* p) const
-{
-    #if defined(_MSC_VER)
-        return _msize(const_cast<void*>(p));
-    #else
-        return malloc_usable_size(p);
+        return p;
     #endif
 }
 
 
-size_t DefaultHeap::GetAllocAlignedSize(const void* p, size_t align) const
+// We convert disabled page memory (see DisablePageMemory) to enabled page memory. The output is the same 
+// as with AllocPageMemory.
+void* DebugPageHeap::EnablePageMemory(void* pPageMemory, size_t blockSize)
 {
-    #if defined(_MSC_VER)
-        return _aligned_msize(const_cast<void*>(p), align, 0);
+    #if defined(_WIN32)
+        // Make sure the entire range of memory is of type PAGE_READWRITE.
+        DWORD dwPrevAccess = 0;
+        BOOL result = VirtualProtect(pPageMemory, OverrunPageEnabled ? (blockSize - PageSize) : blockSize, PAGE_READWRITE, &dwPrevAccess);
+        OVR_ASSERT_AND_UNUSED(result, result);
     #else
-        OVR_UNUSED(align);
-        return malloc_usable_size(p);
+        int result = mprotect(pPageMemory, OverrunPageEnabled ? (blockSize - PageSize) : blockSize, PROT_READ | PROT_WRITE);
+        OVR_ASSERT_AND_UNUSED(result == 0, result);
     #endif
-}
-
 
-void DefaultHeap::Free(void *p)
-{
-    free(p);
+    return pPageMemory;
 }
 
-void DefaultHeap::FreeAligned(void* p)
+
+void DebugPageHeap::DisablePageMemory(void* pPageMemory, size_t blockSize)
 {
-    #if defined(_MSC_VER)
-        _aligned_free(p);
+    #if defined(_WIN32)
+        // Disable access to the page(s). It's faster for us to change the page access than it is to decommit or free the pages.
+        // However, this results in more committed physical memory usage than we would need if we instead decommitted the memory.
+        DWORD dwPrevAccesss = 0;
+        BOOL result = VirtualProtect(pPageMemory, OverrunPageEnabled ?  (blockSize - PageSize) : blockSize, PAGE_NOACCESS, &dwPrevAccesss);
+        OVR_ASSERT_AND_UNUSED(result, result);
     #else
-        free(p); // No special function required.
+        int result = mprotect(pPageMemory, OverrunPageEnabled ? (blockSize - PageSize) : blockSize, PROT_NONE);
+        OVR_ASSERT_AND_UNUSED(result == 0, result);
     #endif
 }
 
 
-void* DefaultHeap::Realloc(void* p, size_t newSize)
-{
-    void* newP = realloc(p, newSize);
-
-    return newP;
-}
-
-void* DefaultHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
+void DebugPageHeap::FreePageMemory(void* pPageMemory, size_t blockSize)
 {
-    #if defined(_MSC_VER)
-        void* pNew = _aligned_realloc(p, newSize, newAlign);
+    #if defined(_WIN32)    
+        OVR_UNUSED(blockSize);
+        BOOL result = VirtualFree(pPageMemory, 0, MEM_RELEASE);
+        OVR_ASSERT_AND_UNUSED(result, result);
     #else
-        void* pNew = realloc(p, newSize); // We expect the implementation to know its alignment. There is no standard posix_memalign_realloc.
+        int result = munmap(pPageMemory, blockSize); // Must supply the size to munmap.
+        OVR_ASSERT_AND_UNUSED(result == 0, result);
     #endif
-
-    return pNew;
 }
 
 
 
 //------------------------------------------------------------------------
-// ***** OSHeap
+// ***** ArenaHeap
 //
 
-OSHeap::OSHeap()
-  : Heap(nullptr)
+// The registry of initialized arenas, used by FindArena. The range covers all arenas ever registered,
+// so that FindArena can reject most pointers without looking at the registry. These are constant
+// initialized, as the Allocator may be used during static init.
+static std::atomic<ArenaHeap*>       ArenaHeapRegistry[ArenaHeap::MaxArenaCount];
+static std::atomic<uintptr_t>        ArenaHeapRangeBegin(UINTPTR_MAX);
+static std::atomic<uintptr_t>        ArenaHeapRangeEnd(0);
+static OVR_THREAD_LOCAL ArenaHeap*   ThreadArenaHeap = nullptr;
+
+
+ArenaHeap::ArenaHeap(size_t reserveSize, size_t commitSize)
+  : Base(nullptr)
+  , ReserveSize(reserveSize)
+  , CommitSize(commitSize)
+  , CommittedSize(0)
+  , UsedSize(0)
+  , PeakUsedSize(0)
+  , LastAlloc(nullptr)
+  , RegistryIndex(MaxArenaCount)
 {
 }
 
-OSHeap::~OSHeap()
-{
-    OSHeap::Shutdown();
-}
 
-bool OSHeap::Init()
+ArenaHeap::~ArenaHeap()
 {
-    Heap = GetProcessHeap(); // This never fails.
-    return true;
+    ArenaHeap::Shutdown();
 }
 
-void OSHeap::Shutdown()
-{
-    // Do not free this heap. Its lifetime is maintained by the OS.
-    Heap = nullptr;
-}
 
-void* OSHeap::Alloc(size_t size)
+bool ArenaHeap::Init()
 {
-    return HeapAlloc(Heap, 0, size);
-}
+    if (Base) // If already initialized...
+        return true;
 
-void* OSHeap::AllocAligned(size_t size, size_t /*align*/)
-{
-    // We need to solve this if we are to support aligned memory. We'll need to allocate exta memory up front, return an internal pointer, and store info to find the base pointer.
-    OVR_FAIL_M("OSHeap::AllocAligned not yet supported.");
-    return HeapAlloc(Heap, 0, size);
-}
+    #if defined(_WIN32)
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        size_t pageSize = (size_t)systemInfo.dwPageSize;
+    #else
+        size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    #endif
 
-size_t OSHeap::GetAllocSize(const void* p) const
-{
-    return HeapSize(Heap, 0, p);
-}
+    ReserveSize = AlignSizeUp(ReserveSize, pageSize);
+    CommitSize  = AlignSizeUp(CommitSize ? CommitSize : DefaultCommitSize, pageSize);
 
-size_t OSHeap::GetAllocAlignedSize(const void* p, size_t /*align*/) const
-{
-    // We need to solve this if we are to support aligned memory.
-    OVR_FAIL_M("OSHeap::AllocAligned not yet supported.");
-    return HeapSize(Heap, 0, p);
-}
+    for (size_t i = 0; i < MaxArenaCount; ++i)
+    {
+        ArenaHeap* expected = nullptr;
 
-void OSHeap::Free(void* p)
-{
-    BOOL result = HeapFree(Heap, 0, p);
-    OVR_ASSERT_AND_UNUSED(result, result);
-}
+        if (ArenaHeapRegistry[i].compare_exchange_strong(expected, this))
+        {
+            RegistryIndex = i;
+            break;
+        }
+    }
 
-void OSHeap::FreeAligned(void* p)
-{
-    OVR_FAIL_M("OSHeap::AllocAligned not yet supported.");
-    BOOL result = HeapFree(Heap, 0, p);
-    OVR_ASSERT_AND_UNUSED(result, result);
-}
+    if (RegistryIndex == MaxArenaCount)
+    {
+        OVR_FAIL_M("ArenaHeap: Too many arenas.");
+        return false;
+    }
+
+    #if defined(_WIN32)
+        Base = static_cast<uint8_t*>(VirtualAlloc(nullptr, ReserveSize, MEM_RESERVE, PAGE_READWRITE));
+    #else
+        void* result = mmap(nullptr, ReserveSize, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+        Base = ((result == MAP_FAILED) ? nullptr : static_cast<uint8_t*>(result));
+    #endif
 
-void* OSHeap::Realloc(void* p, size_t newSize)
-{
-    return HeapReAlloc(Heap, 0, p, newSize);
-}
+    if (!Base)
+    {
+        ArenaHeapRegistry[RegistryIndex].store(nullptr, std::memory_order_release);
+        RegistryIndex = MaxArenaCount;
+        return false;
+    }
 
-void* OSHeap::ReallocAligned(void* p, size_t newSize, size_t /*newAlign*/)
-{
-    // We need to solve this if we are to support aligned memory.
-    return HeapReAlloc(Heap, 0, p, newSize);
-}
+    // Widen the range to include us. It's never narrowed, as that would require knowing about the other arenas.
+    uintptr_t begin = ArenaHeapRangeBegin.load(std::memory_order_relaxed);
+    while ((reinterpret_cast<uintptr_t>(Base) < begin) && !ArenaHeapRangeBegin.compare_exchange_weak(begin, reinterpret_cast<uintptr_t>(Base)))
+        { }
 
+    uintptr_t end = ArenaHeapRangeEnd.load(std::memory_order_relaxed);
+    while ((reinterpret_cast<uintptr_t>(Base + ReserveSize) > end) && !ArenaHeapRangeEnd.compare_exchange_weak(end, reinterpret_cast<uintptr_t>(Base + ReserveSize)))
+        { }
 
+    return true;
+}
 
-//------------------------------------------------------------------------
-// ***** SafeMMapAlloc / SafeMMapFree
-//
 
-void* SafeMMapAlloc(size_t size)
+void ArenaHeap::Shutdown()
 {
-    #if defined(_WIN32)
-        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE); // size is rounded up to a page. // Returned memory is 0-filled.
+    if (RegistryIndex < MaxArenaCount)
+    {
+        ArenaHeapRegistry[RegistryIndex].store(nullptr, std::memory_order_release);
+        RegistryIndex = MaxArenaCount;
+    }
 
-    #elif defined(OVR_OS_MAC) || defined(OVR_OS_UNIX)
-        #if !defined(MAP_FAILED)
-            #define MAP_FAILED ((void*)-1)
+    if (Base)
+    {
+        #if defined(_WIN32)
+            BOOL result = VirtualFree(Base, 0, MEM_RELEASE);
+            OVR_ASSERT_AND_UNUSED(result, result);
+        #else
+            int result = munmap(Base, ReserveSize);
+            OVR_ASSERT_AND_UNUSED(result == 0, result);
         #endif
 
-        void* result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0); // Returned memory is 0-filled.
-        if(result == MAP_FAILED) // mmap returns MAP_FAILED (-1) upon failure.
-            result = nullptr;
-        return result;
-    #endif
+        Base = nullptr;
+    }
+
+    CommittedSize = 0;
+    UsedSize = 0;
+    LastAlloc = nullptr;
 }
 
-void SafeMMapFree(const void* memory, size_t size)
-{
-    #if defined(_WIN32)
-        OVR_UNUSED(size);
-        VirtualFree(const_cast<void*>(memory), 0, MEM_RELEASE);
 
-    #elif defined(OVR_OS_MAC) || defined(OVR_OS_UNIX)
-        size_t pageSize = getpagesize();
-        size = (((size + (pageSize - 1)) / pageSize) * pageSize);
-        munmap(const_cast<void*>(memory), size); // Must supply the size to munmap.
+void ArenaHeap::Reset()
+{
+    #if defined(OVR_BUILD_DEBUG)
+        if (Base)
+            memset(Base, 0xdd, UsedSize); // Make use of memory after Reset more likely to be noticed. 0xdd is what VC++ uses for freed memory.
     #endif
+
+    UsedSize = 0;
+    LastAlloc = nullptr;
 }
 
 
+bool ArenaHeap::Commit(size_t requiredSize)
+{
+    if (requiredSize <= CommittedSize)
+        return true;
 
+    if (requiredSize > ReserveSize)
+        return false;
 
-//------------------------------------------------------------------------
-// ***** DebugPageHeap
+    size_t newCommittedSize = AlignSizeUp(requiredSize, CommitSize);
 
-static size_t AlignSizeUp(size_t value, size_t alignment)
-{
-    return ((value + (alignment - 1)) & ~(alignment - 1));
-}
+    if (newCommittedSize > ReserveSize)
+        newCommittedSize = ReserveSize;
 
-static size_t AlignSizeDown(size_t value, size_t alignment)
-{
-    return (value & ~(alignment - 1));
+    #if defined(_WIN32)
+        bool success = (VirtualAlloc(Base + CommittedSize, newCommittedSize - CommittedSize, MEM_COMMIT, PAGE_READWRITE) != nullptr);
+    #else
+        bool success = (mprotect(Base + CommittedSize, newCommittedSize - CommittedSize, PROT_READ | PROT_WRITE) == 0);
+    #endif
+
+    if (success)
+        CommittedSize = newCommittedSize;
+
+    return success;
 }
 
-template <typename Pointer>
-Pointer AlignPointerUp(Pointer p, size_t alignment)
+
+void* ArenaHeap::Alloc(size_t size)
 {
-    return reinterpret_cast<Pointer>(((reinterpret_cast<size_t>(p) + (alignment - 1)) & ~(alignment - 1)));
+    return AllocAligned(size, DefaultAlignment);
 }
 
-template <typename Pointer>
-Pointer AlignPointerDown(Pointer p, size_t alignment)
+
+void* ArenaHeap::AllocAligned(size_t size, size_t align)
 {
-    return reinterpret_cast<Pointer>(reinterpret_cast<size_t>(p) & ~(alignment-1));
-}
+    if (!Base)
+        return nullptr;
 
+    if (align < DefaultAlignment)
+        align = DefaultAlignment;
 
-const size_t kFreedBlockArrayMaxSizeDefault = 16384;
+    size_t userOffset = AlignSizeUp(UsedSize + HeaderSize, align);
 
+    if ((size > ReserveSize) || !Commit(userOffset + size)) // The first check prevents overflow in the second.
+        return nullptr;
 
+    uint8_t* p = (Base + userOffset);
+    reinterpret_cast<size_t*>(p - HeaderSize)[0] = size;
 
-DebugPageHeap::DebugPageHeap()
-  : FreedBlockArray(nullptr)
-  , FreedBlockArrayMaxSize(0)
-  , FreedBlockArraySize(0)
-  , FreedBlockArrayOldest(0)
-  , AllocationCount(0)
-  , OverrunPageEnabled(true)
-  #if defined(OVR_BUILD_DEBUG)
-  , OverrunGuardBytesEnabled(true)
-  #else
-  , OverrunGuardBytesEnabled(false)
-  #endif
-  //PageSize(0)
-  , Lock()
-{
-    #if OVR_HUNT_UNTRACKED_ALLOCS
-        _CrtSetAllocHook(HuntUntrackedAllocHook);
-    #endif
+    UsedSize  = (userOffset + size);
+    LastAlloc = p;
 
-    #if defined(_WIN32)
-        SYSTEM_INFO systemInfo;
-        GetSystemInfo(&systemInfo);
-        PageSize = (size_t)systemInfo.dwPageSize;
-    #else
-        PageSize = 4096;
-    #endif
+    if (UsedSize > PeakUsedSize)
+        PeakUsedSize = UsedSize;
 
-    SetMaxDelayedFreeCount(kFreedBlockArrayMaxSizeDefault);
+    return p;
 }
 
 
-DebugPageHeap::~DebugPageHeap()
+size_t ArenaHeap::GetAllocSize(const void* p) const
 {
-    Shutdown();
+    return reinterpret_cast<const size_t*>(static_cast<const uint8_t*>(p) - HeaderSize)[0];
 }
 
 
-bool DebugPageHeap::Init()
+void ArenaHeap::Free(void*)
 {
-    // Nothing to do.
-    return true;
+    // Nothing to do. Memory is freed upon Reset.
 }
 
-void DebugPageHeap::Shutdown()
+
+void ArenaHeap::FreeAligned(void*)
 {
-    Lock::Locker autoLock(&Lock);
+}
 
-    for(size_t i = 0; i < FreedBlockArraySize; i++)
-    {
-        if(FreedBlockArray[i].BlockPtr)
-        {
-            FreePageMemory(FreedBlockArray[i].BlockPtr, FreedBlockArray[i].BlockSize);
-            FreedBlockArray[i].Clear();
-        }
-    }
 
-    SetMaxDelayedFreeCount(0);
-    FreedBlockArraySize = 0;
-    FreedBlockArrayOldest = 0;
+void* ArenaHeap::Realloc(void* p, size_t newSize)
+{
+    return ReallocAligned(p, newSize, DefaultAlignment);
 }
 
 
-void DebugPageHeap::EnableOverrunDetection(bool enableOverrunDetection, bool enableOverrunGuardBytes)
+void* ArenaHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
 {
-    // Assert that no allocations have been made, which is a requirement for changing these properties. 
-    // Otherwise future deallocations of these allocations can fail to work properly because these 
-    // settings have changed behind their back.
-    OVR_ASSERT_M(AllocationCount == 0, "DebugPageHeap::EnableOverrunDetection called when DebugPageHeap is not in a newly initialized state.");
+    if (!p)
+        return AllocAligned(newSize, newAlign);
 
-    OverrunPageEnabled       = enableOverrunDetection;
-    OverrunGuardBytesEnabled = (enableOverrunDetection && enableOverrunGuardBytes); // Set OverrunGuardBytesEnabled to false if enableOverrunDetection is false.
-}
+    if (!newSize)
+        return nullptr; // As with realloc, this frees p.
 
+    uint8_t* pCurrent = static_cast<uint8_t*>(p);
 
-void DebugPageHeap::SetMaxDelayedFreeCount(size_t maxDelayedFreeCount)
-{
-    if(FreedBlockArray)
-    {
-        SafeMMapFree(FreedBlockArray, FreedBlockArrayMaxSize * sizeof(Block));
-        FreedBlockArrayMaxSize = 0;
-    }
+    const bool aligned = ((newAlign <= DefaultAlignment) || ((reinterpret_cast<uintptr_t>(p) & (newAlign - 1)) == 0));
 
-    if(maxDelayedFreeCount)
+    if ((pCurrent == LastAlloc) && aligned) // If we can resize in place...
     {
-        FreedBlockArray = (Block*)SafeMMapAlloc(maxDelayedFreeCount * sizeof(Block));
-        OVR_ASSERT(FreedBlockArray);
+        size_t offset = (size_t)(pCurrent - Base);
 
-        if(FreedBlockArray)
+        if ((newSize <= (ReserveSize - offset)) && Commit(offset + newSize))
         {
-            FreedBlockArrayMaxSize = maxDelayedFreeCount;
-            #if defined(OVR_BUILD_DEBUG)
-                memset(FreedBlockArray, 0, maxDelayedFreeCount * sizeof(Block));
-            #endif
+            reinterpret_cast<size_t*>(pCurrent - HeaderSize)[0] = newSize;
+            UsedSize = (offset + newSize);
+
+            if (UsedSize > PeakUsedSize)
+                PeakUsedSize = UsedSize;
+
+            return p;
         }
+
+        return nullptr;
+    }
+
+    void* pNew = AllocAligned(newSize, newAlign);
+
+    if (pNew)
+    {
+        size_t prevSize = GetAllocSize(p);
+        memcpy(pNew, p, (prevSize < newSize) ? prevSize : newSize);
     }
+
+    return pNew;
 }
 
 
-size_t DebugPageHeap::GetMaxDelayedFreeCount() const
+ArenaHeap* ArenaHeap::FindArena(const void* p)
 {
-    return FreedBlockArrayMaxSize;
+    const uintptr_t address = reinterpret_cast<uintptr_t>(p);
+
+    if ((address < ArenaHeapRangeBegin.load(std::memory_order_relaxed)) || (address >= ArenaHeapRangeEnd.load(std::memory_order_relaxed)))
+        return nullptr;
+
+    for (size_t i = 0; i < MaxArenaCount; ++i)
+    {
+        ArenaHeap* arena = ArenaHeapRegistry[i].load(std::memory_order_acquire);
+
+        if (arena && arena->Contains(p))
+            return arena;
+    }
+
+    return nullptr;
 }
 
 
-void* DebugPageHeap::Alloc(size_t size)
+ArenaHeap* ArenaHeap::GetThreadArena()
 {
-    #if defined(_WIN32)
-        return AllocAligned(size, DefaultAlignment);
-    #else
-        return malloc(size);
-    #endif
+    return ThreadArenaHeap;
 }
 
 
-void* DebugPageHeap::AllocAligned(size_t size, size_t align)
+ArenaHeap* ArenaHeap::SetThreadArena(ArenaHeap* arena)
 {
-    #if defined(_WIN32)
-        OVR_ASSERT(align <= PageSize);
+    ArenaHeap* previousArena = ThreadArenaHeap;
+    ThreadArenaHeap = arena;
+    return previousArena;
+}
 
-        Lock::Locker autoLock(&Lock);
 
-        if(align < DefaultAlignment)
-            align = DefaultAlignment;
 
-        // The actual needed size may be a little less than this, but it's hard to tell how the size and alignments will play out.
-        size_t maxRequiredSize = AlignSizeUp(size, align) + SizeStorageSize;
+//------------------------------------------------------------------------
+// ***** PoolAllocator
+//
 
-        if(align > SizeStorageSize)
-        {
-            // Must do: more sophisticated fitting, as maxRequiredSize is potentially too small.
-            OVR_ASSERT(SizeStorageSize <= align);
-        }
+// The per-thread free lists of all pools. Found via thread-local storage, and linked into a global
+// list so that GetStats can sum them up and so that a thread can take over the lists of an exited
+// thread which had the same id. As with AllocatorTagStack, these are never freed and the list is
+// lock-free, as pooled objects may be created during static init.
+struct PoolThreadCache
+{
+    struct Entry
+    {
+        void*                 FreeList;         // PoolAllocator::FreeSlot*
+        std::atomic<uint32_t> FreeCount;        // Written only by the owning thread.
+        std::atomic<uint64_t> AllocCount;       // Written only by the owning thread.
+        std::atomic<uint64_t> FreeCallCount;    // Written only by the owning thread.
+    };
+
+    PoolThreadCache* Next;                      // Set before the cache is added to PoolThreadCacheList and never changed after.
+    uint32_t         ThreadId;
+    Entry            Entries[PoolAllocator::MaxPoolCount];
+};
 
-        size_t blockSize = AlignSizeUp(maxRequiredSize, PageSize);
+static std::atomic<PoolThreadCache*>     PoolThreadCacheList(nullptr);
+static OVR_THREAD_LOCAL PoolThreadCache* ThreadPoolCache = nullptr;
+static std::atomic<PoolAllocator*>       PoolAllocatorList(nullptr);
+static std::atomic<size_t>               PoolAllocatorCount(0);
 
-        if(OverrunPageEnabled)
-            blockSize += PageSize; // We add another page which will be uncommitted, so any read or write with it will except.
 
-        void* pBlockPtr;
+static PoolThreadCache* GetPoolThreadCache()
+{
+    if (ThreadPoolCache)
+        return ThreadPoolCache;
 
-        if((FreedBlockArraySize == FreedBlockArrayMaxSize) && FreedBlockArrayMaxSize &&     // If there is an old block we can recycle...
-           (FreedBlockArray[FreedBlockArrayOldest].BlockSize == blockSize))                 // We require it to be the exact size, as there would be some headaches for us if it was over-sized.
-        {
-            pBlockPtr = EnablePageMemory(FreedBlockArray[FreedBlockArrayOldest].BlockPtr, blockSize);  // Convert this memory from PAGE_NOACCESS back to PAGE_READWRITE.
-            FreedBlockArray[FreedBlockArrayOldest].Clear();
-            
-            if(++FreedBlockArrayOldest == FreedBlockArrayMaxSize)
-                FreedBlockArrayOldest = 0;
-        }
-        else
-        {
-            pBlockPtr = AllocCommittedPageMemory(blockSize); // Allocate a new block of one or more pages (via VirtualAlloc).
-        }
+    const uint32_t threadId = GetThreadId();
+    PoolThreadCache* cache;
 
-        if(pBlockPtr)
-        {
-            void*   pUserPtr = GetUserPosition(pBlockPtr, blockSize, size, align);
-            size_t* pSizePos = GetSizePosition(pUserPtr);
+    for (cache = PoolThreadCacheList.load(std::memory_order_acquire); cache; cache = cache->Next)
+    {
+        if (cache->ThreadId == threadId) // The thread which had our id previously must have exited. Its free slots are ours now.
+            break;
+    }
 
-            pSizePos[UserSizeIndex] = size;
-            pSizePos[BlockSizeIndex] = blockSize;
-            AllocationCount++;
+    if (!cache)
+    {
+        void* memory = SafeMMapAlloc(sizeof(PoolThreadCache)); // Returned memory is 0-filled.
 
-            return pUserPtr;
-        }
+        if (!memory)
+            return nullptr;
 
-        return nullptr;
-    #else
-        OVR_ASSERT_AND_UNUSED(align <= DefaultAlignment, align);
-        return DebugPageHeap::Alloc(size);
-    #endif
-}
+        cache = new(memory) PoolThreadCache;
+        cache->ThreadId = threadId;
+        cache->Next = PoolThreadCacheList.load(std::memory_order_relaxed);
 
+        while (!PoolThreadCacheList.compare_exchange_weak(cache->Next, cache, std::memory_order_release, std::memory_order_relaxed))
+            { }
+    }
 
-size_t DebugPageHeap::GetUserSize(const void* p)
-{
-    #if defined(_WIN32)
-        return GetSizePosition(p)[UserSizeIndex];
-    #elif defined(__APPLE__)
-        return malloc_size(p);
-    #else
-        return malloc_usable_size(const_cast<void*>(p));
-    #endif
+    ThreadPoolCache = cache;
+    return cache;
 }
 
 
-size_t DebugPageHeap::GetBlockSize(const void* p)
+PoolAllocator* PoolAllocator::Create(size_t slotSize, const char* name)
 {
-    #if defined(_WIN32)
-        return GetSizePosition(p)[BlockSizeIndex];
-    #else
-        OVR_UNUSED(p);
-        return 0;
-    #endif
-}
+    void* memory = SafeMMapAlloc(sizeof(PoolAllocator));
 
+    if (!memory)
+        return nullptr;
 
-size_t* DebugPageHeap::GetSizePosition(const void* p)
-{
-    // No thread safety required as per our design, as we assume that anybody 
-    // who owns a pointer returned by Alloc cannot have another thread take it away.
+    Allocator* allocator   = Allocator::GetInstance();
+    bool       passThrough = (allocator && allocator->IsDebugPageHeapEnabled());
+    size_t     index       = PoolAllocatorCount++;
 
-    // We assume the pointer is a valid pointer allocated by this allocator.
-    // We store some size values into the memory returned to the user, a few bytes before it.
-    size_t  value    = reinterpret_cast<size_t>(p);
-    size_t  valuePos = (value - SizeStorageSize);
-    size_t* pSize    = reinterpret_cast<size_t*>(valuePos);
+    PoolAllocator* pool = new(memory) PoolAllocator(slotSize, name, index, passThrough);
 
-    return pSize;
+    pool->Next = PoolAllocatorList.load(std::memory_order_relaxed);
+    while (!PoolAllocatorList.compare_exchange_weak(pool->Next, pool, std::memory_order_release, std::memory_order_relaxed))
+        { }
+
+    return pool;
 }
 
 
-void* DebugPageHeap::Realloc(void* p, size_t newSize)
+PoolAllocator* PoolAllocator::GetFirstPool()
 {
-    #if defined(_WIN32)
-        return ReallocAligned(p, newSize, DefaultAlignment);
-    #else
-        void* newP = realloc(p, newSize);
+    return PoolAllocatorList.load(std::memory_order_acquire);
+}
 
-        if(newP) // Need to check newP because realloc doesn't free p unless it returns a valid newP.
-        {
-            #if !defined(__clang_analyzer__) // The analyzer complains that we are using p after it was freed.
-                untrackAlloc(p);
-            #endif
-        }
-        trackAlloc(newP, newSize);
-        return newP;
-    #endif
+
+PoolAllocator::PoolAllocator(size_t slotSize, const char* name, size_t index, bool passThrough)
+  : Next(nullptr)
+  , Name(name)
+  , SlotSize(AlignSizeUp((slotSize < sizeof(FreeSlot)) ? sizeof(FreeSlot) : slotSize, SlotAlignment))
+  , Index(index)
+  , PassThrough(passThrough)
+  , CentralLock()
+  , SlabList(nullptr)
+  , SlabCount(0)
+  , CentralFreeList(nullptr)
+  , CentralFreeCount(0)
+  , CentralAllocCount(0)
+  , CentralFreeCallCount(0)
+{
+    OVR_ASSERT(SlotSize <= (SlabSize / 4)); // Else we'd waste too much of each slab.
 }
 
 
-void* DebugPageHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
+bool PoolAllocator::AllocSlab()
 {
-    #if defined(_WIN32)
-        // The ISO C99 standard states:
-        //     The realloc function deallocates the old object pointed to by ptr and 
-        //     returns a pointer to a new object that has the size specified by size. 
-        //     The contents of the new object shall be the same as that of the old 
-        //     object prior to deallocation, up to the lesser of the new and old sizes. 
-        //     Any bytes in the new object beyond the size of the old object have
-        //     indeterminate values.
-        //
-        //     If ptr is a null pointer, the realloc function behaves like the malloc 
-        //     function for the specified size. Otherwise, if ptr does not match a 
-        //     pointer earlier returned by the calloc, malloc, or realloc function, 
-        //     or if the space has been deallocated by a call to the free or realloc 
-        //     function, the behavior is undefined. If memory for the new object 
-        //     cannot be allocated, the old object is not deallocated and its value 
-        //     is unchanged.
-        //     
-        //     The realloc function returns a pointer to the new object (which may have 
-        //     the same value as a pointer to the old object), or a null pointer if 
-        //     the new object could not be allocated.
-
-        // A mutex lock isn't required, as the functions below will handle it internally.
-        // But having it here is a little more efficient because it woudl otherwise be 
-        // locked and unlocked multiple times below, with possible context switches in between.
-        Lock::Locker autoLock(&Lock);
-
-        void* pReturn = nullptr;
+    Slab* slab = static_cast<Slab*>(SafeMMapAlloc(SlabSize));
 
-        if(p)
-        {
-            if(newSize)
-            {
-                pReturn = AllocAligned(newSize, newAlign);
+    if (!slab)
+        return false;
 
-                if(pReturn)
-                {
-                    size_t prevSize = GetUserSize(p);
+    slab->Next = SlabList;
+    SlabList = slab;
+    SlabCount++;
 
-                    if(newSize > prevSize)
-                        newSize = prevSize;
+    // The slab header takes the first slot.
+    uint8_t* const slabBegin = reinterpret_cast<uint8_t*>(slab);
+    uint8_t* const slabEnd   = (slabBegin + SlabSize);
 
-                    memcpy(pReturn, p, newSize);
-                    Free(p);
-                } // Else fall through, leaving p's memory unmodified and returning nullptr.
-            }
-            else
-            {
-                Free(p);
-            }
-        }
-        else if(newSize)
-        {
-            pReturn = AllocAligned(newSize, newAlign);
-        }
+    for (uint8_t* p = (slabEnd - SlotSize); p >= (slabBegin + SlotSize); p -= SlotSize) // Push in reverse so that the list starts at the low end.
+    {
+        FreeSlot* slot = reinterpret_cast<FreeSlot*>(p);
+        slot->Next = CentralFreeList;
+        CentralFreeList = slot;
+        CentralFreeCount++;
+    }
 
-        return pReturn;
-    #else
-        OVR_ASSERT_AND_UNUSED(newAlign <= DefaultAlignment, newAlign);
-        return DebugPageHeap::Realloc(p, newSize);
-    #endif
+    return true;
 }
 
 
-void DebugPageHeap::Free(void *p)
+PoolAllocator::FreeSlot* PoolAllocator::TakeFromCentral(size_t& count)
 {
-    #if defined(_WIN32)
-        if(p)
-        {
-            // Creating a scope for the lock
-            {
-                Lock::Locker autoLock(&Lock);
-
-                if(FreedBlockArrayMaxSize)  // If we have a delayed free list...
-                {
-                    // We don't free the page(s) associated with this but rather put them in the FreedBlockArray in an inaccessible state for later freeing.
-                    // We do this because we don't want those pages to be available again in the near future, so we can detect use-after-free misakes.
-                    Block* pBlockNew;
+    Lock::Locker locker(&CentralLock);
 
-                    if(FreedBlockArraySize == FreedBlockArrayMaxSize) // If we have reached freed block capacity... we can start purging old elements from it as a circular queue.
-                    {
-                        pBlockNew = &FreedBlockArray[FreedBlockArrayOldest];
+    if (!CentralFreeList && !AllocSlab())
+    {
+        count = 0;
+        return nullptr;
+    }
 
-                        // The oldest element in the container is FreedBlockArrayOldest.
-                        if(pBlockNew->BlockPtr) // Currently this should always be true.
-                        {
-                            FreePageMemory(pBlockNew->BlockPtr, pBlockNew->BlockSize);
-                            pBlockNew->Clear();
-                        }
+    FreeSlot* first = CentralFreeList;
+    FreeSlot* last  = first;
+    size_t    taken = 1;
 
-                        if(++FreedBlockArrayOldest == FreedBlockArrayMaxSize)
-                            FreedBlockArrayOldest = 0;
-                    }
-                    else // Else we are still building the container and not yet treating it a circular.
-                    {
-                        pBlockNew = &FreedBlockArray[FreedBlockArraySize++];
-                    }
+    while ((taken < count) && last->Next)
+    {
+        last = last->Next;
+        taken++;
+    }
 
-                    pBlockNew->BlockPtr  = GetBlockPtr(p);
-                    pBlockNew->BlockSize = GetBlockSize(p);
-
-                    #if defined(OVR_BUILD_DEBUG)
-                        if(OverrunGuardBytesEnabled) // If we have extra bytes at the end of the user's allocation between it and an inaccessible guard page...
-                        {
-                            const size_t   userSize = GetUserSize(p);
-                            const uint8_t* pUserEnd = (static_cast<uint8_t*>(p) + userSize);
-                            const uint8_t* pPageEnd = AlignPointerUp(pUserEnd, PageSize);
-
-                            while(pUserEnd != pPageEnd)
-                            {
-                                if(*pUserEnd++ != GuardFillByte)
-                                {
-                                    OVR_FAIL();
-                                    break;
-                                }
-                            }
-                        }
-                    #endif
-
-                    DisablePageMemory(pBlockNew->BlockPtr, pBlockNew->BlockSize); // Make it so that future attempts to use this memory result in an exception.
-                }
-                else
-                {
-                    FreePageMemory(GetBlockPtr(p), GetBlockSize(p));
-                }
+    CentralFreeList = last->Next;
+    CentralFreeCount -= taken;
+    last->Next = nullptr;
+    count = taken;
 
-                AllocationCount--;
-            }
-        }
-    #else
-        untrackAlloc(p);
-        return free(p);
-    #endif
+    return first;
 }
 
 
-void DebugPageHeap::FreeAligned(void* p)
+void PoolAllocator::ReturnToCentral(FreeSlot* first, FreeSlot* last, size_t count)
 {
-    return Free(p);
+    Lock::Locker locker(&CentralLock);
+
+    last->Next = CentralFreeList;
+    CentralFreeList = first;
+    CentralFreeCount += count;
 }
 
 
-// Converts a user pointer to the beginning of its page.
-void* DebugPageHeap::GetBlockPtr(void* p)
+void* PoolAllocator::Alloc()
 {
-    // We store size info before p in memory, and this will, by design, be always somewhere within 
-    // the first page of a block of pages. So just align down to the beginning of its page.
-    return AlignPointerDown(GetSizePosition(p), PageSize);
+    if (PassThrough)
+        return Allocator::GetInstance()->Alloc(SlotSize, Name);
+
+    if (ArenaHeap* arena = ArenaHeap::GetThreadArena()) // Pooled objects created within an ArenaHeapScope live in the arena like anything else.
+        return arena->Alloc(SlotSize);
+
+    void* p = AllocSlot();
+
+    if (p)
+    {
+        Allocator* allocator = Allocator::GetInstance(false); // Pooled objects may be created before the Allocator.
+
+        if (allocator && allocator->IsTrackingEnabled())
+            allocator->TrackPoolSlot(p, SlotSize, Name);
+    }
+
+    return p;
 }
 
 
-void* DebugPageHeap::GetUserPosition(void* pPageMemory, size_t blockSize, size_t userSize, size_t userAlignment)
+void* PoolAllocator::AllocSlot()
 {
-    uint8_t* pUserPosition;
+    PoolThreadCache* cache = ((Index < MaxPoolCount) ? GetPoolThreadCache() : nullptr);
 
-    if(OverrunPageEnabled)
+    if (!cache) // If we must use the central list directly...
     {
-        // We need to return the highest position within the page memory that fits the user size while being aligned to userAlignment.
-        const size_t pageEnd      = reinterpret_cast<size_t>(pPageMemory) + (blockSize - PageSize); // pageEnd points to the beginning of the final guard page.
-        const size_t userPosition = AlignSizeDown(pageEnd - userSize, userAlignment);
-        pUserPosition = reinterpret_cast<uint8_t*>(userPosition);
-        OVR_ASSERT((userPosition + userSize) <= pageEnd);
+        size_t count = 1;
+        void*  p = TakeFromCentral(count);
 
-        // If userSize is not a multiple of userAlignment then there will be (userAlignment - userSize) bytes
-        // of unused memory between the user allocated space and the end of the page. There is no way around having this.
-        // For example, a user allocation of 3 bytes with 8 byte alignment will leave 5 unused bytes at the end of the page.
-        // We optionally fill those unused bytes with a pattern and upon Free verify that the pattern is undisturbed.
-        // This won't detect reads or writes in that area immediately as with reads or writes beyond that, but it will
-        // at least detect them at some point (e.g. upon Free).
-        #if defined(OVR_BUILD_DEBUG)
-            if(OverrunGuardBytesEnabled)
-            {
-                uint8_t* const pUserEnd = (pUserPosition + userSize);
-                const size_t remainingByteCount = (reinterpret_cast<uint8_t*>(pageEnd) - pUserEnd);
-                if(remainingByteCount) // If there are any left-over bytes...
-                    memset(pUserEnd, GuardFillByte, remainingByteCount);
-            }
-        #endif
+        if (p)
+            CentralAllocCount++;
+
+        return p;
     }
-    else
+
+    PoolThreadCache::Entry& entry = cache->Entries[Index];
+
+    if (!entry.FreeList)
     {
-        // We need to return the first position in the first page after SizeStorageSize bytes which is aligned to userAlignment.
-        const size_t lowestPossiblePos = reinterpret_cast<size_t>(pPageMemory) + SizeStorageSize;
-        const size_t userPosition = AlignSizeUp(lowestPossiblePos, userAlignment);
-        pUserPosition = reinterpret_cast<uint8_t*>(userPosition);
-        OVR_ASSERT((userPosition + userSize) <= (reinterpret_cast<size_t>(pPageMemory) + blockSize));
+        size_t count = TransferCount;
+        entry.FreeList = TakeFromCentral(count);
+        entry.FreeCount.store((uint32_t)count, std::memory_order_relaxed);
+
+        if (!entry.FreeList)
+            return nullptr;
     }
 
-    // Assert that the returned user pointer (actually the size info before it) will be within the first page.
-    // This is important because it verifieds that we haven't wasted memory and because 
-    // our functionality for telling the start of the page block depends on it.
-    OVR_ASSERT(AlignPointerDown(GetSizePosition(pUserPosition), PageSize) == pPageMemory);
+    FreeSlot* slot = static_cast<FreeSlot*>(entry.FreeList);
+    entry.FreeList = slot->Next;
+    entry.FreeCount.store(entry.FreeCount.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    entry.AllocCount.store(entry.AllocCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 
-    return pUserPosition;
+    return slot;
 }
 
 
-void* DebugPageHeap::AllocCommittedPageMemory(size_t blockSize)
+void PoolAllocator::Free(void* p)
 {
-    #if defined(_WIN32)
-        void* p;
-    
-        if(OverrunPageEnabled)
-        {
-            // We need to make it so that last page is MEM_RESERVE and the previous pages are MEM_COMMIT + PAGE_READWRITE.
-            OVR_ASSERT(blockSize > PageSize); // There should always be at least one extra page.
+    if (!p)
+        return;
 
-            // Reserve blockSize amount of pages.
-            // We could possibly use PAGE_GUARD here for the last page. This differs from simply leaving it reserved
-            // because the OS will generate a one-time-only gaurd page exception. We probabl don't want this, as it's
-            // more useful for maintaining your own stack than for catching unintended overruns.
-            p = VirtualAlloc(nullptr, blockSize, MEM_RESERVE, PAGE_READWRITE);
+    if (PassThrough)
+    {
+        Allocator::GetInstance()->Free(p);
+        return;
+    }
 
-            if(p)
-            {
-                // Commit all but the last page. Leave the last page as merely reserved so that reads from or writes
-                // to it result in an immediate exception.
-                p = VirtualAlloc(p, blockSize - PageSize, MEM_COMMIT, PAGE_READWRITE);
-            }
-        }
-        else
-        {
-            // We need to make it so that all pages are MEM_COMMIT + PAGE_READWRITE.
-            p = VirtualAlloc(nullptr, blockSize, MEM_COMMIT, PAGE_READWRITE);
-        }
+    if (ArenaHeap::FindArena(p))
+        return; // Freed upon ArenaHeap::Reset.
 
-        #if defined(OVR_BUILD_DEBUG)
-            if(!p)
-            {
-                // To consider: Make a generic OVRKernel function for formatting system errors. We could move 
-                // the OVRError GetSysErrorCodeString from LibOVR/OVRError.h to LibOVRKernel/OVR_DebugHelp.h
-                DWORD dwLastError = GetLastError();
-                WCHAR osError[256];
-                DWORD osErrorBufferCapacity = OVR_ARRAY_COUNT(osError);
-                CHAR  reportedError[384];
-                DWORD length = FormatMessageW(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr, (DWORD)dwLastError, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), osError, osErrorBufferCapacity, nullptr);
-        
-                if (length)
-                {
-                    std::string errorBuff = UCSStringToUTF8String(osError, length + 1);
-                    snprintf(reportedError, OVR_ARRAY_COUNT(reportedError), "DebugPageHeap: VirtualAlloc failed with error: %s", errorBuff.c_str());
-                }
-                else
-                {
-                    snprintf(reportedError, OVR_ARRAY_COUNT(reportedError), "DebugPageHeap: VirtualAlloc failed with error: %d.", dwLastError);
-                }
+    Allocator* allocator = Allocator::GetInstance(false);
 
-                //LogError("%s", reportedError); Disabled because this call turns around and allocates memory, yet we may be in a broken or exhausted memory situation.
-                OVR_FAIL_M(reportedError);
-            }
-        #endif
+    if (allocator && allocator->IsTrackingEnabled())
+        allocator->UntrackPoolSlot(p);
 
-        return p;
-    #else
-        OVR_UNUSED2(blockSize, OverrunPageEnabled);
-        return nullptr;
-    #endif
-}
+    FreeSlot*        slot  = static_cast<FreeSlot*>(p);
+    PoolThreadCache* cache = ((Index < MaxPoolCount) ? GetPoolThreadCache() : nullptr);
 
+    if (!cache)
+    {
+        ReturnToCentral(slot, slot, 1);
+        CentralFreeCallCount++;
+        return;
+    }
 
-// We convert disabled page memory (see DisablePageMemory) to enabled page memory. The output is the same 
-// as with AllocPageMemory.
-void* DebugPageHeap::EnablePageMemory(void* pPageMemory, size_t blockSize)
-{
-    #if defined(_WIN32)
-        // Make sure the entire range of memory is of type PAGE_READWRITE.
-        DWORD dwPrevAccess = 0;
-        BOOL result = VirtualProtect(pPageMemory, OverrunPageEnabled ? (blockSize - PageSize) : blockSize, PAGE_READWRITE, &dwPrevAccess);
-        OVR_ASSERT_AND_UNUSED(result, result);
-    #else
-        OVR_UNUSED3(pPageMemory, blockSize, OverrunPageEnabled);
-    #endif
+    PoolThreadCache::Entry& entry = cache->Entries[Index];
+    uint32_t freeCount = entry.FreeCount.load(std::memory_order_relaxed);
 
-    return pPageMemory;
+    slot->Next = static_cast<FreeSlot*>(entry.FreeList);
+    entry.FreeList = slot;
+    entry.FreeCallCount.store(entry.FreeCallCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if (++freeCount >= MaxThreadFreeCount) // If this thread mostly frees what other threads allocate, give the surplus back.
+    {
+        FreeSlot* first = slot;
+        FreeSlot* last  = first;
+
+        for (size_t i = 1; i < TransferCount; ++i)
+            last = last->Next;
+
+        entry.FreeList = last->Next;
+        freeCount -= (uint32_t)TransferCount;
+        ReturnToCentral(first, last, TransferCount);
+    }
+
+    entry.FreeCount.store(freeCount, std::memory_order_relaxed);
 }
 
 
-void DebugPageHeap::DisablePageMemory(void* pPageMemory, size_t blockSize)
+bool PoolAllocator::Contains(const void* p) const
 {
-    #if defined(_WIN32)
-        // Disable access to the page(s). It's faster for us to change the page access than it is to decommit or free the pages.
-        // However, this results in more committed physical memory usage than we would need if we instead decommitted the memory.
-        DWORD dwPrevAccesss = 0;
-        BOOL result = VirtualProtect(pPageMemory, OverrunPageEnabled ?  (blockSize - PageSize) : blockSize, PAGE_NOACCESS, &dwPrevAccesss);
-        OVR_ASSERT_AND_UNUSED(result, result);
-    #else
-        OVR_UNUSED2(pPageMemory, blockSize);
-    #endif
+    if (PassThrough)
+        return false;
+
+    Lock::Locker locker(&CentralLock);
+
+    for (const Slab* slab = SlabList; slab; slab = slab->Next)
+    {
+        const uint8_t* slabBegin = reinterpret_cast<const uint8_t*>(slab);
+
+        if ((p >= slabBegin) && (p < (slabBegin + SlabSize)))
+            return true;
+    }
+
+    return false;
 }
 
 
-void DebugPageHeap::FreePageMemory(void* pPageMemory, size_t /*blockSize*/)
+void PoolAllocator::GetStats(Stats& stats) const
 {
-    #if defined(_WIN32)    
-        BOOL result = VirtualFree(pPageMemory, 0, MEM_RELEASE);
-        OVR_ASSERT_AND_UNUSED(result, result);
-    #else
-        OVR_UNUSED(pPageMemory);
-    #endif
+    uint64_t allocCount = CentralAllocCount.load(std::memory_order_relaxed);
+    uint64_t freeCount  = CentralFreeCallCount.load(std::memory_order_relaxed);
+
+    stats.ThreadFreeCount = 0;
+
+    if (Index < MaxPoolCount)
+    {
+        for (const PoolThreadCache* cache = PoolThreadCacheList.load(std::memory_order_acquire); cache; cache = cache->Next)
+        {
+            const PoolThreadCache::Entry& entry = cache->Entries[Index];
+
+            allocCount            += entry.AllocCount.load(std::memory_order_relaxed);
+            freeCount             += entry.FreeCallCount.load(std::memory_order_relaxed);
+            stats.ThreadFreeCount += entry.FreeCount.load(std::memory_order_relaxed);
+        }
+    }
+
+    Lock::Locker locker(&CentralLock);
+
+    stats.SlabCount        = SlabCount;
+    stats.SlotCapacity     = (SlabCount * ((SlabSize / SlotSize) - 1));
+    stats.LiveCount        = ((allocCount > freeCount) ? (allocCount - freeCount) : 0);
+    stats.CentralFreeCount = CentralFreeCount;
 }
 
 
@@ -3314,6 +6835,7 @@ int AllocatorReportStateDbgCmd(const std::vector<std::string>&, std::string* out
         bool     osHeapEnabled          = allocator->IsOSHeapEnabled();
         bool     mallocRedirectEnabled  = allocator->IsMallocRedirectEnabled();
         bool     traceOnShutdownEnabled = allocator->IsAllocationTraceOnShutdownEnabled();
+        size_t   sampleInterval         = allocator->GetSampleInterval();
         uint64_t heapTimeNs             = allocator->GetCurrentHeapTimeNs();
         uint64_t heapCounter            = allocator->GetCounter();
         uint64_t heapTrackedCount       = 0;
@@ -3344,6 +6866,10 @@ int AllocatorReportStateDbgCmd(const std::vector<std::string>&, std::string* out
         strStream << "Underlying heap: " << (debugPageHeapEnabled ? "debug page heap." : (osHeapEnabled ? "os heap." : "malloc-based heap.")) << std::endl;
         strStream << "malloc redirection: " << (mallocRedirectEnabled ? "" : "not ") << "enabled." << std::endl;
         strStream << "Shutdown trace: " << (traceOnShutdownEnabled ? "" : "not ") << "enabled." << std::endl;
+        if (sampleInterval)
+            strStream << "Heap sampling: enabled, interval " << sampleInterval << " bytes." << std::endl;
+        else
+            strStream << "Heap sampling: not enabled." << std::endl;
         strStream << "Heap time (ns): " << heapTimeNs << std::endl;
         strStream << "Heap counter: " << heapCounter << std::endl;
         strStream << "Heap allocated count: " << heapTrackedCount << std::endl;
@@ -3360,6 +6886,176 @@ int AllocatorReportStateDbgCmd(const std::vector<std::string>&, std::string* out
     return (allocator ? 0 : -1);
 }
 
+// AllocatorEnableSamplingDbgCmd
+const char* allocatorEnableSamplingDbgCmdName  = "Allocator.EnableSampling";
+const char* allocatorEnableSamplingDbgCmdUsage = "[sample interval in bytes]";
+const char* allocatorEnableSamplingDbgCmdDesc  = "Enables or disables heap sampling.";
+const char* allocatorEnableSamplingDbgCmdDoc   = "Enables heap sampling, in any build. This allows for sampled heap profiles (e.g. Allocator.TraceSamples cmd)\n"
+                                                 "On average one allocation is sampled per interval bytes allocated. The default interval is 524288.\n"
+                                                 "An interval of 0 disables sampling. Any existing samples are discarded.\n"
+                                                 "Sampling can be enabled on startup in release builds by setting the appropriate registry key:\n"
+                                                 "    HKEY_LOCAL_MACHINE\\SOFTWARE\\Oculus\\HeapSamplingEnabled, REG_DWORD of 0 or 1.\n"
+                                                 "Example usage:\n"
+                                                 "    Allocator.EnableSampling\n"
+                                                 "    Allocator.EnableSampling 65536\n"
+                                                 "    Allocator.EnableSampling 0\n";
+int AllocatorEnableSamplingDbgCmd(const std::vector<std::string>& args, std::string* output)
+{
+    OVR::Allocator* allocator = OVR::Allocator::GetInstance(false);
+
+    if (allocator)
+    {
+        size_t sampleInterval = ((args.size() >= 2) ? (size_t)strtoull(args[1].c_str(), nullptr, 10) : Allocator::DefaultSampleInterval);
+
+        allocator->EnableSampling(sampleInterval);
+
+        if (sampleInterval)
+            output->append("Allocator sampling enabled.");
+        else
+            output->append("Allocator sampling disabled.");
+    }
+    else
+        output->append("Allocator not found.");
+
+    return (allocator ? 0 : -1);
+}
+
+// AllocatorTraceSamplesDbgCmd
+const char* allocatorTraceSamplesDbgCmdName  = "Allocator.TraceSamples";
+const char* allocatorTraceSamplesDbgCmdUsage = "<filepath> [callsite|tag]";
+const char* allocatorTraceSamplesDbgCmdDesc  = "Writes the estimated live heap of the default allocator by call site or by tag.";
+const char* allocatorTraceSamplesDbgCmdDoc   = "Writes the estimated live heap of the default allocator, grouped by call site (the default) or by tag.\n"
+                                               "Requires heap sampling to be enabled. See Allocator.EnableSampling.\n"
+                                               "Stack traces will be symbolized if the symbol files are present; otherwise they will be missing.\n"
+                                               "\n"
+                                               "Example usage:\n"
+                                               "    Allocator.TraceSamples C:\\temp\\samples.txt\n"
+                                               "    Allocator.TraceSamples C:\\temp\\samples.txt tag\n";
+int AllocatorTraceSamplesDbgCmd(const std::vector<std::string>& args, std::string* output)
+{
+    OVR_DISABLE_MSVC_WARNING(4996) // 4996: This function or variable may be unsafe.
+
+    OVR::Allocator* allocator = OVR::Allocator::GetInstance(false);
+    if (allocator)
+    {
+        std::stringstream strStream;
+
+        if (!allocator->IsSamplingEnabled())
+        {
+            output->append("Allocator sampling is not enabled. To enable, use the Allocator.EnableSampling command or set the DWORD HKEY_LOCAL_MACHINE\\SOFTWARE\\Oculus\\HeapSamplingEnabled reg key before starting the application.");
+            return -1;
+        }
+
+        if (args.size() < 2)
+        {
+            output->append("Filepath first argument is required but was not supplied. See example usage.");
+            return -1;
+        }
+
+        Allocator::SampleGrouping grouping = Allocator::SampleGroupByCallSite;
+
+        if ((args.size() >= 3) && (OVR_stricmp(args[2].c_str(), "tag") == 0))
+            grouping = Allocator::SampleGroupByTag;
+
+        std::string filePath = args[1];
+        FILE* file;
+        errno_t err;
+        err = fopen_s(&file, filePath.c_str(), "w");
+
+        if (err || !file)
+        {
+            strStream << "Failed to open " << filePath;
+            *output = strStream.str();
+            return -1;
+        }
+
+        uint64_t estimatedBytes = allocator->TraceSampledAllocations(grouping,
+            [](uintptr_t context, const char* text)->void
+            {
+                FILE* pFile = reinterpret_cast<FILE*>(context);
+                fwrite(text, 1, strlen(text), pFile);
+            }, (uintptr_t)file);
+        strStream << "Estimated live heap of " << estimatedBytes << " bytes reported to " << filePath;
+
+        std::string str = strStream.str();
+        output->append(str.data(), str.length()); // We don't directly assign string objects because currently we are crossing a DLL boundary between these two strings.
+
+        fclose(file);
+        return 0;
+    }
+
+    output->append("Allocator not found.");
+    return -1;
+
+    OVR_RESTORE_MSVC_WARNING()
+}
+
+// AllocatorReportPoolsDbgCmd
+const char* allocatorReportPoolsDbgCmdName  = "Allocator.ReportPools";
+const char* allocatorReportPoolsDbgCmdUsage = "(no arguments)";
+const char* allocatorReportPoolsDbgCmdDesc  = "Reports the occupancy of each PoolAllocator.";
+const char* allocatorReportPoolsDbgCmdDoc   = "Reports the occupancy of each PoolAllocator (see OVR_MEMORY_REDEFINE_NEW_POOLED).\n"
+                                              "Occupancy is the percentage of slab slots which are allocated. The remainder is memory\n"
+                                              "which the pool holds but doesn't use, as pools never give slabs back to the system.\n"
+                                              "Example usage:\n"
+                                              "    Allocator.ReportPools\n";
+int AllocatorReportPoolsDbgCmd(const std::vector<std::string>&, std::string* output)
+{
+    std::stringstream strStream;
+    size_t poolCount = 0;
+
+    for (const PoolAllocator* pool = PoolAllocator::GetFirstPool(); pool; pool = pool->GetNextPool(), ++poolCount)
+    {
+        PoolAllocator::Stats stats;
+        pool->GetStats(stats);
+
+        double occupancy = (stats.SlotCapacity ? ((100.0 * stats.LiveCount) / stats.SlotCapacity) : 0.0);
+
+        strStream << pool->GetName() << ": slot size " << pool->GetSlotSize()
+                  << ", live " << stats.LiveCount << " of " << stats.SlotCapacity << " slots (" << (int)occupancy << "% occupancy)"
+                  << ", " << stats.SlabCount << " slabs (" << (stats.SlabCount * PoolAllocator::SlabSize) << " bytes)"
+                  << ", free in thread lists " << stats.ThreadFreeCount
+                  << ", free in central list " << stats.CentralFreeCount << std::endl;
+    }
+
+    if (!poolCount)
+        strStream << "No pools have been created." << std::endl;
+
+    std::string str = strStream.str();
+    output->append(str.data(), str.length()); // We don't directly assign string objects because currently we are crossing a DLL boundary between these two strings.
+
+    return 0;
+}
+
+
+// AllocatorReportHeapStatsDbgCmd
+const char* allocatorReportHeapStatsDbgCmdName  = "Allocator.ReportHeapStats";
+const char* allocatorReportHeapStatsDbgCmdUsage = "(no arguments)";
+const char* allocatorReportHeapStatsDbgCmdDesc  = "Reports the heap statistics of the default allocator as JSON.";
+const char* allocatorReportHeapStatsDbgCmdDoc   = "Reports the heap statistics of the default allocator as JSON (see Allocator::GetHeapStats).\n"
+                                                  "PeakLiveBytes is approximate, and byte counts exclude aligned allocations.\n"
+                                                  "Example usage:\n"
+                                                  "    Allocator.ReportHeapStats\n";
+int AllocatorReportHeapStatsDbgCmd(const std::vector<std::string>&, std::string* output)
+{
+    Allocator* allocator = Allocator::GetInstance(false);
+
+    if (!allocator || !allocator->IsHeapStatsEnabled())
+    {
+        output->append("Heap statistics are disabled.\n");
+        return -1;
+    }
+
+    JSON* json = allocator->CreateHeapStatsJSON();
+    String str = json->Stringify(true);
+    json->Release();
+
+    output->append(str.ToCStr(), str.GetSize()); // We don't directly assign string objects because currently we are crossing a DLL boundary between these two strings.
+    output->append("\n");
+
+    return 0;
+}
+
 
 
 } // namespace OVR
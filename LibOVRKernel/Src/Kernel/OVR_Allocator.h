@@ -30,6 +30,7 @@ limitations under the License.
 #include "OVR_Types.h"
 #include "OVR_Atomic.h"
 #include "OVR_Std.h"
+#include "OVR_Rand.h"
 #include "stdlib.h"
 #include "stdint.h"
 
@@ -42,6 +43,8 @@ OVR_DISABLE_ALL_MSVC_WARNINGS()
 #include <exception>
 #include <new>
 #include <atomic>
+#include <type_traits>
+#include <utility>
 OVR_RESTORE_ALL_MSVC_WARNINGS()
 #if defined(_WIN32)
     #include "OVR_Win32_IncludeWindows.h"
@@ -133,6 +136,75 @@ OVR_RESTORE_ALL_MSVC_WARNINGS()
     OVR_MEMORY_REDEFINE_NEW_IMPL(class_name, OVR_MEMORY_CHECK_DELETE_NONE)
 
 
+// Like OVR_MEMORY_REDEFINE_NEW_IMPL, but allocates instances from a PoolAllocator dedicated to class_name.
+// This is intended for small classes which are allocated and freed frequently (e.g. tree nodes).
+// Derived classes which are larger than class_name are allocated from the general heap instead,
+// which is why delete takes the size. Their pointers are distinguished in the placement delete,
+// which has no size, by asking the pool.
+// Ref-counted classes use OVR_REFCOUNT_REDEFINE_NEW_POOLED (OVR_RefCount.h) instead.
+//
+// Example usage:
+//    class TreeNode
+//    {
+//    public:
+//        OVR_MEMORY_REDEFINE_NEW_POOLED(TreeNode)
+//    };
+//
+#define OVR_MEMORY_REDEFINE_NEW_POOLED_IMPL(class_name, check_delete)                \
+    static OVR::PoolAllocator* GetPoolAllocator()                                   \
+    {                                                                               \
+        static OVR::PoolAllocator* pool = OVR::PoolAllocator::Create(sizeof(class_name), #class_name); \
+        return pool;                                                                \
+    }                                                                               \
+                                                                                    \
+    void* operator new(size_t sz)                                                   \
+    {                                                                               \
+        void* p = ((sz <= sizeof(class_name)) ? GetPoolAllocator()->Alloc() :       \
+                                                OVR_ALLOC_DEBUG(sz, __FILE__, __LINE__)); \
+        if (!p)                                                                     \
+            throw OVR::bad_alloc();                                                 \
+        return p;                                                                   \
+    }                                                                               \
+                                                                                    \
+    void* operator new(size_t sz, const char* file, int line)                       \
+    {                                                                               \
+        OVR_UNUSED2(file, line);                                                    \
+        void* p = ((sz <= sizeof(class_name)) ? GetPoolAllocator()->Alloc() :       \
+                                                OVR_ALLOC_DEBUG(sz, file, line));   \
+        if (!p)                                                                     \
+            throw OVR::bad_alloc();                                                 \
+        return p;                                                                   \
+    }                                                                               \
+                                                                                    \
+    void operator delete(void* p, size_t sz)                                        \
+    {                                                                               \
+        if (p)                                                                      \
+        {                                                                           \
+            check_delete(class_name, p);                                            \
+            if (sz <= sizeof(class_name))                                           \
+                GetPoolAllocator()->Free(p);                                        \
+            else                                                                    \
+                OVR_FREE(p);                                                        \
+        }                                                                           \
+    }                                                                               \
+                                                                                    \
+    void operator delete(void* p, const char*, int)                                 \
+    {                                                                               \
+        if (p)                                                                      \
+        {                                                                           \
+            check_delete(class_name, p);                                            \
+            if (GetPoolAllocator()->Contains(p))                                    \
+                GetPoolAllocator()->Free(p);                                        \
+            else                                                                    \
+                OVR_FREE(p);                                                        \
+        }                                                                           \
+    }
+
+// Redefine all delete/new operators in a class to use a PoolAllocator.
+#define OVR_MEMORY_REDEFINE_NEW_POOLED(class_name) \
+    OVR_MEMORY_REDEFINE_NEW_POOLED_IMPL(class_name, OVR_MEMORY_CHECK_DELETE_NONE)
+
+
 namespace OVR {
 
 
@@ -187,6 +259,13 @@ OVR_FORCE_INLINE T*  Construct(void *p, const T& source)
     return ::new(p) T(source);
 }
 
+// Move-constructs from source, which is left in its moved-from state.
+template <class T>
+OVR_FORCE_INLINE T*  ConstructMove(void *p, T& source)
+{
+    return ::new(p) T(std::move(source));
+}
+
 // Same as above, but allows for a different type of constructor.
 template <class T, class S>
 OVR_FORCE_INLINE T*  ConstructAlt(void *p, const S& source)
@@ -237,6 +316,20 @@ OVR_FORCE_INLINE void DestructArray(T *pobj, size_t count)
 }
 
 
+//-----------------------------------------------------------------------------------
+// ***** IsTriviallyRelocatable
+//
+// True if a T can be moved to a new address by copying its bytes, after which the
+// old copy is not destructed. Containers use this to grow with memcpy or realloc instead
+// of constructing a copy of each element and destructing the original.
+// That's the case for trivially copyable types, and also for most types which only own
+// memory through a pointer, such as String and Ptr<>, which specialize this as true.
+// It's not the case for types which point into themselves or register their address.
+//
+//     template<> struct IsTriviallyRelocatable<MyType> : std::true_type { };
+//
+template <class T>
+struct IsTriviallyRelocatable : std::integral_constant<bool, std::is_trivially_copyable<T>::value> { };
 
 
 //-----------------------------------------------------------------------------------
@@ -410,6 +503,16 @@ public:
     virtual void   FreeAligned(void* p) = 0;
     virtual void*  Realloc(void* p, size_t newSize) = 0;
     virtual void*  ReallocAligned(void* p, size_t newSize, size_t newAlign) = 0;
+
+    // Attempts to grow (or shrink) the block p, which was allocated with Alloc, to at least newSize 
+    // bytes without moving it. Returns false if that's not possible, in which case p is unchanged. 
+    // Heaps which have no way of doing this needn't override it.
+    virtual bool   TryExpand(void* /*p*/, size_t /*newSize*/) { return false; }
+
+    // Returns the same as GetAllocSize for a block allocated with Alloc, or SIZE_MAX if that would
+    // require taking a lock, as e.g. the Windows heap functions do. Used for HeapStats, which must
+    // not serialize every allocation. Heaps which keep the size next to the block should override it.
+    virtual size_t GetAllocSizeNoLock(const void* /*p*/) const { return SIZE_MAX; }
 };
 
 
@@ -433,9 +536,11 @@ typedef std::vector<SysAllocatedString, StdAllocatorSysMem<SysAllocatedString>>
 //
 struct AllocMetadata
 {
+    static const size_t BacktraceCapacity = 32; // Deeper backtraces are truncated. Kept small because every tracked allocation stores one.
+
     const void*               Alloc;            // The allocation itself.
-    SysAllocatedPointerVector Backtrace;        // Array of void*
-    SysAllocatedStringVector  BacktraceSymbols; // Array of string.
+    void*                     Backtrace[BacktraceCapacity]; // Return addresses, innermost first.
+    uint32_t                  BacktraceCount;   // Number of valid entries in Backtrace.
     const char*               File;             // __FILE__ of application allocation site.
     int                       Line;             // __LINE__ of application allocation site.
     uint64_t                  TimeNs;           // Allocator time in Nanoseconds. See GetCurrentHeapTimeNs.
@@ -447,8 +552,8 @@ struct AllocMetadata
     char                      ThreadName[32];   // Thread name at the time of the allocation.
 
     AllocMetadata()
-      : Alloc(nullptr), Backtrace(), File(nullptr), Line(0), TimeNs(0), 
-        AllocSize(0), BlockSize(0), Tag(nullptr), ThreadId(0)
+      : Alloc(nullptr), BacktraceCount(0), File(nullptr), Line(0), TimeNs(0), 
+        Count(0), AllocSize(0), BlockSize(0), Tag(nullptr), ThreadId(0)
     {
         ThreadName[0] = '\0';
     }
@@ -474,6 +579,183 @@ enum AllocMetadataFlags
 };
 
 
+//-----------------------------------------------------------------------------------
+// ***** AllocTrackingTable
+//
+// Maps tracked allocations to their AllocMetadata.
+//
+// The table is split into ShardCount shards, selected by a hash of the allocation pointer,
+// each with its own lock, so threads allocating at the same time rarely contend.
+// Each shard is an open-addressing (linear probing) hash table of pointer/record pairs. The
+// AllocMetadata records live in chunks of system memory and are recycled via a free list,
+// so tracking an allocation does no heap allocation except for occasional chunk or table
+// growth. All memory comes from SafeMMapAlloc and is released only by Clear.
+//
+class AllocTrackingTable
+{
+public:
+    AllocTrackingTable();
+    ~AllocTrackingTable();
+
+    // Adds the entry for amd.Alloc, replacing any existing entry for it.
+    // Returns false if memory for the entry couldn't be allocated.
+    bool Insert(const AllocMetadata& amd);
+
+    // Removes the entry for p. Returns false if there is no such entry.
+    bool Remove(const void* p);
+
+    bool Contains(const void* p);
+
+    // Returns false if p is certainly not in the table. Takes no lock, so it's cheap enough to call
+    // on every Free. May return true for pointers which aren't in the table.
+    bool MayContain(const void* p) const;
+
+    // Copies the entry for p to metadata. Returns false if there is no such entry.
+    bool Get(const void* p, AllocMetadata& metadata);
+
+    // Updates the sizes recorded for p, which was resized in place. The rest of its entry is unchanged.
+    // Returns false if there is no such entry.
+    bool SetSize(const void* p, uint64_t allocSize, uint64_t blockSize);
+
+    // Removes all entries and frees all memory.
+    void Clear();
+
+    // Returns the number of entries. This is a snapshot which may be stale if other threads are modifying the table.
+    size_t GetSize() const;
+
+    // Copies up to capacity entries of the given shard to metadata, holding only that shard's lock.
+    // Returns the number of entries in the shard, which may be more than capacity.
+    size_t CopyShard(size_t shardIndex, AllocMetadata* metadata, size_t capacity);
+
+    // Iteration requires the caller to hold LockAll until iteration is complete.
+    // Returns nullptr when there are no more entries.
+    struct Iterator
+    {
+        size_t ShardIndex;
+        size_t SlotIndex;
+    };
+
+    void LockAll();
+    void UnlockAll();
+    const AllocMetadata* IterateBegin(Iterator& it) const;
+    const AllocMetadata* IterateNext(Iterator& it) const;
+
+public:
+    static const size_t ShardCount = 64;                // Must be a power of two.
+
+protected:
+    struct Slot
+    {
+        const void*    Alloc;                           // nullptr if the slot is empty.
+        AllocMetadata* Metadata;
+    };
+
+    struct Shard
+    {
+        OVR::Lock      Lock;                            // Guards everything in this Shard.
+        Slot*          Slots;                           // Open-addressing table with Capacity entries.
+        size_t         Capacity;                        // Zero or a power of two.
+        size_t         Size;                            // Number of used Slots.
+        AllocMetadata* FreeList;                        // Unused records, linked via their first pointer.
+        void*          ChunkList;                       // Memory chunks which hold the records, linked via their first pointer.
+        char           Padding[64];                     // Keeps neighboring shards' locks out of each other's cache line.
+    };
+
+    static uint64_t HashPointer(const void* p);
+    static Slot*    FindSlot(const Shard& shard, const void* p, uint64_t hash);
+    static bool     GrowShard(Shard& shard);
+    static AllocMetadata* NewMetadata(Shard& shard);
+    static void     ClearShard(Shard& shard);
+    const AllocMetadata* IterateFrom(Iterator& it) const; // Returns the first entry at or after it.
+
+    Shard& GetShard(uint64_t hash)
+        { return Shards[hash >> (64 - ShardCountLog2)]; } // The top bits select the shard, the low bits the slot.
+
+    static size_t GetFilterIndex(uint64_t hash)
+        { return (size_t)(hash >> (64 - ShardCountLog2 - FilterShardSizeLog2)); } // The shard's bits and the next ones, so each shard has its own part of Filter.
+
+    static const size_t ShardCountLog2      = 6;
+    static const size_t InitialCapacity     = 256;      // Slots per shard.
+    static const size_t MetadataChunkSize   = 65536;    // Bytes.
+    static const size_t FilterShardSizeLog2 = 8;
+    static const size_t FilterShardSize     = ((size_t)1 << FilterShardSizeLog2); // Filter elements per shard.
+    static const size_t FilterSize          = (ShardCount * FilterShardSize);       // 16384
+
+    Shard                 Shards[ShardCount];
+    std::atomic<uint16_t> Filter[FilterSize];           // Counting filter for MayContain: the number of entries whose hash maps to each element.
+};
+
+
+//-----------------------------------------------------------------------------------
+// ***** HeapStats
+//
+// Heap statistics, as returned by Allocator::GetHeapStats.
+// Byte counts are of the heap's usable block sizes (Heap::GetAllocSize), except for RequestedBytes.
+// Aligned allocations are included in the counts but not in byte totals or size classes, as their
+// size can't portably be queried without knowing their alignment. Likewise for all allocations of
+// heaps which can't report block sizes without taking a lock (Heap::GetAllocSizeNoLock), such as
+// DefaultHeap and OSHeap on Windows; with those only the counts and tags are recorded.
+// Tags are the AllocatorTagScope tag in effect at the time of the allocation, or the tag argument
+// to Alloc. Tags are recorded only for allocations, as freeing doesn't know the tag.
+//
+struct HeapStats
+{
+    static const size_t SizeClassCount = 33;    // Size class i is for sizes in (2^(i-1), 2^i]. Class 0 is for size 0 and 1.
+    static const size_t TagCapacity    = 64;    // Tags beyond this many are counted together as "(other)".
+
+    struct SizeClass
+    {
+        uint64_t AllocCount;        // Number of allocations ever made in this size class, including reallocations into it.
+        uint64_t LiveCount;         // Number of allocations in this size class which are currently live.
+    };
+
+    struct TagTotals
+    {
+        const char* Tag;
+        uint64_t    AllocCount;     // Number of allocations ever made with this tag.
+        uint64_t    AllocBytes;     // Their total size.
+    };
+
+    uint64_t  AllocCount;           // Number of allocations ever made, not including reallocations.
+    uint64_t  FreeCount;            // Number of frees ever made.
+    uint64_t  LiveCount;            // Number of currently live allocations.
+    uint64_t  AllocBytes;           // Total size of all allocations ever made, not including reallocations.
+    uint64_t  RequestedBytes;       // Total of requested sizes for the above. The difference to AllocBytes is internal fragmentation.
+    uint64_t  LiveBytes;            // Total size of currently live allocations.
+    uint64_t  PeakLiveBytes;        // Max LiveBytes. Approximate, as threads report their changes in batches.
+    uint64_t  ReallocCount;         // Number of reallocations of non-null pointers.
+    uint64_t  ReallocGrowCount;     // Number of the above which increased the block size.
+    uint64_t  ReallocShrinkCount;   // Number of the above which decreased the block size.
+    uint64_t  ReallocMoveCount;     // Number of the above which returned a different pointer.
+    uint64_t  ReallocGrowBytes;     // Total size increase due to reallocations.
+    uint64_t  ReallocShrinkBytes;   // Total size decrease due to reallocations.
+    SizeClass SizeClasses[SizeClassCount];
+    TagTotals Tags[TagCapacity + 1];
+    size_t    TagCount;             // Number of valid elements in Tags.
+    size_t    ThreadCount;          // Number of threads which have used the heap.
+
+    // Returns the fraction of allocated bytes that weren't requested (e.g. due to size rounding by the heap).
+    double GetInternalFragmentation() const
+        { return (AllocBytes ? (1.0 - ((double)RequestedBytes / (double)AllocBytes)) : 0.0); }
+
+    static const size_t UnknownSize = SIZE_MAX;
+
+    static size_t GetSizeClass(size_t size);
+};
+
+// How OSHeap backs large allocations on Linux. See Allocator::SetHugePagePolicy.
+enum HugePageMode
+{
+    HugePagesNone,          // Large allocations use regular pages.
+    HugePagesTransparent,   // Large allocations are aligned and madvise'd so that the kernel can back them with transparent huge pages.
+    HugePagesExplicit       // Large allocations use reserved huge pages (MAP_HUGETLB), falling back to HugePagesTransparent if none are available.
+};
+
+struct HeapStatsShard;
+class  FrameSymbolCache;
+class  JSON;
+
+
 //-----------------------------------------------------------------------------------
 // ***** Allocator
 //
@@ -543,6 +825,12 @@ public:
     // Like realloc but also zero-initializes the newly added space.
     void* Recalloc(void* p, size_t count, size_t size);
 
+    // Attempts to resize the block p, which was allocated with Alloc, to newSize bytes without 
+    // moving it. Returns true if the block was resized, in which case its contents are unchanged.
+    // Returns false if the heap can't do it, in which case p is unchanged and the caller needs to
+    // Realloc instead. This lets containers of non-movable types grow without copying.
+    bool  TryExpand(void* p, size_t newSize);
+
     // Reallocates memory allocated with AllocAligned.
     void* ReallocAligned(void* p, size_t newSize, size_t newAlign);
 
@@ -577,6 +865,14 @@ public:
     bool IsTrackingEnabled() const
         { return TrackingEnabled; }
 
+    // Used by PoolAllocator, whose slots come from its own slabs rather than from us, so that pooled
+    // objects appear in leak reports and heap iteration while tracking is enabled.
+    void TrackPoolSlot(const void* p, size_t size, const char* tag)
+        { TrackAlloc(p, size, tag, nullptr, 0); }
+
+    void UntrackPoolSlot(const void* p)
+        { UntrackAlloc(p); } // The slot may have been allocated before tracking was enabled.
+
     // If enabled then the debug page is used. 
     // Must be called before the Init function.
     bool EnableDebugPageHeap(bool enable);
@@ -584,9 +880,27 @@ public:
     bool IsDebugPageHeapEnabled() const
         { return DebugPageHeapEnabled; }
 
+    // If enabled then the OSHeap is used instead of the DefaultHeap.
+    // Must be called before the Init function.
+    bool EnableOSHeap(bool enable);
+
     bool IsOSHeapEnabled() const
         { return OSHeapEnabled; }
 
+    // Sets how the OSHeap backs allocations of at least threshold bytes on Linux, and whether it binds them to 
+    // the NUMA node of the allocating thread. This is meant for large, long-lived buffers, for which TLB misses 
+    // and remote memory access are measurable. Has no effect on other platforms or unless the OSHeap is used.
+    // Must be called before the Init function. See also OVR_ALLOCATOR_HUGE_PAGES_ENABLED and OSHeap::GetHugePageStats.
+    bool SetHugePagePolicy(HugePageMode mode, size_t threshold, bool bindToNumaNode);
+
+    // If enabled then small allocations are served from per-thread caches (see ThreadCachingHeap).
+    // Has no effect if the debug page heap is enabled.
+    // Must be called before the Init function.
+    bool EnableThreadCache(bool enable);
+
+    bool IsThreadCacheEnabled() const
+        { return ThreadCacheEnabled; }
+
     // If enabled then a debug trace of existing allocations occurs on destruction of this Allocator.
     bool EnableAllocationTraceOnShutdown(bool enable)
         { TraceAllocationsOnShutdown = enable; return true; }
@@ -594,6 +908,15 @@ public:
     bool IsAllocationTraceOnShutdownEnabled() const
         { return TraceAllocationsOnShutdown; }
 
+    // If enabled then TraceTrackedAllocations doesn't look up symbols, and instead writes each backtrace
+    // frame as its address and module offset (e.g. "0x00007FF612341234 LibOVR.dll+0x1234"), for symbolizing
+    // the report offline. This makes reports of large heaps nearly instant.
+    bool EnableOfflineSymbolization(bool enable)
+        { OfflineSymbolization = enable; return true; }
+
+    bool IsOfflineSymbolizationEnabled() const
+        { return OfflineSymbolization; }
+
     bool EnableMallocRedirect();
 
     bool IsMallocRedirectEnabled() const
@@ -615,6 +938,13 @@ public:
     const AllocMetadata* IterateHeapNext();
     void                 IterateHeapEnd();
 
+    // Copies the tracked allocations of one AllocTrackingTable shard (shardIndex < AllocTrackingTable::ShardCount)
+    // to metadata, which has room for capacity entries. Returns the number of allocations in the shard, which
+    // may be more than capacity, in which case only capacity of them were copied. Returns 0 if tracking is disabled.
+    // Unlike IterateHeapBegin this locks the heap only during the copy, so the result can be examined at leisure
+    // while other threads keep allocating. HeapIterationFilterRPN uses this.
+    size_t CopyTrackedAllocations(size_t shardIndex, AllocMetadata* metadata, size_t capacity);
+
     // Given an AllocationMetaData, this function writes it to a string description.
     // For amdFlags, see AllocMetadataFlags. 
     // Returns the required strlen of the description (like the strlcpy function, etc.)
@@ -624,6 +954,9 @@ public:
     // purpose of reporting leaked memory on application or module shutdown.
     // This should be used instead of, for example, VC++ _CrtDumpMemoryLeaks 
     // because it allows us to dump additional information about our allocations.
+    // Allocations are grouped by backtrace, and each backtrace is written once followed
+    // by its allocations, largest groups first. The heap is locked only while the
+    // allocations are collected, not while symbols are looked up and output is written.
     // Returns the number of currently outstanding heap allocations.
     // If the callback is valid, this function iteratively calls the callback with 
     // output. If the callback is nullptr then this function debug-traces the output.
@@ -637,6 +970,45 @@ public:
     typedef void (*AllocationTraceCallback)(uintptr_t context, const char* text);
     size_t TraceTrackedAllocations(AllocationTraceCallback callback, uintptr_t context);
 
+    // If sampleInterval is non-zero then heap sampling is enabled: On average one allocation per
+    // sampleInterval allocated bytes is recorded, along with its backtrace and tag. The sampling
+    // points are spaced randomly (exponentially distributed), so allocations of every size are
+    // fairly represented. Sampling works independently of tracking and is cheap enough to leave
+    // enabled in production. Passing 0 disables sampling. Any existing samples are discarded.
+    bool EnableSampling(size_t sampleInterval = DefaultSampleInterval);
+
+    bool IsSamplingEnabled() const
+        { return (SampleInterval.load(std::memory_order_relaxed) != 0); }
+
+    size_t GetSampleInterval() const
+        { return SampleInterval.load(std::memory_order_relaxed); }
+
+    static const size_t DefaultSampleInterval = 524288;
+
+    enum SampleGrouping
+    {
+        SampleGroupByCallSite,  // Samples with identical backtraces are reported together.
+        SampleGroupByTag        // Samples with the same AllocatorTagScope tag are reported together.
+    };
+
+    // Reports the estimated live heap usage per call site or per tag, largest first.
+    // Each sample is weighted by the inverse of the probability that its allocation was sampled.
+    // If the callback is nullptr then this function debug-traces the output.
+    // Returns the estimated total of live bytes.
+    uint64_t TraceSampledAllocations(SampleGrouping grouping, AllocationTraceCallback callback, uintptr_t context);
+
+    // Heap statistics are counters which are kept whether or not tracking is enabled, and are cheap enough
+    // to leave enabled in production (see OVR_ALLOCATOR_HEAP_STATS_ENABLED). Each thread updates its own
+    // shard of the counters, and GetHeapStats sums them up. The result may be slightly inconsistent while
+    // other threads allocate. Arena and pool allocations are counted only as the blocks which back them.
+    bool IsHeapStatsEnabled() const
+        { return HeapStatsEnabled; }
+
+    void GetHeapStats(HeapStats& stats);
+
+    // Returns a new JSON object with the contents of GetHeapStats. The caller must Release it.
+    JSON* CreateHeapStatsJSON();
+
 public:
     // Returns the current heap time in nanoseconds. The returned time is with respect 
     // to first heap startup, which in practice equates to the application start time.
@@ -654,7 +1026,7 @@ public:
 
 protected:
     void SetNewBlockMetadata(Allocator* allocator, AllocMetadata& amd, const void* alloc, uint64_t allocSize, uint64_t blockSize, 
-                                const char* file, int line, const char* tag, void** backtraceArray, size_t backtraceArraySize);
+                                const char* file, int line, const char* tag);
 
     // Add the allocation & the callstack to the tracking database.
     void TrackAlloc(const void* p, size_t size, const char* tag, const char* file, int line);
@@ -672,10 +1044,33 @@ protected:
     // Returns a copy of the AllocMetadata. 
     bool GetAllocMetadata(const void* p, AllocMetadata& metadata);
 
+    // Records p in SampleTable. Called by TrackAlloc when the calling thread's sample countdown expires.
+    void SampleAlloc(const void* p, size_t size, const char* tag, const char* file, int line);
+
+    // Returns a random byte distance to the next sample.
+    int64_t GetNextSampleDistance();
+
+    // Heap statistics recording. These are called only for memory from Heap.
+    HeapStatsShard* GetHeapStatsShard();
+    // Block sizes are HeapStats::UnknownSize for aligned allocations.
+    void RecordStatsAlloc(size_t blockSize, size_t requestedSize, const char* tag);
+    void RecordStatsFree(size_t blockSize);
+    void RecordStatsRealloc(size_t oldBlockSize, size_t newBlockSize, bool moved);
+    void AddStatsLiveBytes(HeapStatsShard* shard, int64_t delta);
+
+    // Writes the symbol description of a backtrace frame, looked up via SymbolCache, to buffer, or an
+    // empty string if unavailable. Returns buffer. The text is copied while SymbolCacheLock is held,
+    // so it stays valid regardless of other threads' lookups or FreeSymbolCache.
+    static const size_t FrameSymbolCapacity = 1024;
+    const char* LookupFrameSymbol(void* address, char* buffer, size_t bufferCapacity);
+    void FreeSymbolCache();
+
 public:
     // Tag push/pop API
 
     // Every PushTag must be matched by a PopTag. It's easiest to do this via the AllocatorTagScope utility class.
+    // Tags are kept in a thread-local stack, so PushTag, PopTag and GetTag take no lock.
+    // The tag string must remain valid for as long as it's in use (e.g. a string literal).
     void PushTag(const char* tag);
 
     // Matches a PushTag. 
@@ -685,47 +1080,43 @@ public:
     // Returns a default string if there is no current tag set for the current thread.
     const char* GetTag(const char* defaultTag = nullptr);
 
-protected:
-    // This is called periodically to purge the map of elements that correspond to threads that no longer exist.
-    void PurgeTagMap();
+    // Gets the current tag for the given thread, for reporting purposes. The result may be stale
+    // by the time it's returned, as the thread can change its tag at any time.
+    // Returns a default string if there is no current tag set for the thread.
+    const char* GetThreadTag(uint32_t threadId, const char* defaultTag = nullptr);
 
 protected:
-    // Tracked allocations
-    #if defined(OVR_BUILD_DEBUG)
-        typedef std::map<const void*, AllocMetadata, std::less<const void*>, // map is slower but in debug builds we can read its sorted contents easier.
-                          StdAllocatorSysMem<std::pair<const void* const, AllocMetadata> > > TrackedAllocMap;
-    #else
-        typedef std::unordered_map<const void*, AllocMetadata, std::hash<const void*>, std::equal_to<const void*>, 
-                          StdAllocatorSysMem<std::pair<const void* const, AllocMetadata> > > TrackedAllocMap;
-    #endif
-
-    // Per-thread tag stack
-    typedef std::vector<const char*, StdAllocatorSysMem<const char*>> ConstCharVector;
-    #if defined(OVR_BUILD_DEBUG)
-        typedef std::map<uint32_t, ConstCharVector, std::less<uint32_t>, 
-                          StdAllocatorSysMem<std::pair<const uint32_t,ConstCharVector>>> ThreadIdToTagVectorMap;
-    #else
-        typedef std::unordered_map<uint32_t, ConstCharVector, std::hash<uint32_t>, std::equal_to<uint32_t>, 
-                          StdAllocatorSysMem<std::pair<const uint32_t,ConstCharVector>>> ThreadIdToTagVectorMap;
-    #endif
-
     char                            AllocatorName[64];           // The name of this allocator. Useful because we could have multiple instances within a process.
     Heap*                           Heap;                        // The underlying heap we are using.
     bool                            DebugPageHeapEnabled;        // If enabled then we use our DebugPageHeap instead of DefaultHeap or OSheap.
     bool                            OSHeapEnabled;               // If enabled then we use our OSHeap instead of DebugPageHeap or DefaultHeap.
+    HugePageMode                    HugePages;                   // OSHeap settings. See SetHugePagePolicy.
+    size_t                          HugePageThreshold;           // "
+    bool                            NumaBindingEnabled;          // "
+    bool                            ThreadCacheEnabled;          // If enabled then DefaultHeap or OSHeap is wrapped by a ThreadCachingHeap.
     bool                            MallocRedirectEnabled;       // If enabled then we redirect CRT malloc to ourself (only if we are the default global allocator).
     InterceptCRTMalloc*             MallocRedirect;              // 
     bool                            TrackingEnabled;             // 
     bool                            TraceAllocationsOnShutdown;  // If true then we do a debug trace of allocations on our shutdown.
-    OVR::Lock                       TrackLock;                   // Thread-exclusive access to AllocationMap.
-    TrackedAllocMap::const_iterator TrackIterator;               // Valid only between IterateHeapBegin and IterateHeapEnd.
-    TrackedAllocMap                 AllocationMap;               // 
+    OVR::Lock                       TrackLock;                   // Serializes enabling/disabling of tracking and heap iteration. AllocationTable has its own per-shard locks.
+    AllocTrackingTable::Iterator    TrackIterator;               // Valid only between IterateHeapBegin and IterateHeapEnd.
+    AllocTrackingTable              AllocationTable;             // 
     SysAllocatedPointerVector       DelayedFreeList;             // Used when we are overriding CRT malloc and need to call CRT free on some pointers after we've restored it.
     SysAllocatedPointerVector       DelayedAlignedFreeList;      // "
     std::atomic_ullong              CurrentCounter;              // Ever-increasing count of allocation requests.
+    std::atomic<size_t>             SampleInterval;              // Average number of bytes between samples. 0 if sampling is disabled.
+    AllocTrackingTable              SampleTable;                 // Sampled allocations which haven't been freed yet.
+    RandomNumberGenerator           SampleRandom;                // Used for the sample spacing. Guarded by SampleRandomLock.
+    OVR::Lock                       SampleRandomLock;            // 
     bool                            SymbolLookupEnabled;         //
-    ThreadIdToTagVectorMap          TagMap;                      // 
-    OVR::Lock                       TagMapLock;                  // Thread-exclusive access to TagMap.
+    bool                            OfflineSymbolization;        // If true then TraceTrackedAllocations writes module offsets instead of symbols.
+    FrameSymbolCache*               SymbolCache;                 // Created on first use. Each unique backtrace frame is looked up only once. Guarded by SymbolCacheLock.
+    OVR::Lock                       SymbolCacheLock;             // Also serializes our use of SymbolLookup::LookupSymbol, which isn't thread-safe on all platforms.
+    bool                            HeapStatsEnabled;            // If enabled then we keep HeapStats counters.
+    uint64_t                        HeapStatsInstanceId;         // Identifies this Allocator's shards in thread-local storage.
+    std::atomic<HeapStatsShard*>    HeapStatsShardList;          // All shards, one per thread which used us. Lock-free, as it's added to during allocation.
+    std::atomic<int64_t>            HeapStatsLiveBytes;          // Live bytes as reported in batches by the shards. Used for HeapStats::PeakLiveBytes.
+    std::atomic<int64_t>            HeapStatsPeakLiveBytes;      //
     static Allocator*               DefaultAllocator;            // Default instance.
     static uint64_t                 ReferenceHeapTimeNs;         // The time that GetCurrentHeapTimeNs reports relative to. In practice this is the time of application startup.
 
@@ -804,14 +1195,21 @@ public:
 //      ThreadId                 ==,<,<=,>,>=    <integer>       <,<=,>,>= are usually useless but provided for consistency with other integer types.
 //      ThreadName               ==,has          <string>        case insensitive. has means substring check.
 //
+// The filter text is compiled once by SetFilter into a compact bytecode, which is what gets executed
+// per allocation. Iteration works on a copy of one AllocTrackingTable shard at a time, so the heap
+// isn't locked while the filter runs or while the caller handles the results.
+//
 struct HeapIterationFilterRPN
 {
     HeapIterationFilterRPN();
+   ~HeapIterationFilterRPN();
 
     bool SetFilter(Allocator* allocator, const char* filter);
 
     // This is the same as Allocator::IterateHeapBegin, except it returns only 
-    // values that match the filter specification.
+    // values that match the filter specification. Unlike Allocator::IterateHeapBegin, the heap isn't 
+    // locked between calls, and the returned metadata is a copy which remains valid until the next call.
+    // Allocations made or freed during iteration may or may not be seen.
     const AllocMetadata* IterateHeapBegin();
     const AllocMetadata* IterateHeapNext();
     void                 IterateHeapEnd();
@@ -823,38 +1221,40 @@ struct HeapIterationFilterRPN
     static void TraceTrackedAllocations(Allocator* allocator, const char* filter, Allocator::AllocationTraceCallback callback, uintptr_t context);
 
 protected:
-    enum Operation{ OpNone, OpAnd, OpOr };
-    enum Comparison{ CmpNone, CmpE, CmpL, CmpLE, CmpG, CmpGE, CmpHas };
-
-    struct Operand
-    {
-        AllocMetadataFlags metadataType;  // e.g. AMFAllocSize
-        Comparison         comparison;    // e.g. CmpLE
-        int64_t            numValue;      // Applies to numeric AllocMetadataFlags types.
-        char               strValue[256]; // Applies to string AllocMetadataFlags types.
+    // Each opcode is either an operation on the stack or an operand comparison which pushes its result.
+    enum Opcode : uint8_t { OpEnd, OpAnd, OpOr, OpNumE, OpNumL, OpNumLE, OpNumG, OpNumGE, OpStrE, OpStrHas };
 
-        Operand() : metadataType(AMFNone), comparison(CmpNone), numValue(0), strValue{} {}
-    };
+    // The AllocMetadata member an operand reads.
+    enum Field : uint8_t { FieldNone, FieldFile, FieldTag, FieldThreadName, FieldLine, FieldTime, FieldCount, FieldAllocSize, FieldBlockSize, FieldThreadId };
 
-    // An instruction is either an operation or an operand. We could use a union to represent
-    // that but it would complicate our declarations here. Instead we declare both types one
-    // after the other. If the operation type is none, then this entry is an operand instead 
-    // of an operation.
     struct Instruction
     {
-        Operation operation;
-        Operand   operand; 
+        Opcode   opcode;
+        Field    field;                 // Applies to operand opcodes.
+        uint16_t strOffset;             // Applies to OpStrE and OpStrHas. Offset of the 0-terminated comparand in Strings.
+        int64_t  numValue;              // Applies to the OpNum opcodes.
     };
 
-    bool Compile(const char* filter);           // Returns false upon syntax error.
-    bool Evaluate(const AllocMetadata* amd);    // Returns true if amd matches the filter.
-    bool EvaluateOperand(const Operand& operand, const AllocMetadata* amd) const;
+    static const size_t InstructionCapacity = 32;   // Also bounds the stack depth, as each instruction pushes at most one value.
+    static const size_t StringCapacity      = 2048;
+
+    bool Compile(const char* filter);               // Returns false upon syntax error.
+    bool Evaluate(const AllocMetadata* amd) const;  // Returns true if amd matches the filter.
+    const AllocMetadata* FindNextMatch();           // Returns the next match, copying further shards as needed.
+    void FreeSnapshot();
 
 protected:
-    Allocator*  AllocatorInstance;      // The Allocator we execute the filter against.
-    const char* Filter;                 // The string-based filter gets converted into the Instructions, which can be executed per alloc.
-    Instruction Instructions[32];       // Array of instructions to execute. 0-terminated.
-    uint64_t    CurrentHeapTimeNs;      // The time at the start of evaluation. Used for time comparisons.
+    Allocator*     AllocatorInstance;       // The Allocator we execute the filter against.
+    const char*    Filter;                  // The string-based filter gets converted into the Instructions, which can be executed per alloc.
+    Instruction    Instructions[InstructionCapacity]; // Array of instructions to execute. Terminated by OpEnd unless full.
+    char           Strings[StringCapacity]; // The string comparands of the Instructions.
+    size_t         StringSize;              // Used bytes in Strings.
+    uint64_t       CurrentHeapTimeNs;       // The time at the start of evaluation. Used for time comparisons.
+    AllocMetadata* Snapshot;                // Copy of the tracked allocations of shard ShardIndex. From SafeMMapAlloc, so we don't disturb the heap we report on.
+    size_t         SnapshotCapacity;        // Capacity of Snapshot, in elements.
+    size_t         SnapshotSize;            // Used elements in Snapshot.
+    size_t         SnapshotIndex;           // The next element of Snapshot to evaluate.
+    size_t         ShardIndex;              // The next AllocTrackingTable shard to copy.
 };
 
 
@@ -881,6 +1281,8 @@ public:
     virtual void   FreeAligned(void* p);
     virtual void*  Realloc(void* p, size_t newSize);
     virtual void*  ReallocAligned(void* p, size_t newSize, size_t newAlign);
+    virtual bool   TryExpand(void* p, size_t newSize);
+    virtual size_t GetAllocSizeNoLock(const void* p) const;
 };
 
 
@@ -890,10 +1292,17 @@ public:
 //
 // Delegates to OS heap functions instead of malloc/free/new/delete.
 //
+// On POSIX platforms the OS heap is malloc, and allocations of at least HugePageThreshold bytes
+// are instead mapped directly with mmap. On Linux these can be backed by huge pages and bound to 
+// the NUMA node of the allocating thread (see HugePageMode). Every block has a small header, 
+// which also allows supporting aligned allocations.
+//
 class OSHeap : public Heap
 {
 public:
-    OSHeap();
+    static const size_t DefaultHugePageThreshold = (4 * 1024 * 1024);
+
+    OSHeap(HugePageMode hugePageMode = HugePagesNone, size_t hugePageThreshold = DefaultHugePageThreshold, bool bindToNumaNode = false);
    ~OSHeap();
 
     virtual bool  Init();
@@ -907,15 +1316,183 @@ public:
     virtual void   FreeAligned(void* p);
     virtual void*  Realloc(void* p, size_t newSize);
     virtual void*  ReallocAligned(void* p, size_t newSize, size_t newAlign);
+    virtual bool   TryExpand(void* p, size_t newSize);
+    virtual size_t GetAllocSizeNoLock(const void* p) const;
+
+    // Counters for directly mapped blocks, summed over all OSHeaps in the process. Always 0 on Windows.
+    struct HugePageStats
+    {
+        uint64_t MappedCount;               // Number of live blocks which are directly mapped.
+        uint64_t MappedBytes;               // Their total mapped size.
+        uint64_t ExplicitHugePageBytes;     // Mapped bytes backed by reserved huge pages (MAP_HUGETLB).
+        uint64_t TransparentHugePageBytes;  // Mapped bytes madvise'd for transparent huge pages. The kernel decides how much of it it actually backs with them.
+        uint64_t NumaBoundBytes;            // Mapped bytes bound to the NUMA node of the allocating thread.
+        uint64_t ExplicitFallbackCount;     // Number of times no reserved huge pages were available for HugePagesExplicit.
+    };
+
+    static void GetHugePageStats(HugePageStats& stats);
 
 protected:
     #if defined(_WIN32)
         HANDLE Heap;    // Windows heap handle.
+    #else
+        struct BlockHeader
+        {
+            size_t   Size;                  // Requested size.
+            uint32_t Offset;                // Distance from the start of the underlying malloc block or mapping to the user pointer.
+            uint32_t Flags;                 // BlockFlags.
+        };
+
+        enum BlockFlags
+        {
+            BlockMapped          = 0x01,    // Mapped with mmap instead of allocated with malloc.
+            BlockExplicitHuge    = 0x02,    // Mapped with MAP_HUGETLB.
+            BlockTransparentHuge = 0x04,    // madvise'd for transparent huge pages.
+            BlockNumaBound       = 0x08     // Bound to a NUMA node.
+        };
+
+        static const size_t MaxMappedAlignment = 4096;  // Mapped blocks support alignment up to this. Larger alignments use malloc.
+
+        static BlockHeader* GetHeader(const void* p)
+            { return (reinterpret_cast<BlockHeader*>(const_cast<void*>(p)) - 1); }
+
+        void*  AllocMapped(size_t size, size_t align);
+        void*  ResizeMapped(void* p, size_t newSize, bool allowMove);
+        void   FreeMapped(BlockHeader* header);
+        size_t GetMappingSize(const BlockHeader* header) const;
+
+        HugePageMode HugePages;
+        size_t       HugePageThreshold;
+        bool         BindToNumaNode;
+        size_t       PageSize;              // The system page size.
+        size_t       HugePageSize;          // The default huge page size, e.g. 2MB on x64.
     #endif
 };
 
 
 
+//------------------------------------------------------------------------
+// ***** ThreadCachingHeap
+//
+// Puts a per-thread cache of small blocks in front of another heap (DefaultHeap or OSHeap).
+//
+// Technical design:
+//   Alloc sizes up to MaxCachedSize are rounded up to one of SizeClassCount size classes.
+//       Each thread has its own free list per size class, so Alloc and Free of small blocks
+//       normally take no lock and make no call into the wrapped heap.
+//   When a thread's free list for a class grows beyond MaxThreadBlockCount, half of it is
+//       moved to a central pool shared by all threads. An empty thread free list is refilled
+//       from the central pool before anything new is allocated from the wrapped heap. The
+//       central pool is limited to MaxCentralBlockCount blocks per class; the excess is
+//       returned to the wrapped heap.
+//   Every RebalanceInterval operations a thread also moves half of the blocks it didn't need
+//       during that interval to the central pool. This keeps memory freed by one thread
+//       available to other threads instead of letting it pile up in an idle cache.
+//   Every block is preceded by a BlockHeader which records its size class, so Free needs no
+//       lookup. Larger and over-aligned blocks carry the same header but bypass the caches.
+//   Thread caches are allocated with SafeMMapAlloc and are freed only at Shutdown, as we have
+//       no thread exit notification. Instead, once there are ThreadCacheReuseThreshold caches, a
+//       thread which first uses the heap takes over the cache of an exited thread, blocks and all.
+//       So the number of caches is bounded by the most threads which used the heap at once, even
+//       with threads that come and go. A thread which is about to exit can call FlushThreadCache
+//       to give its blocks back to the central pool right away.
+//   This class takes ownership of the wrapped heap, which must already be initialized.
+//       Shutdown shuts it down and frees it with SysMemFree.
+//   All pointers passed to Free, Realloc, etc. must have come from this heap.
+//
+class ThreadCachingHeap : public Heap
+{
+public:
+    ThreadCachingHeap(Heap* wrappedHeap, size_t wrappedHeapSize);
+    virtual ~ThreadCachingHeap();
+
+    virtual bool  Init();
+    virtual void  Shutdown();
+
+    virtual void*  Alloc(size_t size);
+    virtual void*  AllocAligned(size_t size, size_t align);
+    virtual size_t GetAllocSize(const void* p) const;
+    virtual size_t GetAllocAlignedSize(const void* p, size_t align) const;
+    virtual void   Free(void* p);
+    virtual void   FreeAligned(void* p);
+    virtual void*  Realloc(void* p, size_t newSize);
+    virtual void*  ReallocAligned(void* p, size_t newSize, size_t newAlign);
+    virtual bool   TryExpand(void* p, size_t newSize);
+    virtual size_t GetAllocSizeNoLock(const void* p) const { return GetAllocSize(p); }
+
+    // Moves all blocks cached by the calling thread to the central pool.
+    void FlushThreadCache();
+
+    // Returns the number of thread caches, including those of exited threads not yet taken over.
+    size_t GetThreadCacheCount() const;
+
+    const Heap* GetWrappedHeap() const
+        { return WrappedHeap; }
+
+public:
+    static const size_t   SizeClassGranularity      = 16;
+    static const size_t   SizeClassCount            = 64;
+    static const size_t   MaxCachedSize             = (SizeClassGranularity * SizeClassCount); // 1024
+    static const uint32_t MaxThreadBlockCount       = 64;       // Per size class, per thread.
+    static const uint32_t MaxCentralBlockCount      = 1024;     // Per size class.
+    static const uint32_t RebalanceInterval         = 4096;     // In Alloc/Free calls of a given thread.
+    static const uint32_t ThreadCacheReuseThreshold = 8;        // Caches we create before taking over those of exited threads.
+
+protected:
+    struct BlockHeader // Stored immediately before the user pointer. 16 bytes, which preserves the wrapped heap's alignment.
+    {
+        uint16_t SizeClass;     // Index of the size class, or LargeSizeClass.
+        uint16_t Magic;         // HeaderMagic. Used to catch pointers that didn't come from this heap.
+        uint32_t Offset;        // Bytes between the wrapped heap block and this header. Non-zero only for over-aligned blocks.
+        uint64_t Size;          // Usable size of the block. For cached blocks this is the size of the size class.
+    };
+
+    struct FreeBlock // Overlays the user area of a cached block.
+    {
+        FreeBlock* Next;
+    };
+
+    struct ThreadCache
+    {
+        ThreadCache* Next;                              // Linked list of all ThreadCaches of this heap. Guarded by CentralLock.
+        uint32_t     ThreadId;                          // The thread which uses this cache.
+        uint32_t     OperationCount;                    // Counts up to RebalanceInterval.
+        FreeBlock*   FreeList[SizeClassCount];          //
+        uint32_t     FreeCount[SizeClassCount];         // Number of blocks in FreeList.
+        uint32_t     LowFreeCount[SizeClassCount];      // Minimum FreeCount since the last rebalance.
+    };
+
+    struct CentralPool
+    {
+        FreeBlock* FreeList;
+        uint32_t   FreeCount;
+    };
+
+    static const uint16_t LargeSizeClass = 0xffff;
+    static const uint16_t HeaderMagic    = 0x7c4e;
+
+    static BlockHeader* GetHeader(const void* p)
+        { return reinterpret_cast<BlockHeader*>(const_cast<char*>(static_cast<const char*>(p)) - sizeof(BlockHeader)); }
+
+    ThreadCache* GetThreadCache();
+    void*        AllocLarge(size_t size, size_t align);
+    void         FreeLarge(BlockHeader* header);
+    void         ReleaseToCentral(size_t sizeClass, FreeBlock* first, FreeBlock* last, uint32_t count);
+    void         RefillFromCentral(ThreadCache* cache, size_t sizeClass);
+    void         TrimThreadCache(ThreadCache* cache, size_t sizeClass, uint32_t count);
+    void         Rebalance(ThreadCache* cache);
+    void         FreeBlockList(FreeBlock* list);
+
+    Heap*             WrappedHeap;                  // The heap we get memory from. We own it.
+    size_t            WrappedHeapSize;              // sizeof the wrapped heap's class, needed for SysMemFree.
+    uint64_t          InstanceId;                   // Unique per Init call. Used to tell if a thread's cache belongs to us.
+    mutable OVR::Lock CentralLock;                  // Guards Central and ThreadCacheList.
+    CentralPool       Central[SizeClassCount];      //
+    ThreadCache*      ThreadCacheList;              // All ThreadCaches we've created.
+};
+
+
+
 //------------------------------------------------------------------------
 // ***** DebugPageHeap
 // 
@@ -1004,14 +1581,20 @@ public:
     bool  Init();
     void  Shutdown();
 
-    void   SetMaxDelayedFreeCount(size_t delayedFreeCount); // Sets how many freed blocks we should save before purging the oldest of them.
+    void   SetMaxDelayedFreeCount(size_t delayedFreeCount); // Sets how many freed blocks we should save (across all threads) before purging the oldest of them. Must not be called while other threads use this heap.
     size_t GetMaxDelayedFreeCount() const;                  // Returns the max number of delayed free allocations before the oldest ones are purged (finally freed).
+    void   SetProtectBatchSize(size_t protectBatchSize);    // Sets how many freed blocks a thread collects before making them inaccessible in one pass. 1 means immediately.
+    size_t GetProtectBatchSize() const;
     void   EnableOverrunDetection(bool enableOverrunDetection, bool enableOverrunGuardBytes);  // enableOverrunDetection is by default. enableOverrunGuardBytes is enabled by default in debug builds.
+    size_t GetAllocationCount() const { return AllocationCount.load(std::memory_order_relaxed); }
+    size_t GetDelayedFreeCount() const { return DelayedFreeCount.load(std::memory_order_relaxed); }
+    size_t GetThreadDelayedFreeCount() const;               // Returns the number of delay-freed blocks held by the calling thread's ring.
 
     void*  Alloc(size_t size);
     void*  AllocAligned(size_t size, size_t align);
     size_t GetAllocSize(const void* p) const { return GetUserSize(p); }
     size_t GetAllocAlignedSize(const void* p, size_t /*align*/) const { return GetUserSize(p); }
+    size_t GetAllocSizeNoLock(const void* p) const { return GetUserSize(p); }
     void*  Realloc(void* p, size_t newSize);
     void*  ReallocAligned(void* p, size_t newSize, size_t newAlign);
     void   Free(void* p);
@@ -1027,15 +1610,37 @@ protected:
         void Clear() { BlockPtr = nullptr; BlockSize = 0; }
     };
 
-    Block*    FreedBlockArray;                            // Currently a very simple array-like container that acts as a ring buffer of delay-freed (but inaccessible) blocks. 
-    size_t    FreedBlockArrayMaxSize;                     // The max number of Freed blocks to put into FreedBlockArray before they start getting purged. Must be <= kFreedBlockArrayCapacity.
-    size_t    FreedBlockArraySize;                        // The amount of valid elements within FreedBlockArray. Increases as elements are added until it reaches kFreedBlockArrayCapacity. Then stays that way until Shutdown.
-    size_t    FreedBlockArrayOldest;                      // The oldest entry in the FreedBlockArray ring buffer.
-    size_t    AllocationCount;                            // Number of currently live Allocations. Incremented by successful calls to Alloc (etc.)  Decremented by successful calss to Free.
-    bool      OverrunPageEnabled;                         // If true then we implement memory overrun detection, at the cost of an extra page per user allocation.
-    bool      OverrunGuardBytesEnabled;                   // If true then any remaining bytes between the end of the user's allocation and the end of the page are filled with guard bytes and verified upon Free. Valid only if OverrunPageEnabled is true. 
-    size_t    PageSize;                                   // The current default platform memory page size (e.g. 4096). We allocated blocks in multiples of pages.
-    OVR::Lock Lock;                                       // Mutex which allows an instance of this class to be used by multiple threads simultaneously.
+    // Each thread which frees memory gets its own ring buffer of delay-freed (but inaccessible) blocks,
+    // so Free needs no lock. Rings are found via thread-local storage and are accessed only by their
+    // owning thread, except by Shutdown and SetMaxDelayedFreeCount, which require that no other thread
+    // is using the heap, and by ReclaimExitedThreadRings once the owner has exited.
+    // The newest PendingCount blocks of a ring have not been made inaccessible yet.
+    // We have no thread exit notification, so a ring outlives its thread. Its blocks would keep
+    // counting against MaxDelayedFreeCount, leaving live threads to purge their own blocks right
+    // away. So a thread which keeps purging because of that budget periodically empties the rings of
+    // exited threads, and a thread's first Free takes over such a ring instead of creating another.
+    struct FreeRing
+    {
+        FreeRing* Next;             // Next in FreeRingList.
+        uint32_t  ThreadId;         // The thread which owns this ring, or 0 if the ring is empty and unowned.
+        size_t    Size;             // The amount of valid elements within Blocks.
+        size_t    Oldest;           // The oldest entry in the Blocks ring buffer.
+        size_t    PendingCount;     // The number of newest entries which are still accessible, awaiting a batched DisablePageMemory.
+        size_t    BudgetPurgeCount; // Blocks this ring purged early due to MaxDelayedFreeCount, since it last checked for exited threads' rings.
+        Block     Blocks[1];        // Actually RingCapacity entries.
+    };
+
+    FreeRing*           FreeRingList;               // All rings created for this heap. Each is owned by a thread that has freed memory, or unowned.
+    OVR::Lock           FreeRingListLock;           // Guards FreeRingList and ring ownership. Used the first time a thread frees memory, when reclaiming rings, and upon Shutdown.
+    uint64_t            InstanceId;                 // Identifies the current generation of FreeRingList, so that threads don't use a stale ring from thread-local storage.
+    size_t              MaxDelayedFreeCount;        // The max number of freed blocks to hold (across all rings) before they start getting purged.
+    size_t              RingCapacity;               // The max number of blocks in a single thread's ring. <= MaxDelayedFreeCount.
+    size_t              ProtectBatchSize;           // See SetProtectBatchSize.
+    std::atomic<size_t> DelayedFreeCount;           // The number of blocks currently held in all rings.
+    std::atomic<size_t> AllocationCount;            // Number of currently live Allocations. Incremented by successful calls to Alloc (etc.)  Decremented by successful calss to Free.
+    bool                OverrunPageEnabled;         // If true then we implement memory overrun detection, at the cost of an extra page per user allocation.
+    bool                OverrunGuardBytesEnabled;   // If true then any remaining bytes between the end of the user's allocation and the end of the page are filled with guard bytes and verified upon Free. Valid only if OverrunPageEnabled is true. 
+    size_t              PageSize;                   // The current default platform memory page size (e.g. 4096). We allocated blocks in multiples of pages.
 
 public:
     #if defined(_WIN64) || defined(_M_IA64) || defined(__LP64__) || defined(__LP64__) || defined(__arch64__) || defined(__APPLE__)
@@ -1043,11 +1648,11 @@ public:
     #else
     static const size_t  DefaultAlignment = 8;                // 32 bit platforms. We want DefaultAlignment as low as possible because that means less unused bytes between a user allocation and the end of the page.
     #endif
-    #if defined(_WIN32)
     static const size_t  MaxAlignment = 2048;                 // Half a page size.
-    #else
-    static const size_t  MaxAlignment = DefaultAlignment;     // Currently a low limit because we don't have full page allocator support yet.
-    #endif
+    static const size_t  MaxRingCapacity = 4096;              // Upper limit for the delayed free ring of a single thread.
+    static const size_t  MaxProtectBatchSize = 64;            // Upper limit for SetProtectBatchSize.
+    static const size_t  FreeRingReuseThreshold = 8;          // Rings we create before a thread's first Free looks for the ring of an exited thread.
+    static const size_t  ExitedRingCheckInterval = 256;       // Early purges by a ring between checks for exited threads' rings to empty.
 
 protected:
     static const size_t  SizeStorageSize = DefaultAlignment;  // Where the user size and block size is stored. Needs to be at least 2 * sizeof(size_t).
@@ -1061,6 +1666,12 @@ protected:
 
     void* GetBlockPtr(void* p);
     void* GetUserPosition(void* pPageMemory, size_t blockSize, size_t userSize, size_t userAlignment);
+    FreeRing* GetFreeRing();
+    FreeRing* FindUnownedRing();
+    size_t ReclaimExitedThreadRings();
+    void  ReleaseFreeRings();
+    void  PurgeOldestBlock(FreeRing* ring);
+    void  FlushPendingBlocks(FreeRing* ring);
     void* AllocCommittedPageMemory(size_t blockSize);
     void* EnablePageMemory(void* pPageMemory, size_t blockSize);
     void  DisablePageMemory(void* pPageMemory, size_t blockSize);
@@ -1069,6 +1680,199 @@ protected:
 
 
 
+///------------------------------------------------------------------------
+/// ***** ArenaHeap
+///
+/// A Heap which allocates by incrementing a pointer and frees everything at once upon Reset.
+/// This is useful for temporaries with a well defined lifetime, such as per-frame or per-request
+/// data (e.g. JSON parse trees, string formatting). Usually this is used via ArenaHeapScope, which
+/// routes a thread's OVR_ALLOC calls to the arena.
+///
+/// Implementation notes:
+///   Init reserves a single contiguous range of address space, which is committed in CommitSize
+///       steps as the arena grows. Reset doesn't decommit, so a reused arena makes no system calls.
+///   Because the range is contiguous, Allocator can cheaply tell that a pointer belongs to an arena
+///       (see FindArena) and forwards Free, Realloc, etc. of it to the arena.
+///   Free does nothing. Realloc of the most recent allocation grows or shrinks it in place.
+///   Arena allocations are not tracked by the Allocator and so don't appear in heap traces.
+///   The arena isn't thread-safe: only one thread at a time may Alloc, Realloc, or Reset it.
+///       Memory from it can be used and freed by any thread, though it's invalid after Reset.
+///       Allocator::Realloc of it from another thread copies it to that thread's arena or heap.
+///
+class ArenaHeap : public Heap
+{
+public:
+    ArenaHeap(size_t reserveSize = DefaultReserveSize, size_t commitSize = DefaultCommitSize);
+    virtual ~ArenaHeap();
+
+    bool   Init();                      // Reserves the address space. Fails if MaxArenaCount arenas are initialized already.
+    void   Shutdown();                  // Releases all memory, as with Reset.
+    void   Reset();                     // Frees all allocations at once.
+
+    void*  Alloc(size_t size);
+    void*  AllocAligned(size_t size, size_t align);
+    size_t GetAllocSize(const void* p) const;
+    size_t GetAllocAlignedSize(const void* p, size_t /*align*/) const { return GetAllocSize(p); }
+    void   Free(void* p);
+    void   FreeAligned(void* p);
+    void*  Realloc(void* p, size_t newSize);
+    void*  ReallocAligned(void* p, size_t newSize, size_t newAlign);
+
+    bool   Contains(const void* p) const { return ((p >= Base) && (p < (Base + ReserveSize))); }
+    size_t GetUsedSize() const { return UsedSize; }             // Bytes allocated since the last Reset, including headers and alignment.
+    size_t GetPeakUsedSize() const { return PeakUsedSize; }     // Max UsedSize since Init.
+    size_t GetCommittedSize() const { return CommittedSize; }
+
+    static ArenaHeap* FindArena(const void* p);             // Returns the initialized arena which p belongs to, else nullptr.
+    static ArenaHeap* GetThreadArena();                     // Returns the arena which the calling thread's Allocator calls go to, else nullptr.
+    static ArenaHeap* SetThreadArena(ArenaHeap* arena);     // Returns the previous thread arena. Use ArenaHeapScope instead of calling this directly.
+
+    static const size_t DefaultReserveSize = (256 * 1024 * 1024);
+    static const size_t DefaultCommitSize  = (1024 * 1024);
+    static const size_t DefaultAlignment   = 16;
+    static const size_t MaxArenaCount      = 32;
+
+protected:
+    static const size_t HeaderSize = DefaultAlignment;      // Each allocation is preceded by its size.
+
+    bool   Commit(size_t requiredSize);                     // Makes sure at least requiredSize bytes from Base are committed.
+
+    uint8_t* Base;              // Start of the reserved range.
+    size_t   ReserveSize;       // Size of the reserved range.
+    size_t   CommitSize;        // Granularity with which we commit the reserved range.
+    size_t   CommittedSize;     // Size of the committed part of the reserved range, which starts at Base.
+    size_t   UsedSize;          // Size of the allocated part of the reserved range, which starts at Base.
+    size_t   PeakUsedSize;
+    uint8_t* LastAlloc;         // The most recent allocation, which Realloc can resize in place.
+    size_t   RegistryIndex;     // Where we are in the arena registry used by FindArena. MaxArenaCount if not registered.
+};
+
+
+///------------------------------------------------------------------------
+/// ***** ArenaHeapScope
+///
+/// Routes allocations made via the global Allocator by the calling thread to the given ArenaHeap
+/// for the lifetime of this object. Optionally resets the arena when the scope ends.
+///
+/// Example usage:
+///    void Server::HandleRequest(const char* text)
+///    {
+///        ArenaHeapScope arenaScope(&RequestArena, true);
+///
+///        JSON* json = JSON::Parse(text); // All nodes and strings are allocated from RequestArena.
+///        ...
+///    }                                   // All of them are freed here at once.
+///
+class ArenaHeapScope
+{
+public:
+    ArenaHeapScope(ArenaHeap* arena, bool resetOnExit = false)
+      : Arena(arena)
+      , PreviousArena(ArenaHeap::SetThreadArena(arena))
+      , ResetOnExit(resetOnExit)
+    {
+    }
+
+    ~ArenaHeapScope()
+    {
+        ArenaHeap::SetThreadArena(PreviousArena);
+
+        if (ResetOnExit && Arena && (Arena != PreviousArena)) // Don't reset an arena that an enclosing scope is still using.
+            Arena->Reset();
+    }
+
+protected:
+    ArenaHeap* Arena;
+    ArenaHeap* PreviousArena;
+    bool       ResetOnExit;
+};
+
+
+///------------------------------------------------------------------------
+/// ***** PoolAllocator
+///
+/// Allocates fixed-size slots (e.g. instances of one class) from 64 KB slabs of SafeMMapAlloc memory.
+/// Classes normally opt into this via OVR_MEMORY_REDEFINE_NEW_POOLED.
+///
+/// Implementation notes:
+///   Each thread has a free list per pool, so Alloc and Free normally need no lock. A thread whose
+///       list runs empty takes a batch of slots from the pool's central free list, and a thread
+///       whose list grows beyond MaxThreadFreeCount gives half of it back.
+///   Slabs are never returned to the system, and pools are never destroyed, as objects may be freed
+///       during static destruction. GetStats reports how much of the slab memory is in use.
+///   While the Allocator's tracking is enabled, slots are tracked like its own allocations, so that
+///       leaked pooled objects are reported. If the Allocator uses the DebugPageHeap then pools
+///       pass every allocation through to the Allocator so that page guarding still applies.
+///   Within an ArenaHeapScope, slots are allocated from the thread's ArenaHeap instead.
+///   Slots are aligned to 16 bytes. Classes with stricter alignment requirements can't be pooled.
+///
+class PoolAllocator
+{
+public:
+    static PoolAllocator* Create(size_t slotSize, const char* name); // Returns nullptr on failure. Never destroyed. name must be a literal or otherwise persist.
+
+    void*  Alloc();                     // Returns nullptr on failure.
+    void   Free(void* p);               // p must be from Alloc of this pool. Any thread may free it.
+    bool   Contains(const void* p) const;  // Returns true if p is a slot from this pool. Slow, as it searches the slabs.
+
+    size_t      GetSlotSize() const { return SlotSize; }
+    const char* GetName() const { return Name; }
+
+    struct Stats
+    {
+        size_t   SlabCount;             // Number of slabs allocated so far.
+        uint64_t SlotCapacity;          // Number of slots in all slabs.
+        uint64_t LiveCount;             // Number of slots currently allocated. May be briefly inaccurate while other threads are using the pool.
+        uint64_t ThreadFreeCount;       // Number of free slots held in thread free lists.
+        uint64_t CentralFreeCount;      // Number of free slots held in the central free list.
+    };
+
+    void GetStats(Stats& stats) const;
+
+    // Iterates all pools ever created, e.g. for reporting. The list only grows, so no lock is needed.
+    static PoolAllocator* GetFirstPool();
+    PoolAllocator* GetNextPool() const { return Next; }
+
+    static const size_t SlabSize           = 65536;
+    static const size_t SlotAlignment      = 16;
+    static const size_t MaxPoolCount       = 64;    // Pools beyond this many have no thread free lists and always use the central list.
+    static const size_t MaxThreadFreeCount = 64;    // When a thread's free list for a pool reaches this, half of it is returned to the central list.
+    static const size_t TransferCount      = 32;    // Number of slots moved between a thread and the central list at a time.
+
+protected:
+    struct FreeSlot
+    {
+        FreeSlot* Next;
+    };
+
+    struct Slab
+    {
+        Slab* Next;
+    };
+
+    PoolAllocator(size_t slotSize, const char* name, size_t index, bool passThrough);
+
+    bool      AllocSlab();              // Adds a slab's worth of slots to the central list. CentralLock must be held.
+    void*     AllocSlot();              // Alloc without pass-through, arena or tracking.
+    FreeSlot* TakeFromCentral(size_t& count);   // Removes up to count slots from the central list as a linked list, setting count to the actual number.
+    void      ReturnToCentral(FreeSlot* first, FreeSlot* last, size_t count);
+
+    PoolAllocator*        Next;             // Next in the global pool list. Set before the pool is added to the list and never changed after.
+    const char*           Name;
+    size_t                SlotSize;         // Requested size rounded up to SlotAlignment.
+    size_t                Index;            // Identifies our thread free list within each thread's PoolThreadCache. >= MaxPoolCount if none.
+    bool                  PassThrough;      // If true then we forward to the Allocator. See above.
+    mutable OVR::Lock     CentralLock;      // Guards everything below.
+    Slab*                 SlabList;
+    size_t                SlabCount;
+    FreeSlot*             CentralFreeList;
+    size_t                CentralFreeCount;
+    std::atomic<uint64_t> CentralAllocCount;    // Allocs and Frees of pools without thread free lists.
+    std::atomic<uint64_t> CentralFreeCallCount;
+};
+
+
+
 ///------------------------------------------------------------------------
 /// ***** AllocatorTagScope
 ///
@@ -1164,6 +1968,50 @@ extern const char* allocatorReportStateDbgCmdDoc;
 extern int AllocatorReportStateDbgCmd(const std::vector<std::string>&, std::string* output);
 
 
+// AllocatorEnableSamplingDbgCmd
+//
+// This is a debug command that lets you enable or disable heap sampling in the Allocator.
+//
+extern const char* allocatorEnableSamplingDbgCmdName;
+extern const char* allocatorEnableSamplingDbgCmdUsage;
+extern const char* allocatorEnableSamplingDbgCmdDesc;
+extern const char* allocatorEnableSamplingDbgCmdDoc;
+extern int AllocatorEnableSamplingDbgCmd(const std::vector<std::string>& args, std::string* output);
+
+
+// AllocatorTraceSamplesDbgCmd
+//
+// This is a debug command that lets you dump the sampled heap profile into a file.
+//
+extern const char* allocatorTraceSamplesDbgCmdName;
+extern const char* allocatorTraceSamplesDbgCmdUsage;
+extern const char* allocatorTraceSamplesDbgCmdDesc;
+extern const char* allocatorTraceSamplesDbgCmdDoc;
+extern int AllocatorTraceSamplesDbgCmd(const std::vector<std::string>& args, std::string* output);
+
+
+// AllocatorReportPoolsDbgCmd
+//
+// This is a debug command that lets you see the occupancy of each PoolAllocator.
+//
+extern const char* allocatorReportPoolsDbgCmdName;
+extern const char* allocatorReportPoolsDbgCmdUsage;
+extern const char* allocatorReportPoolsDbgCmdDesc;
+extern const char* allocatorReportPoolsDbgCmdDoc;
+extern int AllocatorReportPoolsDbgCmd(const std::vector<std::string>& args, std::string* output);
+
+
+// AllocatorReportHeapStatsDbgCmd
+//
+// This is a debug command that lets you see the HeapStats of the default Allocator as JSON.
+//
+extern const char* allocatorReportHeapStatsDbgCmdName;
+extern const char* allocatorReportHeapStatsDbgCmdUsage;
+extern const char* allocatorReportHeapStatsDbgCmdDesc;
+extern const char* allocatorReportHeapStatsDbgCmdDoc;
+extern int AllocatorReportHeapStatsDbgCmd(const std::vector<std::string>& args, std::string* output);
+
+
 
 
 ///------------------------------------------------------------------------
@@ -1336,6 +2184,7 @@ void deletea_Impl(T* pTArray)
 // if necessary.
 
 #define OVR_REALLOC(p, size)            OVR::Allocator::GetInstance()->Realloc((p), (size))
+#define OVR_TRY_EXPAND(p, size)         OVR::Allocator::GetInstance()->TryExpand((p), (size))
 #define OVR_FREE(p)                     OVR::Allocator::GetInstance()->Free((p))
 #define OVR_FREE_ALIGNED(p)             OVR::Allocator::GetInstance()->FreeAligned((p))
 
@@ -28,6 +28,7 @@ limitations under the License.
 #define OVR_Array_h
 
 #include "OVR_ContainerAllocator.h"
+#include <type_traits>
 
 namespace OVR {
 
@@ -35,7 +36,7 @@ namespace OVR {
 // ***** ArrayDefaultPolicy
 //
 // Default resize behavior. No minimal capacity, Granularity=4, 
-// Shrinking as needed. ArrayConstPolicy actually is the same as 
+// Shrinking as needed, growth by 25%. ArrayConstPolicy actually is the same as 
 // ArrayDefaultPolicy, but parametrized with constants. 
 // This struct is used only in order to reduce the template "matroska".
 struct ArrayDefaultPolicy
@@ -47,6 +48,9 @@ struct ArrayDefaultPolicy
     size_t GetGranularity() const { return 4; }
     bool  NeverShrinking() const { return 1; }
 
+    // Returns the capacity to reserve when the array grows to size.
+    size_t GetGrowthCapacity(size_t size) const { return size + (size >> 2); }
+
     size_t GetCapacity()    const      { return Capacity; }
     void  SetCapacity(size_t capacity) { Capacity = capacity; }
 private:
@@ -58,11 +62,14 @@ private:
 // ***** ArrayConstPolicy
 //
 // Statically parametrized resizing behavior:
-// MinCapacity, Granularity, and Shrinking flag.
-template<int MinCapacity=0, int Granularity=4, bool NeverShrink=false>
+// MinCapacity, Granularity, Shrinking flag, and the percentage by which 
+// capacity exceeds the size when the array grows. Arrays which are 
+// appended to a lot benefit from a larger GrowthPercent (e.g. 100), 
+// at the cost of more unused memory.
+template<int MinCapacity=0, int Granularity=4, bool NeverShrink=false, int GrowthPercent=25>
 struct ArrayConstPolicy
 {
-    typedef ArrayConstPolicy<MinCapacity, Granularity, NeverShrink> SelfType;
+    typedef ArrayConstPolicy<MinCapacity, Granularity, NeverShrink, GrowthPercent> SelfType;
 
     ArrayConstPolicy() : Capacity(0) {}
     ArrayConstPolicy(const SelfType&) : Capacity(0) {}
@@ -71,6 +78,12 @@ struct ArrayConstPolicy
     size_t GetGranularity() const { return Granularity; }
     bool  NeverShrinking() const { return NeverShrink; }
 
+    size_t GetGrowthCapacity(size_t size) const 
+    { 
+        OVR_COMPILER_ASSERT(GrowthPercent >= 0);
+        return size + (size / 100) * GrowthPercent + ((size % 100) * GrowthPercent) / 100;
+    }
+
     size_t GetCapacity()    const      { return Capacity; }
     void  SetCapacity(size_t capacity) { Capacity = capacity; }
 private:
@@ -146,7 +159,11 @@ struct ArrayDataBase
             newCapacity = (newCapacity + gran - 1) / gran * gran;
             if (Data)
             {
-                if (Allocator::IsMovable())
+                if ((newCapacity > GetCapacity()) && Allocator::TryExpand(Data, sizeof(T) * newCapacity))
+                {
+                    // The heap grew the block in place, so there is nothing to move.
+                }
+                else if (Allocator::IsMovable())
                 {
                     Data = (T*)Allocator::Realloc(Data, sizeof(T) * newCapacity);
                 }
@@ -155,11 +172,7 @@ struct ArrayDataBase
                     T* newData = (T*)Allocator::Alloc(sizeof(T) * newCapacity);
                     size_t i, s;
                     s = (Size < newCapacity) ? Size : newCapacity;
-                    for (i = 0; i < s; ++i)
-                    {
-                        Allocator::Construct(&newData[i], Data[i]);
-                        Allocator::Destruct(&Data[i]);
-                    }
+                    Allocator::RelocateArray(newData, Data, s);
                     for (i = s; i < Size; ++i)
                     {
                         Allocator::Destruct(&Data[i]);
@@ -195,7 +208,7 @@ struct ArrayDataBase
         }
         else if(newSize >= Policy.GetCapacity())
         {
-            Reserve(newSize + (newSize >> 2));
+            Reserve(Policy.GetGrowthCapacity(newSize));
         }
         //! IMPORTANT to modify Size only after Reserve completes, because garbage collectable
         // array may use this array and may traverse it during Reserve (in the case, if 
@@ -249,6 +262,13 @@ struct ArrayData : ArrayDataBase<T, Allocator, SizePolicy>
         Allocator::Construct(this->Data + this->Size - 1, val);
     }
 
+    void PushBack(ValueType&& val)
+    {
+        BaseType::ResizeNoConstruct(this->Size + 1);
+        OVR_ASSERT(this->Data != NULL);
+        Allocator::ConstructMove(this->Data + this->Size - 1, val);
+    }
+
     template<class S>
     void PushBackAlt(const S& val)
     {
@@ -308,6 +328,12 @@ struct ArrayDataCC : ArrayDataBase<T, Allocator, SizePolicy>
         Allocator::Construct(this->Data + this->Size - 1, val);
     }
 
+    void PushBack(ValueType&& val)
+    {
+        BaseType::ResizeNoConstruct(this->Size + 1);
+        Allocator::ConstructMove(this->Data + this->Size - 1, val);
+    }
+
     template<class S>
     void PushBackAlt(const S& val)
     {
@@ -331,6 +357,193 @@ struct ArrayDataCC : ArrayDataBase<T, Allocator, SizePolicy>
 
 
 
+//-----------------------------------------------------------------------------------
+// ***** ArrayDataInline
+//
+// A modification of ArrayData that stores up to N elements inside the object
+// itself and moves them to the heap only when the array grows beyond that. 
+// The elements move back into the object when the array shrinks enough again.
+// For internal use only in ArrayInline.
+template<class T, class Allocator, class SizePolicy, size_t N>
+struct ArrayDataInline
+{
+    typedef T                                                   ValueType;
+    typedef Allocator                                           AllocatorType;
+    typedef SizePolicy                                          SizePolicyType;
+    typedef ArrayDataInline<T, Allocator, SizePolicy, N>        SelfType;
+
+    ArrayDataInline()
+        : Data(GetInlineData()), Size(0), Policy() { Policy.SetCapacity(N); }
+
+    ArrayDataInline(size_t size)
+        : Data(GetInlineData()), Size(0), Policy() { Policy.SetCapacity(N); Resize(size); }
+
+    ArrayDataInline(const SelfType& a)
+        : Data(GetInlineData()), Size(0), Policy(a.Policy) { Policy.SetCapacity(N); Append(a.Data, a.Size); }
+
+    ~ArrayDataInline()
+    {
+        Allocator::DestructArray(Data, Size);
+        if (!IsInline())
+            Allocator::Free(Data);
+    }
+
+    bool IsInline() const
+    {
+        return (Data == GetInlineData());
+    }
+
+    size_t GetCapacity() const 
+    { 
+        return Policy.GetCapacity(); 
+    }
+
+    void ClearAndRelease()
+    {
+        Allocator::DestructArray(Data, Size);
+        if (!IsInline())
+        {
+            Allocator::Free(Data);
+            Data = GetInlineData();
+        }
+        Size = 0;
+        Policy.SetCapacity(N);
+    }
+
+    void Reserve(size_t newCapacity)
+    {
+        if (Policy.NeverShrinking() && newCapacity < GetCapacity())
+            return;
+
+        if (newCapacity < Policy.GetMinCapacity())
+            newCapacity = Policy.GetMinCapacity();
+
+        OVR_ASSERT(newCapacity >= Size); // Callers destruct excess elements first.
+
+        if (newCapacity <= N)
+        {
+            if (!IsInline())
+            {
+                T* heapData = Data;
+                MoveElements(GetInlineData(), heapData, Size);
+                Allocator::Free(heapData);
+                Data = GetInlineData();
+            }
+            Policy.SetCapacity(N);
+        }
+        else
+        {
+            size_t gran = Policy.GetGranularity();
+            newCapacity = (newCapacity + gran - 1) / gran * gran;
+
+            if (IsInline())
+            {
+                T* newData = (T*)Allocator::Alloc(sizeof(T) * newCapacity);
+                MoveElements(newData, Data, Size);
+                Data = newData;
+            }
+            else if ((newCapacity > GetCapacity()) && Allocator::TryExpand(Data, sizeof(T) * newCapacity))
+            {
+                // The heap grew the block in place, so there is nothing to move.
+            }
+            else if (Allocator::IsMovable())
+            {
+                Data = (T*)Allocator::Realloc(Data, sizeof(T) * newCapacity);
+            }
+            else
+            {
+                T* newData = (T*)Allocator::Alloc(sizeof(T) * newCapacity);
+                MoveElements(newData, Data, Size);
+                Allocator::Free(Data);
+                Data = newData;
+            }
+            Policy.SetCapacity(newCapacity);
+        }
+    }
+
+    // This version of Resize DOES NOT construct the elements.
+    void ResizeNoConstruct(size_t newSize)
+    {
+        size_t oldSize = Size;
+
+        if (newSize < oldSize)
+        {
+            Allocator::DestructArray(Data + newSize, oldSize - newSize);
+            Size = newSize;
+            if (!IsInline() && (newSize < (Policy.GetCapacity() >> 1)))
+            {
+                Reserve(newSize);
+            }
+        }
+        else if(newSize > Policy.GetCapacity()) // Unlike ArrayDataBase we use >, so that N elements fit inline.
+        {
+            Reserve(Policy.GetGrowthCapacity(newSize));
+        }
+        Size = newSize;
+    }
+
+    void Resize(size_t newSize)
+    {
+        size_t oldSize = Size;
+        ResizeNoConstruct(newSize);
+        if(newSize > oldSize)
+            Allocator::ConstructArray(Data + oldSize, newSize - oldSize);
+    }
+
+    void PushBack(const ValueType& val)
+    {
+        ResizeNoConstruct(Size + 1);
+        Allocator::Construct(Data + Size - 1, val);
+    }
+
+    void PushBack(ValueType&& val)
+    {
+        ResizeNoConstruct(Size + 1);
+        Allocator::ConstructMove(Data + Size - 1, val);
+    }
+
+    template<class S>
+    void PushBackAlt(const S& val)
+    {
+        ResizeNoConstruct(Size + 1);
+        Allocator::ConstructAlt(Data + Size - 1, val);
+    }
+
+    // Append the given data to the array.
+    void Append(const ValueType other[], size_t count)
+    {
+        if (count)
+        {
+            size_t oldSize = Size;
+            ResizeNoConstruct(Size + count);
+            Allocator::ConstructArray(Data + oldSize, count, other);
+        }
+    }
+
+    ValueType*  Data;
+    size_t      Size;
+    SizePolicy  Policy;
+
+protected:
+    // Moves count elements from src to the uninitialized memory at dest.
+    static void MoveElements(T* dest, T* src, size_t count)
+    {
+        Allocator::RelocateArray(dest, src, count);
+    }
+
+    T* GetInlineData() const
+    {
+        return reinterpret_cast<T*>(const_cast<typename std::aligned_storage<sizeof(T), OVR_ALIGNOF(T)>::type*>(InlineData));
+    }
+
+    typename std::aligned_storage<sizeof(T), OVR_ALIGNOF(T)>::type InlineData[N];
+
+private:
+    void operator=(const SelfType&); // Not implemented, as Data may point into the source. ArrayBase assigns elements instead.
+};
+
+
+
 
 
 //-----------------------------------------------------------------------------------
@@ -440,6 +653,12 @@ public:
         Data.PushBack(val);
     }
 
+    // Moves val into a new element at the end of the array.
+    void    PushBack(ValueType&& val)
+    {
+        Data.PushBack(std::move(val));
+    }
+
     template<class S>
     void PushBackAlt(const S& val)
     {
@@ -462,7 +681,7 @@ public:
     ValueType Pop()
     {
         OVR_ASSERT((Data.Data) && (Data.Size > 0));
-        ValueType t = Back();
+        ValueType t = std::move(Back());
         PopBack();
         return t;
     }
@@ -497,11 +716,22 @@ public:
         }
         else
         {
-            AllocatorType::DestructArray(Data.Data + index, num);
-            AllocatorType::CopyArrayForward(
-                Data.Data + index, 
-                Data.Data + index + num,
-                Data.Size - num - index);
+            if (AllocatorType::IsMovable())
+            {
+                AllocatorType::DestructArray(Data.Data + index, num);
+                AllocatorType::RelocateArray(
+                    Data.Data + index, 
+                    Data.Data + index + num,
+                    Data.Size - num - index);
+            }
+            else
+            {
+                AllocatorType::CopyArrayForward(
+                    Data.Data + index, 
+                    Data.Data + index + num,
+                    Data.Size - num - index);
+                AllocatorType::DestructArray(Data.Data + Data.Size - num, num);
+            }
             Data.Size -= num;
         }
     }
@@ -520,11 +750,22 @@ public:
         }
         else
         {
-            AllocatorType::Destruct(Data.Data + index);
-            AllocatorType::CopyArrayForward(
-                Data.Data + index, 
-                Data.Data + index + 1,
-                Data.Size - 1 - index);
+            if (AllocatorType::IsMovable())
+            {
+                AllocatorType::Destruct(Data.Data + index);
+                AllocatorType::RelocateArray(
+                    Data.Data + index, 
+                    Data.Data + index + 1,
+                    Data.Size - 1 - index);
+            }
+            else
+            {
+                AllocatorType::CopyArrayForward(
+                    Data.Data + index, 
+                    Data.Data + index + 1,
+                    Data.Size - 1 - index);
+                AllocatorType::Destruct(Data.Data + Data.Size - 1);
+            }
             --Data.Size;
         }
     }
@@ -548,7 +789,7 @@ public:
             if (index < lastElemIndex)
             {
                 AllocatorType::Destruct(Data.Data + index);
-                AllocatorType::Construct(Data.Data + index, Data.Data[lastElemIndex]);
+                AllocatorType::ConstructMove(Data.Data + index, Data.Data[lastElemIndex]);
             }
             AllocatorType::Destruct(Data.Data + lastElemIndex);
             --Data.Size;
@@ -563,10 +804,28 @@ public:
         Data.Resize(Data.Size + 1);
         if (index < Data.Size - 1)
         {
-            AllocatorType::CopyArrayBackward(
-                Data.Data + index + 1, 
-                Data.Data + index, 
-                Data.Size - 1 - index);
+            if (AllocatorType::IsMovable())
+            {
+                AllocatorType::Destruct(Data.Data + Data.Size - 1);
+                AllocatorType::RelocateArray(
+                    Data.Data + index + 1, 
+                    Data.Data + index, 
+                    Data.Size - 1 - index);
+            }
+            else
+            {
+                // The elements are only shifted up by assignment, so the one at index is still alive.
+                AllocatorType::CopyArrayBackward(
+                    Data.Data + index + 1, 
+                    Data.Data + index, 
+                    Data.Size - 1 - index);
+                Data.Data[index] = val;
+                return;
+            }
+        }
+        else
+        {
+            AllocatorType::Destruct(Data.Data + index);
         }
         AllocatorType::Construct(Data.Data + index, val);
     }
@@ -579,10 +838,28 @@ public:
         Data.Resize(Data.Size + num);
         if (index < Data.Size - num)
         {
-            AllocatorType::CopyArrayBackward(
-                Data.Data + index + num,
-                Data.Data + index,
-                Data.Size - num - index);
+            if (AllocatorType::IsMovable())
+            {
+                AllocatorType::DestructArray(Data.Data + Data.Size - num, num);
+                AllocatorType::RelocateArray(
+                    Data.Data + index + num,
+                    Data.Data + index,
+                    Data.Size - num - index);
+            }
+            else
+            {
+                AllocatorType::CopyArrayBackward(
+                    Data.Data + index + num,
+                    Data.Data + index,
+                    Data.Size - num - index);
+                for (size_t i = 0; i < num; ++i)
+                    Data.Data[index + i] = val;
+                return;
+            }
+        }
+        else
+        {
+            AllocatorType::DestructArray(Data.Data + index, num);
         }
         for (size_t i = 0; i < num; ++i)
             AllocatorType::Construct(Data.Data + index + i, val);
@@ -843,6 +1120,35 @@ public:
     const SelfType& operator=(const SelfType& a) { BaseType::operator=(a); return *this; }
 };
 
+
+// ***** ArrayInline
+//
+// Same as Array, but keeps up to N elements inside the array object itself
+// instead of on the heap. Small temporary arrays can thus be built without
+// any memory allocation. Beyond N elements it allocates like Array does.
+// Note that moving between inline and heap storage moves the elements, as 
+// does any growth of an Array.
+template<class T, size_t N, class SizePolicy=ArrayDefaultPolicy>
+class ArrayInline : public ArrayBase<ArrayDataInline<T, ContainerAllocator<T>, SizePolicy, N> >
+{
+public:
+    typedef T                                                                       ValueType;
+    typedef ContainerAllocator<T>                                                   AllocatorType;
+    typedef SizePolicy                                                              SizePolicyType;
+    typedef ArrayInline<T, N, SizePolicy>                                           SelfType;
+    typedef ArrayBase<ArrayDataInline<T, ContainerAllocator<T>, SizePolicy, N> >   BaseType;
+
+    static const size_t InlineCapacity = N;
+
+    ArrayInline() : BaseType() {}
+    explicit ArrayInline(size_t size) : BaseType(size) {}
+    ArrayInline(const SelfType& a) : BaseType(a) {}
+    const SelfType& operator=(const SelfType& a) { BaseType::operator=(a); return *this; }
+
+    // Returns true if the elements are currently stored inside the array object.
+    bool IsInline() const { return this->Data.IsInline(); }
+};
+
 } // OVR
 
 #endif
@@ -72,7 +72,8 @@ class FloatingCallbackEmitter : public CallbackEmitterBase, public RefCountBase<
     }
 
 public:
-    typedef Array< Ptr< FloatingCallbackListener<DelegateT> > > ListenerPtrArray;
+    // Most emitters have only a handful of listeners, so the arrays normally don't allocate.
+    typedef ArrayInline< Ptr< FloatingCallbackListener<DelegateT> >, 4 > ListenerPtrArray;
 
     ~FloatingCallbackEmitter()
     {
@@ -143,7 +144,6 @@ protected:
         {
             Lock::Locker locker(GetEmitterLock());
 
-            // TBD: Should memory allocation be further reduced here?
             ListenersCacheForCalls = Listeners;
             DirtyListenersCache = 0;
         }
@@ -189,6 +189,9 @@ public:
     FloatingCallbackListener(DelegateT handler);
     ~FloatingCallbackListener();
 
+    // Listeners come and go frequently, so we allocate them from a pool.
+    OVR_REFCOUNT_REDEFINE_NEW_POOLED(FloatingCallbackListener)
+
     void EnterCancelState();
 
     bool IsValid() const
@@ -0,0 +1,242 @@
+/************************************************************************************
+
+PublicHeader:   None
+Filename    :   OVR_ConcurrentHash.h
+Content     :   Thread-safe hash table built on OVR::Hash
+Created     :   October 18, 2026
+Notes       :
+
+Copyright   :   Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+
+Licensed under the Oculus VR Rift SDK License Version 3.3 (the "License");
+you may not use the Oculus VR Rift SDK except in compliance with the License,
+which is provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+You may obtain a copy of the License at
+
+http://www.oculusvr.com/licenses/LICENSE-3.3
+
+Unless required by applicable law or agreed to in writing, the Oculus VR SDK
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#ifndef OVR_ConcurrentHash_h
+#define OVR_ConcurrentHash_h
+
+#include "OVR_Hash.h"
+#include "OVR_Atomic.h"
+
+namespace OVR {
+
+
+//-----------------------------------------------------------------------------------
+// ***** ConcurrentHash
+//
+// Key/value table which may be used from multiple threads without external locking.
+//
+// The table is split into StripeCount independent Hash tables, selected by the key's hash,
+// each guarded by its own lock. Operations on keys in different stripes don't contend, so
+// a reader only waits for a writer which happens to be working in the same stripe.
+// StripeCount must be a power of two; a few times the number of concurrently active
+// threads is a reasonable choice.
+//
+// The API mirrors Hash, except that values are always returned by copy. Returning a pointer
+// into the table, as Hash::Get does, isn't safe because another thread may remove the entry
+// or rehash the stripe as soon as the lock is released.
+//
+// Example usage:
+//     ConcurrentHash<uint32_t, ProcessInfo> processTable;
+//     processTable.Set(pid, info);          // Thread A
+//     ProcessInfo info;
+//     if (processTable.Get(pid, &info))     // Thread B
+//         ...
+//
+template<class C, class U,
+         class HashF = FixedSizeHash<C>,
+         size_t StripeCount = 64,
+         class Allocator = ContainerAllocator<C> >
+class ConcurrentHash
+{
+public:
+    OVR_MEMORY_REDEFINE_NEW(ConcurrentHash)
+
+    typedef U                                                   ValueType;
+    typedef ConcurrentHash<C, U, HashF, StripeCount, Allocator> SelfType;
+    typedef Hash<C, U, HashF, Allocator>                        StripeHashType;
+
+    static_assert((StripeCount > 0) && ((StripeCount & (StripeCount - 1)) == 0), "StripeCount must be a power of two.");
+    static_assert(StripeCount <= (1 << 24), "StripeCount is too large.");
+
+public:
+    ConcurrentHash()  { }
+    ~ConcurrentHash() { }
+
+    // Removes all entries. Each stripe is cleared under its own lock, so entries added by
+    // other threads during the call may survive it.
+    void Clear()
+    {
+        for (size_t i = 0; i < StripeCount; ++i)
+        {
+            Lock::Locker locker(&Stripes[i].StripeLock);
+            Stripes[i].Table.Clear();
+        }
+    }
+
+    // Returns the number of entries. This is a snapshot which may be stale if other threads
+    // are modifying the table.
+    size_t GetSize() const
+    {
+        size_t size = 0;
+
+        for (size_t i = 0; i < StripeCount; ++i)
+        {
+            Lock::Locker locker(&Stripes[i].StripeLock);
+            size += Stripes[i].Table.GetSize();
+        }
+
+        return size;
+    }
+
+    int  GetSizeI() const { return (int)GetSize(); }
+    bool IsEmpty() const  { return (GetSize() == 0); }
+
+    // Reserves room for about newSize entries in total, spread evenly over the stripes.
+    void SetCapacity(size_t newSize)
+    {
+        const size_t stripeSize = (newSize + StripeCount - 1) / StripeCount;
+
+        for (size_t i = 0; i < StripeCount; ++i)
+        {
+            Lock::Locker locker(&Stripes[i].StripeLock);
+            Stripes[i].Table.SetCapacity(stripeSize);
+        }
+    }
+
+    // Adds or replaces the value under the given key.
+    void Set(const C& key, const U& value)
+    {
+        Stripe& stripe = GetStripe(key);
+        Lock::Locker locker(&stripe.StripeLock);
+        stripe.Table.Set(key, value);
+    }
+
+    // Adds a value under a key which must not already be present. Use AddIfAbsent if other
+    // threads may be adding the same key.
+    void Add(const C& key, const U& value)
+    {
+        Stripe& stripe = GetStripe(key);
+        Lock::Locker locker(&stripe.StripeLock);
+        OVR_ASSERT(!stripe.Table.Get(key, nullptr));
+        stripe.Table.Add(key, value);
+    }
+
+    // Adds the value if the key isn't present, as a single atomic step.
+    // Returns true if the value was added. Otherwise copies the existing value to
+    // *pexisting (if non-null) and returns false.
+    bool AddIfAbsent(const C& key, const U& value, U* pexisting = nullptr)
+    {
+        Stripe& stripe = GetStripe(key);
+        Lock::Locker locker(&stripe.StripeLock);
+
+        if (stripe.Table.Get(key, pexisting))
+            return false;
+
+        stripe.Table.Add(key, value);
+        return true;
+    }
+
+    // Removes the entry for the given key. If pvalue is non-null, the removed value is
+    // copied to it. Returns false if there was no such entry.
+    bool Remove(const C& key, U* pvalue = nullptr)
+    {
+        return RemoveAlt(key, pvalue);
+    }
+
+    template<class K>
+    bool RemoveAlt(const K& key, U* pvalue = nullptr)
+    {
+        Stripe& stripe = GetStripe(key);
+        Lock::Locker locker(&stripe.StripeLock);
+
+        if (!stripe.Table.GetAlt(key, pvalue))
+            return false;
+
+        stripe.Table.RemoveAlt(key);
+        return true;
+    }
+
+    // Retrieve the value under the given key.
+    //  - If there's no value under the key, then return false and leave *pvalue alone.
+    //  - If there is a value, return true, and set *pvalue to a copy of the value.
+    //  - If pvalue == NULL, return true or false according to the presence of the key.
+    bool Get(const C& key, U* pvalue) const
+    {
+        return GetAlt(key, pvalue);
+    }
+
+    template<class K>
+    bool GetAlt(const K& key, U* pvalue) const
+    {
+        const Stripe& stripe = GetStripe(key);
+        Lock::Locker locker(&stripe.StripeLock);
+        return stripe.Table.GetAlt(key, pvalue);
+    }
+
+    // Calls f(key, value) for every entry. Each stripe is locked while its entries are
+    // visited, so f sees a consistent view of a stripe but not of the whole table.
+    // f must not call back into this table.
+    template<class F>
+    void ForEach(F f) const
+    {
+        for (size_t i = 0; i < StripeCount; ++i)
+        {
+            Lock::Locker locker(&Stripes[i].StripeLock);
+
+            for (typename StripeHashType::ConstIterator it = Stripes[i].Table.Begin(); it != Stripes[i].Table.End(); ++it)
+                f(it->First, it->Second);
+        }
+    }
+
+protected:
+    struct Stripe
+    {
+        mutable Lock   StripeLock;          // Guards Table.
+        StripeHashType Table;
+        char           Padding[64];         // Keeps neighboring stripes' locks out of each other's cache line.
+    };
+
+    // The inner Hash uses the low bits of the key's hash to pick a bucket, so the stripe is
+    // picked from the high bits of a mixed hash; otherwise each stripe's table would only
+    // ever use a fraction of its buckets.
+    template<class K>
+    static size_t GetStripeIndex(const K& key)
+    {
+        const uint64_t hash = (uint64_t)HashF()(key) * UINT64_C(0x9E3779B97F4A7C15);
+        return (size_t)(hash >> 40) & (StripeCount - 1);
+    }
+
+    template<class K>
+    Stripe& GetStripe(const K& key)
+        { return Stripes[GetStripeIndex(key)]; }
+
+    template<class K>
+    const Stripe& GetStripe(const K& key) const
+        { return Stripes[GetStripeIndex(key)]; }
+
+    Stripe Stripes[StripeCount];
+
+private:
+    // Copying would need to lock every stripe of both tables; it isn't needed so far.
+    ConcurrentHash(const SelfType&);
+    void operator = (const SelfType&);
+};
+
+
+} // namespace OVR
+
+#endif // OVR_ConcurrentHash_h
@@ -49,6 +49,10 @@ public:
     
     static void* Realloc(void* p, size_t newSize)
     { return OVR_REALLOC(p, newSize); }
+
+    // Resizes p without moving it, if the heap can. See Allocator::TryExpand.
+    static bool  TryExpand(void* p, size_t newSize)
+    { return OVR_TRY_EXPAND(p, newSize); }
     
     static void  Free(void *p)
     { OVR_FREE(p); }
@@ -72,6 +76,11 @@ public:
         *(T*)p = source;
     }
 
+    static void ConstructMove(void *p, T& source)
+    {
+        *(T*)p = source;
+    }
+
     // Same as above, but allows for a different type of constructor.
     template <class S> 
     static void ConstructAlt(void *p, const S& source)
@@ -110,6 +119,13 @@ public:
         memmove(dst, src, count * sizeof(T));
     }
 
+    // Moves count elements to the uninitialized memory at dst, leaving src uninitialized.
+    static void RelocateArray(T* dst, T* src, size_t count)
+    {
+        if (count)
+            memmove(dst, src, count * sizeof(T));
+    }
+
     static bool IsMovable()
     { return true; }
 };
@@ -133,6 +149,11 @@ public:
         OVR::Construct<T>(p, source);
     }
 
+    static void ConstructMove(void* p, T& source)
+    {
+        OVR::ConstructMove<T>(p, source);
+    }
+
     // Same as above, but allows for a different type of constructor.
     template <class S> 
     static void ConstructAlt(void* p, const S& source)
@@ -183,6 +204,13 @@ public:
         memmove(dst, src, count * sizeof(T));
     }
 
+    // Moves count elements to the uninitialized memory at dst, leaving src uninitialized.
+    static void RelocateArray(T* dst, T* src, size_t count)
+    {
+        if (count)
+            memmove(dst, src, count * sizeof(T));
+    }
+
     static bool IsMovable()
     { return true; }
 };
@@ -191,7 +219,9 @@ public:
 //-----------------------------------------------------------------------------------
 // ***** ConstructorCPP
 //
-// Correct C++ construction and destruction for movable objects
+// Correct C++ construction and destruction for objects which may not be movable
+// with memcpy. Elements are moved with their move constructor and assignment, unless
+// IsTriviallyRelocatable says that copying their bytes is fine.
 template<class T> 
 class ConstructorCPP
 {
@@ -206,6 +236,11 @@ public:
         OVR::Construct<T>(p, source);        
     }
 
+    static void ConstructMove(void* p, T& source)
+    {
+        OVR::ConstructMove<T>(p, source);
+    }
+
     // Same as above, but allows for a different type of constructor.
     template <class S> 
     static void ConstructAlt(void* p, const S& source)
@@ -246,20 +281,40 @@ public:
             p->~T();
     }
 
-    static void CopyArrayForward(T* dst, const T* src, size_t count)
+    // Assigns to the initialized elements at dst, moving from src.
+    static void CopyArrayForward(T* dst, T* src, size_t count)
     {
         for(size_t i = 0; i < count; ++i)
-            dst[i] = src[i];
+            dst[i] = std::move(src[i]);
     }
 
-    static void CopyArrayBackward(T* dst, const T* src, size_t count)
+    static void CopyArrayBackward(T* dst, T* src, size_t count)
     {
         for(size_t i = count; i; --i)
-            dst[i-1] = src[i-1];
+            dst[i-1] = std::move(src[i-1]);
+    }
+
+    // Moves count elements to the uninitialized memory at dst, leaving src uninitialized.
+    // dst must not overlap the part of src which is still to be moved.
+    static void RelocateArray(T* dst, T* src, size_t count)
+    {
+        if (IsMovable())
+        {
+            if (count)
+                memmove(dst, src, count * sizeof(T));
+        }
+        else
+        {
+            for(size_t i = 0; i < count; ++i)
+            {
+                OVR::ConstructMove<T>(dst + i, src[i]);
+                src[i].~T();
+            }
+        }
     }
 
     static bool IsMovable()
-    { return false; }
+    { return IsTriviallyRelocatable<T>::value; }
 };
 
 
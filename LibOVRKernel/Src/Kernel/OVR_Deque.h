@@ -1,7 +1,7 @@
 /************************************************************************************
 
 Filename    :   OVR_Deque.h
-Content     :   Deque container
+Content     :   Deque, ring buffer and circular buffer containers
 Created     :   Nov. 15, 2013
 Authors     :   Dov Katz
 
@@ -24,6 +24,7 @@ limitations under the License.
 
 *************************************************************************************/
 
+
 #pragma once
 
 #include "OVR_ContainerAllocator.h"
@@ -31,6 +32,93 @@ limitations under the License.
 namespace OVR { 
 
 
+//-----------------------------------------------------------------------------------
+// ***** RingBuffer
+//
+// Double-ended queue stored in a power-of-two sized array, so that indexing is a mask
+// rather than a modulo. Head and Tail are free-running counters, so the element count
+// is always Tail - Head and no slot has to be kept free to tell full from empty.
+//
+// The capacity doesn't need to be a power of two: the storage is rounded up, and
+// IsFull is true at exactly the requested capacity. A growable RingBuffer doubles its
+// storage instead of asserting when an element is pushed while it's full.
+//
+// None of the members are virtual, and the contents can be read in place through the
+// span accessors, e.g.:
+//     size_t count;
+//     while ((count = buffer.GetFrontSpan(&pElems)) != 0) {
+//         Process(pElems, count);
+//         buffer.DiscardFront(count);
+//     }
+//
+// RingBuffer isn't thread-safe.
+//
+template <class Elem, class Allocator = ContainerAllocator<Elem> >
+class RingBuffer
+{
+public:
+    enum
+    {
+        DefaultCapacity = 512
+    };
+
+    explicit RingBuffer(size_t capacity = DefaultCapacity, bool growable = false);
+    ~RingBuffer();
+
+    void         PushBack   (const Elem& item);                 // Adds item to the end
+    void         PushFront  (const Elem& item);                 // Adds item to the beginning
+    void         PushBack   (const Elem* items, size_t count);  // Adds count items to the end, in order
+    Elem         PopBack    ();                                 // Removes item from the end
+    Elem         PopFront   ();                                 // Removes item from the beginning
+    size_t       PopFront   (Elem* items, size_t count);        // Removes up to count items from the beginning, returns the number removed
+    void         DiscardFront(size_t count = 1);                // Removes count items from the beginning without returning them
+    void         DiscardBack (size_t count = 1);                // Removes count items from the end without returning them
+
+    const Elem&  PeekFront  (size_t count = 0) const;           // Returns count-th item from the beginning
+    const Elem&  PeekBack   (size_t count = 0) const;           // Returns count-th item from the end
+    Elem&        PeekFront  (size_t count = 0);
+    Elem&        PeekBack   (size_t count = 0);
+
+    const Elem&  operator[] (size_t index) const { return PeekFront(index); }
+    Elem&        operator[] (size_t index)       { return PeekFront(index); }
+
+    // Returns the number of contiguous items starting at the beginning, and sets *pElems to
+    // point to them. All items are covered by this span and the one at GetFrontSpan(...) after
+    // DiscardFront of this span's count, or equivalently by the two spans from GetSpans.
+    size_t       GetFrontSpan(const Elem** pElems) const;
+    size_t       GetFrontSpan(Elem** pElems);
+
+    // Gets all items as two contiguous spans, in order. The second span is empty unless the
+    // items wrap around the end of the storage. Returns the total number of items.
+    size_t       GetSpans(const Elem** pFirst, size_t* firstCount, const Elem** pSecond, size_t* secondCount) const;
+
+    size_t       GetSize    () const { return Tail - Head; }    // Returns number of elements
+    int          GetSizeI   () const { return (int)GetSize(); }
+    size_t       GetCapacity() const { return Capacity; }       // Returns the number of elements which fit before the buffer is full
+    bool         IsEmpty    () const { return Tail == Head; }
+    bool         IsFull     () const { return GetSize() == Capacity; }
+    bool         IsGrowable () const { return Growable; }
+
+    void         Clear      ();                                 // Removes all elements
+    void         Reserve    (size_t capacity);                  // Grows the capacity to at least capacity, even if not growable
+
+protected:
+    Elem*  slot(size_t counter) const { return Data + (counter & Mask); }
+    void   makeRoom(size_t count);                              // Ensures count more elements fit
+    void   reallocate(size_t capacity);
+
+    Elem*       Data;           // Storage for Mask + 1 elements
+    size_t      Mask;           // Storage size - 1; the storage size is a power of two
+    size_t      Capacity;       // Maximum element count, <= Mask + 1
+    size_t      Head;           // Free-running counter of the first element
+    size_t      Tail;           // Free-running counter of the next after last element
+    bool        Growable;
+
+private:
+    OVR_NON_COPYABLE(RingBuffer);
+};
+
+
 template <class Elem, class Allocator = ContainerAllocator<Elem> >
 class Deque
 {
@@ -61,14 +149,7 @@ public:
     virtual inline bool  IsFull     ()              const;
 
 protected:
-    Elem        *Data;          // The actual Data array
-    const int   Capacity;       // Deque capacity
-    int         Beginning;      // Index of the first element
-    int         End;            // Index of the next after last element
-
-    // Instead of calculating the number of elements, using this variable
-    // is much more convenient.
-    int         ElemCount;
+    RingBuffer<Elem, Allocator> Buffer;
 
 private:
     OVR_NON_COPYABLE(Deque);
@@ -89,208 +170,384 @@ public:
     virtual Elem& PeekFront (int count = 0); // Returns count-th Item from the beginning
 };
 
-// Same as Deque, but allows to write more elements than maximum capacity
+// Same as RingBuffer, but allows to write more elements than maximum capacity
 // Old elements are lost as they are overwritten with the new ones
 template <class Elem, class Allocator = ContainerAllocator<Elem> >
-class CircularBuffer : public InPlaceMutableDeque<Elem, Allocator>
+class CircularBuffer : public RingBuffer<Elem, Allocator>
 {
-    typedef InPlaceMutableDeque<Elem, Allocator> BaseType;
+    typedef RingBuffer<Elem, Allocator> BaseType;
 
 public:
-    CircularBuffer(int MaxSize = BaseType::DefaultCapacity) : BaseType(MaxSize) { };
-    virtual ~CircularBuffer(){}
+    enum
+    {
+        DefaultCapacity = 500
+    };
+
+    CircularBuffer(int MaxSize = DefaultCapacity) : BaseType(MaxSize) { };
 
-    // The following methods are inline as a workaround for a VS bug causing erroneous C4505 warnings
-    // See: http://stackoverflow.com/questions/3051992/compiler-warning-at-c-template-base-class
-    inline virtual void PushBack  (const Elem &Item);    // Adds Item to the end, overwriting the oldest element at the beginning if necessary
-    inline virtual void PushFront (const Elem &Item);    // Adds Item to the beginning, overwriting the oldest element at the end if necessary
+    void PushBack  (const Elem &Item);                  // Adds Item to the end, overwriting the oldest element at the beginning if necessary
+    void PushFront (const Elem &Item);                  // Adds Item to the beginning, overwriting the oldest element at the end if necessary
+    void PushBack  (const Elem* items, size_t count);   // Adds count items to the end, keeping only the newest GetCapacity() elements
 };
 
 //----------------------------------------------------------------------------------
 
-// Deque Constructor function
+// RingBuffer Constructor function
 template <class Elem, class Allocator>
-Deque<Elem, Allocator>::Deque(int capacity) :
-Capacity( capacity ), Beginning(0), End(0), ElemCount(0)
+RingBuffer<Elem, Allocator>::RingBuffer(size_t capacity, bool growable) :
+Data(NULL), Mask(0), Capacity(0), Head(0), Tail(0), Growable(growable)
 {
-    Data = (Elem*) Allocator::Alloc(Capacity * sizeof(Elem));
+    reallocate(capacity);
 }
 
-// Deque Destructor function
+// RingBuffer Destructor function
 template <class Elem, class Allocator>
-Deque<Elem, Allocator>::~Deque(void)
+RingBuffer<Elem, Allocator>::~RingBuffer()
 {
     Clear();
     Allocator::Free(Data);
 }
 
 template <class Elem, class Allocator>
-void Deque<Elem, Allocator>::Clear()
+void RingBuffer<Elem, Allocator>::Clear()
 {
-    if (!IsEmpty())
+    DiscardFront(GetSize());
+    Head = 0;
+    Tail = 0;
+}
+
+template <class Elem, class Allocator>
+void RingBuffer<Elem, Allocator>::Reserve(size_t capacity)
+{
+    if (capacity > Capacity)
+        reallocate(capacity);
+}
+
+// Moves the elements to new storage for at least capacity elements. The elements
+// end up at the start of the storage.
+template <class Elem, class Allocator>
+void RingBuffer<Elem, Allocator>::reallocate(size_t capacity)
+{
+    size_t storageSize = 1;
+    while (storageSize < capacity)
+        storageSize <<= 1;
+
+    Elem*        newData = (Elem*) Allocator::Alloc(storageSize * sizeof(Elem));
+    const size_t size    = GetSize();
+    OVR_ASSERT(newData && (size <= capacity));
+
+    if (size)
     {
-        if (Beginning < End)
+        const Elem* first;
+        const Elem* second;
+        size_t      firstCount, secondCount;
+        GetSpans(&first, &firstCount, &second, &secondCount);
+
+        if (Allocator::IsMovable())
         {
-            // no wrap-around
-            Allocator::DestructArray(Data + Beginning, End - Beginning);
+            memcpy((void*)newData, (const void*)first, firstCount * sizeof(Elem));
+            memcpy((void*)(newData + firstCount), (const void*)second, secondCount * sizeof(Elem));
         }
         else
         {
-            // wrap-around
-            Allocator::DestructArray(Data + Beginning, Capacity - Beginning);
-            Allocator::DestructArray(Data, End);
+            Allocator::ConstructArray(newData, firstCount, first);
+            Allocator::ConstructArray(newData + firstCount, secondCount, second);
+            Allocator::DestructArray(const_cast<Elem*>(first), firstCount);
+            Allocator::DestructArray(const_cast<Elem*>(second), secondCount);
         }
     }
-    
-    Beginning = 0;
-    End       = 0;
-    ElemCount = 0;
+
+    Allocator::Free(Data);
+    Data     = newData;
+    Mask     = storageSize - 1;
+    Capacity = Growable ? storageSize : capacity;
+    Head     = 0;
+    Tail     = size;
+}
+
+template <class Elem, class Allocator>
+void RingBuffer<Elem, Allocator>::makeRoom(size_t count)
+{
+    if ((Capacity - GetSize()) < count)
+    {
+        // Error Check: Make sure we aren't  
+        // exceeding our maximum storage space
+        OVR_ASSERT(Growable);
+
+        size_t newCapacity = (Mask + 1) * 2;
+        if (newCapacity < (GetSize() + count))
+            newCapacity = GetSize() + count;
+        reallocate(newCapacity);
+    }
 }
 
 // Push functions
 template <class Elem, class Allocator>
-void Deque<Elem, Allocator>::PushBack(const Elem &Item)
+void RingBuffer<Elem, Allocator>::PushBack(const Elem& item)
 {
-    // Error Check: Make sure we aren't  
-    // exceeding our maximum storage space
-    OVR_ASSERT( ElemCount < Capacity );
+    if (IsFull())
+        makeRoom(1);
+
+    Allocator::Construct(slot(Tail), item);
+    ++Tail;
+}
 
-    Allocator::Construct(Data + End, Item);
-    ++End;
-    ++ElemCount;
+template <class Elem, class Allocator>
+void RingBuffer<Elem, Allocator>::PushFront(const Elem& item)
+{
+    if (IsFull())
+        makeRoom(1);
 
-    // Check for wrap-around
-    if (End >= Capacity)
-        End -= Capacity;
+    Allocator::Construct(slot(Head - 1), item);
+    --Head;
 }
 
 template <class Elem, class Allocator>
-void Deque<Elem, Allocator>::PushFront(const Elem &Item)
+void RingBuffer<Elem, Allocator>::PushBack(const Elem* items, size_t count)
 {
-    // Error Check: Make sure we aren't  
-    // exceeding our maximum storage space
-    OVR_ASSERT( ElemCount < Capacity );
+    makeRoom(count);
 
-    --Beginning;
-    // Check for wrap-around
-    if (Beginning < 0)
-        Beginning += Capacity;
+    // The free space may wrap around the end of the storage.
+    const size_t tailIndex  = (Tail & Mask);
+    const size_t firstCount = ((Mask + 1 - tailIndex) < count) ? (Mask + 1 - tailIndex) : count;
 
-    Allocator::Construct(Data + Beginning, Item);
-    ++ElemCount;
+    Allocator::ConstructArray(Data + tailIndex, firstCount, items);
+    Allocator::ConstructArray(Data, count - firstCount, items + firstCount);
+    Tail += count;
 }
 
 // Pop functions
 template <class Elem, class Allocator>
-Elem Deque<Elem, Allocator>::PopFront(void)
+Elem RingBuffer<Elem, Allocator>::PopFront()
 {
-    // Error Check: Make sure we aren't reading from an empty Deque
-    OVR_ASSERT( ElemCount > 0 );
+    // Error Check: Make sure we aren't reading from an empty RingBuffer
+    OVR_ASSERT(!IsEmpty());
+
+    Elem* p = slot(Head);
+    Elem  returnValue = *p;
+    Allocator::Destruct(p);
+    ++Head;
 
-    Elem ReturnValue = Data[ Beginning ];
-    Allocator::Destruct(Data + Beginning);
+    return returnValue;
+}
 
-    ++Beginning;
-    --ElemCount;
+template <class Elem, class Allocator>
+Elem RingBuffer<Elem, Allocator>::PopBack()
+{
+    // Error Check: Make sure we aren't reading from an empty RingBuffer
+    OVR_ASSERT(!IsEmpty());
 
-    // Check for wrap-around
-    if (Beginning >= Capacity)
-        Beginning -= Capacity;
+    --Tail;
+    Elem* p = slot(Tail);
+    Elem  returnValue = *p;
+    Allocator::Destruct(p);
 
-    return ReturnValue;
+    return returnValue;
 }
 
 template <class Elem, class Allocator>
-Elem Deque<Elem, Allocator>::PopBack(void)
+size_t RingBuffer<Elem, Allocator>::PopFront(Elem* items, size_t count)
 {
-    // Error Check: Make sure we aren't reading from an empty Deque
-    OVR_ASSERT( ElemCount > 0 );
+    if (count > GetSize())
+        count = GetSize();
 
-    --End;
-    --ElemCount;
+    for (size_t done = 0; done < count; )
+    {
+        Elem*  span;
+        size_t spanCount = GetFrontSpan(&span);
+        if (spanCount > (count - done))
+            spanCount = count - done;
+
+        for (size_t i = 0; i < spanCount; ++i)
+            items[done + i] = span[i];
+        DiscardFront(spanCount);
+        done += spanCount;
+    }
 
-    // Check for wrap-around
-    if (End < 0)
-        End += Capacity;
+    return count;
+}
 
-    Elem ReturnValue = Data[ End ];
-    Allocator::Destruct(Data + End);
+template <class Elem, class Allocator>
+void RingBuffer<Elem, Allocator>::DiscardFront(size_t count)
+{
+    OVR_ASSERT(count <= GetSize());
 
-    return ReturnValue;
+    while (count)
+    {
+        Elem*  span;
+        size_t spanCount = GetFrontSpan(&span);
+        if (spanCount > count)
+            spanCount = count;
+
+        Allocator::DestructArray(span, spanCount);
+        Head  += spanCount;
+        count -= spanCount;
+    }
+}
+
+template <class Elem, class Allocator>
+void RingBuffer<Elem, Allocator>::DiscardBack(size_t count)
+{
+    OVR_ASSERT(count <= GetSize());
+
+    for (; count; --count)
+    {
+        --Tail;
+        Allocator::Destruct(slot(Tail));
+    }
 }
 
 // Peek functions
 template <class Elem, class Allocator>
-const Elem& Deque<Elem, Allocator>::PeekFront(int count) const
+const Elem& RingBuffer<Elem, Allocator>::PeekFront(size_t count) const
 {
-    // Error Check: Make sure we aren't reading from an empty Deque
-    OVR_ASSERT( ElemCount > count );
+    // Error Check: Make sure we aren't reading past the end
+    OVR_ASSERT(count < GetSize());
+    return *slot(Head + count);
+}
 
-    int idx = Beginning + count;
-    if (idx >= Capacity)
-        idx -= Capacity;
-    return Data[ idx ];
+template <class Elem, class Allocator>
+const Elem& RingBuffer<Elem, Allocator>::PeekBack(size_t count) const
+{
+    // Error Check: Make sure we aren't reading past the beginning
+    OVR_ASSERT(count < GetSize());
+    return *slot(Tail - count - 1);
 }
 
 template <class Elem, class Allocator>
-const Elem& Deque<Elem, Allocator>::PeekBack(int count) const
+Elem& RingBuffer<Elem, Allocator>::PeekFront(size_t count)
 {
-    // Error Check: Make sure we aren't reading from an empty Deque
-    OVR_ASSERT( ElemCount > count );
+    OVR_ASSERT(count < GetSize());
+    return *slot(Head + count);
+}
 
-    int idx = End - count - 1;
-    if (idx < 0)
-        idx += Capacity;
-    return Data[ idx ];
+template <class Elem, class Allocator>
+Elem& RingBuffer<Elem, Allocator>::PeekBack(size_t count)
+{
+    OVR_ASSERT(count < GetSize());
+    return *slot(Tail - count - 1);
+}
+
+// Span functions
+template <class Elem, class Allocator>
+size_t RingBuffer<Elem, Allocator>::GetFrontSpan(const Elem** pElems) const
+{
+    const size_t headIndex = (Head & Mask);
+    const size_t toEnd     = (Mask + 1 - headIndex);
+
+    *pElems = Data + headIndex;
+    return (GetSize() < toEnd) ? GetSize() : toEnd;
+}
+
+template <class Elem, class Allocator>
+size_t RingBuffer<Elem, Allocator>::GetFrontSpan(Elem** pElems)
+{
+    return const_cast<const RingBuffer*>(this)->GetFrontSpan(const_cast<const Elem**>(pElems));
+}
+
+template <class Elem, class Allocator>
+size_t RingBuffer<Elem, Allocator>::GetSpans(const Elem** pFirst, size_t* firstCount, const Elem** pSecond, size_t* secondCount) const
+{
+    *firstCount  = GetFrontSpan(pFirst);
+    *pSecond     = Data;
+    *secondCount = GetSize() - *firstCount;
+    return GetSize();
+}
+
+
+// Deque Constructor function
+template <class Elem, class Allocator>
+Deque<Elem, Allocator>::Deque(int capacity) :
+Buffer( (size_t)capacity )
+{
+}
+
+// Deque Destructor function
+template <class Elem, class Allocator>
+Deque<Elem, Allocator>::~Deque(void)
+{
+}
+
+template <class Elem, class Allocator>
+void Deque<Elem, Allocator>::Clear()
+{
+    Buffer.Clear();
+}
+
+// Push functions
+template <class Elem, class Allocator>
+void Deque<Elem, Allocator>::PushBack(const Elem &Item)
+{
+    Buffer.PushBack(Item);
+}
+
+template <class Elem, class Allocator>
+void Deque<Elem, Allocator>::PushFront(const Elem &Item)
+{
+    Buffer.PushFront(Item);
+}
+
+// Pop functions
+template <class Elem, class Allocator>
+Elem Deque<Elem, Allocator>::PopFront(void)
+{
+    return Buffer.PopFront();
+}
+
+template <class Elem, class Allocator>
+Elem Deque<Elem, Allocator>::PopBack(void)
+{
+    return Buffer.PopBack();
+}
+
+// Peek functions
+template <class Elem, class Allocator>
+const Elem& Deque<Elem, Allocator>::PeekFront(int count) const
+{
+    return Buffer.PeekFront((size_t)count);
+}
+
+template <class Elem, class Allocator>
+const Elem& Deque<Elem, Allocator>::PeekBack(int count) const
+{
+    return Buffer.PeekBack((size_t)count);
 }
 
 // Mutable Peek functions
 template <class Elem, class Allocator>
 Elem& InPlaceMutableDeque<Elem, Allocator>::PeekFront(int count)
 {
-    // Error Check: Make sure we aren't reading from an empty Deque
-    OVR_ASSERT( BaseType::ElemCount > count );
-
-    int idx = BaseType::Beginning + count;
-    if (idx >= BaseType::Capacity)
-        idx -= BaseType::Capacity;
-    return BaseType::Data[ idx ];
+    return BaseType::Buffer.PeekFront((size_t)count);
 }
 
 template <class Elem, class Allocator>
 Elem& InPlaceMutableDeque<Elem, Allocator>::PeekBack(int count)
 {
-    // Error Check: Make sure we aren't reading from an empty Deque
-    OVR_ASSERT( BaseType::ElemCount > count );
-
-    int idx = BaseType::End - count - 1;
-    if (idx < 0)
-        idx += BaseType::Capacity;
-    return BaseType::Data[ idx ];
+    return BaseType::Buffer.PeekBack((size_t)count);
 }
 
 template <class Elem, class Allocator>
 inline size_t Deque<Elem, Allocator>::GetCapacity(void) const
 {
-    return Capacity;
+    return Buffer.GetCapacity();
 }
 
 template <class Elem, class Allocator>
 inline size_t Deque<Elem, Allocator>::GetSize(void) const
 {
-    return ElemCount;
+    return Buffer.GetSize();
 }
 
 template <class Elem, class Allocator>
 inline bool Deque<Elem, Allocator>::IsEmpty(void) const
 {
-    return ElemCount == 0;
+    return Buffer.IsEmpty();
 }
 
 template <class Elem, class Allocator>
 inline bool Deque<Elem, Allocator>::IsFull(void) const
 {
-    return ElemCount == Capacity;
+    return Buffer.IsFull();
 }
 
 // ******* CircularBuffer<Elem> *******
@@ -299,7 +556,7 @@ template <class Elem, class Allocator>
 void CircularBuffer<Elem, Allocator>::PushBack(const Elem &Item)
 {
     if (this->IsFull())
-        this->PopFront();
+        this->DiscardFront();
     BaseType::PushBack(Item);
 }
 
@@ -307,9 +564,28 @@ template <class Elem, class Allocator>
 void CircularBuffer<Elem, Allocator>::PushFront(const Elem &Item)
 {
     if (this->IsFull())
-        this->PopBack();
+        this->DiscardBack();
     BaseType::PushFront(Item);
 }
 
+template <class Elem, class Allocator>
+void CircularBuffer<Elem, Allocator>::PushBack(const Elem* items, size_t count)
+{
+    const size_t capacity = this->GetCapacity();
+
+    // Items which would be overwritten by later ones in the same call are skipped.
+    if (count > capacity)
+    {
+        items += (count - capacity);
+        count = capacity;
+    }
+
+    const size_t freeCount = capacity - this->GetSize();
+    if (count > freeCount)
+        this->DiscardFront(count - freeCount);
+
+    BaseType::PushBack(items, count);
+}
+
 
 } // namespace OVR
@@ -31,6 +31,19 @@ limitations under the License.
 #include "OVR_ContainerAllocator.h"
 #include "OVR_Alg.h"
 
+// Defined as 1 if the flat hash table (see HashsetFlatEntry) probes with SSE2.
+#if !defined(OVR_HASH_FLAT_SSE2)
+    #if defined(OVR_CPU_X86_64) || (defined(OVR_CPU_X86) && (defined(__SSE2__) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))))
+        #define OVR_HASH_FLAT_SSE2 1
+    #else
+        #define OVR_HASH_FLAT_SSE2 0
+    #endif
+#endif
+
+#if OVR_HASH_FLAT_SSE2
+    #include <emmintrin.h>
+#endif
+
 // 'new' operator is redefined/used in this file.
 #undef new
 
@@ -125,6 +138,8 @@ public:
         : NextInChain(-2) { }
     HashsetEntry(const HashsetEntry& e)
         : NextInChain(e.NextInChain), Value(e.Value) { }
+    HashsetEntry(HashsetEntry&& e)
+        : NextInChain(e.NextInChain), Value(std::move(e.Value)) { }
     HashsetEntry(const C& key, intptr_t next)
         : NextInChain(next), Value(key) { }
 
@@ -161,6 +176,8 @@ public:
         : NextInChain(-2) { }
     HashsetCachedEntry(const HashsetCachedEntry& e)
         : NextInChain(e.NextInChain), HashValue(e.HashValue), Value(e.Value) { }
+    HashsetCachedEntry(HashsetCachedEntry&& e)
+        : NextInChain(e.NextInChain), HashValue(e.HashValue), Value(std::move(e.Value)) { }
     HashsetCachedEntry(const C& key, intptr_t next)
         : NextInChain(next), Value(key) { }
 
@@ -333,7 +350,7 @@ public:
             {               
                 Entry*  enext = &E(e->NextInChain);
                 e->Clear();
-                new (e) Entry(*enext);
+                new (e) Entry(std::move(*enext));
                 // Point us to the follower's cell that will be cleared
                 e = enext;
             }
@@ -345,7 +362,7 @@ public:
         }
 
         // Clear us, of the follower cell that was moved.
-        e->Clear();
+        clearEntry(e);
         pTable->EntryCount --;
         // Should we check the size to condense hash? ...
     }
@@ -457,6 +474,48 @@ public:
         setRawCapacity(newRawSize);
     }
 
+    // Grow the HashSet, if needed, so that it can hold n elements in total
+    // without rehashing. Unlike SetCapacity, this never shrinks the table.
+    void Reserve(size_t n)
+    {
+        if ((n == 0) || (pTable && ((n * 5) <= (pTable->SizeMask + 1) * 4)))
+            return;
+        setRawCapacity((n * 5) / 4);
+    }
+
+    // Shrink the table to the smallest size which holds the current elements,
+    // or free it if the HashSet is empty.
+    void ShrinkToFit()
+    {
+        if (IsEmpty())
+            Clear();
+        else if (roundRawCapacity((GetSize() * 5) / 4) < (pTable->SizeMask + 1))
+            setRawCapacity((GetSize() * 5) / 4);
+    }
+
+    // Add count values, which must not already be in the HashSet and must
+    // be unique. The table is grown at most once.
+    template<class CRef>
+    void Append(const CRef values[], size_t count)
+    {
+        Reserve(GetSize() + count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            OVR_ASSERT(findIndex(values[i]) < 0);
+            add(values[i], HashF()(values[i]));
+        }
+    }
+
+    // Replace the contents of the HashSet with count unique values, sizing
+    // the table once up front.
+    template<class CRef>
+    void BuildFrom(const CRef values[], size_t count)
+    {
+        Clear();
+        Append(values, count);
+    }
+
     // Disable inappropriate 'operator ->' warning on MSVC6.
 #ifdef OVR_CC_MSVC
 #if (OVR_CC_MSVC < 1300)
@@ -485,11 +544,7 @@ public:
             if (Index <= (intptr_t)pHash->pTable->SizeMask)
             {
                 Index++;
-                while ((size_t)Index <= pHash->pTable->SizeMask &&
-                    pHash->E(Index).IsEmpty())
-                {
-                    Index++;
-                }
+                Index = (intptr_t)pHash->nextOccupied((size_t)Index);
             }
         }
 
@@ -613,7 +668,7 @@ public:
                     {               
                         Entry*  enext = &phash->E(e->NextInChain);
                         e->Clear();
-                        new (e) Entry(*enext);
+                        new (e) Entry(std::move(*enext));
                         // Point us to the follower's cell that will be cleared
                         e = enext;
                         --ConstIterator::Index;
@@ -626,7 +681,7 @@ public:
                 }
 
                 // Clear us, of the follower cell that was moved.
-                e->Clear();
+                phash->clearEntry(e);
                 phash->pTable->EntryCount --;
             }
             else 
@@ -649,12 +704,7 @@ public:
             return Iterator(NULL, 0);
 
         // Scan till we hit the First valid Entry.
-        size_t i0 = 0;
-        while (i0 <= pTable->SizeMask && E(i0).IsEmpty())
-        {
-            i0++;
-        }
-        return Iterator(this, i0);
+        return Iterator(this, nextOccupied(0));
     }
     Iterator        End()           { return Iterator(NULL, 0); }
 
@@ -762,6 +812,7 @@ private:
         {
             // Put the new Entry in.
             new (naturalEntry) Entry(key, -1);
+            setOccupied(index);
         }
         else
         {
@@ -772,13 +823,14 @@ private:
             } while(!E(blankIndex).IsEmpty());
 
             Entry*  blankEntry = &E(blankIndex);
+            setOccupied(blankIndex);
 
             if (naturalEntry->GetCachedHash(pTable->SizeMask) == (size_t)index)
             {
                 // Collision.  Link into this chain.
 
                 // Move existing list head.
-                new (blankEntry) Entry(*naturalEntry);    // placement new, copy ctor
+                new (blankEntry) Entry(std::move(*naturalEntry));    // placement new, move ctor
 
                 // Put the new info in the natural Entry.
                 naturalEntry->Value       = key;
@@ -799,7 +851,7 @@ private:
                     if (e->NextInChain == index)
                     {
                         // Here's where we need to splice.
-                        new (blankEntry) Entry(*naturalEntry);
+                        new (blankEntry) Entry(std::move(*naturalEntry));
                         e->NextInChain = blankIndex;
                         break;
                     }
@@ -817,6 +869,96 @@ private:
         naturalEntry->SetCachedHash(hashValue);
     }
 
+    // Moves the value of src, an entry of the table being rehashed, into this table.
+    // Same as add, except that the table must already be large enough and that values
+    // are moved instead of copied. If C is trivially relocatable, entries are moved with
+    // memcpy, so that rehashing doesn't touch reference counts or heap data.
+    // The Allocator isn't consulted, as Hash passes one for its key type rather than for C.
+    // src is left empty.
+    void relocate(Entry* src, size_t hashValue)
+    {
+        hashValue &= pTable->SizeMask;
+
+        pTable->EntryCount++;
+
+        intptr_t   index        = hashValue;
+        Entry*  naturalEntry = &(E(index));
+
+        if (naturalEntry->IsEmpty())
+        {
+            setOccupied(index);
+            naturalEntry->NextInChain = -1;
+        }
+        else
+        {
+            // Find a blank spot.
+            intptr_t blankIndex = index;
+            do {
+                blankIndex = (blankIndex + 1) & pTable->SizeMask;
+            } while(!E(blankIndex).IsEmpty());
+
+            Entry*  blankEntry = &E(blankIndex);
+            setOccupied(blankIndex);
+
+            // Either way the existing Entry moves to the blank spot, as in add.
+            intptr_t collidedIndex = naturalEntry->GetCachedHash(pTable->SizeMask);
+            relocateEntry(blankEntry, naturalEntry);
+
+            if (collidedIndex == index)
+            {
+                // Collision.  Link into this chain.
+                naturalEntry->NextInChain = blankIndex;
+            }
+            else
+            {
+                // Existing Entry did not naturally belong in this slot, so splice
+                // the blank spot into its chain instead.
+                OVR_ASSERT(collidedIndex >= 0 && collidedIndex <= (intptr_t)pTable->SizeMask);
+                for (;;)
+                {
+                    Entry*  e = &E(collidedIndex);
+                    if (e->NextInChain == index)
+                    {
+                        e->NextInChain = blankIndex;
+                        break;
+                    }
+                    collidedIndex = e->NextInChain;
+                    OVR_ASSERT(collidedIndex >= 0 && collidedIndex <= (intptr_t)pTable->SizeMask);
+                }
+                naturalEntry->NextInChain = -1;
+            }
+        }
+
+        // naturalEntry->Value is uninitialized at this point.
+        if (IsTriviallyRelocatable<C>::value)
+        {
+            memcpy((void*)&naturalEntry->Value, (const void*)&src->Value, sizeof(C));
+        }
+        else
+        {
+            OVR::ConstructMove<C>(&naturalEntry->Value, src->Value);
+            src->Value.~C();
+        }
+        src->NextInChain = -2;
+
+        // Record hash value: has effect only if cached node is used.
+        naturalEntry->SetCachedHash(hashValue);
+    }
+
+    // Moves the Entry at src to the uninitialized Entry at dest, leaving src->Value uninitialized.
+    static void relocateEntry(Entry* dest, Entry* src)
+    {
+        if (IsTriviallyRelocatable<C>::value)
+        {
+            memcpy((void*)dest, (const void*)src, sizeof(Entry));
+        }
+        else
+        {
+            new (dest) Entry(std::move(*src));
+            src->Value.~C();
+        }
+    }
+
     // Index access helpers.
     Entry& E(size_t index)
     {
@@ -831,6 +973,68 @@ private:
     }
 
 
+    // Rounds a raw capacity up to the table size setRawCapacity would use.
+    static size_t roundRawCapacity(size_t newSize)
+    {
+        // Minimum size; don't incur rehashing cost when expanding
+        // very small tables. Not that we perform this check before 
+        // 'log2f' call to avoid fp exception with newSize == 1.
+        if (newSize < HashMinSize)        
+            return HashMinSize;
+
+        // Force newSize to be a power of two.
+        int bits = Alg::UpperBit(newSize-1) + 1; // Chop( Log2f((float)(newSize-1)) + 1);
+        OVR_ASSERT((size_t(1) << bits) >= newSize);
+        return size_t(1) << bits;
+    }
+
+    // The table has a bitmap of the non-empty entries after the Entry array, so that
+    // iteration can skip over empty entries a word at a time.
+    static size_t getBitmapWords(size_t capacity)
+    {
+        return (capacity + 31) / 32;
+    }
+
+    uint32_t* Bitmap() const
+    {
+        return reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(pTable + 1) + sizeof(Entry) * (pTable->SizeMask + 1));
+    }
+
+    void setOccupied(size_t index)
+    {
+        Bitmap()[index / 32] |= (uint32_t(1) << (index % 32));
+    }
+
+    // Clears the Entry e, which must be in the table.
+    void clearEntry(Entry* e)
+    {
+        const size_t index = (size_t)(e - &E(0));
+        e->Clear();
+        Bitmap()[index / 32] &= ~(uint32_t(1) << (index % 32));
+    }
+
+    // Returns the index of the first non-empty Entry at or after index, or SizeMask + 1 if there is none.
+    size_t nextOccupied(size_t index) const
+    {
+        const size_t    capacity = pTable->SizeMask + 1;
+        const uint32_t* bitmap   = Bitmap();
+
+        if (index >= capacity)
+            return capacity;
+
+        size_t   word = index / 32;
+        uint32_t bits = bitmap[word] & (~uint32_t(0) << (index % 32));
+
+        while (bits == 0)
+        {
+            if (++word >= getBitmapWords(capacity))
+                return capacity;
+            bits = bitmap[word];
+        }
+
+        return (word * 32) + Alg::CountTrailing0Bits(bits);
+    }
+
     // Resize the HashSet table to the given size (Rehash the
     // contents of the current table).  The arg is the number of
     // HashSet table entries, not the number of elements we should
@@ -844,23 +1048,12 @@ private:
             return;
         }
 
-        // Minimum size; don't incur rehashing cost when expanding
-        // very small tables. Not that we perform this check before 
-        // 'log2f' call to avoid fp exception with newSize == 1.
-        if (newSize < HashMinSize)        
-            newSize = HashMinSize;       
-        else
-        {
-            // Force newSize to be a power of two.
-            int bits = Alg::UpperBit(newSize-1) + 1; // Chop( Log2f((float)(newSize-1)) + 1);
-            OVR_ASSERT((size_t(1) << bits) >= newSize);
-            newSize = size_t(1) << bits;
-        }
+        newSize = roundRawCapacity(newSize);
 
         SelfType  newHash;
         newHash.pTable = (TableType*)
             Allocator::Alloc(                
-                sizeof(TableType) + sizeof(Entry) * newSize);
+                sizeof(TableType) + sizeof(Entry) * newSize + sizeof(uint32_t) * getBitmapWords(newSize));
         // Need to do something on alloc failure!
         OVR_ASSERT(newHash.pTable);
 
@@ -871,6 +1064,7 @@ private:
         // Mark all entries as empty.
         for (i = 0; i < newSize; i++)
             newHash.E(i).NextInChain = -2;
+        memset(newHash.Bitmap(), 0, sizeof(uint32_t) * getBitmapWords(newSize));
 
         // Copy stuff to newHash
         if (pTable)
@@ -880,10 +1074,8 @@ private:
                 Entry*  e = &E(i);
                 if (e->IsEmpty() == false)
                 {
-                    // Insert old Entry into new HashSet.
-                    newHash.Add(e->Value);
-                    // placement delete of old element
-                    e->Clear();
+                    // Move old Entry into new HashSet, which leaves it empty.
+                    newHash.relocate(e, HashF()(e->Value));
                 }
             }
 
@@ -907,137 +1099,893 @@ private:
 };
 
 
-
 //-----------------------------------------------------------------------------------
-template<class C, class HashF = FixedSizeHash<C>,
-         class AltHashF = HashF, 
-         class Allocator = ContainerAllocator<C>,
-         class Entry = HashsetCachedEntry<C, HashF> >
-class HashSet : public HashSetBase<C, HashF, AltHashF, Allocator, Entry>
+// ***** Flat hash table implementation
+//
+// Using HashsetFlatEntry as the Entry type of HashSet or Hash selects an open 
+// addressing implementation of HashSetBase in the style of Google's "Swiss table",
+// with the same API as the chained implementation above.
+//
+// Technical design:
+//   Besides the value slots, the table has a control byte per slot, which is either
+//       Empty, Deleted, or the low 7 bits of the slot value's hash (H2). The upper bits
+//       of the hash (H1) select a group of GroupWidth consecutive slots to start at.
+//   A lookup compares the H2 of the key against all control bytes of a group at once 
+//       (with SSE2 when available) and compares values only for the matching slots, 
+//       which are nearly always true matches. It proceeds to the next group in a 
+//       triangular probe sequence only if the group has no Empty slot.
+//   Values are never moved after insertion, except when the table is rehashed. Removal
+//       marks the slot Deleted, or Empty if no probe sequence can have passed the group.
+//   The table is rehashed when the Empty slots would drop below 1/8th of the table. This 
+//       keeps probe sequences short even with high load factors.
+//   Hash values are mixed before use, as some of our hash functions (e.g. IdentityHash) 
+//       have poorly distributed bits.
+//
+// As with the chained implementation, iterators are invalidated by insertion, but 
+// Iterator::Remove keeps the iterator valid.
+
+// Selects the flat HashSetBase implementation. It needs no per-entry data besides the value.
+template<class C, class HashF>
+class HashsetFlatEntry
 {
 public:
-    typedef HashSetBase<C, HashF, AltHashF, Allocator, Entry> BaseType;
-    typedef HashSet<C, HashF, AltHashF, Allocator, Entry>     SelfType;
+    typedef C       ValueType;
+    typedef HashF   HashFunctor;
+};
 
-    HashSet()                                      {   }
-    HashSet(int sizeHint) : BaseType(sizeHint)     {   }
-    HashSet(const SelfType& src) : BaseType(src)   {   }
-    ~HashSet()                                     {   }
 
-    void operator = (const SelfType& src)   { BaseType::Assign(src); }
+// The control bytes of a group of slots in the flat hash table.
+class HashFlatGroup
+{
+public:
+    enum
+    {
+        Width   = 16,
+        Empty   = -128,     // 0x80
+        Deleted = -2        // 0xfe. Full slots are 0x00 - 0x7f.
+    };
 
-    // Set a new or existing value under the key, to the value.
-    // Pass a different class of 'key' so that assignment reference object
-    // can be passed instead of the actual object.
-    template<class CRef>
-    void Set(const CRef& key)
+    explicit HashFlatGroup(const int8_t* ctrl)
     {
-        BaseType::Set(key);
+        #if OVR_HASH_FLAT_SSE2
+            Ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        #else
+            memcpy(Ctrl, ctrl, Width);
+        #endif
     }
 
-    template<class CRef>
-    inline void Add(const CRef& key)
+    // Returns a bit mask of the slots with the given control byte.
+    uint16_t Match(int8_t value) const
     {
-        BaseType::Add(key);
+        #if OVR_HASH_FLAT_SSE2
+            return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(Ctrl, _mm_set1_epi8(value)));
+        #else
+            uint16_t mask = 0;
+            for (int i = 0; i < Width; ++i)
+                mask |= (uint16_t)((Ctrl[i] == value) << i);
+            return mask;
+        #endif
     }
 
-    // Hint the bucket count to >= n.
-    void Resize(size_t n)    
+    uint16_t MatchEmpty() const
     {
-        BaseType::SetCapacity(n);
+        return Match((int8_t)Empty);
     }
 
-    // Size the HashSet so that it can comfortably contain the given
-    // number of elements.  If the HashSet already contains more
-    // elements than newSize, then this may be a no-op.
-    void SetCapacity(size_t newSize)
+    // Empty and Deleted are the control bytes with the high bit set.
+    uint16_t MatchEmptyOrDeleted() const
     {
-        BaseType::SetCapacity(newSize);
+        #if OVR_HASH_FLAT_SSE2
+            return (uint16_t)_mm_movemask_epi8(Ctrl);
+        #else
+            uint16_t mask = 0;
+            for (int i = 0; i < Width; ++i)
+                mask |= (uint16_t)((Ctrl[i] < 0) << i);
+            return mask;
+        #endif
     }
 
-};
-
-// HashSet with uncached hash code; declared for convenience.
-template<class C, class HashF = FixedSizeHash<C>,
-                  class AltHashF = HashF,
-                  class Allocator = ContainerAllocator<C> >
-class HashSetUncached : public HashSet<C, HashF, AltHashF, Allocator, HashsetEntry<C, HashF> >
-{
-public:
-    
-    typedef HashSetUncached<C, HashF, AltHashF, Allocator>                  SelfType;
-    typedef HashSet<C, HashF, AltHashF, Allocator, HashsetEntry<C, HashF> > BaseType;
-
-    // Delegated constructors.
-    HashSetUncached()                                        { }
-    HashSetUncached(int sizeHint) : BaseType(sizeHint)       { }
-    HashSetUncached(const SelfType& src) : BaseType(src)     { }
-    ~HashSetUncached()                                       { }
-    
-    void    operator = (const SelfType& src)
+    uint16_t MatchFull() const
     {
-        BaseType::operator = (src);
+        return (uint16_t)~MatchEmptyOrDeleted();
     }
-};
 
+protected:
+    #if OVR_HASH_FLAT_SSE2
+        __m128i Ctrl;
+    #else
+        int8_t  Ctrl[Width];
+    #endif
+};
 
-//-----------------------------------------------------------------------------------
-// ***** Hash hash table implementation
 
-// Node for Hash - necessary so that Hash can delegate its implementation
-// to HashSet.
-template<class C, class U, class HashF>
-struct HashNode
+template<class C, class HashF, class AltHashF, class Allocator, class EntryC, class EntryHashF>
+class HashSetBase<C, HashF, AltHashF, Allocator, HashsetFlatEntry<EntryC, EntryHashF> >
 {
-    typedef HashNode<C, U, HashF>   SelfType;
-    typedef C                       FirstType;
-    typedef U                       SecondType;
-
-    C   First;
-    U   Second;
+    typedef HashsetFlatEntry<EntryC, EntryHashF> Entry;
 
-    // NodeRef is used to allow passing of elements into HashSet
-    // without using a temporary object.
-    struct NodeRef
-    {
-        const C*   pFirst;
-        const U*   pSecond;
+    enum { GroupWidth = HashFlatGroup::Width, HashMinSize = GroupWidth };
 
-        NodeRef(const C& f, const U& s) : pFirst(&f), pSecond(&s) { }
-        NodeRef(const NodeRef& src)     : pFirst(src.pFirst), pSecond(src.pSecond) { }
+public:
+    OVR_MEMORY_REDEFINE_NEW(HashSetBase)
 
-        // Enable computation of ghash_node_hashf.
-        inline size_t GetHash() const            { return HashF()(*pFirst); } 
-        // Necessary conversion to allow HashNode::operator == to work.
-        operator const C& () const              { return *pFirst; }
-    };
+    typedef HashSetBase<C, HashF, AltHashF, Allocator, Entry>    SelfType;
 
-    // Note: No default constructor is necessary.
-     HashNode(const HashNode& src) : First(src.First), Second(src.Second)    { }
-     HashNode(const NodeRef& src) : First(*src.pFirst), Second(*src.pSecond)  { }
-    void operator = (const NodeRef& src)  { First  = *src.pFirst; Second = *src.pSecond; }
+    HashSetBase() : pTable(NULL)                       {   }
+    HashSetBase(int sizeHint) : pTable(NULL)           { SetCapacity(sizeHint); }
+    HashSetBase(const SelfType& src) : pTable(NULL)    { Assign(src); }
+    ~HashSetBase()                                     { Clear(); }
 
-    template<class K>
-    bool operator == (const K& src) const   { return (First == src); }
+    void Assign(const SelfType& src)
+    {
+        Clear();
+        if (src.IsEmpty() == false)
+        {
+            SetCapacity(src.GetSize());
 
-    template<class K>
-    static size_t CalcHash(const K& data)   { return HashF()(data); }
-    inline size_t GetHash() const           { return HashF()(First); }
+            for (ConstIterator it = src.Begin(); it != src.End(); ++it)
+            {
+                Add(*it);
+            }
+        }
+    }
 
-    // Hash functors used with this node. A separate functor is used for alternative
-    // key lookup so that it does not need to access the '.First' element.    
-    struct NodeHashF
-    {    
-        template<class K>
-        size_t operator()(const K& data) const { return data.GetHash(); } 
-    };    
-    struct NodeAltHashF
+    // Remove all entries from the HashSet table.
+    void Clear()
     {
-        template<class K>
-        size_t operator()(const K& data) const { return HashNode<C,U,HashF>::CalcHash(data); }
-    };
+        if (pTable)
+        {
+            for (size_t i = 0, n = pTable->SizeMask; i <= n; i++)
+            {
+                if (isFull(i))
+                    V(i).~C();
+            }
+
+            Allocator::Free(pTable);
+            pTable = NULL;
+        }
+    }
+
+    // Returns true if the HashSet is empty.
+    bool IsEmpty() const
+    {
+        return pTable == NULL || pTable->EntryCount == 0;
+    }
+
+    // Set a new or existing value under the key, to the value.
+    template<class CRef>
+    void Set(const CRef& key)
+    {
+        size_t   hashValue = HashF()(key);
+        intptr_t index     = findIndexCore(key, hashValue);
+
+        if (index >= 0)
+            V(index) = key;
+        else
+            add(key, hashValue);
+    }
+
+    template<class CRef>
+    inline void Add(const CRef& key)
+    {
+        add(key, HashF()(key));
+    }
+
+    // Remove by alternative key.
+    template<class K>
+    void RemoveAlt(const K& key)
+    {
+        intptr_t index = findIndexAlt(key);
+        if (index >= 0)
+            removeAt(index);
+    }
+
+    // Remove by main key.
+    template<class CRef>
+    void Remove(const CRef& key)
+    {
+        RemoveAlt(key);
+    }
+
+    template<class K>
+    C* Get(const K& key)
+    {
+        intptr_t index = findIndex(key);
+        return (index >= 0) ? &V(index) : 0;
+    }
+
+    template<class K>
+    const C* Get(const K& key) const
+    {
+        intptr_t index = findIndex(key);
+        return (index >= 0) ? &V(index) : 0;
+    }
+
+    template<class K>
+    const C* GetAlt(const K& key) const
+    {
+        intptr_t index = findIndexAlt(key);
+        return (index >= 0) ? &V(index) : 0;
+    }
+
+    template<class K>
+    C* GetAlt(const K& key)
+    {
+        intptr_t index = findIndexAlt(key);
+        return (index >= 0) ? &V(index) : 0;
+    }
+
+    template<class K>
+    bool GetAlt(const K& key, C* pval) const
+    {
+        intptr_t index = findIndexAlt(key);
+        if (index >= 0)
+        {
+            if (pval)
+                *pval = V(index);
+            return true;
+        }
+        return false;
+    }
+
+    size_t GetSize() const
+    {
+        return pTable == NULL ? 0 : (size_t)pTable->EntryCount;
+    }
+    int GetSizeI() const { return (int)GetSize(); }
+
+    // Resize the HashSet table to fit one more Entry.
+    void CheckExpand()
+    {
+        if (pTable == NULL)
+            setRawCapacity(HashMinSize);
+        else if (pTable->GrowthLeft == 0)
+            rehashForInsert();
+    }
+
+    // Hint the bucket count to >= n.
+    void Resize(size_t n)
+    {
+        SetCapacity(n);
+    }
+
+    // Size the HashSet so that it can comfortably contain the given
+    // number of elements.  If the HashSet already contains more
+    // elements than newSize, then this may be a no-op.
+    void SetCapacity(size_t newSize)
+    {
+        if (newSize < GetSize())
+            return;
+        setRawCapacity(newSize + (newSize / 7) + 1); // Max load is 7/8.
+    }
+
+    // Grow the HashSet, if needed, so that it can hold n elements in total
+    // without rehashing. Unlike SetCapacity, this never shrinks the table.
+    void Reserve(size_t n)
+    {
+        if ((n <= GetSize()) || (pTable && (pTable->GrowthLeft >= (n - GetSize()))))
+            return;
+        setRawCapacity(n + (n / 7) + 1);
+    }
+
+    // Shrink the table to the smallest size which holds the current elements,
+    // or free it if the HashSet is empty. This also drops any tombstones.
+    void ShrinkToFit()
+    {
+        if (IsEmpty())
+            Clear();
+        else if ((roundRawCapacity(GetSize() + (GetSize() / 7) + 1) < (pTable->SizeMask + 1)) ||
+                 ((pTable->GrowthLeft + GetSize()) < getMaxLoad(pTable->SizeMask + 1)))
+            setRawCapacity(GetSize() + (GetSize() / 7) + 1);
+    }
+
+    // Add count values, which must not already be in the HashSet and must
+    // be unique. The table is grown at most once.
+    template<class CRef>
+    void Append(const CRef values[], size_t count)
+    {
+        Reserve(GetSize() + count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            OVR_ASSERT(findIndex(values[i]) < 0);
+            add(values[i], HashF()(values[i]));
+        }
+    }
+
+    // Replace the contents of the HashSet with count unique values, sizing
+    // the table once up front.
+    template<class CRef>
+    void BuildFrom(const CRef values[], size_t count)
+    {
+        Clear();
+        Append(values, count);
+    }
+
+    // Iterator API, like STL.
+    struct ConstIterator
+    {   
+        const C&    operator * () const
+        {            
+            OVR_ASSERT(Index >= 0 && Index <= (intptr_t)pHash->pTable->SizeMask);
+            return pHash->V(Index);
+        }
+
+        const C*    operator -> () const
+        {
+            OVR_ASSERT(Index >= 0 && Index <= (intptr_t)pHash->pTable->SizeMask);
+            return &pHash->V(Index);
+        }
+
+        void    operator ++ ()
+        {
+            // Find next full slot.
+            if (Index <= (intptr_t)pHash->pTable->SizeMask)
+            {
+                Index++;
+                Index = (intptr_t)pHash->nextFull((size_t)Index);
+            }
+        }
+
+        bool    operator == (const ConstIterator& it) const
+        {
+            if (IsEnd() && it.IsEnd())
+                return true;
+            return (pHash == it.pHash) && (Index == it.Index);
+        }
+
+        bool    operator != (const ConstIterator& it) const
+        {
+            return ! (*this == it);
+        }
+
+        bool    IsEnd() const
+        {
+            return (pHash == NULL) || 
+                (pHash->pTable == NULL) || 
+                (Index > (intptr_t)pHash->pTable->SizeMask);
+        }
+
+        ConstIterator()
+            : pHash(NULL), Index(0)
+        { }
+
+    public:
+        ConstIterator(const SelfType* h, intptr_t index)
+            : pHash(h), Index(index)
+        { }
+
+        const SelfType* GetContainer() const
+        {
+            return pHash;
+        }
+        intptr_t GetIndex() const
+        {
+            return Index;
+        }
+
+    protected:
+        friend class HashSetBase<C, HashF, AltHashF, Allocator, Entry>;
+
+        const SelfType* pHash;
+        intptr_t        Index;
+    };
+
+    friend struct ConstIterator;
+
+    // Non-const Iterator; Get most of it from ConstIterator.
+    struct Iterator : public ConstIterator
+    {      
+        C&  operator*() const
+        {            
+            OVR_ASSERT((ConstIterator::pHash) && ConstIterator::pHash->pTable && (ConstIterator::Index >= 0) && (ConstIterator::Index <= (intptr_t)ConstIterator::pHash->pTable->SizeMask));
+            return const_cast<SelfType*>(ConstIterator::pHash)->V(ConstIterator::Index);
+        }    
+
+        C*  operator->() const 
+        {
+            return &(operator*());
+        }
+
+        Iterator()
+            : ConstIterator(NULL, 0)
+        { }
+
+        // Removes current element from Hash. Values don't move, so the iterator stays valid.
+        void Remove()
+        {
+            const_cast<SelfType*>(ConstIterator::pHash)->removeAt(ConstIterator::Index);
+        }
+
+        template <class K>
+        void RemoveAlt(const K& key)
+        {
+            SelfType* phash = const_cast<SelfType*>(ConstIterator::pHash);
+            intptr_t  index = phash->findIndexAlt(key);
+
+            if (index == (intptr_t)ConstIterator::Index)
+                phash->removeAt(index);
+            else
+                OVR_ASSERT(index < 0); //?
+        }
+
+    private:
+        friend class HashSetBase<C, HashF, AltHashF, Allocator, Entry>;
+
+        Iterator(SelfType* h, intptr_t i0)
+            : ConstIterator(h, i0)
+        { }
+    };
+
+    friend struct Iterator;
+
+    Iterator    Begin()
+    {
+        if (pTable == 0)
+            return Iterator(NULL, 0);
+
+        // Scan till we hit the first full slot.
+        return Iterator(this, nextFull(0));
+    }
+    Iterator        End()           { return Iterator(NULL, 0); }
+
+    ConstIterator   Begin() const   { return const_cast<SelfType*>(this)->Begin(); }
+    ConstIterator   End() const     { return const_cast<SelfType*>(this)->End(); }
+
+    template<class K>
+    Iterator Find(const K& key)
+    {
+        intptr_t index = findIndex(key);
+        if (index >= 0)        
+            return Iterator(this, index);        
+        return Iterator(NULL, 0);
+    }
+
+    template<class K>
+    Iterator FindAlt(const K& key)
+    {
+        intptr_t index = findIndexAlt(key);
+        if (index >= 0)        
+            return Iterator(this, index);        
+        return Iterator(NULL, 0);
+    }
+
+    template<class K>
+    ConstIterator Find(const K& key) const       { return const_cast<SelfType*>(this)->Find(key); }
+
+    template<class K>
+    ConstIterator FindAlt(const K& key) const    { return const_cast<SelfType*>(this)->FindAlt(key); }
+
+private:
+    template<class K>
+    intptr_t findIndex(const K& key) const
+    {
+        return findIndexCore(key, HashF()(key));
+    }
+
+    template<class K>
+    intptr_t findIndexAlt(const K& key) const
+    {
+        return findIndexCore(key, AltHashF()(key));
+    }
+
+    // Find the index of the matching value. If no match, then return -1.
+    // hashValue is the unmixed hash of the key.
+    template<class K>
+    intptr_t findIndexCore(const K& key, size_t hashValue) const
+    {
+        if (pTable == NULL)
+            return -1;
+
+        hashValue = mixHash(hashValue);
+
+        const int8_t h2        = (int8_t)(hashValue & 0x7f);
+        const size_t groupMask = (pTable->SizeMask / GroupWidth);
+        size_t       group     = ((hashValue >> 7) & groupMask);
+
+        for (size_t probe = 1; ; ++probe)
+        {
+            HashFlatGroup g(Ctrl() + (group * GroupWidth));
+
+            for (uint16_t mask = g.Match(h2); mask; mask &= (mask - 1))
+            {
+                size_t index = (group * GroupWidth) + Alg::CountTrailing0Bits(mask);
+                if (V(index) == key)
+                    return (intptr_t)index;
+            }
+
+            // If the group has an empty slot, then the key would have been put there.
+            if (g.MatchEmpty())
+                return -1;
+
+            // Triangular probing visits every group, as the group count is a power of two.
+            OVR_ASSERT(probe <= groupMask);
+            group = ((group + probe) & groupMask);
+        }
+    }
+
+    // Returns the first Empty or Deleted slot in the probe sequence of the mixed hashValue.
+    size_t findInsertIndex(size_t hashValue) const
+    {
+        const size_t groupMask = (pTable->SizeMask / GroupWidth);
+        size_t       group     = ((hashValue >> 7) & groupMask);
+
+        for (size_t probe = 1; ; ++probe)
+        {
+            uint16_t mask = HashFlatGroup(Ctrl() + (group * GroupWidth)).MatchEmptyOrDeleted();
+
+            if (mask)
+                return (group * GroupWidth) + Alg::CountTrailing0Bits(mask);
+
+            OVR_ASSERT(probe <= groupMask);
+            group = ((group + probe) & groupMask);
+        }
+    }
+
+    // Add a new value to the HashSet table, under the specified key.
+    template<class CRef>
+    void add(const CRef& key, size_t hashValue)
+    {
+        if (pTable == NULL)
+            setRawCapacity(HashMinSize);
+
+        hashValue = mixHash(hashValue);
+
+        size_t index = findInsertIndex(hashValue);
+
+        // Reusing a Deleted slot doesn't reduce the number of Empty slots.
+        if ((pTable->GrowthLeft == 0) && (Ctrl()[index] != (int8_t)HashFlatGroup::Deleted))
+        {
+            rehashForInsert();
+            index = findInsertIndex(hashValue);
+        }
+
+        if (Ctrl()[index] == (int8_t)HashFlatGroup::Empty)
+            pTable->GrowthLeft--;
+
+        Ctrl()[index] = (int8_t)(hashValue & 0x7f);
+        new (&V(index)) C(key);
+        pTable->EntryCount++;
+    }
+
+    void removeAt(size_t index)
+    {
+        OVR_ASSERT(isFull(index));
+        V(index).~C();
+
+        // If the group has an empty slot then no probe sequence has ever continued past 
+        // this group, so we can mark the slot Empty instead of leaving a tombstone.
+        if (HashFlatGroup(Ctrl() + (index & ~(size_t)(GroupWidth - 1))).MatchEmpty())
+        {
+            Ctrl()[index] = (int8_t)HashFlatGroup::Empty;
+            pTable->GrowthLeft++;
+        }
+        else
+            Ctrl()[index] = (int8_t)HashFlatGroup::Deleted;
+
+        pTable->EntryCount--;
+    }
+
+    // Called when inserting into an Empty slot would leave too few Empty slots.
+    void rehashForInsert()
+    {
+        const size_t capacity = (pTable->SizeMask + 1);
+
+        // If a lot of the used up slots are tombstones, just rehash in place to get rid of 
+        // them. Otherwise grow.
+        if ((pTable->EntryCount * 32) <= (capacity * 25))
+            setRawCapacity(capacity);
+        else
+            setRawCapacity(capacity * 2);
+    }
+
+    static size_t mixHash(size_t h)
+    {
+        #if defined(OVR_64BIT_POINTERS)
+            h ^= (h >> 33);
+            h *= UINT64_C(0xff51afd7ed558ccd);
+            h ^= (h >> 33);
+        #else
+            h ^= (h >> 16);
+            h *= 0x85ebca6bU;
+            h ^= (h >> 13);
+        #endif
+        return h;
+    }
+
+    // Index access helpers.
+    int8_t* Ctrl() const
+    {
+        return reinterpret_cast<int8_t*>(pTable + 1);
+    }
+
+    bool isFull(size_t index) const
+    {
+        return (Ctrl()[index] >= 0);
+    }
+
+    // Returns the index of the first full slot at or after index, or SizeMask + 1 if there is none.
+    // Checks a group of control bytes at a time.
+    size_t nextFull(size_t index) const
+    {
+        const size_t capacity = (pTable->SizeMask + 1);
+
+        while (index < capacity)
+        {
+            const size_t groupStart = (index & ~(size_t)(GroupWidth - 1));
+            const uint16_t mask = (uint16_t)(HashFlatGroup(Ctrl() + groupStart).MatchFull() & (0xffffu << (index - groupStart)));
+
+            if (mask)
+                return groupStart + Alg::CountTrailing0Bits(mask);
+
+            index = groupStart + GroupWidth;
+        }
+
+        return capacity;
+    }
+
+    static size_t getSlotOffset(size_t capacity)
+    {
+        const size_t align = OVR_ALIGNOF(C);
+        return ((sizeof(TableType) + capacity + (align - 1)) & ~(align - 1));
+    }
+
+    C& V(size_t index) const
+    {
+        OVR_ASSERT(index <= pTable->SizeMask);
+        return reinterpret_cast<C*>(reinterpret_cast<uint8_t*>(pTable) + getSlotOffset(pTable->SizeMask + 1))[index];
+    }
+
+    // Rounds a slot count up to the table size setRawCapacity would use.
+    static size_t roundRawCapacity(size_t newSize)
+    {
+        if (newSize < HashMinSize)
+            return HashMinSize;
+
+        // Force newSize to be a power of two.
+        int bits = Alg::UpperBit(newSize-1) + 1;
+        return size_t(1) << bits;
+    }
+
+    // Max load is 7/8.
+    static size_t getMaxLoad(size_t capacity)
+    {
+        return capacity - (capacity / 8);
+    }
+
+    // Resize the table to the given number of slots (rounded up to a power of two),
+    // rehashing the contents of the current table.
+    void setRawCapacity(size_t newSize)
+    {
+        if (newSize == 0)
+        {
+            // Special case.
+            Clear();
+            return;
+        }
+
+        newSize = roundRawCapacity(newSize);
+
+        while (getMaxLoad(newSize) < GetSize()) // This happens only when shrinking to fewer slots than the size.
+            newSize *= 2;
+
+        SelfType newHash;
+        newHash.pTable = (TableType*)Allocator::Alloc(getSlotOffset(newSize) + (sizeof(C) * newSize));
+        // Need to do something on alloc failure!
+        OVR_ASSERT(newHash.pTable);
+
+        newHash.pTable->EntryCount = 0;
+        newHash.pTable->SizeMask   = newSize - 1;
+        newHash.pTable->GrowthLeft = getMaxLoad(newSize);
+        memset(newHash.Ctrl(), HashFlatGroup::Empty, newSize);
+
+        if (pTable)
+        {
+            for (size_t i = 0, n = pTable->SizeMask; i <= n; i++)
+            {
+                if (isFull(i))
+                {
+                    // The values are unique, so we can put them in the first free slot.
+                    C&     value     = V(i);
+                    size_t hashValue = mixHash(HashF()(value));
+                    size_t index     = newHash.findInsertIndex(hashValue);
+
+                    newHash.Ctrl()[index] = (int8_t)(hashValue & 0x7f);
+
+                    // As with the chained table's relocate, the Allocator isn't consulted, as
+                    // HashFlat passes one for its key type rather than for C.
+                    if (IsTriviallyRelocatable<C>::value)
+                        memcpy((void*)&newHash.V(index), (const void*)&value, sizeof(C));
+                    else
+                    {
+                        OVR::ConstructMove<C>(&newHash.V(index), value);
+                        value.~C();
+                    }
+                }
+            }
+
+            newHash.pTable->EntryCount = pTable->EntryCount;
+            newHash.pTable->GrowthLeft -= pTable->EntryCount;
+
+            Allocator::Free(pTable);
+        }
+
+        // Steal newHash's data.
+        pTable = newHash.pTable;
+        newHash.pTable = NULL;
+    }
+
+    struct TableType
+    {
+        size_t EntryCount;
+        size_t SizeMask;
+        size_t GrowthLeft;  // Number of Empty slots which may still be used before we need to rehash.
+        // Control bytes follow this structure in memory, followed by the slots.
+    };
+    TableType*  pTable;
+};
+
+
+
+//-----------------------------------------------------------------------------------
+template<class C, class HashF = FixedSizeHash<C>,
+         class AltHashF = HashF, 
+         class Allocator = ContainerAllocator<C>,
+         class Entry = HashsetCachedEntry<C, HashF> >
+class HashSet : public HashSetBase<C, HashF, AltHashF, Allocator, Entry>
+{
+public:
+    typedef HashSetBase<C, HashF, AltHashF, Allocator, Entry> BaseType;
+    typedef HashSet<C, HashF, AltHashF, Allocator, Entry>     SelfType;
+
+    HashSet()                                      {   }
+    HashSet(int sizeHint) : BaseType(sizeHint)     {   }
+    HashSet(const SelfType& src) : BaseType(src)   {   }
+    ~HashSet()                                     {   }
+
+    void operator = (const SelfType& src)   { BaseType::Assign(src); }
+
+    // Set a new or existing value under the key, to the value.
+    // Pass a different class of 'key' so that assignment reference object
+    // can be passed instead of the actual object.
+    template<class CRef>
+    void Set(const CRef& key)
+    {
+        BaseType::Set(key);
+    }
+
+    template<class CRef>
+    inline void Add(const CRef& key)
+    {
+        BaseType::Add(key);
+    }
+
+    // Hint the bucket count to >= n.
+    void Resize(size_t n)    
+    {
+        BaseType::SetCapacity(n);
+    }
+
+    // Size the HashSet so that it can comfortably contain the given
+    // number of elements.  If the HashSet already contains more
+    // elements than newSize, then this may be a no-op.
+    void SetCapacity(size_t newSize)
+    {
+        BaseType::SetCapacity(newSize);
+    }
+
+};
+
+// HashSet with uncached hash code; declared for convenience.
+template<class C, class HashF = FixedSizeHash<C>,
+                  class AltHashF = HashF,
+                  class Allocator = ContainerAllocator<C> >
+class HashSetUncached : public HashSet<C, HashF, AltHashF, Allocator, HashsetEntry<C, HashF> >
+{
+public:
+    
+    typedef HashSetUncached<C, HashF, AltHashF, Allocator>                  SelfType;
+    typedef HashSet<C, HashF, AltHashF, Allocator, HashsetEntry<C, HashF> > BaseType;
+
+    // Delegated constructors.
+    HashSetUncached()                                        { }
+    HashSetUncached(int sizeHint) : BaseType(sizeHint)       { }
+    HashSetUncached(const SelfType& src) : BaseType(src)     { }
+    ~HashSetUncached()                                       { }
+    
+    void    operator = (const SelfType& src)
+    {
+        BaseType::operator = (src);
+    }
+};
+
+// HashSet using the flat implementation; declared for convenience.
+template<class C, class HashF = FixedSizeHash<C>,
+                  class AltHashF = HashF,
+                  class Allocator = ContainerAllocator<C> >
+class HashSetFlat : public HashSet<C, HashF, AltHashF, Allocator, HashsetFlatEntry<C, HashF> >
+{
+public:
+    typedef HashSetFlat<C, HashF, AltHashF, Allocator>                          SelfType;
+    typedef HashSet<C, HashF, AltHashF, Allocator, HashsetFlatEntry<C, HashF> > BaseType;
+
+    // Delegated constructors.
+    HashSetFlat()                                        { }
+    HashSetFlat(int sizeHint) : BaseType(sizeHint)       { }
+    HashSetFlat(const SelfType& src) : BaseType(src)     { }
+    ~HashSetFlat()                                       { }
+
+    void    operator = (const SelfType& src)
+    {
+        BaseType::operator = (src);
+    }
+};
+
+
+//-----------------------------------------------------------------------------------
+// ***** Hash hash table implementation
+
+// Node for Hash - necessary so that Hash can delegate its implementation
+// to HashSet.
+template<class C, class U, class HashF>
+struct HashNode
+{
+    typedef HashNode<C, U, HashF>   SelfType;
+    typedef C                       FirstType;
+    typedef U                       SecondType;
+
+    C   First;
+    U   Second;
+
+    // NodeRef is used to allow passing of elements into HashSet
+    // without using a temporary object.
+    struct NodeRef
+    {
+        const C*   pFirst;
+        const U*   pSecond;
+
+        NodeRef(const C& f, const U& s) : pFirst(&f), pSecond(&s) { }
+        NodeRef(const NodeRef& src)     : pFirst(src.pFirst), pSecond(src.pSecond) { }
+
+        // Enable computation of ghash_node_hashf.
+        inline size_t GetHash() const            { return HashF()(*pFirst); } 
+        // Necessary conversion to allow HashNode::operator == to work.
+        operator const C& () const              { return *pFirst; }
+    };
+
+    // Note: No default constructor is necessary.
+     HashNode(const HashNode& src) : First(src.First), Second(src.Second)    { }
+     HashNode(HashNode&& src) : First(std::move(src.First)), Second(std::move(src.Second)) { }
+     HashNode(const NodeRef& src) : First(*src.pFirst), Second(*src.pSecond)  { }
+    void operator = (const NodeRef& src)  { First  = *src.pFirst; Second = *src.pSecond; }
+    void operator = (const HashNode& src) { First  = src.First;   Second = src.Second; }
+
+    template<class K>
+    bool operator == (const K& src) const   { return (First == src); }
+
+    template<class K>
+    static size_t CalcHash(const K& data)   { return HashF()(data); }
+    inline size_t GetHash() const           { return HashF()(First); }
+
+    // Hash functors used with this node. A separate functor is used for alternative
+    // key lookup so that it does not need to access the '.First' element.    
+    struct NodeHashF
+    {    
+        template<class K>
+        size_t operator()(const K& data) const { return data.GetHash(); } 
+    };    
+    struct NodeAltHashF
+    {
+        template<class K>
+        size_t operator()(const K& data) const { return HashNode<C,U,HashF>::CalcHash(data); }
+    };
 };
 
+// A node can be moved with memcpy if both of its members can.
+template<class C, class U, class HashF>
+struct IsTriviallyRelocatable<HashNode<C, U, HashF> >
+    : std::integral_constant<bool, IsTriviallyRelocatable<C>::value && IsTriviallyRelocatable<U>::value> { };
+
 
 
 // **** Extra hashset_entry types to allow NodeRef construction.
@@ -1060,6 +2008,8 @@ public:
         : NextInChain(-2) { }
     HashsetNodeEntry(const HashsetNodeEntry& e)
         : NextInChain(e.NextInChain), Value(e.Value) { }
+    HashsetNodeEntry(HashsetNodeEntry&& e)
+        : NextInChain(e.NextInChain), Value(std::move(e.Value)) { }
     HashsetNodeEntry(const C& key, intptr_t next)
         : NextInChain(next), Value(key) { }    
     HashsetNodeEntry(const typename C::NodeRef& keyRef, intptr_t next)
@@ -1095,6 +2045,8 @@ public:
         : NextInChain(-2) { }
     HashsetCachedNodeEntry(const HashsetCachedNodeEntry& e)
         : NextInChain(e.NextInChain), HashValue(e.HashValue), Value(e.Value) { }
+    HashsetCachedNodeEntry(HashsetCachedNodeEntry&& e)
+        : NextInChain(e.NextInChain), HashValue(e.HashValue), Value(std::move(e.Value)) { }
     HashsetCachedNodeEntry(const C& key, intptr_t next)
         : NextInChain(next), Value(key) { }
     HashsetCachedNodeEntry(const typename C::NodeRef& keyRef, intptr_t next)
@@ -1234,6 +2186,30 @@ public:
     inline int     GetSizeI() const             { return (int)GetSize(); }
     inline void    Resize(size_t n)              { mHash.Resize(n); }
     inline void    SetCapacity(size_t newSize)   { mHash.SetCapacity(newSize); }
+    inline void    Reserve(size_t n)             { mHash.Reserve(n); }
+    inline void    ShrinkToFit()                 { mHash.ShrinkToFit(); }
+
+    // Add count key/value pairs, whose keys must be unique and not already in the Hash.
+    // The table is grown at most once.
+    void    Append(const C keys[], const U values[], size_t count)
+    {
+        mHash.Reserve(GetSize() + count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            OVR_ASSERT(mHash.GetAlt(keys[i]) == NULL);
+            typename HashNode::NodeRef e(keys[i], values[i]);
+            mHash.Add(e);
+        }
+    }
+
+    // Replace the contents of the Hash with count key/value pairs with unique keys,
+    // sizing the table once up front.
+    void    BuildFrom(const C keys[], const U values[], size_t count)
+    {
+        Clear();
+        Append(keys, values, count);
+    }
 
     // Iterator API, like STL.
     typedef typename Container::ConstIterator   ConstIterator;
@@ -1277,6 +2253,28 @@ public:
 
 
 
+// Hash using the flat implementation; declared for convenience.
+template<class C, class U, class HashF = FixedSizeHash<C>, class Allocator = ContainerAllocator<C> >
+class HashFlat
+    : public Hash<C, U, HashF, Allocator, HashNode<C,U,HashF>,
+                   HashsetFlatEntry<HashNode<C,U,HashF>, typename HashNode<C,U,HashF>::NodeHashF> >
+{
+public:
+    typedef HashFlat<C, U, HashF, Allocator>                    SelfType;
+    typedef Hash<C, U, HashF, Allocator, HashNode<C,U,HashF>,
+                 HashsetFlatEntry<HashNode<C,U,HashF>,
+                 typename HashNode<C,U,HashF>::NodeHashF> >     BaseType;
+
+    // Delegated constructors.
+    HashFlat()                                            { }
+    HashFlat(int sizeHint) : BaseType(sizeHint)           { }
+    HashFlat(const SelfType& src) : BaseType(src)         { }
+    ~HashFlat()                                           { }
+    void operator = (const SelfType& src)                 { BaseType::operator = (src); }
+};
+
+
+
 // And identity hash in which keys serve as hash value. Can be uncached,
 // since hash computation is assumed cheap.
 template<class C, class U, class Allocator = ContainerAllocator<C>, class HashF = IdentityHash<C> >
@@ -173,7 +173,7 @@ JSON::~JSON()
     JSON* child = Children.GetFirst();
     while (!Children.IsNull(child))
     {
-        child->RemoveNode();
+        Children.Remove(child);
         child->Release();
         child = Children.GetFirst();
     }
@@ -944,38 +944,34 @@ char* JSON::PrintObject(int depth, bool fmt)
 
 
 // Returns the number of child items in the object
-// Counts the number of items in the object.
 unsigned JSON::GetItemCount() const
 {
-    unsigned count = 0;
-    for (const JSON* p = Children.GetFirst(); !Children.IsNull(p); p = Children.GetNext(p))
-    {
-        count++;
-    }
-    return count;
+    return (unsigned)Children.GetSize();
 }
 
+// Walks from whichever end of the child list is nearer to index.
 JSON* JSON::GetItemByIndex(unsigned index)
 {
-    unsigned i     = 0;
-    JSON*    child = 0;
+    const unsigned count = GetItemCount();
 
-    if (!Children.IsEmpty())
+    if (index >= count)
+        return 0;
+
+    JSON* child;
+
+    if (index < count / 2)
     {
         child = Children.GetFirst();
-
-        while (i < index)
-        {   
-            if (Children.IsLast(child))
-            {
-                child = 0;
-                break;
-            }
-            child = child->GetNext();
-            i++;
-        }
+        for (unsigned i = 0; i < index; ++i)
+            child = Children.GetNext(child);
     }
-  
+    else
+    {
+        child = Children.GetLast();
+        for (unsigned i = count - 1; i > index; --i)
+            child = Children.GetPrev(child);
+    }
+
     return child;
 }
 
@@ -1058,7 +1054,7 @@ void JSON::RemoveLast()
     JSON* child = Children.GetLast();
     if (!Children.IsNull(child))
     {
-        child->RemoveNode();
+        Children.Remove(child);
         child->Release();
     }
 }
@@ -1192,7 +1188,7 @@ void JSON::InsertArrayElement(int index, JSON *item)
     }
 
     if (iter)
-        iter->InsertNodeBefore(item);
+        Children.InsertBefore(iter, item);
     else
         Children.PushBack(item);
 }
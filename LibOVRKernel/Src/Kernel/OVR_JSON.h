@@ -58,7 +58,7 @@ enum JSONItemType
 class JSON : public RefCountBase<JSON>, public ListNode<JSON>
 {
 protected:
-    List<JSON>      Children;
+    List<JSON, JSON, ListCountedSize> Children;   // Counted, so GetItemCount and GetArraySize are O(1).
 
 public:
     JSONItemType    Type;       // Type of this JSON node.
@@ -69,6 +69,9 @@ public:
 public:
     ~JSON();
 
+    // JSON trees consist of many small nodes, so we allocate them from a pool.
+    OVR_REFCOUNT_REDEFINE_NEW_POOLED(JSON)
+
     // *** Creation of NEW JSON objects
 
     static JSON*    CreateObject() { return new JSON(JSON_Object);}
@@ -29,6 +29,7 @@ limitations under the License.
 #define OVR_List_h
 
 #include "OVR_Types.h"
+#include "OVR_Array.h"
 
 namespace OVR {
 
@@ -50,7 +51,7 @@ private:
     ListNode<T>* pPrev;
     ListNode<T>* pNext;
 
-    template<class X, class B> friend class List;
+    template<class X, class B, class S> friend class List;
 
 #ifdef OVR_BUILD_DEBUG
     bool marker; // Is this a marker node (rather than an actual data node)?
@@ -148,6 +149,40 @@ public:
     }
 };
 
+//------------------------------------------------------------------------
+// ***** List size policies
+//
+// ListUncountedSize (the default) stores nothing, and List::GetSize walks the list.
+// ListCountedSize keeps a count, making GetSize O(1). That only works if every
+// insertion and removal goes through the List, so with ListCountedSize don't use
+// the ListNode functions which modify the list (RemoveNode, InsertNodeAfter, etc.);
+// use the List functions with the same purpose instead.
+
+class ListUncountedSize
+{
+protected:
+    enum { IsCounted = 0 };
+
+    void   adjustCount(intptr_t) { }
+    void   resetCount()          { }
+    size_t getCount() const      { return 0; }
+};
+
+class ListCountedSize
+{
+protected:
+    enum { IsCounted = 1 };
+
+    ListCountedSize() : Count(0) { }
+
+    void   adjustCount(intptr_t delta) { Count += (size_t)delta; }
+    void   resetCount()                { Count = 0; }
+    size_t getCount() const            { return Count; }
+
+    size_t Count;
+};
+
+
 //------------------------------------------------------------------------
 // ***** List
 //
@@ -180,12 +215,13 @@ public:
 // List<> represents a doubly-linked list of T, where each T must derive
 // from ListNode<B>. B specifies the base class that was directly
 // derived from ListNode, and is only necessary if there is an intermediate
-// inheritance chain.
+// inheritance chain. SizePolicy is ListUncountedSize or ListCountedSize (see above).
 
-template<class T, class B = T> class List
+template<class T, class B = T, class SizePolicy = ListUncountedSize> class List : protected SizePolicy
 {
 public:
-    typedef T ValueType;
+    typedef T                          ValueType;
+    typedef List<T, B, SizePolicy>     SelfType;
 
     List()
     {
@@ -198,16 +234,16 @@ public:
     void Clear()
     {
         Root.pNext = Root.pPrev = &Root;
+        this->resetCount();
     }
 
+    // O(1) with ListCountedSize, otherwise O(n).
     size_t GetSize() const
     {
-        size_t n = 0;
+        if (SizePolicy::IsCounted)
+            return this->getCount();
 
-        for(const ListNode<B>* pNode = Root.pNext; pNode != &Root; pNode = pNode->pNext)
-            ++n;
-
-        return n;
+        return countRange(Root.pNext, &Root);
     }
 
     const ValueType* GetFirst() const { return IsEmpty() ? nullptr : (const ValueType*)Root.pNext; }
@@ -234,6 +270,7 @@ public:
         p->pPrev          =  &Root;
         Root.pNext->pPrev =  p;
         Root.pNext        =  p;
+        this->adjustCount(1);
     }
 
     void PushBack(ValueType* p)
@@ -242,14 +279,36 @@ public:
         p->pNext          =  &Root;
         Root.pPrev->pNext =  p;
         Root.pPrev        =  p;
+        this->adjustCount(1);
     }
 
-    static void Remove(ValueType* p)
+    // Inserts p before/after pos, which must be in this list.
+    void InsertBefore(ValueType* pos, ValueType* p)
+    {
+        pos->InsertNodeBefore(p);
+        this->adjustCount(1);
+    }
+
+    void InsertAfter(ValueType* pos, ValueType* p)
+    {
+        pos->InsertNodeAfter(p);
+        this->adjustCount(1);
+    }
+
+    // Removes p, which must be in this list, and puts pnew in its place.
+    void Replace(ValueType* p, ValueType* pnew)
+    {
+        p->ReplaceNodeWith(pnew);
+    }
+
+    // The element must be in this list.
+    void Remove(ValueType* p)
     {
         p->pPrev->pNext = p->pNext;
         p->pNext->pPrev = p->pPrev;
         p->pPrev        =  nullptr;
         p->pNext        =  nullptr;
+        this->adjustCount(-1);
     }
 
     void BringToFront(ValueType* p)
@@ -265,13 +324,14 @@ public:
     }
 
     // Appends the contents of the argument list to the front of this list;
-    // items are removed from the argument list.
-    void PushListToFront(List<T>& src)
+    // items are removed from the argument list. O(1).
+    void PushListToFront(SelfType& src)
     {
         if (!src.IsEmpty())
         {
             ValueType* pfirst = src.GetFirst();
             ValueType* plast  = src.GetLast();
+            this->adjustCount((intptr_t)src.getCount());
             src.Clear();
             plast->pNext      = Root.pNext;
             pfirst->pPrev     = &Root;
@@ -280,12 +340,13 @@ public:
         }
     }
 
-    void PushListToBack(List<T>& src)
+    void PushListToBack(SelfType& src)
     {
         if (!src.IsEmpty())
         {
             ValueType* pfirst = src.GetFirst();
             ValueType* plast  = src.GetLast();
+            this->adjustCount((intptr_t)src.getCount());
             src.Clear();
             plast->pNext      = &Root;
             pfirst->pPrev     = Root.pPrev;
@@ -295,13 +356,17 @@ public:
     }
 
     // Removes all source list items after (and including) the 'pfirst' node from the
-    // source list and adds them to out list.
-    void    PushFollowingListItemsToFront(List<T>& src, ValueType *pfirst)
+    // source list and adds them to out list. With ListCountedSize this is O(n) in the
+    // number of moved items, as they need to be counted.
+    void    PushFollowingListItemsToFront(SelfType& src, ValueType *pfirst)
     {
         if (pfirst != &src.Root)
         {
             ValueType *plast = src.Root.pPrev;
 
+            if (SizePolicy::IsCounted)
+                transferCount(src, countRange(pfirst, &src.Root));
+
             // Remove list remainder from source.
             pfirst->pPrev->pNext = &src.Root;
             src.Root.pPrev       = pfirst->pPrev;
@@ -314,14 +379,18 @@ public:
     }
 
     // Removes all source list items up to but NOT including the 'pend' node from the
-    // source list and adds them to out list.
-    void    PushPrecedingListItemsToFront(List<T>& src, ValueType *ptail)
+    // source list and adds them to out list. With ListCountedSize this is O(n) in the
+    // number of moved items, as they need to be counted.
+    void    PushPrecedingListItemsToFront(SelfType& src, ValueType *ptail)
     {
         if (src.GetFirst() != ptail)
         {
             ValueType *pfirst = src.Root.pNext;
             ValueType *plast  = ptail->pPrev;
 
+            if (SizePolicy::IsCounted)
+                transferCount(src, countRange(pfirst, ptail));
+
             // Remove list remainder from source.
             ptail->pPrev      = &src.Root;
             src.Root.pNext    = ptail;
@@ -337,8 +406,11 @@ public:
 
     // Removes a range of source list items starting at 'pfirst' and up to, but not including 'pend',
     // and adds them to out list. Note that source items MUST already be in the list.
+    // Not available with ListCountedSize, as the source list is unknown; use Splice instead.
     void    PushListItemsToFront(ValueType *pfirst, ValueType *pend)
     {
+        static_assert(!SizePolicy::IsCounted, "Use Splice with counted lists.");
+
         if (pfirst != pend)
         {
             ValueType *plast = pend->pPrev;
@@ -355,7 +427,45 @@ public:
     }
 
 
-    void    Alloc_MoveTo(List<T>* pdest)
+    // Moves the range [pfirst, pend) of src in front of pos, which must be in this list, or to
+    // the back of this list if pos is null. pend may be null for the end of src.
+    // O(1), except that with ListCountedSize the range is counted unless count is given.
+    void    Splice(ValueType* pos, SelfType& src, ValueType* pfirst, ValueType* pend = nullptr, size_t count = (size_t)-1)
+    {
+        ListNode<B>* pstop = pend ? (ListNode<B>*)pend : &src.Root;
+
+        if ((ListNode<B>*)pfirst == pstop)
+            return;
+
+        if (SizePolicy::IsCounted)
+        {
+            if (count == (size_t)-1)
+                count = countRange(pfirst, pstop);
+            transferCount(src, count);
+        }
+
+        ListNode<B>* plast  = pstop->pPrev;
+        ListNode<B>* pafter = pos ? (ListNode<B>*)pos : &Root;
+
+        // Unlink the range from src.
+        pfirst->pPrev->pNext = pstop;
+        pstop->pPrev         = pfirst->pPrev;
+
+        // Link it in front of pafter.
+        pfirst->pPrev        = pafter->pPrev;
+        plast->pNext         = pafter;
+        pafter->pPrev->pNext = pfirst;
+        pafter->pPrev        = plast;
+    }
+
+    // Moves all of src in front of pos, or to the back of this list if pos is null. O(1).
+    void    Splice(ValueType* pos, SelfType& src)
+    {
+        if (!src.IsEmpty())
+            Splice(pos, src, src.GetFirst(), nullptr, SizePolicy::IsCounted ? src.getCount() : 0);
+    }
+
+    void    Alloc_MoveTo(SelfType* pdest)
     {
         if (IsEmpty())
             pdest->Clear();
@@ -366,19 +476,88 @@ public:
 
             Root.pNext->pPrev = &pdest->Root;
             Root.pPrev->pNext = &pdest->Root;
+
+            pdest->resetCount();
+            pdest->adjustCount((intptr_t)this->getCount());
         }
     }
 
 
 private:
     // Copying is prohibited
-    List(const List<T>&);
-    const List<T>& operator = (const List<T>&);
+    List(const SelfType&);
+    const SelfType& operator = (const SelfType&);
+
+    // Counts the nodes from pfirst up to, but not including, pend.
+    static size_t countRange(const ListNode<B>* pfirst, const ListNode<B>* pend)
+    {
+        size_t n = 0;
+
+        for(const ListNode<B>* pNode = pfirst; pNode != pend; pNode = pNode->pNext)
+            ++n;
+
+        return n;
+    }
+
+    void transferCount(SelfType& src, size_t count)
+    {
+        src.adjustCount(-(intptr_t)count);
+        this->adjustCount((intptr_t)count);
+    }
 
     ListNode<B> Root;
 };
 
 
+//------------------------------------------------------------------------
+// ***** ListIndex
+//
+// Gives O(1) access to the elements of a List by position, after an O(n) Build.
+// The index doesn't track changes to the list; it must be rebuilt after the list
+// is modified.
+//
+//    ListIndex< List<MyData> > index(myList);
+//    for (size_t i = 0; i < index.GetSize(); ++i)
+//        Process(index[i]);
+
+template<class ListType>
+class ListIndex
+{
+public:
+    typedef typename ListType::ValueType ValueType;
+
+    ListIndex() { }
+    explicit ListIndex(ListType& list) { Build(list); }
+
+    void Build(ListType& list)
+    {
+        Items.Clear();
+        Items.Reserve(list.GetSize());
+
+        for (ValueType* p = list.GetFirst(); !list.IsNull(p); p = list.GetNext(p))
+            Items.PushBack(p);
+    }
+
+    void   Clear()                              { Items.Clear(); }
+    size_t GetSize() const                      { return Items.GetSize(); }
+    ValueType* operator[] (size_t index) const  { return Items[index]; }
+
+    // Returns the position of p in the list, or -1 if it isn't there. O(n).
+    intptr_t Find(const ValueType* p) const
+    {
+        for (size_t i = 0; i < Items.GetSize(); ++i)
+        {
+            if (Items[i] == p)
+                return (intptr_t)i;
+        }
+        return -1;
+    }
+
+protected:
+    ArrayPOD<ValueType*> Items;
+};
+
+
 //------------------------------------------------------------------------
 // ***** FreeListElements
 //
@@ -28,12 +28,12 @@ limitations under the License.
 #define OVR_Lockless_h
 
 #include <cstring>
+#include <utility>
 using std::memcpy;
 
 #include "OVR_Atomic.h"
-
-// Define this to compile-in Lockless test logic
-//#define OVR_LOCKLESS_TEST
+#include "OVR_Threads.h"    // For Event, used by LocklessWaitableQueue
+#include "OVR_Timer.h"
 
 namespace OVR {
 
@@ -139,6 +139,332 @@ OVR_RESTORE_MSVC_WARNING()
 #pragma pack(pop)
 
 
+// ***** LocklessSPSCQueue
+
+// Bounded FIFO queue for exactly one producer thread and one consumer thread.
+//
+// Capacity must be a power of two. Head and Tail are free-running counters, each written
+// by only one side. Each side also keeps a cached copy of the other side's counter, and
+// only reloads it (pulling in the other side's cache line) when the cached value says
+// the queue is full or empty. The counters are padded onto separate cache lines.
+//
+// T must be default-constructible and assignable. A popped slot is reset to T(), so the
+// queue doesn't keep the resources of values it has handed out (e.g. a Ptr's object) alive.
+
+template<class T, size_t Capacity>
+class LocklessSPSCQueue
+{
+public:
+    typedef T ValueType;
+
+    static_assert((Capacity >= 2) && ((Capacity & (Capacity - 1)) == 0), "Capacity must be a power of two.");
+
+    LocklessSPSCQueue() : Tail(0), HeadCache(0), Head(0), TailCache(0)
+    {
+    }
+
+    // Producer only. Returns false if the queue is full.
+    bool TryPush(const T& item)
+    {
+        const size_t tail = Tail.load(std::memory_order_relaxed);
+
+        if ((tail - HeadCache) == Capacity)
+        {
+            HeadCache = Head.load(std::memory_order_acquire);
+            if ((tail - HeadCache) == Capacity)
+                return false;
+        }
+
+        Slots[tail & (Capacity - 1)] = item;
+        Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false if the queue is empty.
+    bool TryPop(T& item)
+    {
+        const size_t head = Head.load(std::memory_order_relaxed);
+
+        if (head == TailCache)
+        {
+            TailCache = Tail.load(std::memory_order_acquire);
+            if (head == TailCache)
+                return false;
+        }
+
+        T& slot = Slots[head & (Capacity - 1)];
+        item = std::move(slot);
+        slot = T();
+        Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // These are snapshots which may be stale by the time they return, unless called
+    // from the side which the answer is about (e.g. IsEmpty from the consumer).
+    size_t GetSize() const
+    {
+        const size_t head = Head.load(std::memory_order_acquire);
+        return Tail.load(std::memory_order_acquire) - head;
+    }
+    bool IsEmpty() const { return GetSize() == 0; }
+    bool IsFull() const  { return GetSize() == Capacity; }
+
+    static size_t GetCapacity() { return Capacity; }
+
+protected:
+    char                Padding0[64];
+    std::atomic<size_t> Tail;           // Written by the producer.
+    size_t              HeadCache;      // Producer's copy of Head.
+    char                Padding1[64];
+    std::atomic<size_t> Head;           // Written by the consumer.
+    size_t              TailCache;      // Consumer's copy of Tail.
+    char                Padding2[64];
+    T                   Slots[Capacity];
+
+    OVR_NON_COPYABLE(LocklessSPSCQueue);
+};
+
+
+// ***** LocklessMPMCQueue
+
+// Bounded FIFO queue for any number of producer and consumer threads (Vyukov's design).
+//
+// Each slot has a sequence number saying whether it's ready to be written or read at the
+// current lap around the queue, so producers only contend on EnqueuePos, and consumers
+// on DequeuePos, with a single compare-exchange per operation in the uncontended case.
+// Neither operation ever waits for another thread to finish: a full or empty queue
+// just returns false.
+//
+// Capacity must be a power of two. T must be default-constructible and assignable. As with
+// LocklessSPSCQueue, a popped cell is reset to T().
+
+template<class T, size_t Capacity>
+class LocklessMPMCQueue
+{
+public:
+    typedef T ValueType;
+
+    static_assert((Capacity >= 2) && ((Capacity & (Capacity - 1)) == 0), "Capacity must be a power of two.");
+
+    LocklessMPMCQueue() : EnqueuePos(0), DequeuePos(0)
+    {
+        for (size_t i = 0; i < Capacity; ++i)
+            Cells[i].Sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // Returns false if the queue is full.
+    bool TryPush(const T& item)
+    {
+        size_t pos = EnqueuePos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            Cell&          cell = Cells[pos & (Capacity - 1)];
+            const size_t   seq  = cell.Sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            if (diff == 0)
+            {
+                // The cell is free at this lap; claim it. On failure pos is reloaded.
+                if (EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.Value = item;
+                    cell.Sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;   // The cell still holds the value from the previous lap.
+            else
+                pos = EnqueuePos.load(std::memory_order_relaxed);  // Another producer got here first.
+        }
+    }
+
+    // Returns false if the queue is empty.
+    bool TryPop(T& item)
+    {
+        size_t pos = DequeuePos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            Cell&          cell = Cells[pos & (Capacity - 1)];
+            const size_t   seq  = cell.Sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+            if (diff == 0)
+            {
+                if (DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    item = std::move(cell.Value);
+                    cell.Value = T();
+                    cell.Sequence.store(pos + Capacity, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;   // The cell hasn't been written at this lap yet.
+            else
+                pos = DequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Snapshot which may be stale by the time it returns.
+    size_t GetSize() const
+    {
+        const size_t dequeuePos = DequeuePos.load(std::memory_order_acquire);
+        const size_t enqueuePos = EnqueuePos.load(std::memory_order_acquire);
+        return (enqueuePos > dequeuePos) ? (enqueuePos - dequeuePos) : 0;
+    }
+    bool IsEmpty() const { return GetSize() == 0; }
+
+    static size_t GetCapacity() { return Capacity; }
+
+protected:
+    struct Cell
+    {
+        std::atomic<size_t> Sequence;
+        T                   Value;
+    };
+
+    char                Padding0[64];
+    std::atomic<size_t> EnqueuePos;
+    char                Padding1[64];
+    std::atomic<size_t> DequeuePos;
+    char                Padding2[64];
+    Cell                Cells[Capacity];
+
+    OVR_NON_COPYABLE(LocklessMPMCQueue);
+};
+
+
+#if defined(OVR_ENABLE_THREADS)
+
+// ***** LocklessWaitableQueue
+
+// Adds blocking and timed Push/Pop to LocklessSPSCQueue or LocklessMPMCQueue, so a thread
+// can sleep on an Event instead of spinning. The lock-free TryPush/TryPop paths stay
+// lock-free: a push or pop only signals an Event if a thread on the other side has
+// announced that it's waiting, so the Event's mutex is only taken when someone is asleep.
+//
+// The thread rules of QueueType still apply, e.g. with LocklessSPSCQueue only one thread
+// may call Push/TryPush and only one may call Pop/TryPop.
+//
+// Example usage:
+//     LocklessWaitableQueue< LocklessSPSCQueue<Message, 256> > queue;
+//     queue.Push(msg);                   // Producer thread
+//     Message msg;
+//     if (queue.Pop(msg, 100))           // Consumer thread, waits up to 100 ms
+//         ...
+
+template<class QueueType>
+class LocklessWaitableQueue
+{
+public:
+    typedef typename QueueType::ValueType ValueType;
+
+    LocklessWaitableQueue() : PopWaiters(0), PushWaiters(0)
+    {
+    }
+
+    bool TryPush(const ValueType& item)
+    {
+        if (!Queue.TryPush(item))
+            return false;
+        wake(PopWaiters, ItemEvent);
+        return true;
+    }
+
+    bool TryPop(ValueType& item)
+    {
+        if (!Queue.TryPop(item))
+            return false;
+        wake(PushWaiters, SpaceEvent);
+        return true;
+    }
+
+    // Waits up to delay milliseconds for space in the queue. Returns false if the item
+    // couldn't be pushed in time. A delay of 0 is the same as TryPush.
+    bool Push(const ValueType& item, unsigned delay = OVR_WAIT_INFINITE)
+    {
+        return wait(PushWaiters, SpaceEvent, delay, [&]() { return TryPush(item); });
+    }
+
+    // Waits up to delay milliseconds for an item. Returns false if none arrived in time.
+    bool Pop(ValueType& item, unsigned delay = OVR_WAIT_INFINITE)
+    {
+        return wait(PopWaiters, ItemEvent, delay, [&]() { return TryPop(item); });
+    }
+
+    size_t GetSize() const  { return Queue.GetSize(); }
+    bool   IsEmpty() const  { return Queue.IsEmpty(); }
+
+protected:
+    // The seq_cst fence pairs with the waiter's seq_cst increment of waiters before it
+    // re-checks the queue: either the waiter sees our change to the queue, or we see
+    // the waiter and signal it.
+    static void wake(std::atomic<int>& waiters, Event& event)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0)
+            event.SetEvent();
+    }
+
+    template<class TryF>
+    static bool wait(std::atomic<int>& waiters, Event& event, unsigned delay, TryF tryOnce)
+    {
+        if (tryOnce())
+            return true;
+        if (delay == 0)
+            return false;
+
+        const uint32_t startMs = Timer::GetTicksMs();
+        bool           result  = false;
+
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+
+        for (;;)
+        {
+            // Resetting before the re-check means a wake after the re-check isn't lost.
+            event.ResetEvent();
+
+            if (tryOnce())
+            {
+                result = true;
+                break;
+            }
+
+            unsigned waitMs = delay;
+            if (delay != OVR_WAIT_INFINITE)
+            {
+                const uint32_t elapsedMs = (Timer::GetTicksMs() - startMs);
+                if (elapsedMs >= delay)
+                    break;
+                waitMs = delay - elapsedMs;
+            }
+
+            event.Wait(waitMs); // May return early; the loop re-checks the queue and the time.
+        }
+
+        waiters.fetch_sub(1, std::memory_order_seq_cst);
+
+        // Another waiter may have slept through the wake which we consumed by resetting
+        // the event, so pass it on.
+        if (result && (waiters.load(std::memory_order_relaxed) > 0))
+            event.SetEvent();
+
+        return result;
+    }
+
+    QueueType        Queue;
+    Event            ItemEvent;         // Set when an item is pushed while PopWaiters > 0.
+    Event            SpaceEvent;        // Set when an item is popped while PushWaiters > 0.
+    std::atomic<int> PopWaiters;
+    std::atomic<int> PushWaiters;
+};
+
+#endif // OVR_ENABLE_THREADS
+
+
 } // namespace OVR
 
 #endif // OVR_Lockless_h
@@ -0,0 +1,249 @@
+/************************************************************************************
+
+PublicHeader:   None
+Filename    :   OVR_ParallelSort.h
+Content     :   Multi-threaded in-place sort built on the OVR_Alg IntroSort
+Created     :   October 18, 2026
+Notes       :
+
+Copyright   :   Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+
+Licensed under the Oculus VR Rift SDK License Version 3.3 (the "License");
+you may not use the Oculus VR Rift SDK except in compliance with the License,
+which is provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+You may obtain a copy of the License at
+
+http://www.oculusvr.com/licenses/LICENSE-3.3
+
+Unless required by applicable law or agreed to in writing, the Oculus VR SDK
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#ifndef OVR_ParallelSort_h
+#define OVR_ParallelSort_h
+
+#include "OVR_Alg.h"
+#include "OVR_Array.h"
+
+#ifdef OVR_ENABLE_THREADS
+    #include <thread>
+    #include <mutex>
+    #include <condition_variable>
+#endif
+
+namespace OVR { namespace Alg {
+
+
+// Arrays smaller than this are sorted on the calling thread, as starting the worker
+// threads would cost more than it saves.
+static const size_t ParallelSortMinSize = 32768;
+
+// Slices smaller than this are not split any further, but sorted by a single worker.
+static const size_t ParallelSortMinSlice = 4096;
+
+
+#ifdef OVR_ENABLE_THREADS
+
+//-----------------------------------------------------------------------------------
+// ***** ParallelSorter
+//
+// Implements ParallelSortSliced; not intended to be used directly.
+//
+// The threads share a queue of unsorted slices. A worker takes a slice, partitions it,
+// queues the larger side for any idle worker and keeps partitioning the smaller side
+// until it's small enough to IntroSort on its own. The sort is in place, so it works
+// with any array type which IntroSortSliced accepts.
+template<class Array, class Less>
+class ParallelSorter
+{
+public:
+    ParallelSorter(Array& arr, Less less, size_t minSlice)
+      : Arr(arr), LessF(less), MinSlice(minSlice), Outstanding(0) { }
+
+    void Run(size_t start, size_t end, unsigned threadCount)
+    {
+        pushSlice(start, end, IntroSortDepthLimit(end - start));
+
+        // The calling thread is one of the workers.
+        ArrayPOD<std::thread*> threads;
+        for (unsigned i = 1; i < threadCount; ++i)
+            threads.PushBack(new std::thread(&ParallelSorter::workerLoop, this));
+
+        workerLoop();
+
+        for (size_t i = 0; i < threads.GetSize(); ++i)
+        {
+            threads[i]->join();
+            delete threads[i];
+        }
+    }
+
+protected:
+    struct Slice
+    {
+        size_t Start;
+        size_t End;
+        int    DepthLimit;
+    };
+
+    void pushSlice(size_t start, size_t end, int depthLimit)
+    {
+        Slice slice = { start, end, depthLimit };
+
+        std::lock_guard<std::mutex> lock(QueueMutex);
+        Pending.PushBack(slice);
+        Outstanding++;
+        QueueCondition.notify_one();
+    }
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            Slice slice;
+            {
+                std::unique_lock<std::mutex> lock(QueueMutex);
+
+                while (Pending.IsEmpty() && (Outstanding != 0))
+                    QueueCondition.wait(lock);
+
+                if (Outstanding == 0)
+                    return;     // Everything is sorted.
+
+                slice = Pending.Pop();
+            }
+
+            sortSlice(slice);
+
+            std::lock_guard<std::mutex> lock(QueueMutex);
+            if (--Outstanding == 0)
+                QueueCondition.notify_all();
+        }
+    }
+
+    void sortSlice(Slice slice)
+    {
+        while ((slice.End - slice.Start > MinSlice) && (slice.DepthLimit > 0))
+        {
+            slice.DepthLimit--;
+
+            size_t p = PartitionSliced(Arr, slice.Start, slice.End, LessF);
+
+            // Hand off the larger side, keep going with the smaller one.
+            if (p - slice.Start > slice.End - (p + 1))
+            {
+                pushSlice(slice.Start, p, slice.DepthLimit);
+                slice.Start = p + 1;
+            }
+            else
+            {
+                pushSlice(p + 1, slice.End, slice.DepthLimit);
+                slice.End = p;
+            }
+        }
+
+        IntroSortSliced(Arr, slice.Start, slice.End, LessF, slice.DepthLimit);
+    }
+
+    Array&                  Arr;
+    Less                    LessF;
+    size_t                  MinSlice;
+
+    std::mutex              QueueMutex;         // Guards Pending and Outstanding.
+    std::condition_variable QueueCondition;     // Signaled when a slice is queued or the sort completes.
+    ArrayPOD<Slice>         Pending;            // Slices waiting for a worker.
+    size_t                  Outstanding;        // Slices queued or being sorted.
+
+private:
+    ParallelSorter(const ParallelSorter&);
+    void operator = (const ParallelSorter&);
+};
+
+#endif // OVR_ENABLE_THREADS
+
+
+//-----------------------------------------------------------------------------------
+// ***** ParallelSortSliced
+//
+// Sort any part of any array: plain, Array, ArrayPaged, ArrayUnsafe.
+// The range is specified with start, end, where "end" is exclusive!
+// The comparison predicate must be specified, and must be safe to call from several
+// threads at once.
+// threadCount is the number of threads to use including the calling one; 0 means one
+// per hardware thread. Small arrays, and builds without OVR_ENABLE_THREADS, use
+// IntroSortSliced on the calling thread. The order of equal elements is unspecified,
+// as with QuickSort.
+template<class Array, class Less>
+void ParallelSortSliced(Array& arr, size_t start, size_t end, Less less, unsigned threadCount = 0)
+{
+#ifdef OVR_ENABLE_THREADS
+    const size_t size = end - start;
+
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+
+    if ((threadCount > 1) && (size >= ParallelSortMinSize))
+    {
+        // Aim for several slices per thread so that uneven partitions still balance out.
+        const size_t minSlice = Max(size / (threadCount * 8), ParallelSortMinSlice);
+
+        ParallelSorter<Array, Less> sorter(arr, less, minSlice);
+        sorter.Run(start, end, threadCount);
+        return;
+    }
+#else
+    OVR_UNUSED(threadCount);
+#endif
+
+    IntroSortSliced(arr, start, end, less);
+}
+
+template<class Array>
+void ParallelSortSliced(Array& arr, size_t start, size_t end)
+{
+    typedef typename Array::ValueType ValueType;
+    ParallelSortSliced(arr, start, end, OperatorLess<ValueType>::Compare);
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** ParallelSort
+//
+// Sort an array Array, ArrayPaged, ArrayUnsafe, or a plain [first, last) range.
+// The array must have GetSize() function.
+// If no comparison predicate is specified, the data type must have a defined "<" operator.
+template<class Array, class Less>
+void ParallelSort(Array& arr, Less less)
+{
+    ParallelSortSliced(arr, 0, arr.GetSize(), less);
+}
+
+template<class Array>
+void ParallelSort(Array& arr)
+{
+    typedef typename Array::ValueType ValueType;
+    ParallelSortSliced(arr, 0, arr.GetSize(), OperatorLess<ValueType>::Compare);
+}
+
+template<class T, class Less>
+void ParallelSort(T* first, T* last, Less less)
+{
+    ParallelSortSliced(first, 0, (size_t)(last - first), less);
+}
+
+template<class T>
+void ParallelSort(T* first, T* last)
+{
+    ParallelSortSliced(first, 0, (size_t)(last - first), OperatorLess<T>::Compare);
+}
+
+
+}} // namespace OVR::Alg
+
+#endif // OVR_ParallelSort_h
@@ -289,6 +289,20 @@ public:
 };
 
 
+// OVR_MEMORY_REDEFINE_NEW_POOLED for classes derived from RefCountBase or RefCountBaseNTS.
+// The pooled operator delete hides RefCountBaseStatImpl's, so this version repeats its debug
+// check against deleting a ref-counted object other than via Release.
+#ifdef OVR_BUILD_DEBUG
+    #define OVR_REFCOUNT_POOLED_CHECK_DELETE(class_name, p)   \
+        do {if (p) class_name::checkInvalidDelete((class_name*)p); } while(0)
+#else
+    #define OVR_REFCOUNT_POOLED_CHECK_DELETE(class_name, p)
+#endif
+
+#define OVR_REFCOUNT_REDEFINE_NEW_POOLED(class_name) \
+    OVR_MEMORY_REDEFINE_NEW_POOLED_IMPL(class_name, OVR_REFCOUNT_POOLED_CHECK_DELETE)
+
+
 
 
 //-----------------------------------------------------------------------------------
@@ -338,6 +352,13 @@ public:
         pObject = src.pObject;
     }
 
+    // Takes over the reference held by src, which is left null.
+    OVR_FORCE_INLINE Ptr(Ptr<C> &&src)
+        : pObject(src.pObject)
+    {
+        src.pObject = 0;
+    }
+
     template<class R>
     OVR_FORCE_INLINE Ptr(Ptr<R> &src)
     {
@@ -402,6 +423,17 @@ public:
         pObject = src;
         return *this;
     }   
+
+    // Takes over the reference held by src, which is left null.
+    OVR_FORCE_INLINE const Ptr<C>& operator = (Ptr<C> &&src)
+    {
+        C* pnew = src.pObject;
+        src.pObject = 0;
+        if (pObject)
+            pObject->Release();
+        pObject = pnew;
+        return *this;
+    }
     
     OVR_FORCE_INLINE const Ptr<C>& operator = (C *psrc)
     {
@@ -507,6 +539,11 @@ public:
 
 };
 
+// Ptr only holds a counted pointer, so containers may move it with memcpy.
+template<class C>
+struct IsTriviallyRelocatable<Ptr<C> > : std::true_type { };
+
+
 
 // LockedPtr
 //
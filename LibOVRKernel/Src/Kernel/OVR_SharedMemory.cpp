@@ -30,6 +30,8 @@ limitations under the License.
 #include "OVR_String.h"
 #include "OVR_Array.h"
 
+#include <memory>
+
 #if defined(OVR_OS_WIN32)
 #include <Sddl.h> // ConvertStringSecurityDescriptorToSecurityDescriptor
 #endif // OVR_OS_WIN32
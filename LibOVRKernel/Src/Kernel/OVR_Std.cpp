@@ -1149,12 +1149,16 @@ static const GUnicodePairType UnicodeToLowerTable[] = {
 
 int OVR_CDECL OVR_towupper(wchar_t charCode)
 {
+    // ASCII is by far the most common case, and maps the same way in the table.
+    if (charCode < 128)
+        return ((charCode >= 'a') && (charCode <= 'z')) ? (charCode - ('a' - 'A')) : charCode;
+
     // Don't use UnicodeUpperBits! It differs from UnicodeToUpperBits.
     if (UnicodeCharIs(UnicodeToUpperBits, charCode))
     {
         // To protect from memory overrun in case the character is not found
         // we use one extra fake element in the table {65536, 0}.
-        size_t idx = Alg::LowerBoundSliced(
+        size_t idx = Alg::LowerBoundBranchlessSliced(
             UnicodeToUpperTable,
             0,
             sizeof(UnicodeToUpperTable) / sizeof(UnicodeToUpperTable[0]) - 1,
@@ -1167,12 +1171,16 @@ int OVR_CDECL OVR_towupper(wchar_t charCode)
 
 int OVR_CDECL OVR_towlower(wchar_t charCode)
 {
+    // ASCII is by far the most common case, and maps the same way in the table.
+    if (charCode < 128)
+        return ((charCode >= 'A') && (charCode <= 'Z')) ? (charCode + ('a' - 'A')) : charCode;
+
     // Don't use UnicodeLowerBits! It differs from UnicodeToLowerBits.
     if (UnicodeCharIs(UnicodeToLowerBits, charCode))
     {
         // To protect from memory overrun in case the character is not found
         // we use one extra fake element in the table {65536, 0}.
-        size_t idx = Alg::LowerBoundSliced(
+        size_t idx = Alg::LowerBoundBranchlessSliced(
             UnicodeToLowerTable,
             0,
             sizeof(UnicodeToLowerTable) / sizeof(UnicodeToLowerTable[0]) - 1,
@@ -119,6 +119,13 @@ String::String(const String& src)
     pData->AddRef();
 }
 
+String::String(String&& src)
+{
+    pData = src.GetData();
+    src.SetData(&NullData);
+    NullData.AddRef();
+}
+
 String::String(const StringBuffer& src)
 {
     pData = AllocDataCopy1(src.GetSize(), 0, src.ToCStr(), src.GetSize());
@@ -344,6 +351,17 @@ void    String::operator = (const String& src)
 }
 
 
+void    String::operator = (String&& src)
+{
+    DataDesc*    psdata = src.GetData();
+    DataDesc*    pdata = GetData();
+
+    // The old data is released when src is destroyed, so no reference counts change here.
+    SetData(psdata);
+    src.SetData(pdata);
+}
+
+
 void    String::operator = (const StringBuffer& src)
 { 
     DataDesc* polddata = GetData();    
@@ -535,20 +553,48 @@ size_t String::BernsteinHashFunction(const void* pdataIn, size_t size, size_t se
 }
 
 // Hash function, case-insensitive
+//
+// Reads eight bytes at a time and lower-cases all of them at once with bit arithmetic, then
+// mixes the word into the hash with a multiply. OVR_tolower is ASCII-only, and so is this.
+static inline uint64_t FoldCaseASCII8(uint64_t x)
+{
+    const uint64_t ones = UINT64_C(0x0101010101010101);
+    const uint64_t heptets = x & (0x7f * ones);
+    const uint64_t geA = heptets + ((0x80 - 'A') * ones);       // High bit set if the byte is >= 'A'.
+    const uint64_t gtZ = heptets + ((0x80 - 'Z' - 1) * ones);   // High bit set if the byte is > 'Z'.
+    const uint64_t isUpper = geA & ~gtZ & ~x & (0x80 * ones);   // Non-ASCII bytes are never upper case.
+    return x | (isUpper >> 2);                                  // 0x80 >> 2 == 0x20, the case bit.
+}
+
+static inline uint64_t MixHashWord(uint64_t h, uint64_t word)
+{
+    h = (h ^ word) * UINT64_C(0x9E3779B97F4A7C15);
+    return h ^ (h >> 29);
+}
+
 size_t String::BernsteinHashFunctionCIS(const void* pdataIn, size_t size, size_t seed)
 {
-    const uint8_t*    pdata = (const uint8_t*) pdataIn;
-    size_t          h = seed;
-    while (size > 0)
+    const uint8_t* pdata = (const uint8_t*) pdataIn;
+    uint64_t       h = MixHashWord((uint64_t)seed, (uint64_t)size);
+    uint64_t       word;
+
+    for (; size >= sizeof(word); size -= sizeof(word), pdata += sizeof(word))
     {
-        size--;
-        h = ((h << 5) + h) ^ OVR_tolower(pdata[size]);
+        memcpy(&word, pdata, sizeof(word));
+        h = MixHashWord(h, FoldCaseASCII8(word));
     }
 
-    // Alternative: "sdbm" hash function, suggested at same web page above.
-    // h = 0;
-    // for bytes { h = (h << 16) + (h << 6) - hash + *p; }
-    return h;
+    if (size > 0)
+    {
+        word = 0;
+        memcpy(&word, pdata, size);
+        h = MixHashWord(h, FoldCaseASCII8(word));
+    }
+
+    // Hash tables index with the low bits, so fold the well-mixed high bits into them.
+    h *= UINT64_C(0xff51afd7ed558ccd);
+    h ^= (h >> 32);
+    return (size_t)h;
 }
 
 
@@ -634,11 +680,23 @@ void    StringBuffer::Reserve(size_t _size)
 {
     if (_size >= BufferSize) // >= because of trailing zero! (!AB)
     {
-        BufferSize = (_size + 1 + GrowSize - 1) & ~(GrowSize - 1);
+        size_t newBufferSize = (_size + 1 + GrowSize - 1) & ~(GrowSize - 1);
+
         if (!pData)
-            pData = (char*)OVR_ALLOC(BufferSize);
-        else 
-            pData = (char*)OVR_REALLOC(pData, BufferSize);
+            pData = (char*)OVR_ALLOC(newBufferSize);
+        else
+        {
+            // Grow by at least 50%, so that repeated appends to a long string don't copy 
+            // the whole buffer every GrowSize bytes.
+            size_t minBufferSize = (BufferSize + (BufferSize >> 1) + GrowSize - 1) & ~(GrowSize - 1);
+            if (newBufferSize < minBufferSize)
+                newBufferSize = minBufferSize;
+
+            if (!OVR_TRY_EXPAND(pData, newBufferSize))
+                pData = (char*)OVR_REALLOC(pData, newBufferSize);
+        }
+
+        BufferSize = newBufferSize;
     }
 }
 
@@ -170,6 +170,7 @@ public:
     String(const char* data1, const char* pdata2, const char* pdata3 = 0);
     String(const char* data, size_t buflen);
     String(const String& src);
+    String(String&& src);               // src is left empty.
     String(const StringBuffer& src);
     String(const InitStruct& src, size_t size);
     explicit String(const wchar_t* data);      
@@ -259,7 +260,9 @@ public:
         return OVR_strnicmp(a, b, len);
     }
 
-    // Hash function, case-insensitive
+    // Hash function, case-insensitive (ASCII only). Processes a word at a time, so it's much
+    // cheaper than BernsteinHashFunction for all but very short strings. Despite the name
+    // it isn't a Bernstein hash.
     static size_t OVR_STDCALL BernsteinHashFunctionCIS(const void* pdataIn, size_t size, size_t seed = 5381);
 
     // Hash function, case-sensitive
@@ -296,6 +299,7 @@ public:
     void        operator =  (const char* str);
     void        operator =  (const wchar_t* str);
     void        operator =  (const String& src);
+    void        operator =  (String&& src);      // Swaps the data with src.
     void        operator =  (const StringBuffer& src);
 
     // Addition
@@ -390,6 +394,54 @@ public:
         return !(CompareNoCase(ToCStr(), strKey.pStr->ToCStr()) == 0);
     }
 
+    // Keys for looking up strings in NoCaseHashFunctor tables (e.g. StringHash) without
+    // constructing a String. The hash is computed when the key is constructed, so a key
+    // which is kept around (e.g. a static one for a constant name) costs only the table
+    // probe on each lookup. The string must outlive the key.
+    // HashedKey matches case-sensitively, like String keys; NoCaseHashedKey doesn't.
+    struct HashedKey
+    {
+        const char* pStr;
+        size_t      Size;
+        size_t      Hash;                               // BernsteinHashFunctionCIS(pStr, Size)
+
+        explicit HashedKey(const char* str)
+            : pStr(str), Size(OVR_strlen(str)), Hash(BernsteinHashFunctionCIS(str, Size)) { }
+        HashedKey(const char* str, size_t size)
+            : pStr(str), Size(size), Hash(BernsteinHashFunctionCIS(str, size)) { }
+        HashedKey(const char* str, size_t size, size_t hash)  // hash must come from BernsteinHashFunctionCIS.
+            : pStr(str), Size(size), Hash(hash) { OVR_ASSERT(hash == BernsteinHashFunctionCIS(str, size)); }
+        explicit HashedKey(const String& str)
+            : pStr(str.ToCStr()), Size(str.GetSize()), Hash(BernsteinHashFunctionCIS(pStr, Size)) { }
+    };
+
+    struct NoCaseHashedKey : public HashedKey
+    {
+        explicit NoCaseHashedKey(const char* str)              : HashedKey(str) { }
+        NoCaseHashedKey(const char* str, size_t size)           : HashedKey(str, size) { }
+        NoCaseHashedKey(const char* str, size_t size, size_t hash) : HashedKey(str, size, hash) { }
+        explicit NoCaseHashedKey(const String& str)            : HashedKey(str) { }
+    };
+
+    bool    operator == (const HashedKey& key) const
+    {
+        return (GetSize() == key.Size) && (memcmp(ToCStr(), key.pStr, key.Size) == 0);
+    }
+    bool    operator != (const HashedKey& key) const
+    {
+        return !operator == (key);
+    }
+
+    // Case folding is ASCII-only, so strings which match case-insensitively have the same size.
+    bool    operator == (const NoCaseHashedKey& key) const
+    {
+        return (GetSize() == key.Size) && (CompareNoCase(ToCStr(), key.pStr, key.Size) == 0);
+    }
+    bool    operator != (const NoCaseHashedKey& key) const
+    {
+        return !operator == (key);
+    }
+
     // Hash functor used for strings.
     struct HashFunctor
     {    
@@ -413,10 +465,22 @@ public:
             size_t size = data.pStr->GetSize();
             return String::BernsteinHashFunctionCIS((const char*)data.pStr->ToCStr(), size);
         }
+        size_t operator()(const char* data) const
+        {
+            return String::BernsteinHashFunctionCIS(data, OVR_strlen(data));
+        }
+        size_t operator()(const HashedKey& data) const
+        {
+            return data.Hash;
+        }
     };
 
 };
 
+// String only holds a reference counted pointer to its data, so containers may move it with memcpy.
+template<>
+struct IsTriviallyRelocatable<String> : std::true_type { };
+
 
 //-----------------------------------------------------------------------------------
 // ***** String Buffer used for Building Strings
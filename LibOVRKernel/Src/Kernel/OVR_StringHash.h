@@ -53,6 +53,23 @@ public:
 
     void    operator = (const SelfType& src) { BaseType::operator = (src); }
 
+    // Lookups by C string or String::HashedKey, which don't construct a temporary String.
+    // A HashedKey carries its hash, so one kept for a constant name is a single probe:
+    //     static const String::HashedKey WidthKey("Width");
+    //     const U* width = table.Get(WidthKey);
+    using BaseType::Get;
+    using BaseType::Remove;
+
+    bool     Get(const char* key, U* pvalue) const                { return BaseType::GetAlt(key, pvalue); }
+    const U* Get(const char* key) const                           { return BaseType::GetAlt(key); }
+    U*       Get(const char* key)                                 { return BaseType::GetAlt(key); }
+    bool     Get(const String::HashedKey& key, U* pvalue) const   { return BaseType::GetAlt(key, pvalue); }
+    const U* Get(const String::HashedKey& key) const              { return BaseType::GetAlt(key); }
+    U*       Get(const String::HashedKey& key)                    { return BaseType::GetAlt(key); }
+
+    void     Remove(const char* key)                              { BaseType::RemoveAlt(key); }
+    void     Remove(const String::HashedKey& key)                 { BaseType::RemoveAlt(key); }
+
     bool    GetCaseInsensitive(const String& key, U* pvalue) const
     {
         String::NoCaseKey ikey(key);
@@ -70,6 +87,13 @@ public:
         return BaseType::GetAlt(ikey);
     }
 
+    bool     GetCaseInsensitive(const char* key, U* pvalue) const                 { return BaseType::GetAlt(String::NoCaseHashedKey(key), pvalue); }
+    const U* GetCaseInsensitive(const char* key) const                            { return BaseType::GetAlt(String::NoCaseHashedKey(key)); }
+    U*       GetCaseInsensitive(const char* key)                                  { return BaseType::GetAlt(String::NoCaseHashedKey(key)); }
+    bool     GetCaseInsensitive(const String::NoCaseHashedKey& key, U* pvalue) const { return BaseType::GetAlt(key, pvalue); }
+    const U* GetCaseInsensitive(const String::NoCaseHashedKey& key) const         { return BaseType::GetAlt(key); }
+    U*       GetCaseInsensitive(const String::NoCaseHashedKey& key)               { return BaseType::GetAlt(key); }
+
     
     typedef typename BaseType::Iterator base_iterator;
 
@@ -102,7 +102,7 @@ public:
 
 protected:
     Lock ListLock;
-    Array< WatchDog* > DogList;
+    ArrayInline< WatchDog*, 16 > DogList; // There are normally only a few watchdogs, so we avoid allocating.
 
     // This indicates that EnableReporting() was requested
     bool IsReporting = false;
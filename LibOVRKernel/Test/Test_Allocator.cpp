@@ -0,0 +1,363 @@
+/************************************************************************************
+
+Filename    :   Test_Allocator.cpp
+Content     :   Tests of the Heap implementations in OVR_Allocator.h
+Created     :   October 18, 2026
+Notes       :   See Test_Common.h for how to build and run.
+
+Copyright   :   Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+
+Licensed under the Oculus VR Rift SDK License Version 3.3 (the "License");
+you may not use the Oculus VR Rift SDK except in compliance with the License,
+which is provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+You may obtain a copy of the License at
+
+http://www.oculusvr.com/licenses/LICENSE-3.3
+
+Unless required by applicable law or agreed to in writing, the Oculus VR SDK
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#include "Test_Common.h"
+#include "Kernel/OVR_System.h"
+#include "Kernel/OVR_Allocator.h"
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+using namespace OVR;
+using namespace OVR::Test;
+
+OVR_TEST_FAILURE_COUNT_DEFINITION;
+
+
+static bool IsAligned(const void* p, size_t align)
+{
+    return ((reinterpret_cast<uintptr_t>(p) & (align - 1)) == 0);
+}
+
+// Fills the first size bytes of p with a pattern which depends on seed.
+static void Fill(void* p, size_t size, uint8_t seed)
+{
+    for (size_t i = 0; i < size; ++i)
+        static_cast<uint8_t*>(p)[i] = (uint8_t)(seed + i);
+}
+
+static bool CheckFill(const void* p, size_t size, uint8_t seed)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (static_cast<const uint8_t*>(p)[i] != (uint8_t)(seed + i))
+            return false;
+    }
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** AllocTrackingTable
+//
+
+// Entries inserted and removed while another thread clears the table must stay consistent with
+// MayContain, which the Allocator relies on to skip the table lock when freeing. Otherwise an
+// entry can be left which Free never removes.
+static void TestAllocTrackingTableClearRace()
+{
+    std::unique_ptr<AllocTrackingTable> table(new AllocTrackingTable); // Too large for the stack.
+    const int                           threadCount = 4;
+    const uintptr_t                     insertCount = 200000;
+    std::atomic<bool>                   done(false);
+    std::vector<std::thread>            threads;
+
+    auto MakePointer = [](int threadIndex, uintptr_t i) -> const void* {
+        return reinterpret_cast<const void*>(((uintptr_t)(threadIndex + 1) << 24) + (i * 16));
+    };
+
+    std::thread clearThread([&]()
+    {
+        while (!done.load())
+            table->Clear();
+    });
+
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            AllocMetadata amd;
+
+            for (uintptr_t i = 0; i < insertCount; ++i)
+            {
+                amd.Alloc = MakePointer(t, i);
+                table->Insert(amd);
+
+                if (i & 1)
+                    table->Remove(amd.Alloc);
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    done.store(true);
+    clearThread.join();
+
+    // Every remaining entry must be visible to MayContain, and removing them all must leave no
+    // filter counts behind.
+    std::vector<const void*> remaining;
+    AllocTrackingTable::Iterator it;
+
+    table->LockAll();
+    for (const AllocMetadata* amd = table->IterateBegin(it); amd; amd = table->IterateNext(it))
+        remaining.push_back(amd->Alloc);
+    table->UnlockAll();
+
+    for (const void* p : remaining)
+    {
+        OVR_TEST_CHECK(table->MayContain(p));
+        OVR_TEST_CHECK(table->Remove(p));
+    }
+
+    OVR_TEST_CHECK(table->GetSize() == 0);
+
+    size_t falsePositiveCount = 0;
+
+    for (int t = 0; t < threadCount; ++t)
+    {
+        for (uintptr_t i = 0; i < insertCount; ++i)
+            falsePositiveCount += table->MayContain(MakePointer(t, i));
+    }
+
+    OVR_TEST_CHECK(falsePositiveCount == 0);
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** ThreadCachingHeap
+//
+
+// Creates a ThreadCachingHeap which wraps a DefaultHeap, the way the Allocator does.
+static ThreadCachingHeap* CreateThreadCachingHeap()
+{
+    Heap* wrappedHeap = new(SysMemAlloc(sizeof(DefaultHeap))) DefaultHeap;
+    wrappedHeap->Init();
+
+    ThreadCachingHeap* heap = new(SysMemAlloc(sizeof(ThreadCachingHeap))) ThreadCachingHeap(wrappedHeap, sizeof(DefaultHeap));
+    heap->Init();
+    return heap;
+}
+
+static void DestroyThreadCachingHeap(ThreadCachingHeap* heap)
+{
+    heap->Shutdown(); // Also shuts down and frees the DefaultHeap.
+    heap->~ThreadCachingHeap();
+    SysMemFree(heap, sizeof(ThreadCachingHeap));
+}
+
+
+// Every ReallocAligned result must have the requested alignment, whether the block was cached,
+// large or over-aligned before, and whatever the wrapped heap's own alignment is.
+static void TestThreadCachingHeapReallocAligned()
+{
+    ThreadCachingHeap* heap = CreateThreadCachingHeap();
+    const size_t       aligns[] = { 1, 4, 8, 16, 32, 64, 256, 4096 };
+    const size_t       sizes[]  = { 1, 24, 200, 1024, 1500, 5000, 100, 8 };
+
+    for (size_t align : aligns)
+    {
+        // Starts with a regular block, so the first ReallocAligned may need to move it.
+        size_t size = 40;
+        void*  p = heap->Alloc(size);
+        Fill(p, size, (uint8_t)align);
+
+        for (size_t newSize : sizes)
+        {
+            p = heap->ReallocAligned(p, newSize, align);
+
+            OVR_TEST_CHECK(p != nullptr);
+            OVR_TEST_CHECK(IsAligned(p, align));
+            OVR_TEST_CHECK(heap->GetAllocSize(p) >= newSize);
+            OVR_TEST_CHECK(CheckFill(p, std::min(size, newSize), (uint8_t)align));
+
+            size = newSize;
+            Fill(p, size, (uint8_t)align);
+        }
+
+        heap->FreeAligned(p);
+
+        // From nothing, like realloc(nullptr, ...).
+        p = heap->ReallocAligned(nullptr, 100, align);
+        OVR_TEST_CHECK((p != nullptr) && IsAligned(p, align));
+        heap->FreeAligned(p);
+    }
+
+    DestroyThreadCachingHeap(heap);
+}
+
+
+// Threads which use the heap and exit one after another mustn't each leave a cache behind.
+static void TestThreadCachingHeapThreadChurn()
+{
+    ThreadCachingHeap* heap = CreateThreadCachingHeap();
+    const int          threadCount = 100;
+
+    for (int t = 0; t < threadCount; ++t)
+    {
+        std::thread thread([heap]()
+        {
+            void* blocks[32];
+
+            for (size_t i = 0; i < 32; ++i)
+                blocks[i] = heap->Alloc(16 * (i + 1));
+            for (size_t i = 0; i < 32; ++i)
+                heap->Free(blocks[i]);
+        });
+
+        thread.join();
+    }
+
+    // Platforms where thread liveness can't be checked keep every cache.
+    #if defined(_WIN32) || defined(__linux__)
+        OVR_TEST_CHECK(heap->GetThreadCacheCount() <= (ThreadCachingHeap::ThreadCacheReuseThreshold + 1));
+    #endif
+
+    DestroyThreadCachingHeap(heap);
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** DebugPageHeap
+//
+
+// Frees count page-sized blocks, which the heap keeps inaccessible for a while.
+static void AllocAndFree(DebugPageHeap* heap, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        heap->Free(heap->Alloc(64));
+}
+
+
+// Blocks delay-freed by threads which have since exited mustn't keep using up MaxDelayedFreeCount,
+// or the remaining threads would purge their own frees right away and use-after-free detection
+// would stop working for them.
+static void TestDebugPageHeapThreadChurn()
+{
+    DebugPageHeap* heap = new(SysMemAlloc(sizeof(DebugPageHeap))) DebugPageHeap;
+    const size_t   maxDelayedFreeCount = 64;
+    const int      threadCount = 20; // More than FreeRingReuseThreshold, so rings are also taken over.
+
+    heap->Init();
+    heap->SetMaxDelayedFreeCount(maxDelayedFreeCount);
+    AllocAndFree(heap, 1); // So this thread has its ring before the others exit, and won't take theirs over.
+
+    for (int t = 0; t < threadCount; ++t)
+    {
+        std::thread thread([heap, maxDelayedFreeCount]()
+        {
+            AllocAndFree(heap, maxDelayedFreeCount);
+        });
+
+        thread.join();
+    }
+
+    OVR_TEST_CHECK(heap->GetDelayedFreeCount() <= (maxDelayedFreeCount + threadCount));
+
+    // Platforms where thread liveness can't be checked keep the exited threads' blocks.
+    #if defined(_WIN32) || defined(__linux__)
+        AllocAndFree(heap, DebugPageHeap::ExitedRingCheckInterval + (2 * maxDelayedFreeCount));
+        OVR_TEST_CHECK(heap->GetThreadDelayedFreeCount() == maxDelayedFreeCount);
+        OVR_TEST_CHECK(heap->GetDelayedFreeCount() == maxDelayedFreeCount);
+    #endif
+
+    heap->Shutdown();
+    heap->~DebugPageHeap();
+    SysMemFree(heap, sizeof(DebugPageHeap));
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** PoolAllocator
+//
+
+class PooledObject
+{
+public:
+    OVR_MEMORY_REDEFINE_NEW_POOLED(PooledObject)
+
+    uint64_t Value[4];
+};
+
+
+static void AppendTraceText(uintptr_t context, const char* text)
+{
+    reinterpret_cast<std::string*>(context)->append(text);
+}
+
+
+// Pooled objects take their memory from the pool's slabs rather than the Allocator's heap, but
+// while tracking is enabled a leaked one must still be reported like any other allocation.
+static void TestPoolAllocatorLeakReport()
+{
+    Allocator* allocator   = Allocator::GetInstance();
+    const bool wasTracking = allocator->IsTrackingEnabled();
+
+    if (!allocator->EnableTracking(true)) // Tracking can't be changed while the DebugPageHeap is in use.
+        return;
+
+    PooledObject* leaked = new PooledObject;
+    PooledObject* freed  = new PooledObject;
+    delete freed;
+
+    bool leakedFound = false;
+    bool freedFound  = false;
+
+    for (const AllocMetadata* amd = allocator->IterateHeapBegin(); amd; amd = allocator->IterateHeapNext())
+    {
+        if (amd->Alloc == leaked)
+            leakedFound = (amd->Tag && (strcmp(amd->Tag, "PooledObject") == 0));
+        else if (amd->Alloc == freed)
+            freedFound = true;
+    }
+    allocator->IterateHeapEnd();
+
+    OVR_TEST_CHECK(leakedFound);
+    OVR_TEST_CHECK(!freedFound);
+
+    std::string report;
+    OVR_TEST_CHECK(allocator->TraceTrackedAllocations(AppendTraceText, reinterpret_cast<uintptr_t>(&report)) >= 1);
+    OVR_TEST_CHECK(report.find("PooledObject") != std::string::npos);
+
+    delete leaked;
+
+    for (const AllocMetadata* amd = allocator->IterateHeapBegin(); amd; amd = allocator->IterateHeapNext())
+        OVR_TEST_CHECK(amd->Alloc != leaked);
+    allocator->IterateHeapEnd();
+
+    allocator->EnableTracking(wasTracking);
+}
+
+
+int main()
+{
+    OVR::System::Init();
+
+    TestAllocTrackingTableClearRace();
+    TestThreadCachingHeapReallocAligned();
+    TestThreadCachingHeapThreadChurn();
+    TestDebugPageHeapThreadChurn();
+    TestPoolAllocatorLeakReport();
+
+    OVR::System::Destroy();
+    return Finish("Test_Allocator");
+}
@@ -0,0 +1,69 @@
+/************************************************************************************
+
+PublicHeader:   None
+Filename    :   Test_Common.h
+Content     :   Check and reporting helpers shared by the Kernel tests
+Created     :   October 18, 2026
+Notes       :   Each Test_*.cpp in this directory is a standalone program which
+                links against LibOVRKernel, e.g. with the Src directory as the
+                include path:
+                    cl /EHsc /I..\Src Test_Allocator.cpp LibOVRKernel.lib
+                A test prints each failed check and exits with a nonzero code if any failed.
+
+Copyright   :   Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+
+Licensed under the Oculus VR Rift SDK License Version 3.3 (the "License");
+you may not use the Oculus VR Rift SDK except in compliance with the License,
+which is provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+You may obtain a copy of the License at
+
+http://www.oculusvr.com/licenses/LICENSE-3.3
+
+Unless required by applicable law or agreed to in writing, the Oculus VR SDK
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#ifndef Test_Common_h
+#define Test_Common_h
+
+#include "Kernel/OVR_Types.h"
+#include <stdio.h>
+
+namespace OVR { namespace Test {
+
+
+// Number of checks which have failed so far.
+extern int FailureCount;
+#define OVR_TEST_FAILURE_COUNT_DEFINITION int OVR::Test::FailureCount = 0
+
+inline void ReportFailure(const char* expression, const char* file, int line)
+{
+    printf("%s(%d): check failed: %s\n", file, line, expression);
+    ++FailureCount;
+}
+
+// Records a failure if expression is false, and carries on with the test.
+#define OVR_TEST_CHECK(expression) \
+    ((expression) ? (void)0 : OVR::Test::ReportFailure(#expression, __FILE__, __LINE__))
+
+// Prints the result and returns the exit code for main.
+inline int Finish(const char* testName)
+{
+    if (FailureCount)
+        printf("%s: %d check(s) failed\n", testName, FailureCount);
+    else
+        printf("%s: passed\n", testName);
+
+    return (FailureCount ? 1 : 0);
+}
+
+
+}} // namespace OVR::Test
+
+#endif // Test_Common_h
@@ -0,0 +1,129 @@
+/************************************************************************************
+
+Filename    :   Test_ChaperoneQuadStream.cpp
+Content     :   Publishes quad sets through the shared memory region and reads them
+                back the way a viewer would, including sets which don't fit
+Created     :   October 18, 2026
+Notes       :   Builds like the Kernel tests (see LibOVRKernel/Test/Test_Common.h), with
+                the repo root, openvr/headers and LibOVRKernel/Test also on the include path.
+
+************************************************************************************/
+
+#include "Test_Common.h"
+#include "Kernel/OVR_System.h"
+#include "openvr.h"
+#include "ChaperoneQuadStream.h"
+#include <vector>
+
+using namespace OVR::Test;
+
+OVR_TEST_FAILURE_COUNT_DEFINITION;
+
+
+// Each test uses its own region, so a converter running on the same machine isn't disturbed.
+static const char* const TestStreamName = "Guardian2Chaperone_QuadStreamTest";
+
+
+static std::vector<vr::HmdQuad_t> MakeQuads(int quadCount)
+{
+    std::vector<vr::HmdQuad_t> quads(quadCount);
+
+    for (int i = 0; i < quadCount; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            quads[i].vCorners[c].v[0] = (float)i;
+            quads[i].vCorners[c].v[1] = (float)c;
+            quads[i].vCorners[c].v[2] = (float)(i * 4 + c);
+        }
+    }
+
+    return quads;
+}
+
+
+static bool QuadsMatch(const ChaperoneQuadSet& set, const std::vector<vr::HmdQuad_t>& quads)
+{
+    for (uint32_t i = 0; i < set.QuadCount; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                if (set.Quads[i].Corners[c][k] != quads[i].vCorners[c].v[k])
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+static void TestRoundTrip()
+{
+    ChaperoneQuadPublisher  publisher;
+    ChaperoneQuadSubscriber subscriber;
+    ChaperoneQuadSet        set;
+    const float             origin[3] = { 1.0f, 2.0f, 3.0f };
+
+    // On POSIX a closed region stays behind until it's created again, so the reader is only
+    // opened once the publisher has recreated it.
+    OVR_TEST_CHECK(publisher.Open(TestStreamName));
+    OVR_TEST_CHECK(subscriber.Open(TestStreamName));
+
+    // Nothing published yet.
+    OVR_TEST_CHECK(!subscriber.GetLatest(set));
+
+    const std::vector<vr::HmdQuad_t> quads = MakeQuads(10);
+    OVR_TEST_CHECK(publisher.Publish(origin, quads.data(), (int)quads.size()));
+
+    OVR_TEST_CHECK(subscriber.GetLatest(set));
+    OVR_TEST_CHECK(set.Sequence == 1);
+    OVR_TEST_CHECK(set.QuadCount == 10);
+    OVR_TEST_CHECK(set.TotalQuadCount == 10);
+    OVR_TEST_CHECK(!set.IsTruncated());
+    OVR_TEST_CHECK((set.Origin[0] == 1.0f) && (set.Origin[1] == 2.0f) && (set.Origin[2] == 3.0f));
+    OVR_TEST_CHECK(QuadsMatch(set, quads));
+
+    // A set larger than the region holds is cut to MaxQuads, and says so.
+    const int largeCount = ChaperoneQuadSet::MaxQuads + 44;
+    const std::vector<vr::HmdQuad_t> largeQuads = MakeQuads(largeCount);
+    OVR_TEST_CHECK(publisher.Publish(origin, largeQuads.data(), largeCount));
+
+    OVR_TEST_CHECK(subscriber.GetLatest(set));
+    OVR_TEST_CHECK(set.Sequence == 2);
+    OVR_TEST_CHECK(set.QuadCount == (uint32_t)ChaperoneQuadSet::MaxQuads);
+    OVR_TEST_CHECK(set.TotalQuadCount == (uint32_t)largeCount);
+    OVR_TEST_CHECK(set.IsTruncated());
+    OVR_TEST_CHECK(QuadsMatch(set, largeQuads));
+
+    // Publishing a set which fits again clears the flag.
+    OVR_TEST_CHECK(publisher.Publish(origin, quads.data(), (int)quads.size()));
+    OVR_TEST_CHECK(subscriber.GetLatest(set));
+    OVR_TEST_CHECK(set.Sequence == 3);
+    OVR_TEST_CHECK(!set.IsTruncated());
+}
+
+
+static void TestClosedPublisher()
+{
+    ChaperoneQuadPublisher publisher;
+    const float            origin[3] = {};
+    const std::vector<vr::HmdQuad_t> quads = MakeQuads(1);
+
+    // Publishing before the region is open fails rather than writing anywhere.
+    OVR_TEST_CHECK(!publisher.Publish(origin, quads.data(), (int)quads.size()));
+}
+
+
+int main()
+{
+    OVR::System::Init();
+
+    TestRoundTrip();
+    TestClosedPublisher();
+
+    OVR::System::Destroy();
+    return Finish("Test_ChaperoneQuadStream");
+}
@@ -3,6 +3,7 @@
 #pragma warning(disable: 4324)
 #include "OVR_CAPI_D3D.h" // Oculus SDK
 #include "openvr.h"
+#include "ChaperoneQuadStream.h"
 #include <vector>
 #include <thread>
 #include <chrono>
@@ -13,7 +14,10 @@ class Guardian2Chaperone
 public:
     void Start();
 
-
+protected:
+    // Owned by the app rather than Start() so the shared region outlives a single pass and
+    // viewers have time to attach.
+    ChaperoneQuadPublisher Publisher;
 };
 
 
@@ -47,6 +51,9 @@ void Guardian2Chaperone::Start()
     // Use Eye level origin -- seems to correspond with SteamVR "raw" origin
 	ovr_SetTrackingOriginType(mSession, ovrTrackingOrigin_EyeLevel);
 
+	// Each boundary is read as count-then-data. ovr_GetBoundaryGeometry takes no buffer capacity and
+	// writes every point it has, so reading in one call into a buffer sized from an earlier count
+	// would overflow as soon as the boundary grew.
 	int numOfPlayPoints;
 	if (!OVR_SUCCESS(ovr_GetBoundaryGeometry(mSession, ovrBoundaryType::ovrBoundary_PlayArea, NULL, &numOfPlayPoints))) {
 		printf("Getting number of boundary points failed"); exit(-1);
@@ -145,6 +152,16 @@ void Guardian2Chaperone::Start()
 		
 	}
 
+	// Let an external viewer see the converted bounds without screenshotting SteamVR
+	if (Publisher.Open()) {
+		const float publishedOrigin[3] = { origin.x, origin.y, origin.z };
+		Publisher.Publish(publishedOrigin, quads.data(), numOfGuardianPoints);
+
+		if (numOfGuardianPoints > ChaperoneQuadSet::MaxQuads) {
+			printf("Published only %d of %d bounds quads to viewers\n", ChaperoneQuadSet::MaxQuads, numOfGuardianPoints);
+		}
+	}
+
 
 	
 	vr::VRChaperoneSetup()->SetWorkingStandingZeroPoseToRawTrackingPose(&standingZero);
@@ -181,7 +198,11 @@ void Guardian2Chaperone::Start()
 
 int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 {
+    OVR::System::Init();
     Guardian2Chaperone* instance = new (_aligned_malloc(sizeof(Guardian2Chaperone), 16)) Guardian2Chaperone();
     instance->Start();
+    instance->~Guardian2Chaperone(); // Closes the shared region before the Kernel shuts down.
+    _aligned_free(instance);
+    OVR::System::Destroy();
     return 0;
 }